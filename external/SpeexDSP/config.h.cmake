@@ -52,6 +52,9 @@
 // Use FFT from OggVorbis
 #cmakedefine USE_SMALLFT
 
+// Approximate the preprocessor gain computation
+#cmakedefine FAST_MATH_APPROX
+
 // Use FFTW3 for FFT
 #cmakedefine USE_GPL_FFTW3
 
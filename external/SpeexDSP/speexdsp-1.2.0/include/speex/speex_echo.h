@@ -59,6 +59,26 @@ extern "C" {
 /** Get impulse response (int32[]) */
 #define SPEEX_ECHO_GET_IMPULSE_RESPONSE 29
 
+/* Can't set snapshot size */
+/** Get size in bytes of the adaptive state snapshot (int32) */
+#define SPEEX_ECHO_GET_STATE_SIZE 31
+/** Restore adaptive state from a snapshot taken with the same frame size,
+ * filter length and channel counts (char[], returns -1 on mismatch) */
+#define SPEEX_ECHO_SET_STATE 32
+/** Save adaptive state (filter weights and adaptation statistics, but not the
+ * signal history) to a snapshot (char[] of SPEEX_ECHO_GET_STATE_SIZE bytes) */
+#define SPEEX_ECHO_GET_STATE 33
+
+/** Enable sparse partition evaluation (int32): filter partitions holding a negligible part of
+ * the echo path energy are left out of the filter output and only adapted every N-th frame,
+ * where N is the value set. They are re-activated when their energy grows or when the echo path
+ * appears to change. 0 (default) disables sparse evaluation. */
+#define SPEEX_ECHO_SET_SPARSE 34
+/** Get sparse evaluation decimation (int32) */
+#define SPEEX_ECHO_GET_SPARSE 35
+/** Get the number of partitions evaluated in the last frame (int32) */
+#define SPEEX_ECHO_GET_ACTIVE_PARTITIONS 36
+
 /** Internal echo canceller state. Should never be accessed directly. */
 struct SpeexEchoState_;
 
@@ -85,6 +105,57 @@ SpeexEchoState *speex_echo_state_init(int frame_size, int filter_length);
  */
 SpeexEchoState *speex_echo_state_init_mc(int frame_size, int filter_length, int nb_mic, int nb_speakers);
 
+/** Internal far-end analyser state. Should never be accessed directly. */
+struct SpeexEchoReference_;
+
+/** Far-end analyser shared by several echo cancellers that hear the same loudspeaker signal
+ * (e.g. all the legs of a conference). It computes the far-end history and spectra once per
+ * frame; cancellers created with speex_echo_state_init_shared() use them read-only.
+*/
+typedef struct SpeexEchoReference_ SpeexEchoReference;
+
+/** Creates a new far-end analyser
+ * @param frame_size Number of samples to process at one time
+ * @param filter_length Number of samples of echo to cancel
+ * @param nb_speakers Number of speaker channels
+ * @return Newly-created far-end analyser
+ */
+SpeexEchoReference *speex_echo_reference_init(int frame_size, int filter_length, int nb_speakers);
+
+/** Destroys a far-end analyser. All the cancellers using it must be destroyed first.
+ * @param ref Far-end analyser
+*/
+void speex_echo_reference_destroy(SpeexEchoReference *ref);
+
+/** Clears the far-end history
+ * @param ref Far-end analyser
+*/
+void speex_echo_reference_reset(SpeexEchoReference *ref);
+
+/** Analyses one frame of the far end. Must be called once per frame, before
+ * speex_echo_cancellation() of every canceller sharing the analyser.
+ * @param ref Far-end analyser
+ * @param play Signal played to the speaker (received from far end)
+*/
+void speex_echo_reference_update(SpeexEchoReference *ref, const spx_int16_t *play);
+
+/** Same as speex_echo_reference_update() with float samples, full scale at +/-1.0.
+ * Only available in floating point builds.
+ * @param ref Far-end analyser
+ * @param play Signal played to the speaker (received from far end)
+*/
+void speex_echo_reference_update_float(SpeexEchoReference *ref, const float *play);
+
+/** Creates an echo canceller which takes its far end from a shared analyser. The play argument
+ * of speex_echo_cancellation() is ignored for such a canceller and may be NULL.
+ * @param frame_size Must match the analyser
+ * @param filter_length Must match the analyser
+ * @param nb_mic Number of microphone channels
+ * @param ref Far-end analyser, must outlive the canceller
+ * @return Newly-created echo canceller state, NULL if the analyser doesn't match
+ */
+SpeexEchoState *speex_echo_state_init_shared(int frame_size, int filter_length, int nb_mic, SpeexEchoReference *ref);
+
 /** Destroys an echo canceller state
  * @param st Echo canceller state
 */
@@ -100,6 +171,16 @@ void speex_echo_state_destroy(SpeexEchoState *st);
  */
 void speex_echo_cancellation(SpeexEchoState *st, const spx_int16_t *rec, const spx_int16_t *play, spx_int16_t *out);
 
+/** Same as speex_echo_cancellation() with float samples, full scale at +/-1.0. The output is
+ * not clipped. Only available in floating point builds.
+ *
+ * @param st Echo canceller state
+ * @param rec Signal from the microphone (near end + far end echo)
+ * @param play Signal played to the speaker (received from far end)
+ * @param out Returns near-end signal with echo removed
+ */
+void speex_echo_cancellation_float(SpeexEchoState *st, const float *rec, const float *play, float *out);
+
 /** Performs echo cancellation a frame (deprecated) */
 void speex_echo_cancel(SpeexEchoState *st, const spx_int16_t *rec, const spx_int16_t *play, spx_int16_t *out, spx_int32_t *Yout);
 
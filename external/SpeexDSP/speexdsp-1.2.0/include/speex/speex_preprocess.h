@@ -69,6 +69,12 @@ SpeexPreprocessState *speex_preprocess_state_init(int frame_size, int sampling_r
 */
 void speex_preprocess_state_destroy(SpeexPreprocessState *st);
 
+/** Resets a preprocessor to its original state: default parameters and no adaptation. The
+ * buffers are kept, so this is cheaper than destroying and initialising a new state.
+ * @param st Preprocessor state
+ */
+void speex_preprocess_state_reset(SpeexPreprocessState *st);
+
 /** Preprocess a frame
  * @param st Preprocessor state
  * @param x Audio sample vector (in and out). Must be same size as specified in speex_preprocess_state_init().
@@ -76,6 +82,14 @@ void speex_preprocess_state_destroy(SpeexPreprocessState *st);
 */
 int speex_preprocess_run(SpeexPreprocessState *st, spx_int16_t *x);
 
+/** Same as speex_preprocess_run() with float samples, full scale at +/-1.0. The output is
+ * not clipped. Only available in floating point builds.
+ * @param st Preprocessor state
+ * @param x Audio sample vector (in and out). Must be same size as specified in speex_preprocess_state_init().
+ * @return Bool value for voice activity (1 for speech, 0 for noise/silence), ONLY if VAD turned on.
+*/
+int speex_preprocess_run_float(SpeexPreprocessState *st, float *x);
+
 /** Preprocess a frame (deprecated, use speex_preprocess_run() instead)*/
 int speex_preprocess(SpeexPreprocessState *st, spx_int16_t *x, spx_int32_t *echo);
 
@@ -211,6 +225,123 @@ int speex_preprocess_ctl(SpeexPreprocessState *st, int request, void *ptr);
 /** Get preprocessor Automatic Gain Control level (int32) */
 #define SPEEX_PREPROCESS_GET_AGC_TARGET 47
 
+/* Can't set snapshot size */
+/** Get size in bytes of the adaptive state snapshot (int32) */
+#define SPEEX_PREPROCESS_GET_STATE_SIZE 49
+/** Restore adaptive state from a snapshot taken with the same frame size and
+ * sampling rate (char[], returns -1 on mismatch) */
+#define SPEEX_PREPROCESS_SET_STATE 50
+/** Save adaptive state (noise estimate, SNR history and AGC gain) to a
+ * snapshot (char[] of SPEEX_PREPROCESS_GET_STATE_SIZE bytes) */
+#define SPEEX_PREPROCESS_GET_STATE 51
+
+/** Use the fast approximations for the gain computation (spx_int32_t), on by default in builds
+ * with FAST_MATH_APPROX. Returns -1 when asked to turn them on in other builds */
+#define SPEEX_PREPROCESS_SET_FAST_MATH 54
+/** Get whether the fast approximations are used (spx_int32_t) */
+#define SPEEX_PREPROCESS_GET_FAST_MATH 55
+
+/** State of a batch of preprocessors advanced in lockstep. Should never be accessed directly. */
+struct SpeexPreprocessBatch_;
+
+/** Batch of same-configuration preprocessors (one per stream) whose spectral state is stored
+ * stream-interleaved, so that the per-bin computations of all the streams run in the same loop.
+ * Only noise suppression and VAD are supported (no AGC, dereverb or residual echo suppression),
+ * and only in floating point builds.
+*/
+typedef struct SpeexPreprocessBatch_ SpeexPreprocessBatch;
+
+/** Creates a new batch of preprocessors
+ * @param nb_streams Number of streams processed together (8 or 16 make the best use of SIMD units)
+ * @param frame_size Number of samples to process at one time
+ * @param sampling_rate Sampling rate used for the input
+ * @return Newly created batch, NULL if batches are not supported by this build
+*/
+SpeexPreprocessBatch *speex_preprocess_batch_init(int nb_streams, int frame_size, int sampling_rate);
+
+/** Destroys a batch of preprocessors
+ * @param st Batch to destroy
+*/
+void speex_preprocess_batch_destroy(SpeexPreprocessBatch *st);
+
+/** Preprocesses one frame of every stream of the batch. Gives the same result as
+ * speex_preprocess_run() on separate states with the same configuration.
+ * @param st Batch
+ * @param x nb_streams audio sample vectors (in and out) of frame_size samples each
+ * @param vad nb_streams voice activity flags (out, only meaningful with the VAD turned on), may be NULL
+*/
+void speex_preprocess_batch_run(SpeexPreprocessBatch *st, spx_int16_t **x, int *vad);
+
+/** Resets the adaptive state of one stream, e.g. when a new call takes over its slot
+ * @param st Batch
+ * @param stream Index of the stream to reset
+*/
+void speex_preprocess_batch_reset_stream(SpeexPreprocessBatch *st, int stream);
+
+/** Used like the ioctl function to control the batch. Supports the DENOISE, VAD,
+ * NOISE_SUPPRESS, PROB_START and PROB_CONTINUE requests, which apply to every stream.
+ * @param st Batch
+ * @param request ioctl-type request (one of the SPEEX_PREPROCESS_* macros)
+ * @param ptr Data exchanged to-from function
+ * @return 0 if no error, -1 if request in unknown
+*/
+int speex_preprocess_batch_ctl(SpeexPreprocessBatch *st, int request, void *ptr);
+
+/** Set the number of frames a VAD-only state keeps reporting speech after the speech
+ * probability has dropped (spx_int32_t), 0 by default */
+#define SPEEX_VAD_SET_HANGOVER 52
+/** Get the VAD hangover in frames (spx_int32_t) */
+#define SPEEX_VAD_GET_HANGOVER 53
+
+/** State of a VAD-only analyser. Should never be accessed directly. */
+struct SpeexVadState_;
+
+/** Voice activity detection without the rest of the preprocessor. Runs the same speech
+ * probability estimator on a decimated spectrum, with the SNR computed on the Bark bands only,
+ * and synthesises nothing. Without hangover, decisions match those of speex_preprocess_run()
+ * with the VAD on for at least 97% of the frames of synthetic speech in stationary white or
+ * pink noise from 0 to 60 dB SNR, at 8 to 48 kHz, and for more than 99% in most of these
+ * conditions (see vad_benchmark). They differ mostly around onsets, and most in white noise
+ * below 15 dB SNR at 48 kHz. Only available in floating point builds.
+*/
+typedef struct SpeexVadState_ SpeexVadState;
+
+/** Creates a new VAD-only state
+ * @param frame_size Number of samples to analyse at one time, must be even
+ * @param sampling_rate Sampling rate used for the input
+ * @return Newly created state, NULL if the frame size is odd or the build is fixed-point
+*/
+SpeexVadState *speex_vad_state_init(int frame_size, int sampling_rate);
+
+/** Brings the adaptive state back to that of a new state, keeping the parameters
+ * @param st State to reset
+*/
+void speex_vad_state_reset(SpeexVadState *st);
+
+/** Destroys a VAD-only state
+ * @param st State to destroy
+*/
+void speex_vad_state_destroy(SpeexVadState *st);
+
+/** Analyses one frame
+ * @param st State
+ * @param x Audio sample vector (in only)
+ * @return 1 for speech, including the hangover, 0 for silence
+*/
+int speex_vad_run(SpeexVadState *st, const spx_int16_t *x);
+
+/** Same as speex_vad_run() with float samples, full scale at +/-1.0 */
+int speex_vad_run_float(SpeexVadState *st, const float *x);
+
+/** Used like the ioctl function to control the state. Supports the PROB_START, PROB_CONTINUE
+ * and PROB requests of the preprocessor, and SPEEX_VAD_SET_HANGOVER/GET_HANGOVER.
+ * @param st State
+ * @param request ioctl-type request
+ * @param ptr Data exchanged to-from function
+ * @return 0 if no error, -1 if request in unknown
+*/
+int speex_vad_ctl(SpeexVadState *st, int request, void *ptr);
+
 #ifdef __cplusplus
 }
 #endif
@@ -182,6 +182,34 @@ struct SpeexEchoState_ {
    spx_int16_t *play_buf;
    int play_buf_pos;
    int play_buf_started;
+
+   /* Shared far-end analyser, x, X and memX point into it when set (conference mode) */
+   SpeexEchoReference *ref;
+
+   /* Sparse partition evaluation */
+   int sparse;               /* Update decimation of inactive partitions, 0 when disabled */
+   int sparse_hold;          /* Frames left with every partition forced active */
+   int nb_active;            /* Number of active partitions */
+   unsigned char *active;    /* Per-partition activity (M) */
+   spx_word16_t *part_rms;   /* Per-partition RMS filter weight (M) */
+};
+
+/** Far-end analysis shared by several echo cancellers listening to the same loudspeaker signal */
+struct SpeexEchoReference_ {
+   int frame_size;
+   int window_size;
+   int M;
+   int K;
+   int saturated;        /* Far end saturated during the last frame (fixed-point only) */
+   /* Kept per speaker, so that the cancellers add them up in the same order as from their own
+      far end and the output stays bit-identical with several speakers */
+   spx_word32_t *Sxx;    /* Far-end energy of the last frame (K) */
+   spx_word16_t *x;      /* Far-end input buffer (2N) */
+   spx_word16_t *X;      /* Far-end buffer (M+1 frames) in frequency domain */
+   spx_word32_t *Xf;     /* Far-end power spectrum of the last frame (K*(frame_size+1)) */
+   spx_word16_t *memX;
+   spx_word16_t preemph;
+   void *fft_table;
 };
 
 static inline void filter_dc_notch16(const spx_int16_t *in, spx_word16_t radius, spx_word16_t *out, int len, spx_mem_t *mem, int stride)
@@ -208,6 +236,32 @@ static inline void filter_dc_notch16(const spx_int16_t *in, spx_word16_t radius,
    }
 }
 
+#ifndef FIXED_POINT
+/* Float samples are full scale at +/-1.0, the filters work on the 16-bit scale */
+#define FLOAT_SCALE 32768.f
+#define FLOAT_SCALE_1 (1.f/32768.f)
+
+/* Sample i of a signal given either as 16-bit or as float samples, on the 16-bit scale */
+#define SAMPLE16(x16, xf, i) ((xf) ? FLOAT_SCALE*(xf)[i] : (spx_word16_t)(x16)[i])
+
+static inline void filter_dc_notch_float(const float *in, spx_word16_t radius, spx_word16_t *out, int len, spx_mem_t *mem, int stride)
+{
+   int i;
+   spx_word16_t den2;
+   den2 = radius*radius + .7*(1-radius)*(1-radius);
+   for (i=0;i<len;i++)
+   {
+      spx_word16_t vin = FLOAT_SCALE*in[i*stride];
+      spx_word32_t vout = mem[0] + vin;
+      mem[0] = mem[1] + 2*(-vin + radius*vout);
+      mem[1] = vin - den2*vout;
+      out[i] = radius*vout;
+   }
+}
+#else
+#define SAMPLE16(x16, xf, i) ((x16)[i])
+#endif
+
 /* This inner product is slightly different from the codec version because of fixed-point */
 static inline spx_word32_t mdf_inner_prod(const spx_word16_t *x, const spx_word16_t *y, int len)
 {
@@ -327,6 +381,95 @@ static inline void spectral_mul_accum(const spx_word16_t *X, const spx_word32_t
 #define spectral_mul_accum16 spectral_mul_accum
 #endif
 
+/** Same as spectral_mul_accum(), skipping the partitions (of K blocks each) marked inactive */
+#ifdef FIXED_POINT
+static inline void spectral_mul_accum_sparse(const spx_word16_t *X, const spx_word32_t *Y, spx_word16_t *acc, int N, int M, int K, const unsigned char *active)
+{
+   int i,j;
+   spx_word32_t tmp1=0,tmp2=0;
+   for (j=0;j<M*K;j++)
+   {
+      if (active[j/K])
+         tmp1 = MAC16_16(tmp1, X[j*N],TOP16(Y[j*N]));
+   }
+   acc[0] = PSHR32(tmp1,WEIGHT_SHIFT);
+   for (i=1;i<N-1;i+=2)
+   {
+      tmp1 = tmp2 = 0;
+      for (j=0;j<M*K;j++)
+      {
+         if (!active[j/K])
+            continue;
+         tmp1 = SUB32(MAC16_16(tmp1, X[j*N+i],TOP16(Y[j*N+i])), MULT16_16(X[j*N+i+1],TOP16(Y[j*N+i+1])));
+         tmp2 = MAC16_16(MAC16_16(tmp2, X[j*N+i+1],TOP16(Y[j*N+i])), X[j*N+i], TOP16(Y[j*N+i+1]));
+      }
+      acc[i] = PSHR32(tmp1,WEIGHT_SHIFT);
+      acc[i+1] = PSHR32(tmp2,WEIGHT_SHIFT);
+   }
+   tmp1 = tmp2 = 0;
+   for (j=0;j<M*K;j++)
+   {
+      if (active[j/K])
+         tmp1 = MAC16_16(tmp1, X[(j+1)*N-1],TOP16(Y[(j+1)*N-1]));
+   }
+   acc[N-1] = PSHR32(tmp1,WEIGHT_SHIFT);
+}
+static inline void spectral_mul_accum16_sparse(const spx_word16_t *X, const spx_word16_t *Y, spx_word16_t *acc, int N, int M, int K, const unsigned char *active)
+{
+   int i,j;
+   spx_word32_t tmp1=0,tmp2=0;
+   for (j=0;j<M*K;j++)
+   {
+      if (active[j/K])
+         tmp1 = MAC16_16(tmp1, X[j*N],Y[j*N]);
+   }
+   acc[0] = PSHR32(tmp1,WEIGHT_SHIFT);
+   for (i=1;i<N-1;i+=2)
+   {
+      tmp1 = tmp2 = 0;
+      for (j=0;j<M*K;j++)
+      {
+         if (!active[j/K])
+            continue;
+         tmp1 = SUB32(MAC16_16(tmp1, X[j*N+i],Y[j*N+i]), MULT16_16(X[j*N+i+1],Y[j*N+i+1]));
+         tmp2 = MAC16_16(MAC16_16(tmp2, X[j*N+i+1],Y[j*N+i]), X[j*N+i], Y[j*N+i+1]);
+      }
+      acc[i] = PSHR32(tmp1,WEIGHT_SHIFT);
+      acc[i+1] = PSHR32(tmp2,WEIGHT_SHIFT);
+   }
+   tmp1 = tmp2 = 0;
+   for (j=0;j<M*K;j++)
+   {
+      if (active[j/K])
+         tmp1 = MAC16_16(tmp1, X[(j+1)*N-1],Y[(j+1)*N-1]);
+   }
+   acc[N-1] = PSHR32(tmp1,WEIGHT_SHIFT);
+}
+#else
+static inline void spectral_mul_accum_sparse(const spx_word16_t *X, const spx_word32_t *Y, spx_word16_t *acc, int N, int M, int K, const unsigned char *active)
+{
+   int i,j;
+   for (i=0;i<N;i++)
+      acc[i] = 0;
+   for (j=0;j<M*K;j++)
+   {
+      if (active[j/K])
+      {
+         acc[0] += X[0]*Y[0];
+         for (i=1;i<N-1;i+=2)
+         {
+            acc[i] += (X[i]*Y[i] - X[i+1]*Y[i+1]);
+            acc[i+1] += (X[i+1]*Y[i] + X[i]*Y[i+1]);
+         }
+         acc[i] += X[i]*Y[i];
+      }
+      X += N;
+      Y += N;
+   }
+}
+#define spectral_mul_accum16_sparse spectral_mul_accum_sparse
+#endif
+
 /** Compute weighted cross-power spectrum of a half-complex (packed) vector with conjugate */
 static inline void weighted_spectral_mul_conj(const spx_float_t *w, const spx_float_t p, const spx_word16_t *X, const spx_word16_t *Y, spx_word32_t *prod, int N)
 {
@@ -376,6 +519,61 @@ static inline void mdf_adjust_prop(const spx_word32_t *W, int N, int M, int P, s
    /*printf ("\n");*/
 }
 
+/* Sparse mode: a partition is inactive below this fraction of the strongest partition's RMS
+   weight (about -30 dB), and every partition is kept active for SPARSE_HOLD_PARTITIONS*M frames
+   after an apparent echo path change */
+#define SPARSE_THRESHOLD QCONST16(.0316f,15)
+#define SPARSE_HOLD_PARTITIONS 2
+
+/** Sparse mode: re-evaluates which partitions hold a significant part of the echo path energy */
+static void mdf_update_active(SpeexEchoState *st)
+{
+   int i, j, p;
+   int N = st->window_size;
+   int M = st->M;
+   int P = st->C*st->K;
+   spx_word16_t max_rms = 0;
+   spx_word16_t threshold;
+
+   /* Until every partition had time to pick up its share of the echo path (or after a likely
+      echo path change) nothing is skipped */
+   if (st->cancel_count < SPARSE_HOLD_PARTITIONS*M || st->sparse_hold > 0)
+   {
+      for (j=0;j<M;j++)
+         st->active[j] = 1;
+      st->nb_active = M;
+      return;
+   }
+
+   /* Partition j of channel c and speaker k lives at W[c*N*K*M + j*N*K + k*N] */
+   for (j=0;j<M;j++)
+   {
+      spx_word32_t tmp = 0;
+      spx_word16_t rms;
+      for (p=0;p<P;p++)
+      {
+         const spx_word32_t *W = st->W + (p/st->K)*N*st->K*M + j*N*st->K + (p%st->K)*N;
+         for (i=0;i<N;i++)
+            tmp += MULT16_16(EXTRACT16(SHR32(W[i],18)), EXTRACT16(SHR32(W[i],18)));
+      }
+#ifdef FIXED_POINT
+      tmp = MIN32(ABS32(tmp), 536870912);
+#endif
+      rms = spx_sqrt(tmp);
+      st->part_rms[j] = rms;
+      if (rms > max_rms)
+         max_rms = rms;
+   }
+
+   threshold = MULT16_16_Q15(SPARSE_THRESHOLD, max_rms);
+   st->nb_active = 0;
+   for (j=0;j<M;j++)
+   {
+      st->active[j] = st->part_rms[j] >= threshold;
+      st->nb_active += st->active[j];
+   }
+}
+
 #ifdef DUMP_ECHO_CANCEL_DATA
 #include <stdio.h>
 static FILE *rFile=NULL, *pFile=NULL, *oFile=NULL;
@@ -398,11 +596,12 @@ EXPORT SpeexEchoState *speex_echo_state_init(int frame_size, int filter_length)
    return speex_echo_state_init_mc(frame_size, filter_length, 1, 1);
 }
 
-EXPORT SpeexEchoState *speex_echo_state_init_mc(int frame_size, int filter_length, int nb_mic, int nb_speakers)
+static SpeexEchoState *echo_state_init(int frame_size, int filter_length, int nb_mic, int nb_speakers, SpeexEchoReference *ref)
 {
    int i,N,M, C, K;
    SpeexEchoState *st = (SpeexEchoState *)speex_alloc(sizeof(SpeexEchoState));
 
+   st->ref = ref;
    st->K = nb_speakers;
    st->C = nb_mic;
    C=st->C;
@@ -438,7 +637,10 @@ EXPORT SpeexEchoState *speex_echo_state_init_mc(int frame_size, int filter_lengt
    st->fft_table = spx_fft_init(N);
 
    st->e = (spx_word16_t*)speex_alloc(C*N*sizeof(spx_word16_t));
-   st->x = (spx_word16_t*)speex_alloc(K*N*sizeof(spx_word16_t));
+   if (ref)
+      st->x = ref->x;
+   else
+      st->x = (spx_word16_t*)speex_alloc(K*N*sizeof(spx_word16_t));
    st->input = (spx_word16_t*)speex_alloc(C*st->frame_size*sizeof(spx_word16_t));
    st->y = (spx_word16_t*)speex_alloc(C*N*sizeof(spx_word16_t));
    st->last_y = (spx_word16_t*)speex_alloc(C*N*sizeof(spx_word16_t));
@@ -448,7 +650,10 @@ EXPORT SpeexEchoState *speex_echo_state_init_mc(int frame_size, int filter_lengt
    st->Yh = (spx_word32_t*)speex_alloc((st->frame_size+1)*sizeof(spx_word32_t));
    st->Eh = (spx_word32_t*)speex_alloc((st->frame_size+1)*sizeof(spx_word32_t));
 
-   st->X = (spx_word16_t*)speex_alloc(K*(M+1)*N*sizeof(spx_word16_t));
+   if (ref)
+      st->X = ref->X;
+   else
+      st->X = (spx_word16_t*)speex_alloc(K*(M+1)*N*sizeof(spx_word16_t));
    st->Y = (spx_word16_t*)speex_alloc(C*N*sizeof(spx_word16_t));
    st->E = (spx_word16_t*)speex_alloc(C*N*sizeof(spx_word16_t));
    st->W = (spx_word32_t*)speex_alloc(C*K*M*N*sizeof(spx_word32_t));
@@ -461,6 +666,13 @@ EXPORT SpeexEchoState *speex_echo_state_init_mc(int frame_size, int filter_lengt
    st->window = (spx_word16_t*)speex_alloc(N*sizeof(spx_word16_t));
    st->prop = (spx_word16_t*)speex_alloc(M*sizeof(spx_word16_t));
    st->wtmp = (spx_word16_t*)speex_alloc(N*sizeof(spx_word16_t));
+   st->active = (unsigned char*)speex_alloc(M*sizeof(unsigned char));
+   st->part_rms = (spx_word16_t*)speex_alloc(M*sizeof(spx_word16_t));
+   for (i=0;i<M;i++)
+      st->active[i] = 1;
+   st->nb_active = M;
+   st->sparse = 0;
+   st->sparse_hold = 0;
 #ifdef FIXED_POINT
    st->wtmp2 = (spx_word16_t*)speex_alloc(N*sizeof(spx_word16_t));
    for (i=0;i<N>>1;i++)
@@ -493,7 +705,10 @@ EXPORT SpeexEchoState *speex_echo_state_init_mc(int frame_size, int filter_lengt
       }
    }
 
-   st->memX = (spx_word16_t*)speex_alloc(K*sizeof(spx_word16_t));
+   if (ref)
+      st->memX = ref->memX;
+   else
+      st->memX = (spx_word16_t*)speex_alloc(K*sizeof(spx_word16_t));
    st->memD = (spx_word16_t*)speex_alloc(C*sizeof(spx_word16_t));
    st->memE = (spx_word16_t*)speex_alloc(C*sizeof(spx_word16_t));
    st->preemph = QCONST16(.9,15);
@@ -520,6 +735,158 @@ EXPORT SpeexEchoState *speex_echo_state_init_mc(int frame_size, int filter_lengt
    return st;
 }
 
+EXPORT SpeexEchoState *speex_echo_state_init_mc(int frame_size, int filter_length, int nb_mic, int nb_speakers)
+{
+   return echo_state_init(frame_size, filter_length, nb_mic, nb_speakers, NULL);
+}
+
+EXPORT SpeexEchoState *speex_echo_state_init_shared(int frame_size, int filter_length, int nb_mic, SpeexEchoReference *ref)
+{
+   if (ref->frame_size != frame_size || ref->M != (filter_length+frame_size-1)/frame_size)
+   {
+      speex_warning("Echo reference was created with a different frame size or filter length");
+      return NULL;
+   }
+   return echo_state_init(frame_size, filter_length, nb_mic, ref->K, ref);
+}
+
+EXPORT SpeexEchoReference *speex_echo_reference_init(int frame_size, int filter_length, int nb_speakers)
+{
+   int N, M, K;
+   SpeexEchoReference *ref = (SpeexEchoReference *)speex_alloc(sizeof(SpeexEchoReference));
+
+   ref->frame_size = frame_size;
+   ref->window_size = 2*frame_size;
+   N = ref->window_size;
+   M = ref->M = (filter_length+frame_size-1)/frame_size;
+   K = ref->K = nb_speakers;
+   ref->preemph = QCONST16(.9,15);
+   ref->fft_table = spx_fft_init(N);
+
+   ref->x = (spx_word16_t*)speex_alloc(K*N*sizeof(spx_word16_t));
+   ref->X = (spx_word16_t*)speex_alloc(K*(M+1)*N*sizeof(spx_word16_t));
+   ref->Sxx = (spx_word32_t*)speex_alloc(K*sizeof(spx_word32_t));
+   ref->Xf = (spx_word32_t*)speex_alloc(K*(frame_size+1)*sizeof(spx_word32_t));
+   ref->memX = (spx_word16_t*)speex_alloc(K*sizeof(spx_word16_t));
+
+   return ref;
+}
+
+EXPORT void speex_echo_reference_reset(SpeexEchoReference *ref)
+{
+   int i;
+   int N = ref->window_size;
+   for (i=0;i<ref->K*N*(ref->M+1);i++)
+      ref->X[i] = 0;
+   for (i=0;i<ref->K*N;i++)
+      ref->x[i] = 0;
+   for (i=0;i<ref->K*(ref->frame_size+1);i++)
+      ref->Xf[i] = 0;
+   for (i=0;i<ref->K;i++)
+   {
+      ref->memX[i] = 0;
+      ref->Sxx[i] = 0;
+   }
+   ref->saturated = 0;
+}
+
+EXPORT void speex_echo_reference_destroy(SpeexEchoReference *ref)
+{
+   spx_fft_destroy(ref->fft_table);
+   speex_free(ref->x);
+   speex_free(ref->X);
+   speex_free(ref->Sxx);
+   speex_free(ref->Xf);
+   speex_free(ref->memX);
+   speex_free(ref);
+}
+
+/* Adds the far-end energy and power spectrum of the shared reference, one speaker after the other
+   like speex_echo_cancellation() does from its own far end */
+static void shared_spectrum_accum(SpeexEchoState *st, spx_word32_t *Sxx)
+{
+   int i, speak;
+   const SpeexEchoReference *ref = st->ref;
+   for (speak = 0; speak < ref->K; speak++)
+   {
+      const spx_word32_t *Xf = ref->Xf+speak*(ref->frame_size+1);
+      *Sxx += ref->Sxx[speak];
+      for (i=0;i<=ref->frame_size;i++)
+         st->Xf[i] = ADD32(st->Xf[i], Xf[i]);
+   }
+}
+
+/* Pre-emphasis, history shift and FFT of the far end: the part of speex_echo_cancellation()
+   that only depends on the loudspeaker signal */
+static void echo_reference_update(SpeexEchoReference *ref, const spx_int16_t *far_end, const float *far_end_float)
+{
+   int i, j, speak;
+   int N = ref->window_size;
+   int M = ref->M;
+   int K = ref->K;
+
+   ref->saturated = 0;
+   for (speak = 0; speak < K; speak++)
+   {
+      for (i=0;i<ref->frame_size;i++)
+      {
+         spx_word32_t tmp32;
+         spx_word16_t play = SAMPLE16(far_end, far_end_float, i*K+speak);
+         ref->x[speak*N+i] = ref->x[speak*N+i+ref->frame_size];
+         tmp32 = SUB32(EXTEND32(play), EXTEND32(MULT16_16_P15(ref->preemph, ref->memX[speak])));
+#ifdef FIXED_POINT
+         if (tmp32 > 32767)
+         {
+            tmp32 = 32767;
+            ref->saturated = 1;
+         }
+         if (tmp32 < -32767)
+         {
+            tmp32 = -32767;
+            ref->saturated = 1;
+         }
+#endif
+         ref->x[speak*N+i+ref->frame_size] = EXTRACT16(tmp32);
+         ref->memX[speak] = play;
+      }
+   }
+
+   for (speak = 0; speak < K; speak++)
+   {
+      for (j=M-1;j>=0;j--)
+      {
+         for (i=0;i<N;i++)
+            ref->X[(j+1)*N*K+speak*N+i] = ref->X[j*N*K+speak*N+i];
+      }
+      spx_fft(ref->fft_table, ref->x+speak*N, &ref->X[speak*N]);
+   }
+
+   for (i=0;i<K*(ref->frame_size+1);i++)
+      ref->Xf[i] = 0;
+   for (speak = 0; speak < K; speak++)
+   {
+      ref->Sxx[speak] = mdf_inner_prod(ref->x+speak*N+ref->frame_size, ref->x+speak*N+ref->frame_size, ref->frame_size);
+      power_spectrum_accum(ref->X+speak*N, ref->Xf+speak*(ref->frame_size+1), N);
+   }
+}
+
+EXPORT void speex_echo_reference_update(SpeexEchoReference *ref, const spx_int16_t *far_end)
+{
+   echo_reference_update(ref, far_end, NULL);
+}
+
+#ifndef FIXED_POINT
+EXPORT void speex_echo_reference_update_float(SpeexEchoReference *ref, const float *far_end)
+{
+   echo_reference_update(ref, NULL, far_end);
+}
+#else
+EXPORT void speex_echo_reference_update_float(SpeexEchoReference *ref, const float *far_end)
+{
+   speex_warning("Float far-end analysis is only available in floating point builds");
+}
+#endif
+
 /** Resets echo canceller state */
 EXPORT void speex_echo_state_reset(SpeexEchoState *st)
 {
@@ -536,8 +903,16 @@ EXPORT void speex_echo_state_reset(SpeexEchoState *st)
    for (i=0;i<N*M;i++)
       st->foreground[i] = 0;
 #endif
-   for (i=0;i<N*(M+1);i++)
-      st->X[i] = 0;
+   /* The far-end history of a shared reference belongs to all the cancellers using it */
+   if (!st->ref)
+   {
+      for (i=0;i<N*(M+1);i++)
+         st->X[i] = 0;
+      for (i=0;i<N*K;i++)
+         st->x[i] = 0;
+      for (i=0;i<K;i++)
+         st->memX[i]=0;
+   }
    for (i=0;i<=st->frame_size;i++)
    {
       st->power[i] = 0;
@@ -553,16 +928,10 @@ EXPORT void speex_echo_state_reset(SpeexEchoState *st)
    {
       st->E[i] = 0;
    }
-   for (i=0;i<N*K;i++)
-   {
-      st->x[i] = 0;
-   }
    for (i=0;i<2*C;i++)
       st->notch_mem[i] = 0;
    for (i=0;i<C;i++)
       st->memD[i]=st->memE[i]=0;
-   for (i=0;i<K;i++)
-      st->memX[i]=0;
 
    st->saturated = 0;
    st->adapted = 0;
@@ -572,6 +941,10 @@ EXPORT void speex_echo_state_reset(SpeexEchoState *st)
    st->Davg1 = st->Davg2 = 0;
    st->Dvar1 = st->Dvar2 = FLOAT_ZERO;
 #endif
+   for (i=0;i<M;i++)
+      st->active[i] = 1;
+   st->nb_active = M;
+   st->sparse_hold = 0;
    for (i=0;i<3*st->frame_size;i++)
       st->play_buf[i] = 0;
    st->play_buf_pos = PLAYBACK_DELAY*st->frame_size;
@@ -585,7 +958,8 @@ EXPORT void speex_echo_state_destroy(SpeexEchoState *st)
    spx_fft_destroy(st->fft_table);
 
    speex_free(st->e);
-   speex_free(st->x);
+   if (!st->ref)
+      speex_free(st->x);
    speex_free(st->input);
    speex_free(st->y);
    speex_free(st->last_y);
@@ -595,7 +969,8 @@ EXPORT void speex_echo_state_destroy(SpeexEchoState *st)
    speex_free(st->Yh);
    speex_free(st->Eh);
 
-   speex_free(st->X);
+   if (!st->ref)
+      speex_free(st->X);
    speex_free(st->Y);
    speex_free(st->E);
    speex_free(st->W);
@@ -608,10 +983,13 @@ EXPORT void speex_echo_state_destroy(SpeexEchoState *st)
    speex_free(st->window);
    speex_free(st->prop);
    speex_free(st->wtmp);
+   speex_free(st->active);
+   speex_free(st->part_rms);
 #ifdef FIXED_POINT
    speex_free(st->wtmp2);
 #endif
-   speex_free(st->memX);
+   if (!st->ref)
+      speex_free(st->memX);
    speex_free(st->memD);
    speex_free(st->memE);
    speex_free(st->notch_mem);
@@ -682,8 +1060,10 @@ EXPORT void speex_echo_cancel(SpeexEchoState *st, const spx_int16_t *in, const s
    speex_echo_cancellation(st, in, far_end, out);
 }
 
-/** Performs echo cancellation on a frame */
-EXPORT void speex_echo_cancellation(SpeexEchoState *st, const spx_int16_t *in, const spx_int16_t *far_end, spx_int16_t *out)
+/* Echo cancellation of one frame given either as 16-bit samples (in, far_end, out) or as
+   float samples (in_float, far_end_float, out_float), the other pointers being NULL */
+static void echo_cancellation(SpeexEchoState *st, const spx_int16_t *in, const spx_int16_t *far_end, spx_int16_t *out,
+      const float *in_float, const float *far_end_float, float *out_float)
 {
    int i,j, chan, speak;
    int N,M, C, K;
@@ -716,6 +1096,11 @@ EXPORT void speex_echo_cancellation(SpeexEchoState *st, const spx_int16_t *in, c
    for (chan = 0; chan < C; chan++)
    {
       /* Apply a notch filter to make sure DC doesn't end up causing problems */
+#ifndef FIXED_POINT
+      if (in_float)
+         filter_dc_notch_float(in_float+chan, st->notch_radius, st->input+chan*st->frame_size, st->frame_size, st->notch_mem+2*chan, C);
+      else
+#endif
       filter_dc_notch16(in+chan, st->notch_radius, st->input+chan*st->frame_size, st->frame_size, st->notch_mem+2*chan, C);
       /* Copy input data to buffer and apply pre-emphasis */
       /* Copy input data to buffer */
@@ -743,48 +1128,58 @@ EXPORT void speex_echo_cancellation(SpeexEchoState *st, const spx_int16_t *in, c
       }
    }
 
-   for (speak = 0; speak < K; speak++)
+   if (st->ref)
    {
-      for (i=0;i<st->frame_size;i++)
+      /* The shared reference was updated with this frame's far end already */
+      if (st->ref->saturated)
+         st->saturated = M+1;
+      Sxx = 0;
+      shared_spectrum_accum(st, &Sxx);
+   } else {
+      for (speak = 0; speak < K; speak++)
       {
-         spx_word32_t tmp32;
-         st->x[speak*N+i] = st->x[speak*N+i+st->frame_size];
-         tmp32 = SUB32(EXTEND32(far_end[i*K+speak]), EXTEND32(MULT16_16_P15(st->preemph, st->memX[speak])));
-#ifdef FIXED_POINT
-         /*FIXME: If saturation occurs here, we need to freeze adaptation for M frames (not just one) */
-         if (tmp32 > 32767)
+         for (i=0;i<st->frame_size;i++)
          {
-            tmp32 = 32767;
-            st->saturated = M+1;
+            spx_word32_t tmp32;
+            spx_word16_t play = SAMPLE16(far_end, far_end_float, i*K+speak);
+            st->x[speak*N+i] = st->x[speak*N+i+st->frame_size];
+            tmp32 = SUB32(EXTEND32(play), EXTEND32(MULT16_16_P15(st->preemph, st->memX[speak])));
+#ifdef FIXED_POINT
+            /*FIXME: If saturation occurs here, we need to freeze adaptation for M frames (not just one) */
+            if (tmp32 > 32767)
+            {
+               tmp32 = 32767;
+               st->saturated = M+1;
+            }
+            if (tmp32 < -32767)
+            {
+               tmp32 = -32767;
+               st->saturated = M+1;
+            }
+#endif
+            st->x[speak*N+i+st->frame_size] = EXTRACT16(tmp32);
+            st->memX[speak] = play;
          }
-         if (tmp32 < -32767)
+      }
+
+      for (speak = 0; speak < K; speak++)
+      {
+         /* Shift memory: this could be optimized eventually*/
+         for (j=M-1;j>=0;j--)
          {
-            tmp32 = -32767;
-            st->saturated = M+1;
+            for (i=0;i<N;i++)
+               st->X[(j+1)*N*K+speak*N+i] = st->X[j*N*K+speak*N+i];
          }
-#endif
-         st->x[speak*N+i+st->frame_size] = EXTRACT16(tmp32);
-         st->memX[speak] = far_end[i*K+speak];
+         /* Convert x (echo input) to frequency domain */
+         spx_fft(st->fft_table, st->x+speak*N, &st->X[speak*N]);
       }
-   }
 
-   for (speak = 0; speak < K; speak++)
-   {
-      /* Shift memory: this could be optimized eventually*/
-      for (j=M-1;j>=0;j--)
+      Sxx = 0;
+      for (speak = 0; speak < K; speak++)
       {
-         for (i=0;i<N;i++)
-            st->X[(j+1)*N*K+speak*N+i] = st->X[j*N*K+speak*N+i];
+         Sxx += mdf_inner_prod(st->x+speak*N+st->frame_size, st->x+speak*N+st->frame_size, st->frame_size);
+         power_spectrum_accum(st->X+speak*N, st->Xf, N);
       }
-      /* Convert x (echo input) to frequency domain */
-      spx_fft(st->fft_table, st->x+speak*N, &st->X[speak*N]);
-   }
-
-   Sxx = 0;
-   for (speak = 0; speak < K; speak++)
-   {
-      Sxx += mdf_inner_prod(st->x+speak*N+st->frame_size, st->x+speak*N+st->frame_size, st->frame_size);
-      power_spectrum_accum(st->X+speak*N, st->Xf, N);
    }
 
    Sff = 0;
@@ -792,7 +1187,10 @@ EXPORT void speex_echo_cancellation(SpeexEchoState *st, const spx_int16_t *in, c
    {
 #ifdef TWO_PATH
       /* Compute foreground filter */
-      spectral_mul_accum16(st->X, st->foreground+chan*N*K*M, st->Y+chan*N, N, M*K);
+      if (st->sparse)
+         spectral_mul_accum16_sparse(st->X, st->foreground+chan*N*K*M, st->Y+chan*N, N, M, K, st->active);
+      else
+         spectral_mul_accum16(st->X, st->foreground+chan*N*K*M, st->Y+chan*N, N, M*K);
       spx_ifft(st->fft_table, st->Y+chan*N, st->e+chan*N);
       for (i=0;i<st->frame_size;i++)
          st->e[chan*N+i] = SUB16(st->input[chan*st->frame_size+i], st->e[chan*N+i+st->frame_size]);
@@ -804,6 +1202,14 @@ EXPORT void speex_echo_cancellation(SpeexEchoState *st, const spx_int16_t *in, c
    /* FIXME: Adjust that for C, K*/
    if (st->adapted)
       mdf_adjust_prop (st->W, N, M, C*K, st->prop);
+   /* Sparse mode: refresh the set of partitions worth evaluating */
+   if (st->sparse)
+   {
+      if (st->sparse_hold > 0)
+         st->sparse_hold--;
+      if (st->cancel_count % st->sparse == 0 || st->sparse_hold > 0)
+         mdf_update_active(st);
+   }
    /* Compute weight gradient */
    if (st->saturated == 0)
    {
@@ -813,6 +1219,9 @@ EXPORT void speex_echo_cancellation(SpeexEchoState *st, const spx_int16_t *in, c
          {
             for (j=M-1;j>=0;j--)
             {
+               /* Inactive partitions are only adapted every st->sparse frames (staggered) */
+               if (st->sparse && !st->active[j] && (st->cancel_count + j) % st->sparse != 0)
+                  continue;
                weighted_spectral_mul_conj(st->power_1, FLOAT_SHL(PSEUDOFLOAT(st->prop[j]),-15), &st->X[(j+1)*N*K+speak*N], st->E+chan*N, st->PHI, N);
                for (i=0;i<N;i++)
                   st->W[chan*N*K*M + j*N*K + speak*N + i] += st->PHI[i];
@@ -874,7 +1283,10 @@ EXPORT void speex_echo_cancellation(SpeexEchoState *st, const spx_int16_t *in, c
    /* Difference in response, this is used to estimate the variance of our residual power estimate */
    for (chan = 0; chan < C; chan++)
    {
-      spectral_mul_accum(st->X, st->W+chan*N*K*M, st->Y+chan*N, N, M*K);
+      if (st->sparse)
+         spectral_mul_accum_sparse(st->X, st->W+chan*N*K*M, st->Y+chan*N, N, M, K, st->active);
+      else
+         spectral_mul_accum(st->X, st->W+chan*N*K*M, st->Y+chan*N, N, M*K);
       spx_ifft(st->fft_table, st->Y+chan*N, st->y+chan*N);
       for (i=0;i<st->frame_size;i++)
          st->e[chan*N+i] = SUB16(st->e[chan*N+i+st->frame_size], st->y[chan*N+i+st->frame_size]);
@@ -970,17 +1382,24 @@ EXPORT void speex_echo_cancellation(SpeexEchoState *st, const spx_int16_t *in, c
 #endif
          tmp_out = ADD32(tmp_out, EXTEND32(MULT16_16_P15(st->preemph, st->memE[chan])));
       /* This is an arbitrary test for saturation in the microphone signal */
-         if (in[i*C+chan] <= -32000 || in[i*C+chan] >= 32000)
+         if (SAMPLE16(in, in_float, i*C+chan) <= -32000 || SAMPLE16(in, in_float, i*C+chan) >= 32000)
          {
          if (st->saturated == 0)
             st->saturated = 1;
          }
+#ifndef FIXED_POINT
+         /* The float output isn't clipped */
+         if (out_float)
+            out_float[i*C+chan] = FLOAT_SCALE_1*tmp_out;
+         else
+#endif
          out[i*C+chan] = WORD2INT(tmp_out);
          st->memE[chan] = tmp_out;
       }
 
 #ifdef DUMP_ECHO_CANCEL_DATA
-      dump_audio(in, far_end, out, st->frame_size);
+      if (!in_float)
+         dump_audio(in, far_end, out, st->frame_size);
 #endif
 
       /* Compute error signal (filter update version) */
@@ -1020,7 +1439,12 @@ EXPORT void speex_echo_cancellation(SpeexEchoState *st, const spx_int16_t *in, c
       /* Things have gone really bad */
       st->screwed_up += 50;
       for (i=0;i<st->frame_size*C;i++)
-         out[i] = 0;
+      {
+         if (out_float)
+            out_float[i] = 0;
+         else
+            out[i] = 0;
+      }
    } else if (SHR32(Sff, 2) > ADD32(Sdd, SHR32(MULT16_16(N, 10000),6)))
    {
       /* AEC seems to add lots of echo instead of removing it, let's see if it will improve */
@@ -1039,12 +1463,21 @@ EXPORT void speex_echo_cancellation(SpeexEchoState *st, const spx_int16_t *in, c
    /* Add a small noise floor to make sure not to have problems when dividing */
    See = MAX32(See, SHR32(MULT16_16(N, 100),6));
 
-   for (speak = 0; speak < K; speak++)
+   if (st->ref)
    {
-      Sxx += mdf_inner_prod(st->x+speak*N+st->frame_size, st->x+speak*N+st->frame_size, st->frame_size);
-      power_spectrum_accum(st->X+speak*N, st->Xf, N);
+      shared_spectrum_accum(st, &Sxx);
+   } else {
+      for (speak = 0; speak < K; speak++)
+      {
+         Sxx += mdf_inner_prod(st->x+speak*N+st->frame_size, st->x+speak*N+st->frame_size, st->frame_size);
+         power_spectrum_accum(st->X+speak*N, st->Xf, N);
+      }
    }
 
+   /* Sparse mode: a residual this large while the far end is active suggests the echo path
+      changed, evaluate every partition again until the filter has re-converged */
+   if (st->sparse && Sxx > SHR32(MULT16_16(N, 1000),6) && See > SHR32(Sdd,1))
+      st->sparse_hold = SPARSE_HOLD_PARTITIONS*M;
 
    /* Smooth far end energy estimate over time */
    for (j=0;j<=st->frame_size;j++)
@@ -1177,7 +1610,7 @@ EXPORT void speex_echo_cancellation(SpeexEchoState *st, const spx_int16_t *in, c
    {
       /* If the filter is adapted, take the filtered echo */
       for (i=0;i<st->frame_size;i++)
-         st->last_y[st->frame_size+i] = in[i]-out[i];
+         st->last_y[st->frame_size+i] = SAMPLE16(in, in_float, i)-SAMPLE16(out, out_float, i);
    } else {
       /* If filter isn't adapted yet, all we can do is take the far end signal directly */
       /* moved earlier: for (i=0;i<N;i++)
@@ -1186,6 +1619,24 @@ EXPORT void speex_echo_cancellation(SpeexEchoState *st, const spx_int16_t *in, c
 
 }
 
+/** Performs echo cancellation on a frame */
+EXPORT void speex_echo_cancellation(SpeexEchoState *st, const spx_int16_t *in, const spx_int16_t *far_end, spx_int16_t *out)
+{
+   echo_cancellation(st, in, far_end, out, NULL, NULL, NULL);
+}
+
+#ifndef FIXED_POINT
+EXPORT void speex_echo_cancellation_float(SpeexEchoState *st, const float *in, const float *far_end, float *out)
+{
+   echo_cancellation(st, NULL, NULL, NULL, in, far_end, out);
+}
+#else
+EXPORT void speex_echo_cancellation_float(SpeexEchoState *st, const float *in, const float *far_end, float *out)
+{
+   speex_warning("Float echo cancellation is only available in floating point builds");
+}
+#endif
+
 /* Compute spectrum of estimated echo for use in an echo post-filter */
 void speex_echo_get_residual(SpeexEchoState *st, spx_word32_t *residual_echo, int len)
 {
@@ -1220,6 +1671,93 @@ void speex_echo_get_residual(SpeexEchoState *st, spx_word32_t *residual_echo, in
 
 }
 
+/* Adaptive state snapshot: a header with the dimensions, the foreground filter and the
+   adaptation statistics. The far-end history is not saved, it refills within M frames. */
+#ifdef FIXED_POINT
+#define ECHO_STATE_MAGIC 0x4d444631
+#else
+#define ECHO_STATE_MAGIC 0x4d444646
+#endif
+#define ECHO_STATE_HEADER 5
+
+#define STATE_PUT(ptr, src, n) do { memcpy((ptr), (src), (n)*sizeof(*(src))); (ptr) += (n)*sizeof(*(src)); } while (0)
+#define STATE_GET(ptr, dst, n) do { memcpy((dst), (ptr), (n)*sizeof(*(dst))); (ptr) += (n)*sizeof(*(dst)); } while (0)
+
+static int echo_state_size(SpeexEchoState *st)
+{
+   int size = ECHO_STATE_HEADER*sizeof(spx_int32_t);
+#ifdef TWO_PATH
+   size += st->window_size*st->M*st->C*st->K*sizeof(spx_word16_t);
+#else
+   size += st->window_size*st->M*st->C*st->K*sizeof(spx_word32_t);
+#endif
+   size += (st->frame_size+1)*(3*sizeof(spx_word32_t) + sizeof(spx_float_t));
+   size += st->M*sizeof(spx_word16_t);
+   size += 2*sizeof(spx_float_t) + sizeof(spx_word16_t) + sizeof(spx_word32_t) + sizeof(spx_int32_t);
+   return size;
+}
+
+static void echo_state_save(SpeexEchoState *st, char *ptr)
+{
+   spx_int32_t header[ECHO_STATE_HEADER];
+   spx_int32_t adapted = st->adapted;
+   header[0] = ECHO_STATE_MAGIC;
+   header[1] = st->frame_size;
+   header[2] = st->M;
+   header[3] = st->C;
+   header[4] = st->K;
+   STATE_PUT(ptr, header, ECHO_STATE_HEADER);
+#ifdef TWO_PATH
+   STATE_PUT(ptr, st->foreground, st->window_size*st->M*st->C*st->K);
+#else
+   STATE_PUT(ptr, st->W, st->window_size*st->M*st->C*st->K);
+#endif
+   STATE_PUT(ptr, st->power, st->frame_size+1);
+   STATE_PUT(ptr, st->power_1, st->frame_size+1);
+   STATE_PUT(ptr, st->Eh, st->frame_size+1);
+   STATE_PUT(ptr, st->Yh, st->frame_size+1);
+   STATE_PUT(ptr, st->prop, st->M);
+   STATE_PUT(ptr, &st->Pey, 1);
+   STATE_PUT(ptr, &st->Pyy, 1);
+   STATE_PUT(ptr, &st->leak_estimate, 1);
+   STATE_PUT(ptr, &st->sum_adapt, 1);
+   STATE_PUT(ptr, &adapted, 1);
+}
+
+static int echo_state_restore(SpeexEchoState *st, const char *ptr)
+{
+   int i;
+   spx_int32_t header[ECHO_STATE_HEADER];
+   spx_int32_t adapted;
+   STATE_GET(ptr, header, ECHO_STATE_HEADER);
+   if (header[0] != ECHO_STATE_MAGIC || header[1] != st->frame_size || header[2] != st->M
+       || header[3] != st->C || header[4] != st->K)
+      return -1;
+#ifdef TWO_PATH
+   /* The foreground filter is the one we trust, restart the background from it */
+   STATE_GET(ptr, st->foreground, st->window_size*st->M*st->C*st->K);
+   for (i=0;i<st->window_size*st->M*st->C*st->K;i++)
+      st->W[i] = SHL32(EXTEND32(st->foreground[i]),16);
+   st->Davg1 = st->Davg2 = 0;
+   st->Dvar1 = st->Dvar2 = FLOAT_ZERO;
+#else
+   STATE_GET(ptr, st->W, st->window_size*st->M*st->C*st->K);
+#endif
+   STATE_GET(ptr, st->power, st->frame_size+1);
+   STATE_GET(ptr, st->power_1, st->frame_size+1);
+   STATE_GET(ptr, st->Eh, st->frame_size+1);
+   STATE_GET(ptr, st->Yh, st->frame_size+1);
+   STATE_GET(ptr, st->prop, st->M);
+   STATE_GET(ptr, &st->Pey, 1);
+   STATE_GET(ptr, &st->Pyy, 1);
+   STATE_GET(ptr, &st->leak_estimate, 1);
+   STATE_GET(ptr, &st->sum_adapt, 1);
+   STATE_GET(ptr, &adapted, 1);
+   st->adapted = adapted;
+   st->screwed_up = 0;
+   return 0;
+}
+
 EXPORT int speex_echo_ctl(SpeexEchoState *st, int request, void *ptr)
 {
    switch(request)
@@ -1271,6 +1809,34 @@ EXPORT int speex_echo_ctl(SpeexEchoState *st, int request, void *ptr)
          }
       }
          break;
+      case SPEEX_ECHO_GET_STATE_SIZE:
+         *((spx_int32_t *)ptr) = echo_state_size(st);
+         break;
+      case SPEEX_ECHO_SET_STATE:
+         /* The restored filter may have a different shape, evaluate it fully until re-assessed */
+         st->sparse_hold = st->M;
+         return echo_state_restore(st, (const char *)ptr);
+      case SPEEX_ECHO_GET_STATE:
+         echo_state_save(st, (char *)ptr);
+         break;
+      case SPEEX_ECHO_SET_SPARSE:
+      {
+         int i;
+         st->sparse = *(spx_int32_t *)ptr;
+         if (st->sparse < 0)
+            st->sparse = 0;
+         for (i=0;i<st->M;i++)
+            st->active[i] = 1;
+         st->nb_active = st->M;
+         st->sparse_hold = 0;
+      }
+         break;
+      case SPEEX_ECHO_GET_SPARSE:
+         *((spx_int32_t *)ptr) = st->sparse;
+         break;
+      case SPEEX_ECHO_GET_ACTIVE_PARTITIONS:
+         *((spx_int32_t *)ptr) = st->nb_active;
+         break;
       default:
          speex_warning_int("Unknown speex_echo_ctl request: ", request);
          return -1;
@@ -88,6 +88,11 @@
 #define SQR16(x) (MULT16_16((x),(x)))
 #define SQR16_Q15(x) (MULT16_16_Q15((x),(x)))
 
+/* The approximations of the float build, fixed-point has its own in math_approx.h */
+#ifdef FIXED_POINT
+#undef FAST_MATH_APPROX
+#endif
+
 #ifdef FIXED_POINT
 static inline spx_word16_t DIV32_16_Q8(spx_word32_t a, spx_word32_t b)
 {
@@ -194,6 +199,9 @@ struct SpeexPreprocessState_ {
    int    echo_suppress;
    int    echo_suppress_active;
    SpeexEchoState *echo_state;
+#ifdef FAST_MATH_APPROX
+   int    fast_math;         /**< Use the approximations for the gain computation */
+#endif
 
    spx_word16_t	speech_prob;  /**< Probability last frame was speech */
 
@@ -348,15 +356,17 @@ static void compute_gain_floor(int noise_suppress, int effective_echo_suppress,
    which multiplied by xi/(1+xi) is the optimal gain
    in the loudness domain ( sqrt[amplitude] )
 */
+static const float hypergeom_table[21] = {
+   0.82157f, 1.02017f, 1.20461f, 1.37534f, 1.53363f, 1.68092f, 1.81865f,
+   1.94811f, 2.07038f, 2.18638f, 2.29688f, 2.40255f, 2.50391f, 2.60144f,
+   2.69551f, 2.78647f, 2.87458f, 2.96015f, 3.04333f, 3.12431f, 3.20326f};
+
 static inline spx_word32_t hypergeom_gain(spx_word32_t xx)
 {
    int ind;
    float integer, frac;
    float x;
-   static const float table[21] = {
-      0.82157f, 1.02017f, 1.20461f, 1.37534f, 1.53363f, 1.68092f, 1.81865f,
-      1.94811f, 2.07038f, 2.18638f, 2.29688f, 2.40255f, 2.50391f, 2.60144f,
-      2.69551f, 2.78647f, 2.87458f, 2.96015f, 3.04333f, 3.12431f, 3.20326f};
+   const float *table = hypergeom_table;
       x = EXPIN_SCALING_1*xx;
       integer = floor(2*x);
       ind = (int)integer;
@@ -373,6 +383,21 @@ static inline spx_word16_t qcurve(spx_word16_t x)
    return 1.f/(1.f+.15f/(SNR_SCALING_1*x));
 }
 
+/* Same as hypergeom_gain() for xx >= 0 (always the case for the gain computation), without
+   branches so that a loop over several streams can be vectorised */
+static inline spx_word32_t hypergeom_gain_nonneg(spx_word32_t xx)
+{
+   float x = EXPIN_SCALING_1*xx;
+   /* Truncation is floor() for non-negative values */
+   float integer = (float)(int)(2*x);
+   int ind = (int)integer;
+   int clamped = ind>19 ? 19 : ind;
+   float frac = 2*x-integer;
+   spx_word32_t interpolated = FRAC_SCALING*((1-frac)*hypergeom_table[clamped] + frac*hypergeom_table[clamped+1])/sqrt(x+.0001f);
+   spx_word32_t asymptotic = FRAC_SCALING*(1+.1296/x);
+   return ind>19 ? asymptotic : interpolated;
+}
+
 static void compute_gain_floor(int noise_suppress, int effective_echo_suppress, spx_word32_t *noise, spx_word32_t *echo, spx_word16_t *gain_floor, int len)
 {
    int i;
@@ -387,7 +412,261 @@ static void compute_gain_floor(int noise_suppress, int effective_echo_suppress,
       gain_floor[i] = FRAC_SCALING*sqrt(noise_floor*PSHR32(noise[i],NOISE_SHIFT) + echo_floor*echo[i])/sqrt(1+PSHR32(noise[i],NOISE_SHIFT) + echo[i]);
 }
 
+#ifdef FAST_MATH_APPROX
+/* Branch-free replacements for the libm calls and divisions of the per-bin loops, so that the
+   compiler can vectorise them (sqrt() and exp() are library calls as long as they may set errno,
+   and the hypergeometric table needs a gather). The maximum relative errors given are the ones
+   measured against double precision over the range each approximation is used on. */
+typedef union {
+   float f;
+   spx_int32_t i;
+} float_bits;
+
+/* 1/sqrt(x) for x >= 0: first guess from the exponent bits, two Newton steps. Max error 4.8e-6 */
+static inline float approx_rsqrt(float x)
+{
+   float_bits u, v;
+   float y;
+   u.f = x;
+   v.i = 0x5f375a86 - (u.i>>1);
+   y = v.f;
+   y = y*(1.5f - .5f*x*y*y);
+   y = y*(1.5f - .5f*x*y*y);
+   return y;
+}
+
+/* sqrt(x) for x >= 0, exactly 0 for 0. Max error 4.8e-6 */
+static inline float approx_sqrt(float x)
+{
+   return x*approx_rsqrt(x);
+}
+
+/* 1/x for x > 0: first guess from the exponent bits, three Newton steps. Max error 1.5e-7 */
+static inline float approx_rcp(float x)
+{
+   float_bits u, v;
+   float y;
+   u.f = x;
+   v.i = 0x7ef311c3 - u.i;
+   y = v.f;
+   y = y*(2.f - x*y);
+   y = y*(2.f - x*y);
+   y = y*(2.f - x*y);
+   return y;
+}
+
+/* exp(x) as 2^n * 2^f with n rounded to nearest (adding and removing 1.5*2^23) and a degree 4
+   polynomial for 2^f, f in [-.5,.5]. Max error 6.5e-6 for x in [-87,88], clamped outside of it
+   (exp(-87) is 1.6e-38) */
+static inline float approx_exp(float x)
+{
+   float_bits u;
+   float t, n, f;
+   x = MIN16(MAX16(x, -87.f), 88.f);
+   t = 1.442695041f*x;
+   n = (t + 12582912.f) - 12582912.f;
+   f = t - n;
+   u.i = ((spx_int32_t)n + 127) << 23;
+   return u.f*(.99999919f + f*(.69312197f + f*(.24024981f + f*(.055917039f + f*.0095605102f))));
+}
+
+/* hypergeom_gain() for xx >= 0 with a degree 4 polynomial fitted to the table instead of the
+   interpolation, joined to the asymptote at 10 by clamping rather than by a branch. It is
+   within 3.7e-4 of the table entries and within 2.3e-3 of the linear interpolation between them
+   (the interpolation error of the table itself) */
+static inline float hypergeom_gain_approx(float x)
+{
+   float xc = MIN16(x, 10.f);
+   float poly = .82147855f + xc*(.41428896f + xc*(-.033431142f + xc*(.00225518f - 6.7396523e-05f*xc)));
+   /* The asymptote cancels out below 10, above it the polynomial stays at its value at 10 */
+   float asymptotic = .1296f*approx_rcp(MAX16(x, 10.f)) - .1296f*approx_rcp(MAX16(xc, 10.f));
+   return poly*approx_rsqrt(xc+.0001f) + asymptotic;
+}
+
+/* qcurve() for x >= 0, as x/(x+.15). Max error 1.5e-7 */
+static inline float qcurve_approx(float x)
+{
+   return x*approx_rcp(x + .15f);
+}
+
+/* compute_gain_floor() with the approximations. Max error 1.5e-5 */
+static void compute_gain_floor_approx(int noise_suppress, int effective_echo_suppress, spx_word32_t *noise, spx_word32_t *echo, spx_word16_t *gain_floor, int len)
+{
+   int i;
+   float noise_floor = approx_exp(.2302585f*noise_suppress);
+   float echo_floor = approx_exp(.2302585f*effective_echo_suppress);
+
+   for (i=0;i<len;i++)
+      gain_floor[i] = approx_sqrt(noise_floor*noise[i] + echo_floor*echo[i])*approx_rsqrt(1+noise[i] + echo[i]);
+}
+
+/* The a posteriori and a priori SNR update of preprocess_frame(). The arrays are read through
+   locals so that the stores can't be taken for changes to the state, and the loops are split
+   so that few enough pairs of them may overlap for the compiler to check at run time */
+static void update_snr_approx(SpeexPreprocessState *st, int len)
+{
+   int i;
+   const float *ps = st->ps;
+   const float *noise = st->noise;
+   const float *echo_noise = st->echo_noise;
+   const float *reverb_estimate = st->reverb_estimate;
+   const float *old_ps = st->old_ps;
+   float *post = st->post;
+   float *prior = st->prior;
+
+   /* A posteriori SNR, and the reciprocal of the total noise kept in the a priori SNR for now */
+   for (i=0;i<len;i++)
+   {
+      float inv_noise = approx_rcp(1.f + noise[i] + echo_noise[i] + reverb_estimate[i]);
+      post[i] = MIN16(ps[i]*inv_noise - 1.f, 100.f);
+      prior[i] = inv_noise;
+   }
+   /* With r = old/noise, old/(old+noise) is r/(r+1) */
+   for (i=0;i<len;i++)
+   {
+      float ratio = old_ps[i]*prior[i];
+      float gamma = ratio*approx_rcp(ratio + 1.f);
+      gamma = .1f + .89f*gamma*gamma;
+      prior[i] = MIN16(gamma*MAX16(0, post[i]) + (1.f-gamma)*ratio, 100.f);
+   }
+}
+
+/* The critical band gains and speech probabilities of preprocess_frame() */
+static void compute_band_gain_approx(SpeexPreprocessState *st, float Pframe)
+{
+   int i;
+   int N = st->ps_size;
+   int M = st->nbands;
+   const float *ps = st->ps+N;
+   const float *prior = st->prior+N;
+   const float *post = st->post+N;
+   const float *zeta = st->zeta+N;
+   float *old_ps = st->old_ps+N;
+   float *gain = st->gain+N;
+   float *gain2 = st->gain2+N;
+   for (i=0;i<M;i++)
+   {
+      float prior_ratio = prior[i]*approx_rcp(prior[i] + 1.f);
+      float theta = prior_ratio*(1.f + post[i]);
+      float P1 = .199f + .8f*qcurve_approx(zeta[i]);
+      float q = 1.f - Pframe*P1;
+      gain[i] = MIN16(1.f, prior_ratio*hypergeom_gain_approx(theta));
+      gain2[i] = approx_rcp(1.f + q*approx_rcp(1.f-q)*(1+prior[i])*approx_exp(-theta));
+   }
+   for (i=0;i<M;i++)
+      old_ps[i] = .2f*old_ps[i] + .8f*gain[i]*gain[i]*ps[i];
+}
+
+/* The linear frequency gains of preprocess_frame(), with the conditions written as MIN/MAX. The
+   constraint to the Bark scale gain caps at 3 times it from 3 times it on, instead of 3.003 */
+static void compute_linear_gain_approx(SpeexPreprocessState *st)
+{
+   int i;
+   int N = st->ps_size;
+   const float *ps = st->ps;
+   const float *prior = st->prior;
+   const float *post = st->post;
+   const float *gain_floor = st->gain_floor;
+   float *old_ps = st->old_ps;
+   float *gain = st->gain;
+   float *gain2 = st->gain2;
+
+   /* EM gain with bound, constrained to be close to the Bark scale gain */
+   for (i=0;i<N;i++)
+   {
+      float prior_ratio = prior[i]*approx_rcp(prior[i] + 1.f);
+      float theta = prior_ratio*(1.f + post[i]);
+      float g = MIN16(1.f, prior_ratio*hypergeom_gain_approx(theta));
+      gain[i] = MIN16(g, 3*gain[i]);
+   }
+   for (i=0;i<N;i++)
+      old_ps[i] = .2f*old_ps[i] + .8f*gain[i]*gain[i]*ps[i];
+   /* Gain floor, and the speech probability of presence (in gain2) into account */
+   for (i=0;i<N;i++)
+   {
+      float g = MAX16(gain[i], gain_floor[i]);
+      float tmp = gain2[i]*approx_sqrt(g) + (1.f-gain2[i])*approx_sqrt(gain_floor[i]);
+      gain[i] = g;
+      gain2[i] = tmp*tmp;
+   }
+}
+#endif
+
+#endif
+/** Parameters back to their defaults and adaptation back to the start, without reallocating */
+static void preprocess_reset(SpeexPreprocessState *st)
+{
+   int i;
+   int N = st->ps_size;
+   int N3 = 2*N - st->frame_size;
+   int M = st->nbands;
+
+   st->denoise_enabled = 1;
+   st->vad_enabled = 0;
+   st->dereverb_enabled = 0;
+   st->reverb_decay = 0;
+   st->reverb_level = 0;
+   st->noise_suppress = NOISE_SUPPRESS_DEFAULT;
+   st->echo_suppress = ECHO_SUPPRESS_DEFAULT;
+   st->echo_suppress_active = ECHO_SUPPRESS_ACTIVE_DEFAULT;
+
+   st->speech_prob_start = SPEECH_PROB_START_DEFAULT;
+   st->speech_prob_continue = SPEECH_PROB_CONTINUE_DEFAULT;
+
+   st->echo_state = NULL;
+   st->speech_prob = 0;
+#ifdef FAST_MATH_APPROX
+   st->fast_math = 1;
+#endif
+
+   SPEEX_MEMSET(st->frame, 0, 2*N);
+   SPEEX_MEMSET(st->ft, 0, 2*N);
+   SPEEX_MEMSET(st->ps, 0, N+M);
+   SPEEX_MEMSET(st->gain2, 0, N+M);
+   SPEEX_MEMSET(st->gain_floor, 0, N+M);
+   SPEEX_MEMSET(st->zeta, 0, N+M);
+   SPEEX_MEMSET(st->echo_noise, 0, N+M);
+   SPEEX_MEMSET(st->residual_echo, 0, N+M);
+   SPEEX_MEMSET(st->S, 0, N);
+   SPEEX_MEMSET(st->Smin, 0, N);
+   SPEEX_MEMSET(st->Stmp, 0, N);
+
+   for (i=0;i<N+M;i++)
+   {
+      st->noise[i]=QCONST32(1.f,NOISE_SHIFT);
+      st->reverb_estimate[i]=0;
+      st->old_ps[i]=1;
+      st->gain[i]=Q15_ONE;
+      st->post[i]=SHL16(1, SNR_SHIFT);
+      st->prior[i]=SHL16(1, SNR_SHIFT);
+   }
+
+   for (i=0;i<N;i++)
+      st->update_prob[i] = 1;
+   for (i=0;i<N3;i++)
+   {
+      st->inbuf[i]=0;
+      st->outbuf[i]=0;
+   }
+#ifndef FIXED_POINT
+   st->agc_enabled = 0;
+   st->agc_level = 8000;
+   st->loudness_accum = 0;
+   /*st->loudness = pow(AMP_SCALE*st->agc_level,LOUDNESS_EXP);*/
+   st->loudness = 1e-15;
+   st->agc_gain = 1;
+   st->max_gain = 30;
+   st->max_increase_step = exp(0.11513f * 12.*st->frame_size / st->sampling_rate);
+   st->max_decrease_step = exp(-0.11513f * 40.*st->frame_size / st->sampling_rate);
+   st->prev_loudness = 1;
+   st->init_max = 1;
 #endif
+   st->was_speech = 0;
+
+   st->nb_adapt=0;
+   st->min_count=0;
+}
+
 EXPORT SpeexPreprocessState *speex_preprocess_state_init(int frame_size, int sampling_rate)
 {
    int i;
@@ -423,19 +702,6 @@ EXPORT SpeexPreprocessState *speex_preprocess_state_init(int frame_size, int sam
    N4 = st->frame_size - N3;
 
    st->sampling_rate = sampling_rate;
-   st->denoise_enabled = 1;
-   st->vad_enabled = 0;
-   st->dereverb_enabled = 0;
-   st->reverb_decay = 0;
-   st->reverb_level = 0;
-   st->noise_suppress = NOISE_SUPPRESS_DEFAULT;
-   st->echo_suppress = ECHO_SUPPRESS_DEFAULT;
-   st->echo_suppress_active = ECHO_SUPPRESS_ACTIVE_DEFAULT;
-
-   st->speech_prob_start = SPEECH_PROB_START_DEFAULT;
-   st->speech_prob_continue = SPEECH_PROB_CONTINUE_DEFAULT;
-
-   st->echo_state = NULL;
 
    st->nbands = NB_BANDS;
    M = st->nbands;
@@ -478,26 +744,7 @@ EXPORT SpeexPreprocessState *speex_preprocess_state_init(int frame_size, int sam
          st->window[i+N3]=1;
       }
    }
-   for (i=0;i<N+M;i++)
-   {
-      st->noise[i]=QCONST32(1.f,NOISE_SHIFT);
-      st->reverb_estimate[i]=0;
-      st->old_ps[i]=1;
-      st->gain[i]=Q15_ONE;
-      st->post[i]=SHL16(1, SNR_SHIFT);
-      st->prior[i]=SHL16(1, SNR_SHIFT);
-   }
-
-   for (i=0;i<N;i++)
-      st->update_prob[i] = 1;
-   for (i=0;i<N3;i++)
-   {
-      st->inbuf[i]=0;
-      st->outbuf[i]=0;
-   }
 #ifndef FIXED_POINT
-   st->agc_enabled = 0;
-   st->agc_level = 8000;
    st->loudness_weight = (float*)speex_alloc(N*sizeof(float));
    for (i=0;i<N;i++)
    {
@@ -508,24 +755,19 @@ EXPORT SpeexPreprocessState *speex_preprocess_state_init(int frame_size, int sam
          st->loudness_weight[i]=.01f;
       st->loudness_weight[i] *= st->loudness_weight[i];
    }
-   /*st->loudness = pow(AMP_SCALE*st->agc_level,LOUDNESS_EXP);*/
-   st->loudness = 1e-15;
-   st->agc_gain = 1;
-   st->max_gain = 30;
-   st->max_increase_step = exp(0.11513f * 12.*st->frame_size / st->sampling_rate);
-   st->max_decrease_step = exp(-0.11513f * 40.*st->frame_size / st->sampling_rate);
-   st->prev_loudness = 1;
-   st->init_max = 1;
 #endif
-   st->was_speech = 0;
 
    st->fft_lookup = spx_fft_init(2*N);
 
-   st->nb_adapt=0;
-   st->min_count=0;
+   preprocess_reset(st);
    return st;
 }
 
+EXPORT void speex_preprocess_state_reset(SpeexPreprocessState *st)
+{
+   preprocess_reset(st);
+}
+
 EXPORT void speex_preprocess_state_destroy(SpeexPreprocessState *st)
 {
    speex_free(st->frame);
@@ -611,13 +853,11 @@ static void speex_compute_agc(SpeexPreprocessState *st, spx_word16_t Pframe, spx
 }
 #endif
 
-static void preprocess_analysis(SpeexPreprocessState *st, spx_int16_t *x)
+static void preprocess_input(SpeexPreprocessState *st, const spx_int16_t *x)
 {
    int i;
-   int N = st->ps_size;
-   int N3 = 2*N - st->frame_size;
+   int N3 = 2*st->ps_size - st->frame_size;
    int N4 = st->frame_size - N3;
-   spx_word32_t *ps=st->ps;
 
    /* 'Build' input frame */
    for (i=0;i<N3;i++)
@@ -628,6 +868,67 @@ static void preprocess_analysis(SpeexPreprocessState *st, spx_int16_t *x)
    /* Update inbuf */
    for (i=0;i<N3;i++)
       st->inbuf[i]=x[N4+i];
+}
+
+/* Overlap and add of the synthesised frame, then update of outbuf */
+static void preprocess_output(SpeexPreprocessState *st, spx_int16_t *x)
+{
+   int i;
+   int N3 = 2*st->ps_size - st->frame_size;
+   int N4 = st->frame_size - N3;
+
+   for (i=0;i<N3;i++)
+      x[i] = WORD2INT(ADD32(EXTEND32(st->outbuf[i]), EXTEND32(st->frame[i])));
+   for (i=0;i<N4;i++)
+      x[N3+i] = st->frame[N3+i];
+
+   for (i=0;i<N3;i++)
+      st->outbuf[i] = st->frame[st->frame_size+i];
+}
+
+#ifndef FIXED_POINT
+/* Float samples are full scale at +/-1.0, the preprocessor works on the 16-bit scale */
+#define FLOAT_SCALE 32768.f
+#define FLOAT_SCALE_1 (1.f/32768.f)
+
+static void preprocess_input_float(SpeexPreprocessState *st, const float *x)
+{
+   int i;
+   int N3 = 2*st->ps_size - st->frame_size;
+   int N4 = st->frame_size - N3;
+
+   for (i=0;i<N3;i++)
+      st->frame[i]=st->inbuf[i];
+   for (i=0;i<st->frame_size;i++)
+      st->frame[N3+i]=FLOAT_SCALE*x[i];
+
+   for (i=0;i<N3;i++)
+      st->inbuf[i]=FLOAT_SCALE*x[N4+i];
+}
+
+/* Same as preprocess_output(), without clipping */
+static void preprocess_output_float(SpeexPreprocessState *st, float *x)
+{
+   int i;
+   int N3 = 2*st->ps_size - st->frame_size;
+   int N4 = st->frame_size - N3;
+
+   for (i=0;i<N3;i++)
+      x[i] = FLOAT_SCALE_1*(st->outbuf[i] + st->frame[i]);
+   for (i=0;i<N4;i++)
+      x[N3+i] = FLOAT_SCALE_1*st->frame[N3+i];
+
+   for (i=0;i<N3;i++)
+      st->outbuf[i] = st->frame[st->frame_size+i];
+}
+#endif
+
+/* Analysis of the frame built by preprocess_input() */
+static void preprocess_analysis(SpeexPreprocessState *st)
+{
+   int i;
+   int N = st->ps_size;
+   spx_word32_t *ps=st->ps;
 
    /* Windowing */
    for (i=0;i<2*N;i++)
@@ -719,13 +1020,13 @@ EXPORT int speex_preprocess(SpeexPreprocessState *st, spx_int16_t *x, spx_int32_
    return speex_preprocess_run(st, x);
 }
 
-EXPORT int speex_preprocess_run(SpeexPreprocessState *st, spx_int16_t *x)
+/* Denoising, AGC and VAD of the frame built by preprocess_input(). Leaves the windowed
+   synthesis in st->frame for preprocess_output(). */
+static int preprocess_frame(SpeexPreprocessState *st)
 {
    int i;
    int M;
    int N = st->ps_size;
-   int N3 = 2*N - st->frame_size;
-   int N4 = st->frame_size - N3;
    spx_word32_t *ps=st->ps;
    spx_word32_t Zframe;
    spx_word16_t Pframe;
@@ -759,7 +1060,7 @@ EXPORT int speex_preprocess_run(SpeexPreprocessState *st, spx_int16_t *x)
       for (i=0;i<N+M;i++)
          st->echo_noise[i] = 0;
    }
-   preprocess_analysis(st, x);
+   preprocess_analysis(st);
 
    update_noise_prob(st);
 
@@ -785,6 +1086,11 @@ EXPORT int speex_preprocess_run(SpeexPreprocessState *st, spx_int16_t *x)
          st->old_ps[i] = ps[i];
 
    /* Compute a posteriori SNR */
+#ifdef FAST_MATH_APPROX
+   if (st->fast_math)
+      update_snr_approx(st, N+M);
+   else
+#endif
    for (i=0;i<N+M;i++)
    {
       spx_word16_t gamma;
@@ -818,15 +1124,30 @@ EXPORT int speex_preprocess_run(SpeexPreprocessState *st, spx_int16_t *x)
    Zframe = 0;
    for (i=N;i<N+M;i++)
       Zframe = ADD32(Zframe, EXTEND32(st->zeta[i]));
+#ifdef FAST_MATH_APPROX
+   if (st->fast_math)
+      Pframe = .1f + .899f*qcurve_approx(Zframe/st->nbands);
+   else
+#endif
    Pframe = QCONST16(.1f,15)+MULT16_16_Q15(QCONST16(.899f,15),qcurve(DIV32_16(Zframe,st->nbands)));
 
    effective_echo_suppress = EXTRACT16(PSHR32(ADD32(MULT16_16(SUB16(Q15_ONE,Pframe), st->echo_suppress), MULT16_16(Pframe, st->echo_suppress_active)),15));
 
+#ifdef FAST_MATH_APPROX
+   if (st->fast_math)
+      compute_gain_floor_approx(st->noise_suppress, effective_echo_suppress, st->noise+N, st->echo_noise+N, st->gain_floor+N, M);
+   else
+#endif
    compute_gain_floor(st->noise_suppress, effective_echo_suppress, st->noise+N, st->echo_noise+N, st->gain_floor+N, M);
 
    /* Compute Ephraim & Malah gain speech probability of presence for each critical band (Bark scale)
       Technically this is actually wrong because the EM gaim assumes a slightly different probability
       distribution */
+#ifdef FAST_MATH_APPROX
+   if (st->fast_math)
+      compute_band_gain_approx(st, Pframe);
+   else
+#endif
    for (i=N;i<N+M;i++)
    {
       /* See EM and Cohen papers*/
@@ -874,6 +1195,11 @@ EXPORT int speex_preprocess_run(SpeexPreprocessState *st, spx_int16_t *x)
       filterbank_compute_psd16(st->bank,st->gain_floor+N, st->gain_floor);
 
       /* Compute gain according to the Ephraim-Malah algorithm -- linear frequency */
+#ifdef FAST_MATH_APPROX
+      if (st->fast_math)
+         compute_linear_gain_approx(st);
+      else
+#endif
       for (i=0;i<N;i++)
       {
          spx_word32_t MM;
@@ -978,16 +1304,6 @@ EXPORT int speex_preprocess_run(SpeexPreprocessState *st, spx_int16_t *x)
    for (i=0;i<2*N;i++)
       st->frame[i] = MULT16_16_Q15(st->frame[i], st->window[i]);
 
-   /* Perform overlap and add */
-   for (i=0;i<N3;i++)
-      x[i] = WORD2INT(ADD32(EXTEND32(st->outbuf[i]), EXTEND32(st->frame[i])));
-   for (i=0;i<N4;i++)
-      x[N3+i] = st->frame[N3+i];
-
-   /* Update outbuf */
-   for (i=0;i<N3;i++)
-      st->outbuf[i] = st->frame[st->frame_size+i];
-
    /* FIXME: This VAD is a kludge */
    st->speech_prob = Pframe;
    if (st->vad_enabled)
@@ -1006,6 +1322,32 @@ EXPORT int speex_preprocess_run(SpeexPreprocessState *st, spx_int16_t *x)
    }
 }
 
+EXPORT int speex_preprocess_run(SpeexPreprocessState *st, spx_int16_t *x)
+{
+   int vad;
+   preprocess_input(st, x);
+   vad = preprocess_frame(st);
+   preprocess_output(st, x);
+   return vad;
+}
+
+#ifndef FIXED_POINT
+EXPORT int speex_preprocess_run_float(SpeexPreprocessState *st, float *x)
+{
+   int vad;
+   preprocess_input_float(st, x);
+   vad = preprocess_frame(st);
+   preprocess_output_float(st, x);
+   return vad;
+}
+#else
+EXPORT int speex_preprocess_run_float(SpeexPreprocessState *st, float *x)
+{
+   speex_warning("Float preprocessing is only available in floating point builds");
+   return 1;
+}
+#endif
+
 EXPORT void speex_preprocess_estimate_update(SpeexPreprocessState *st, spx_int16_t *x)
 {
    int i;
@@ -1017,7 +1359,8 @@ EXPORT void speex_preprocess_estimate_update(SpeexPreprocessState *st, spx_int16
    M = st->nbands;
    st->min_count++;
 
-   preprocess_analysis(st, x);
+   preprocess_input(st, x);
+   preprocess_analysis(st);
 
    update_noise_prob(st);
 
@@ -1041,14 +1384,103 @@ EXPORT void speex_preprocess_estimate_update(SpeexPreprocessState *st, spx_int16
 }
 
 
-EXPORT int speex_preprocess_ctl(SpeexPreprocessState *state, int request, void *ptr)
+/* Adaptive state snapshot: a header with the dimensions, the noise and SNR estimates and
+   the AGC state. Analysis/synthesis buffers are not saved. */
+#ifdef FIXED_POINT
+#define PREPROCESS_STATE_MAGIC 0x50525031
+#else
+#define PREPROCESS_STATE_MAGIC 0x50525046
+#endif
+#define PREPROCESS_STATE_HEADER 5
+
+#define STATE_PUT(ptr, src, n) do { memcpy((ptr), (src), (n)*sizeof(*(src))); (ptr) += (n)*sizeof(*(src)); } while (0)
+#define STATE_GET(ptr, dst, n) do { memcpy((dst), (ptr), (n)*sizeof(*(dst))); (ptr) += (n)*sizeof(*(dst)); } while (0)
+
+static int preprocess_state_size(SpeexPreprocessState *st)
 {
-   int i;
-   SpeexPreprocessState *st;
-   st=(SpeexPreprocessState*)state;
-   switch(request)
-   {
-   case SPEEX_PREPROCESS_SET_DENOISE:
+   int N = st->ps_size;
+   int M = st->nbands;
+   int size = PREPROCESS_STATE_HEADER*sizeof(spx_int32_t);
+   size += (N+M)*(2*sizeof(spx_word32_t) + sizeof(spx_word16_t));
+   size += N*3*sizeof(spx_word32_t);
+   size += sizeof(spx_word16_t) + 3*sizeof(spx_int32_t);
+#ifndef FIXED_POINT
+   size += 5*sizeof(float);
+#endif
+   return size;
+}
+
+static void preprocess_state_save(SpeexPreprocessState *st, char *ptr)
+{
+   int N = st->ps_size;
+   int M = st->nbands;
+   spx_int32_t header[PREPROCESS_STATE_HEADER];
+   spx_int32_t counters[3];
+   header[0] = PREPROCESS_STATE_MAGIC;
+   header[1] = st->frame_size;
+   header[2] = st->ps_size;
+   header[3] = st->nbands;
+   header[4] = st->sampling_rate;
+   counters[0] = st->nb_adapt;
+   counters[1] = st->min_count;
+   counters[2] = st->was_speech;
+   STATE_PUT(ptr, header, PREPROCESS_STATE_HEADER);
+   STATE_PUT(ptr, st->noise, N+M);
+   STATE_PUT(ptr, st->old_ps, N+M);
+   STATE_PUT(ptr, st->zeta, N+M);
+   STATE_PUT(ptr, st->S, N);
+   STATE_PUT(ptr, st->Smin, N);
+   STATE_PUT(ptr, st->Stmp, N);
+   STATE_PUT(ptr, &st->speech_prob, 1);
+   STATE_PUT(ptr, counters, 3);
+#ifndef FIXED_POINT
+   STATE_PUT(ptr, &st->loudness, 1);
+   STATE_PUT(ptr, &st->loudness_accum, 1);
+   STATE_PUT(ptr, &st->agc_gain, 1);
+   STATE_PUT(ptr, &st->prev_loudness, 1);
+   STATE_PUT(ptr, &st->init_max, 1);
+#endif
+}
+
+static int preprocess_state_restore(SpeexPreprocessState *st, const char *ptr)
+{
+   int N = st->ps_size;
+   int M = st->nbands;
+   spx_int32_t header[PREPROCESS_STATE_HEADER];
+   spx_int32_t counters[3];
+   STATE_GET(ptr, header, PREPROCESS_STATE_HEADER);
+   if (header[0] != PREPROCESS_STATE_MAGIC || header[1] != st->frame_size || header[2] != st->ps_size
+       || header[3] != st->nbands || header[4] != st->sampling_rate)
+      return -1;
+   STATE_GET(ptr, st->noise, N+M);
+   STATE_GET(ptr, st->old_ps, N+M);
+   STATE_GET(ptr, st->zeta, N+M);
+   STATE_GET(ptr, st->S, N);
+   STATE_GET(ptr, st->Smin, N);
+   STATE_GET(ptr, st->Stmp, N);
+   STATE_GET(ptr, &st->speech_prob, 1);
+   STATE_GET(ptr, counters, 3);
+   st->nb_adapt = counters[0];
+   st->min_count = counters[1];
+   st->was_speech = counters[2];
+#ifndef FIXED_POINT
+   STATE_GET(ptr, &st->loudness, 1);
+   STATE_GET(ptr, &st->loudness_accum, 1);
+   STATE_GET(ptr, &st->agc_gain, 1);
+   STATE_GET(ptr, &st->prev_loudness, 1);
+   STATE_GET(ptr, &st->init_max, 1);
+#endif
+   return 0;
+}
+
+EXPORT int speex_preprocess_ctl(SpeexPreprocessState *state, int request, void *ptr)
+{
+   int i;
+   SpeexPreprocessState *st;
+   st=(SpeexPreprocessState*)state;
+   switch(request)
+   {
+   case SPEEX_PREPROCESS_SET_DENOISE:
       st->denoise_enabled = (*(spx_int32_t*)ptr);
       break;
    case SPEEX_PREPROCESS_GET_DENOISE:
@@ -1201,6 +1633,29 @@ EXPORT int speex_preprocess_ctl(SpeexPreprocessState *state, int request, void *
    case SPEEX_PREPROCESS_GET_AGC_TARGET:
       (*(spx_int32_t*)ptr) = st->agc_level;
       break;
+#endif
+   case SPEEX_PREPROCESS_GET_STATE_SIZE:
+      (*(spx_int32_t*)ptr) = preprocess_state_size(st);
+      break;
+   case SPEEX_PREPROCESS_SET_STATE:
+      return preprocess_state_restore(st, (const char*)ptr);
+   case SPEEX_PREPROCESS_GET_STATE:
+      preprocess_state_save(st, (char*)ptr);
+      break;
+#ifdef FAST_MATH_APPROX
+   case SPEEX_PREPROCESS_SET_FAST_MATH:
+      st->fast_math = (*(spx_int32_t*)ptr) != 0;
+      break;
+   case SPEEX_PREPROCESS_GET_FAST_MATH:
+      (*(spx_int32_t*)ptr) = st->fast_math;
+      break;
+#else
+   case SPEEX_PREPROCESS_SET_FAST_MATH:
+      /* Not compiled in */
+      return (*(spx_int32_t*)ptr) ? -1 : 0;
+   case SPEEX_PREPROCESS_GET_FAST_MATH:
+      (*(spx_int32_t*)ptr) = 0;
+      break;
 #endif
    default:
       speex_warning_int("Unknown speex_preprocess_ctl request: ", request);
@@ -1213,3 +1668,890 @@ EXPORT int speex_preprocess_ctl(SpeexPreprocessState *state, int request, void *
 long long spx_mips=0;
 #endif
 
+
+#ifndef FIXED_POINT
+
+/** Batch of preprocessors advanced in lockstep. Spectral arrays are stream-interleaved: the
+    value of bin i for stream s is at [i*nb_streams + s], so that the per-bin loops below have
+    the streams as their (branch-free) inner loop. Time domain buffers are stream-major. */
+struct SpeexPreprocessBatch_ {
+   int    nb_streams;
+   int    frame_size;
+   int    ps_size;
+   int    sampling_rate;
+   int    nbands;
+   FilterBank *bank;
+
+   /* Parameters, shared by all the streams */
+   int    denoise_enabled;
+   int    vad_enabled;
+   int    noise_suppress;
+   spx_word16_t speech_prob_start;
+   spx_word16_t speech_prob_continue;
+
+   /* Time domain, stream-major */
+   spx_word16_t *frame;      /**< Processing frame (nb_streams*2*ps_size) */
+   spx_word16_t *ft;         /**< Processing frame in freq domain (nb_streams*2*ps_size) */
+   spx_word16_t *inbuf;      /**< Input buffer (nb_streams*N3) */
+   spx_word16_t *outbuf;     /**< Output buffer (nb_streams*N3) */
+   spx_word16_t *window;     /**< Analysis/Synthesis window (2*ps_size) */
+
+   /* Spectral state, stream-interleaved */
+   spx_word32_t *ps;
+   spx_word32_t *noise;
+   spx_word32_t *echo_noise; /**< Always zero, only the gain floor uses it */
+   spx_word32_t *old_ps;
+   spx_word16_t *gain;
+   spx_word16_t *gain2;
+   spx_word16_t *gain_floor;
+   spx_word16_t *prior;
+   spx_word16_t *post;
+   spx_word16_t *zeta;
+   spx_word32_t *S;
+   spx_word32_t *Smin;
+   spx_word32_t *Stmp;
+   int *update_prob;
+
+   /* Per-stream scalars */
+   spx_word16_t *beta;
+   spx_word32_t *Zframe;
+   spx_word16_t *speech_prob;
+   int *nb_adapt;
+   int *min_count;
+   int *reset_min;
+   int *was_speech;
+
+   void  *fft_lookup;
+};
+
+/* filterbank_compute_bank32() over all the streams of a batch */
+static void batch_compute_bank(FilterBank *bank, const spx_word32_t *ps, spx_word32_t *mel, int S)
+{
+   int i, s;
+   for (i=0;i<bank->nb_banks*S;i++)
+      mel[i] = 0;
+   for (i=0;i<bank->len;i++)
+   {
+      spx_word32_t *left = mel + bank->bank_left[i]*S;
+      spx_word32_t *right = mel + bank->bank_right[i]*S;
+      for (s=0;s<S;s++)
+      {
+         left[s] += MULT16_32_P15(bank->filter_left[i],ps[i*S+s]);
+         right[s] += MULT16_32_P15(bank->filter_right[i],ps[i*S+s]);
+      }
+   }
+}
+
+/* filterbank_compute_psd16() over all the streams of a batch */
+static void batch_compute_psd(FilterBank *bank, const spx_word16_t *mel, spx_word16_t *ps, int S)
+{
+   int i, s;
+   for (i=0;i<bank->len;i++)
+   {
+      const spx_word16_t *left = mel + bank->bank_left[i]*S;
+      const spx_word16_t *right = mel + bank->bank_right[i]*S;
+      for (s=0;s<S;s++)
+         ps[i*S+s] = left[s]*bank->filter_left[i] + right[s]*bank->filter_right[i];
+   }
+}
+
+EXPORT SpeexPreprocessBatch *speex_preprocess_batch_init(int nb_streams, int frame_size, int sampling_rate)
+{
+   int i, s;
+   int N, N3, N4, M, S;
+   SpeexPreprocessBatch *st;
+
+   if (nb_streams < 1)
+      return NULL;
+
+   st = (SpeexPreprocessBatch *)speex_alloc(sizeof(SpeexPreprocessBatch));
+   st->nb_streams = S = nb_streams;
+   st->frame_size = frame_size;
+   st->ps_size = N = frame_size;
+   N3 = 2*N - st->frame_size;
+   N4 = st->frame_size - N3;
+   st->sampling_rate = sampling_rate;
+
+   st->denoise_enabled = 1;
+   st->vad_enabled = 0;
+   st->noise_suppress = NOISE_SUPPRESS_DEFAULT;
+   st->speech_prob_start = SPEECH_PROB_START_DEFAULT;
+   st->speech_prob_continue = SPEECH_PROB_CONTINUE_DEFAULT;
+
+   st->nbands = M = NB_BANDS;
+   st->bank = filterbank_new(M, sampling_rate, N, 1);
+
+   st->frame = (spx_word16_t*)speex_alloc(S*2*N*sizeof(spx_word16_t));
+   st->ft = (spx_word16_t*)speex_alloc(S*2*N*sizeof(spx_word16_t));
+   st->inbuf = (spx_word16_t*)speex_alloc(S*N3*sizeof(spx_word16_t));
+   st->outbuf = (spx_word16_t*)speex_alloc(S*N3*sizeof(spx_word16_t));
+   st->window = (spx_word16_t*)speex_alloc(2*N*sizeof(spx_word16_t));
+
+   st->ps = (spx_word32_t*)speex_alloc(S*(N+M)*sizeof(spx_word32_t));
+   st->noise = (spx_word32_t*)speex_alloc(S*(N+M)*sizeof(spx_word32_t));
+   st->echo_noise = (spx_word32_t*)speex_alloc(S*(N+M)*sizeof(spx_word32_t));
+   st->old_ps = (spx_word32_t*)speex_alloc(S*(N+M)*sizeof(spx_word32_t));
+   st->gain = (spx_word16_t*)speex_alloc(S*(N+M)*sizeof(spx_word16_t));
+   st->gain2 = (spx_word16_t*)speex_alloc(S*(N+M)*sizeof(spx_word16_t));
+   st->gain_floor = (spx_word16_t*)speex_alloc(S*(N+M)*sizeof(spx_word16_t));
+   st->prior = (spx_word16_t*)speex_alloc(S*(N+M)*sizeof(spx_word16_t));
+   st->post = (spx_word16_t*)speex_alloc(S*(N+M)*sizeof(spx_word16_t));
+   st->zeta = (spx_word16_t*)speex_alloc(S*(N+M)*sizeof(spx_word16_t));
+   st->S = (spx_word32_t*)speex_alloc(S*N*sizeof(spx_word32_t));
+   st->Smin = (spx_word32_t*)speex_alloc(S*N*sizeof(spx_word32_t));
+   st->Stmp = (spx_word32_t*)speex_alloc(S*N*sizeof(spx_word32_t));
+   st->update_prob = (int*)speex_alloc(S*N*sizeof(int));
+
+   st->beta = (spx_word16_t*)speex_alloc(S*sizeof(spx_word16_t));
+   st->Zframe = (spx_word32_t*)speex_alloc(S*sizeof(spx_word32_t));
+   st->speech_prob = (spx_word16_t*)speex_alloc(S*sizeof(spx_word16_t));
+   st->nb_adapt = (int*)speex_alloc(S*sizeof(int));
+   st->min_count = (int*)speex_alloc(S*sizeof(int));
+   st->reset_min = (int*)speex_alloc(S*sizeof(int));
+   st->was_speech = (int*)speex_alloc(S*sizeof(int));
+
+   /* Same window as speex_preprocess_state_init() */
+   conj_window(st->window, 2*N3);
+   for (i=2*N3;i<2*st->ps_size;i++)
+      st->window[i]=Q15_ONE;
+   if (N4>0)
+   {
+      for (i=N3-1;i>=0;i--)
+      {
+         st->window[i+N3+N4]=st->window[i+N3];
+         st->window[i+N3]=1;
+      }
+   }
+
+   for (s=0;s<S;s++)
+      speex_preprocess_batch_reset_stream(st, s);
+
+   st->fft_lookup = spx_fft_init(2*N);
+   return st;
+}
+
+EXPORT void speex_preprocess_batch_reset_stream(SpeexPreprocessBatch *st, int stream)
+{
+   int i;
+   int S = st->nb_streams;
+   int N = st->ps_size;
+   int N3 = 2*N - st->frame_size;
+   int M = st->nbands;
+
+   if (stream < 0 || stream >= S)
+      return;
+
+   for (i=0;i<N+M;i++)
+   {
+      st->noise[i*S+stream]=QCONST32(1.f,NOISE_SHIFT);
+      st->old_ps[i*S+stream]=1;
+      st->gain[i*S+stream]=Q15_ONE;
+      st->post[i*S+stream]=SHL16(1, SNR_SHIFT);
+      st->prior[i*S+stream]=SHL16(1, SNR_SHIFT);
+      st->zeta[i*S+stream]=0;
+      st->echo_noise[i*S+stream]=0;
+   }
+   for (i=0;i<N;i++)
+   {
+      st->update_prob[i*S+stream] = 1;
+      st->S[i*S+stream] = st->Smin[i*S+stream] = st->Stmp[i*S+stream] = 0;
+   }
+   for (i=0;i<N3;i++)
+   {
+      st->inbuf[stream*N3+i]=0;
+      st->outbuf[stream*N3+i]=0;
+   }
+   st->speech_prob[stream] = 0;
+   st->nb_adapt[stream] = 0;
+   st->min_count[stream] = 0;
+   st->was_speech[stream] = 0;
+}
+
+EXPORT void speex_preprocess_batch_destroy(SpeexPreprocessBatch *st)
+{
+   speex_free(st->frame);
+   speex_free(st->ft);
+   speex_free(st->inbuf);
+   speex_free(st->outbuf);
+   speex_free(st->window);
+   speex_free(st->ps);
+   speex_free(st->noise);
+   speex_free(st->echo_noise);
+   speex_free(st->old_ps);
+   speex_free(st->gain);
+   speex_free(st->gain2);
+   speex_free(st->gain_floor);
+   speex_free(st->prior);
+   speex_free(st->post);
+   speex_free(st->zeta);
+   speex_free(st->S);
+   speex_free(st->Smin);
+   speex_free(st->Stmp);
+   speex_free(st->update_prob);
+   speex_free(st->beta);
+   speex_free(st->Zframe);
+   speex_free(st->speech_prob);
+   speex_free(st->nb_adapt);
+   speex_free(st->min_count);
+   speex_free(st->reset_min);
+   speex_free(st->was_speech);
+   spx_fft_destroy(st->fft_lookup);
+   filterbank_destroy(st->bank);
+   speex_free(st);
+}
+
+/* update_noise_prob() over all the streams of a batch */
+static void batch_update_noise_prob(SpeexPreprocessBatch *st)
+{
+   int i, s;
+   int S = st->nb_streams;
+   int N = st->ps_size;
+   spx_word32_t *ps = st->ps;
+
+   for (s=0;s<S;s++)
+      st->S[s] = MULT16_32_Q15(QCONST16(.8f,15),st->S[s]) + MULT16_32_Q15(QCONST16(.2f,15),ps[s]);
+   for (i=1;i<N-1;i++)
+      for (s=0;s<S;s++)
+         st->S[i*S+s] = MULT16_32_Q15(QCONST16(.8f,15),st->S[i*S+s]) + MULT16_32_Q15(QCONST16(.05f,15),ps[(i-1)*S+s])
+                      + MULT16_32_Q15(QCONST16(.1f,15),ps[i*S+s]) + MULT16_32_Q15(QCONST16(.05f,15),ps[(i+1)*S+s]);
+   for (s=0;s<S;s++)
+      st->S[(N-1)*S+s] = MULT16_32_Q15(QCONST16(.8f,15),st->S[(N-1)*S+s]) + MULT16_32_Q15(QCONST16(.2f,15),ps[(N-1)*S+s]);
+
+   /* Streams may have been reset at different times, so the minimum tracking window is per stream */
+   for (s=0;s<S;s++)
+   {
+      int min_range;
+      if (st->nb_adapt[s]==1)
+      {
+         for (i=0;i<N;i++)
+            st->Smin[i*S+s] = st->Stmp[i*S+s] = 0;
+      }
+      if (st->nb_adapt[s] < 100)
+         min_range = 15;
+      else if (st->nb_adapt[s] < 1000)
+         min_range = 50;
+      else if (st->nb_adapt[s] < 10000)
+         min_range = 150;
+      else
+         min_range = 300;
+      st->reset_min[s] = st->min_count[s] > min_range;
+      if (st->reset_min[s])
+         st->min_count[s] = 0;
+   }
+   for (i=0;i<N;i++)
+   {
+      for (s=0;s<S;s++)
+      {
+         spx_word32_t Sv = st->S[i*S+s];
+         spx_word32_t Smin = MIN32(st->Smin[i*S+s], Sv);
+         spx_word32_t Stmp = MIN32(st->Stmp[i*S+s], Sv);
+         st->Smin[i*S+s] = st->reset_min[s] ? MIN32(st->Stmp[i*S+s], Sv) : Smin;
+         st->Stmp[i*S+s] = st->reset_min[s] ? Sv : Stmp;
+         st->update_prob[i*S+s] = MULT16_32_Q15(QCONST16(.4f,15),Sv) > st->Smin[i*S+s];
+      }
+   }
+}
+
+EXPORT void speex_preprocess_batch_run(SpeexPreprocessBatch *st, spx_int16_t **x, int *vad)
+{
+   int i, s;
+   int S = st->nb_streams;
+   int N = st->ps_size;
+   int N3 = 2*N - st->frame_size;
+   int N4 = st->frame_size - N3;
+   int M = st->nbands;
+   spx_word32_t *ps = st->ps;
+
+   for (s=0;s<S;s++)
+   {
+      st->nb_adapt[s]++;
+      if (st->nb_adapt[s]>20000)
+         st->nb_adapt[s] = 20000;
+      st->min_count[s]++;
+      st->beta[s] = MAX16(QCONST16(.03,15),DIV32_16(Q15_ONE,st->nb_adapt[s]));
+   }
+
+   /* Analysis, the FFTs are done one stream at a time */
+   for (s=0;s<S;s++)
+   {
+      spx_word16_t *frame = st->frame + s*2*N;
+      spx_word16_t *ft = st->ft + s*2*N;
+      spx_word16_t *inbuf = st->inbuf + s*N3;
+
+      for (i=0;i<N3;i++)
+         frame[i]=inbuf[i];
+      for (i=0;i<st->frame_size;i++)
+         frame[N3+i]=x[s][i];
+      for (i=0;i<N3;i++)
+         inbuf[i]=x[s][N4+i];
+      for (i=0;i<2*N;i++)
+         frame[i] = MULT16_16_Q15(frame[i], st->window[i]);
+
+      spx_fft(st->fft_lookup, frame, ft);
+
+      ps[s]=MULT16_16(ft[0],ft[0]);
+      for (i=1;i<N;i++)
+         ps[i*S+s]=MULT16_16(ft[2*i-1],ft[2*i-1]) + MULT16_16(ft[2*i],ft[2*i]);
+   }
+   batch_compute_bank(st->bank, ps, ps+N*S, S);
+
+   batch_update_noise_prob(st);
+
+   /* Update the noise estimate for the frequencies where it can be */
+   for (i=0;i<N;i++)
+   {
+      for (s=0;s<S;s++)
+      {
+         spx_word32_t noise = st->noise[i*S+s];
+         spx_word32_t updated = MAX32(EXTEND32(0),MULT16_32_Q15(Q15_ONE-st->beta[s],noise) + MULT16_32_Q15(st->beta[s],SHL32(ps[i*S+s],NOISE_SHIFT)));
+         st->noise[i*S+s] = (!st->update_prob[i*S+s] || ps[i*S+s] < PSHR32(noise, NOISE_SHIFT)) ? updated : noise;
+      }
+   }
+   batch_compute_bank(st->bank, st->noise, st->noise+N*S, S);
+
+   /* Special case for first frame */
+   for (s=0;s<S;s++)
+   {
+      if (st->nb_adapt[s]==1)
+         for (i=0;i<N+M;i++)
+            st->old_ps[i*S+s] = ps[i*S+s];
+   }
+
+   /* Compute a posteriori and a priori SNR */
+   for (i=0;i<(N+M)*S;i++)
+   {
+      spx_word16_t gamma;
+      spx_word32_t tot_noise = ADD32(ADD32(EXTEND32(1), PSHR32(st->noise[i],NOISE_SHIFT)) , st->echo_noise[i]);
+
+      st->post[i] = SUB16(DIV32_16_Q8(ps[i],tot_noise), QCONST16(1.f,SNR_SHIFT));
+      st->post[i]=MIN16(st->post[i], QCONST16(100.f,SNR_SHIFT));
+      gamma = QCONST16(.1f,15)+MULT16_16_Q15(QCONST16(.89f,15),SQR16_Q15(DIV32_16_Q15(st->old_ps[i],ADD32(st->old_ps[i],tot_noise))));
+      st->prior[i] = EXTRACT16(PSHR32(ADD32(MULT16_16(gamma,MAX16(0,st->post[i])), MULT16_16(Q15_ONE-gamma,DIV32_16_Q8(st->old_ps[i],tot_noise))), 15));
+      st->prior[i]=MIN16(st->prior[i], QCONST16(100.f,SNR_SHIFT));
+   }
+
+   /* Recursive average of the a priori SNR. A bit smoothed for the psd components */
+   for (s=0;s<S;s++)
+      st->zeta[s] = PSHR32(ADD32(MULT16_16(QCONST16(.7f,15),st->zeta[s]), MULT16_16(QCONST16(.3f,15),st->prior[s])),15);
+   for (i=1;i<N-1;i++)
+      for (s=0;s<S;s++)
+         st->zeta[i*S+s] = PSHR32(ADD32(ADD32(ADD32(MULT16_16(QCONST16(.7f,15),st->zeta[i*S+s]), MULT16_16(QCONST16(.15f,15),st->prior[i*S+s])),
+                              MULT16_16(QCONST16(.075f,15),st->prior[(i-1)*S+s])), MULT16_16(QCONST16(.075f,15),st->prior[(i+1)*S+s])),15);
+   for (i=(N-1)*S;i<(N+M)*S;i++)
+      st->zeta[i] = PSHR32(ADD32(MULT16_16(QCONST16(.7f,15),st->zeta[i]), MULT16_16(QCONST16(.3f,15),st->prior[i])),15);
+
+   /* Speech probability of presence for the entire frame is based on the average filterbank a priori SNR */
+   for (s=0;s<S;s++)
+      st->Zframe[s] = 0;
+   for (i=N;i<N+M;i++)
+      for (s=0;s<S;s++)
+         st->Zframe[s] = ADD32(st->Zframe[s], EXTEND32(st->zeta[i*S+s]));
+   for (s=0;s<S;s++)
+      st->speech_prob[s] = QCONST16(.1f,15)+MULT16_16_Q15(QCONST16(.899f,15),qcurve(DIV32_16(st->Zframe[s],st->nbands)));
+
+   /* Without residual echo the floor doesn't depend on the echo suppression */
+   compute_gain_floor(st->noise_suppress, ECHO_SUPPRESS_DEFAULT, st->noise+N*S, st->echo_noise+N*S, st->gain_floor+N*S, M*S);
+
+   /* Ephraim & Malah gain and speech probability of presence for each critical band */
+   for (i=N;i<N+M;i++)
+   {
+      for (s=0;s<S;s++)
+      {
+         int j = i*S+s;
+         spx_word32_t theta;
+         spx_word32_t MM;
+         spx_word16_t prior_ratio;
+         spx_word16_t P1;
+         spx_word16_t q;
+
+         prior_ratio = PDIV32_16(SHL32(EXTEND32(st->prior[j]), 15), ADD16(st->prior[j], SHL32(1,SNR_SHIFT)));
+         theta = MULT16_32_P15(prior_ratio, QCONST32(1.f,EXPIN_SHIFT)+SHL32(EXTEND32(st->post[j]),EXPIN_SHIFT-SNR_SHIFT));
+
+         MM = hypergeom_gain_nonneg(theta);
+         st->gain[j] = EXTRACT16(MIN32(Q15_ONE, MULT16_32_Q15(prior_ratio, MM)));
+         st->old_ps[j] = MULT16_32_P15(QCONST16(.2f,15),st->old_ps[j]) + MULT16_32_P15(MULT16_16_P15(QCONST16(.8f,15),SQR16_Q15(st->gain[j])),ps[j]);
+
+         P1 = QCONST16(.199f,15)+MULT16_16_Q15(QCONST16(.8f,15),qcurve (st->zeta[j]));
+         q = Q15_ONE-MULT16_16_Q15(st->speech_prob[s],P1);
+         st->gain2[j]=1/(1.f + (q/(1.f-q))*(1+st->prior[j])*exp(-theta));
+      }
+   }
+   /* Convert the EM gains and speech prob to linear frequency */
+   batch_compute_psd(st->bank, st->gain2+N*S, st->gain2, S);
+   batch_compute_psd(st->bank, st->gain+N*S, st->gain, S);
+   batch_compute_psd(st->bank, st->gain_floor+N*S, st->gain_floor, S);
+
+   /* Compute gain according to the Ephraim-Malah algorithm -- linear frequency */
+   for (i=0;i<N*S;i++)
+   {
+      spx_word32_t MM;
+      spx_word32_t theta;
+      spx_word16_t prior_ratio;
+      spx_word16_t tmp;
+      spx_word16_t p;
+      spx_word16_t g;
+
+      prior_ratio = PDIV32_16(SHL32(EXTEND32(st->prior[i]), 15), ADD16(st->prior[i], SHL32(1,SNR_SHIFT)));
+      theta = MULT16_32_P15(prior_ratio, QCONST32(1.f,EXPIN_SHIFT)+SHL32(EXTEND32(st->post[i]),EXPIN_SHIFT-SNR_SHIFT));
+      MM = hypergeom_gain_nonneg(theta);
+      g = EXTRACT16(MIN32(Q15_ONE, MULT16_32_Q15(prior_ratio, MM)));
+      p = st->gain2[i];
+
+      /* Constrain the gain to be close to the Bark scale gain */
+      g = MULT16_16_Q15(QCONST16(.333f,15),g) > st->gain[i] ? MULT16_16(3,st->gain[i]) : g;
+      st->gain[i] = g;
+      st->old_ps[i] = MULT16_32_P15(QCONST16(.2f,15),st->old_ps[i]) + MULT16_32_P15(MULT16_16_P15(QCONST16(.8f,15),SQR16_Q15(st->gain[i])),ps[i]);
+      st->gain[i] = MAX16(st->gain[i], st->gain_floor[i]);
+
+      tmp = MULT16_16_P15(p,spx_sqrt(SHL32(EXTEND32(st->gain[i]),15))) + MULT16_16_P15(SUB16(Q15_ONE,p),spx_sqrt(SHL32(EXTEND32(st->gain_floor[i]),15)));
+      st->gain2[i]=SQR16_Q15(tmp);
+   }
+
+   if (!st->denoise_enabled)
+   {
+      for (i=0;i<(N+M)*S;i++)
+         st->gain2[i]=Q15_ONE;
+   }
+
+   /* Synthesis, one stream at a time */
+   for (s=0;s<S;s++)
+   {
+      spx_word16_t *frame = st->frame + s*2*N;
+      spx_word16_t *ft = st->ft + s*2*N;
+      spx_word16_t *outbuf = st->outbuf + s*N3;
+
+      for (i=1;i<N;i++)
+      {
+         ft[2*i-1] = MULT16_16_P15(st->gain2[i*S+s],ft[2*i-1]);
+         ft[2*i] = MULT16_16_P15(st->gain2[i*S+s],ft[2*i]);
+      }
+      ft[0] = MULT16_16_P15(st->gain2[s],ft[0]);
+      ft[2*N-1] = MULT16_16_P15(st->gain2[(N-1)*S+s],ft[2*N-1]);
+
+      spx_ifft(st->fft_lookup, ft, frame);
+
+      for (i=0;i<2*N;i++)
+         frame[i] = MULT16_16_Q15(frame[i], st->window[i]);
+      for (i=0;i<N3;i++)
+         x[s][i] = WORD2INT(ADD32(EXTEND32(outbuf[i]), EXTEND32(frame[i])));
+      for (i=0;i<N4;i++)
+         x[s][N3+i] = frame[N3+i];
+      for (i=0;i<N3;i++)
+         outbuf[i] = frame[st->frame_size+i];
+
+      /* Same VAD kludge as speex_preprocess_run() */
+      if (st->vad_enabled)
+         st->was_speech[s] = st->speech_prob[s] > st->speech_prob_start || (st->was_speech[s] && st->speech_prob[s] > st->speech_prob_continue);
+      if (vad)
+         vad[s] = st->vad_enabled ? st->was_speech[s] : 1;
+   }
+}
+
+EXPORT int speex_preprocess_batch_ctl(SpeexPreprocessBatch *st, int request, void *ptr)
+{
+   switch(request)
+   {
+   case SPEEX_PREPROCESS_SET_DENOISE:
+      st->denoise_enabled = (*(spx_int32_t*)ptr);
+      break;
+   case SPEEX_PREPROCESS_GET_DENOISE:
+      (*(spx_int32_t*)ptr) = st->denoise_enabled;
+      break;
+   case SPEEX_PREPROCESS_SET_VAD:
+      st->vad_enabled = (*(spx_int32_t*)ptr);
+      break;
+   case SPEEX_PREPROCESS_GET_VAD:
+      (*(spx_int32_t*)ptr) = st->vad_enabled;
+      break;
+   case SPEEX_PREPROCESS_SET_PROB_START:
+      *(spx_int32_t*)ptr = MIN32(100,MAX32(0, *(spx_int32_t*)ptr));
+      st->speech_prob_start = DIV32_16(MULT16_16(Q15ONE,*(spx_int32_t*)ptr), 100);
+      break;
+   case SPEEX_PREPROCESS_GET_PROB_START:
+      (*(spx_int32_t*)ptr) = MULT16_16_Q15(st->speech_prob_start, 100);
+      break;
+   case SPEEX_PREPROCESS_SET_PROB_CONTINUE:
+      *(spx_int32_t*)ptr = MIN32(100,MAX32(0, *(spx_int32_t*)ptr));
+      st->speech_prob_continue = DIV32_16(MULT16_16(Q15ONE,*(spx_int32_t*)ptr), 100);
+      break;
+   case SPEEX_PREPROCESS_GET_PROB_CONTINUE:
+      (*(spx_int32_t*)ptr) = MULT16_16_Q15(st->speech_prob_continue, 100);
+      break;
+   case SPEEX_PREPROCESS_SET_NOISE_SUPPRESS:
+      st->noise_suppress = -ABS(*(spx_int32_t*)ptr);
+      break;
+   case SPEEX_PREPROCESS_GET_NOISE_SUPPRESS:
+      (*(spx_int32_t*)ptr) = st->noise_suppress;
+      break;
+   default:
+      speex_warning_int("Unknown speex_preprocess_batch_ctl request: ", request);
+      return -1;
+   }
+   return 0;
+}
+
+#else
+
+/* The batch relies on the floating point gain computations */
+EXPORT SpeexPreprocessBatch *speex_preprocess_batch_init(int nb_streams, int frame_size, int sampling_rate)
+{
+   speex_warning("Preprocessor batches are only available in floating point builds");
+   return NULL;
+}
+
+EXPORT void speex_preprocess_batch_destroy(SpeexPreprocessBatch *st)
+{
+}
+
+EXPORT void speex_preprocess_batch_run(SpeexPreprocessBatch *st, spx_int16_t **x, int *vad)
+{
+}
+
+EXPORT void speex_preprocess_batch_reset_stream(SpeexPreprocessBatch *st, int stream)
+{
+}
+
+EXPORT int speex_preprocess_batch_ctl(SpeexPreprocessBatch *st, int request, void *ptr)
+{
+   return -1;
+}
+
+#endif
+
+#ifndef FIXED_POINT
+
+/** VAD-only analysis. Runs the speech probability estimation of the preprocessor on a decimated
+    spectrum: the windowed frame of 2N samples is folded to N samples before the transform, which
+    gives every other bin of the 2N-point FFT used by the preprocessor. The noise is tracked on
+    these bins, the SNR estimation and gains only on the Bark bands, and nothing is synthesised. */
+struct SpeexVadState_ {
+   int    frame_size;
+   int    nb_bins;           /**< Bins of the decimated spectrum (frame_size/2) */
+   int    nbands;
+   FilterBank *bank;
+
+   spx_word16_t speech_prob_start;
+   spx_word16_t speech_prob_continue;
+   int    hangover;          /**< Frames held as speech after the probability drops */
+
+   spx_word16_t *window;     /**< Same analysis window as the preprocessor (2*frame_size) */
+   spx_word16_t *inbuf;      /**< Previous frame (frame_size) */
+   spx_word16_t *frame;      /**< Folded frame (frame_size) */
+   spx_word16_t *ft;         /**< Folded frame in freq domain (frame_size) */
+   spx_word32_t *ps;         /**< Power spectrum, then band energies (nb_bins+nbands) */
+
+   /* See the members of the same names in SpeexPreprocessState. The noise is tracked on the
+      bins, everything else on the bands. */
+   spx_word32_t *noise;      /**< Noise estimate (nb_bins+nbands) */
+   spx_word32_t *S;          /**< (nb_bins) */
+   spx_word32_t *Smin;
+   spx_word32_t *Stmp;
+   spx_word32_t *old_ps;     /**< (nbands) */
+   spx_word16_t *prior;
+   spx_word16_t *post;
+   spx_word16_t *zeta;
+
+   spx_word16_t speech_prob;
+   int    was_speech;
+   int    hangover_count;
+   int    nb_adapt;
+   int    min_count;
+   void  *fft_lookup;
+};
+
+EXPORT SpeexVadState *speex_vad_state_init(int frame_size, int sampling_rate)
+{
+   int N, M;
+   SpeexVadState *st;
+
+   /* The folded frame has to be split into bins */
+   if (frame_size < 2 || frame_size%2)
+      return NULL;
+
+   st = (SpeexVadState *)speex_alloc(sizeof(SpeexVadState));
+   st->frame_size = N = frame_size;
+   st->nb_bins = N/2;
+   st->nbands = M = NB_BANDS;
+   st->bank = filterbank_new(M, sampling_rate, st->nb_bins, 1);
+
+   st->window = (spx_word16_t*)speex_alloc(2*N*sizeof(spx_word16_t));
+   st->inbuf = (spx_word16_t*)speex_alloc(N*sizeof(spx_word16_t));
+   st->frame = (spx_word16_t*)speex_alloc(N*sizeof(spx_word16_t));
+   st->ft = (spx_word16_t*)speex_alloc(N*sizeof(spx_word16_t));
+   st->ps = (spx_word32_t*)speex_alloc((st->nb_bins+M)*sizeof(spx_word32_t));
+
+   st->noise = (spx_word32_t*)speex_alloc((st->nb_bins+M)*sizeof(spx_word32_t));
+   st->S = (spx_word32_t*)speex_alloc(st->nb_bins*sizeof(spx_word32_t));
+   st->Smin = (spx_word32_t*)speex_alloc(st->nb_bins*sizeof(spx_word32_t));
+   st->Stmp = (spx_word32_t*)speex_alloc(st->nb_bins*sizeof(spx_word32_t));
+   st->old_ps = (spx_word32_t*)speex_alloc(M*sizeof(spx_word32_t));
+   st->prior = (spx_word16_t*)speex_alloc(M*sizeof(spx_word16_t));
+   st->post = (spx_word16_t*)speex_alloc(M*sizeof(spx_word16_t));
+   st->zeta = (spx_word16_t*)speex_alloc(M*sizeof(spx_word16_t));
+
+   conj_window(st->window, 2*N);
+   st->fft_lookup = spx_fft_init(N);
+
+   st->speech_prob_start = SPEECH_PROB_START_DEFAULT;
+   st->speech_prob_continue = SPEECH_PROB_CONTINUE_DEFAULT;
+   st->hangover = 0;
+   speex_vad_state_reset(st);
+   return st;
+}
+
+EXPORT void speex_vad_state_reset(SpeexVadState *st)
+{
+   int i;
+   int B = st->nb_bins;
+   int M = st->nbands;
+
+   SPEEX_MEMSET(st->inbuf, 0, st->frame_size);
+   for (i=0;i<B+M;i++)
+      st->noise[i]=QCONST32(1.f,NOISE_SHIFT);
+   for (i=0;i<B;i++)
+      st->S[i]=st->Smin[i]=st->Stmp[i]=0;
+   for (i=0;i<M;i++)
+   {
+      st->old_ps[i]=1;
+      st->prior[i]=st->post[i]=SHL16(1, SNR_SHIFT);
+      st->zeta[i]=0;
+   }
+   st->speech_prob = 0;
+   st->was_speech = 0;
+   st->hangover_count = 0;
+   st->nb_adapt = 0;
+   st->min_count = 0;
+}
+
+EXPORT void speex_vad_state_destroy(SpeexVadState *st)
+{
+   filterbank_destroy(st->bank);
+   speex_free(st->window);
+   speex_free(st->inbuf);
+   speex_free(st->frame);
+   speex_free(st->ft);
+   speex_free(st->ps);
+   speex_free(st->noise);
+   speex_free(st->old_ps);
+   speex_free(st->S);
+   speex_free(st->Smin);
+   speex_free(st->Stmp);
+   speex_free(st->prior);
+   speex_free(st->post);
+   speex_free(st->zeta);
+   spx_fft_destroy(st->fft_lookup);
+   speex_free(st);
+}
+
+/* Speech probability of the frame in st->frame, same estimator as preprocess_frame() */
+static int vad_analysis(SpeexVadState *st)
+{
+   int i;
+   int min_range;
+   int B = st->nb_bins;
+   int M = st->nbands;
+   spx_word32_t *ps = st->ps;
+   spx_word32_t *bands = st->ps+B;
+   spx_word32_t Zframe;
+   spx_word16_t beta, beta_1;
+
+   st->nb_adapt++;
+   if (st->nb_adapt>20000)
+      st->nb_adapt = 20000;
+   st->min_count++;
+
+   beta = MAX16(QCONST16(.03,15),DIV32_16(Q15_ONE,st->nb_adapt));
+   beta_1 = Q15_ONE-beta;
+
+   spx_fft(st->fft_lookup, st->frame, st->ft);
+
+   /* Every bin stands for two bins of the full spectrum. The N-point transform is scaled by 1/N
+      instead of 1/(2N), so a bin has 4 times the power of one of them and .5 gives that of the
+      pair. The scale has to match the preprocessor, or the +1 floor of the noise weighs less
+      at high SNR. */
+   ps[0]=.5f*MULT16_16(st->ft[0],st->ft[0]);
+   for (i=1;i<B;i++)
+      ps[i]=.5f*(MULT16_16(st->ft[2*i-1],st->ft[2*i-1]) + MULT16_16(st->ft[2*i],st->ft[2*i]));
+   filterbank_compute_bank32(st->bank, ps, bands);
+
+   /* Minimum statistics on the smoothed bins (see update_noise_prob()) */
+   for (i=1;i<B-1;i++)
+      st->S[i] =  MULT16_32_Q15(QCONST16(.8f,15),st->S[i]) + MULT16_32_Q15(QCONST16(.05f,15),ps[i-1])
+                      + MULT16_32_Q15(QCONST16(.1f,15),ps[i]) + MULT16_32_Q15(QCONST16(.05f,15),ps[i+1]);
+   st->S[0] =  MULT16_32_Q15(QCONST16(.8f,15),st->S[0]) + MULT16_32_Q15(QCONST16(.2f,15),ps[0]);
+   st->S[B-1] =  MULT16_32_Q15(QCONST16(.8f,15),st->S[B-1]) + MULT16_32_Q15(QCONST16(.2f,15),ps[B-1]);
+   if (st->nb_adapt==1)
+   {
+      for (i=0;i<B;i++)
+         st->Smin[i] = st->Stmp[i] = 0;
+   }
+   if (st->nb_adapt < 100)
+      min_range = 15;
+   else if (st->nb_adapt < 1000)
+      min_range = 50;
+   else if (st->nb_adapt < 10000)
+      min_range = 150;
+   else
+      min_range = 300;
+   if (st->min_count > min_range)
+   {
+      st->min_count = 0;
+      for (i=0;i<B;i++)
+      {
+         st->Smin[i] = MIN32(st->Stmp[i], st->S[i]);
+         st->Stmp[i] = st->S[i];
+      }
+   } else {
+      for (i=0;i<B;i++)
+      {
+         st->Smin[i] = MIN32(st->Smin[i], st->S[i]);
+         st->Stmp[i] = MIN32(st->Stmp[i], st->S[i]);
+      }
+   }
+
+   /* Noise estimate update where the bin looks like noise */
+   for (i=0;i<B;i++)
+   {
+      int update_prob = MULT16_32_Q15(QCONST16(.4f,15),st->S[i]) > st->Smin[i];
+      if (!update_prob || ps[i] < PSHR32(st->noise[i], NOISE_SHIFT))
+         st->noise[i] = MAX32(EXTEND32(0),MULT16_32_Q15(beta_1,st->noise[i]) + MULT16_32_Q15(beta,SHL32(ps[i],NOISE_SHIFT)));
+   }
+   filterbank_compute_bank32(st->bank, st->noise, st->noise+B);
+
+   if (st->nb_adapt==1)
+      for (i=0;i<M;i++)
+         st->old_ps[i] = bands[i];
+
+   /* A posteriori and a priori SNR, then the gain that feeds the next a priori estimate */
+   Zframe = 0;
+   for (i=0;i<M;i++)
+   {
+      spx_word16_t gamma;
+      spx_word16_t prior_ratio;
+      spx_word32_t theta;
+      spx_word16_t gain;
+      spx_word32_t tot_noise = ADD32(EXTEND32(1), PSHR32(st->noise[B+i],NOISE_SHIFT));
+
+      st->post[i] = SUB16(DIV32_16_Q8(bands[i],tot_noise), QCONST16(1.f,SNR_SHIFT));
+      st->post[i] = MIN16(st->post[i], QCONST16(100.f,SNR_SHIFT));
+      gamma = QCONST16(.1f,15)+MULT16_16_Q15(QCONST16(.89f,15),SQR16_Q15(DIV32_16_Q15(st->old_ps[i],ADD32(st->old_ps[i],tot_noise))));
+      st->prior[i] = EXTRACT16(PSHR32(ADD32(MULT16_16(gamma,MAX16(0,st->post[i])), MULT16_16(Q15_ONE-gamma,DIV32_16_Q8(st->old_ps[i],tot_noise))), 15));
+      st->prior[i] = MIN16(st->prior[i], QCONST16(100.f,SNR_SHIFT));
+
+      st->zeta[i] = PSHR32(ADD32(MULT16_16(QCONST16(.7f,15),st->zeta[i]), MULT16_16(QCONST16(.3f,15),st->prior[i])),15);
+      Zframe = ADD32(Zframe, EXTEND32(st->zeta[i]));
+
+      prior_ratio = PDIV32_16(SHL32(EXTEND32(st->prior[i]), 15), ADD16(st->prior[i], SHL32(1,SNR_SHIFT)));
+      theta = MULT16_32_P15(prior_ratio, QCONST32(1.f,EXPIN_SHIFT)+SHL32(EXTEND32(st->post[i]),EXPIN_SHIFT-SNR_SHIFT));
+      gain = EXTRACT16(MIN32(Q15_ONE, MULT16_32_Q15(prior_ratio, hypergeom_gain(theta))));
+      st->old_ps[i] = MULT16_32_P15(QCONST16(.2f,15),st->old_ps[i]) + MULT16_32_P15(MULT16_16_P15(QCONST16(.8f,15),SQR16_Q15(gain)),bands[i]);
+   }
+   st->speech_prob = QCONST16(.1f,15)+MULT16_16_Q15(QCONST16(.899f,15),qcurve(DIV32_16(Zframe,M)));
+
+   /* Same hysteresis as the preprocessor, then the hangover */
+   if (st->speech_prob > st->speech_prob_start || (st->was_speech && st->speech_prob > st->speech_prob_continue))
+   {
+      st->was_speech = 1;
+      st->hangover_count = st->hangover;
+      return 1;
+   }
+   st->was_speech = 0;
+   if (st->hangover_count > 0)
+   {
+      st->hangover_count--;
+      return 1;
+   }
+   return 0;
+}
+
+EXPORT int speex_vad_run(SpeexVadState *st, const spx_int16_t *x)
+{
+   int i;
+   int N = st->frame_size;
+
+   for (i=0;i<N;i++)
+      st->frame[i] = MULT16_16_Q15(st->inbuf[i], st->window[i]) + MULT16_16_Q15(x[i], st->window[N+i]);
+   for (i=0;i<N;i++)
+      st->inbuf[i] = x[i];
+   return vad_analysis(st);
+}
+
+EXPORT int speex_vad_run_float(SpeexVadState *st, const float *x)
+{
+   int i;
+   int N = st->frame_size;
+
+   for (i=0;i<N;i++)
+      st->frame[i] = MULT16_16_Q15(st->inbuf[i], st->window[i]) + MULT16_16_Q15(FLOAT_SCALE*x[i], st->window[N+i]);
+   for (i=0;i<N;i++)
+      st->inbuf[i] = FLOAT_SCALE*x[i];
+   return vad_analysis(st);
+}
+
+EXPORT int speex_vad_ctl(SpeexVadState *st, int request, void *ptr)
+{
+   switch(request)
+   {
+   case SPEEX_PREPROCESS_SET_PROB_START:
+      *(spx_int32_t*)ptr = MIN32(100,MAX32(0, *(spx_int32_t*)ptr));
+      st->speech_prob_start = DIV32_16(MULT16_16(Q15ONE,*(spx_int32_t*)ptr), 100);
+      break;
+   case SPEEX_PREPROCESS_GET_PROB_START:
+      (*(spx_int32_t*)ptr) = MULT16_16_Q15(st->speech_prob_start, 100);
+      break;
+   case SPEEX_PREPROCESS_SET_PROB_CONTINUE:
+      *(spx_int32_t*)ptr = MIN32(100,MAX32(0, *(spx_int32_t*)ptr));
+      st->speech_prob_continue = DIV32_16(MULT16_16(Q15ONE,*(spx_int32_t*)ptr), 100);
+      break;
+   case SPEEX_PREPROCESS_GET_PROB_CONTINUE:
+      (*(spx_int32_t*)ptr) = MULT16_16_Q15(st->speech_prob_continue, 100);
+      break;
+   case SPEEX_PREPROCESS_GET_PROB:
+      (*(spx_int32_t*)ptr) = MULT16_16_Q15(st->speech_prob, 100);
+      break;
+   case SPEEX_VAD_SET_HANGOVER:
+      st->hangover = MAX32(0, *(spx_int32_t*)ptr);
+      break;
+   case SPEEX_VAD_GET_HANGOVER:
+      (*(spx_int32_t*)ptr) = st->hangover;
+      break;
+   default:
+      speex_warning_int("Unknown speex_vad_ctl request: ", request);
+      return -1;
+   }
+   return 0;
+}
+
+#else
+
+/* The band estimator relies on the floating point gain computations */
+EXPORT SpeexVadState *speex_vad_state_init(int frame_size, int sampling_rate)
+{
+   speex_warning("VAD-only analysis is only available in floating point builds");
+   return NULL;
+}
+
+EXPORT void speex_vad_state_reset(SpeexVadState *st)
+{
+}
+
+EXPORT void speex_vad_state_destroy(SpeexVadState *st)
+{
+}
+
+EXPORT int speex_vad_run(SpeexVadState *st, const spx_int16_t *x)
+{
+   return 1;
+}
+
+EXPORT int speex_vad_run_float(SpeexVadState *st, const float *x)
+{
+   return 1;
+}
+
+EXPORT int speex_vad_ctl(SpeexVadState *st, int request, void *ptr)
+{
+   return -1;
+}
+
+#endif
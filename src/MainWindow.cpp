@@ -11,36 +11,38 @@ namespace {
 Q_LOGGING_CATEGORY(Gui, "gui")
 }
 
-QAudioFormat getCaptureFormat()
+// Sample types are 16-bit signed integers or 32-bit floats
+QAudioFormat getCaptureFormat(QAudioFormat::SampleType sampleType)
 {
 	QAudioFormat format;
 	format.setSampleRate(48000);
 	format.setChannelCount(1);
-	format.setSampleSize(16);
+	format.setSampleSize(sampleType == QAudioFormat::Float ? 32 : 16);
 	format.setCodec("audio/pcm");
 	format.setByteOrder(QAudioFormat::LittleEndian);
-	format.setSampleType(QAudioFormat::SignedInt);
+	format.setSampleType(sampleType);
 	return format;
 }
 
-QAudioFormat getOutputFormat()
+QAudioFormat getOutputFormat(QAudioFormat::SampleType sampleType)
 {
-	return getCaptureFormat();
+	return getCaptureFormat(sampleType);
 }
 
-QAudioFormat getMonitorFormat()
+QAudioFormat getMonitorFormat(QAudioFormat::SampleType sampleType)
 {
 	QAudioFormat format;
 	format.setSampleRate(48000);
 	format.setChannelCount(2);
-	format.setSampleSize(16);
+	format.setSampleSize(sampleType == QAudioFormat::Float ? 32 : 16);
 	format.setCodec("audio/pcm");
 	format.setByteOrder(QAudioFormat::LittleEndian);
-	format.setSampleType(QAudioFormat::SignedInt);
+	format.setSampleType(sampleType);
 	return format;
 }
 
-MainWindow::MainWindow() : ui(new Ui::MainWindow)
+MainWindow::MainWindow(QAudioFormat::SampleType sampleType)
+    : ui(new Ui::MainWindow), sampleType_(sampleType)
 {
 	ui->setupUi(this);
 
@@ -107,14 +109,25 @@ void MainWindow::initializeAudio(const QAudioDeviceInfo& inputDeviceInfo,
                                  const QAudioDeviceInfo& monitorDeviceInfo)
 {
 	qDebug(Gui) << "Initializing audio processing tract...";
-	auto captureFormat = getCaptureFormat();
-	auto outputFormat = getOutputFormat();
-	auto monitorFormat = getMonitorFormat();
+	auto captureFormat = getCaptureFormat(sampleType_);
+	auto outputFormat = getOutputFormat(sampleType_);
+	auto monitorFormat = getMonitorFormat(sampleType_);
 
 	fixFormatForDevice(captureFormat, inputDeviceInfo);
 	fixFormatForDevice(outputFormat, outputDeviceInfo);
 	fixFormatForDevice(monitorFormat, monitorDeviceInfo);
 
+	// The processor plays back the samples it captures, so both devices must use floats. A
+	// monitor device with another sample type is converted once per frame by the effect.
+	if (captureFormat.sampleType() != outputFormat.sampleType())
+	{
+		qWarning(Gui) << "Output device doesn't support the capture format, falling back to 16-bit";
+		captureFormat = getCaptureFormat(QAudioFormat::SignedInt);
+		outputFormat = getOutputFormat(QAudioFormat::SignedInt);
+		fixFormatForDevice(captureFormat, inputDeviceInfo);
+		fixFormatForDevice(outputFormat, outputDeviceInfo);
+	}
+
 	audioInput_.reset(new QAudioInput(inputDeviceInfo, captureFormat));
 	audioOutput_.reset(new QAudioOutput(outputDeviceInfo, outputFormat));
 	monitorInput_.reset(new QAudioInput(monitorDeviceInfo, monitorFormat));
@@ -123,13 +136,132 @@ void MainWindow::initializeAudio(const QAudioDeviceInfo& inputDeviceInfo,
 	audioOutput_->moveToThread(&audioOutputThread_);
 	monitorInput_->moveToThread(&audioInputThread_);
 
+	// Carry the adaptive DSP state over to the new processing tract if it is compatible
+	QByteArray effectState;
+	if (processor_)
+		effectState = processor_->saveEffectState();
+
 	processor_.reset(new AudioProcessor(captureFormat, monitorFormat, monitorBuffer_));
+	if (!effectState.isEmpty() && !processor_->restoreEffectState(effectState))
+		qInfo(Gui) << "DSP state is not compatible with the new devices, starting from scratch";
+	if (!traceFile_.isEmpty())
+		processor_->setTraceFile(traceFile_);
+	if (!realtimeProfile_.isDefault())
+		processor_->setRealtimeProfile(realtimeProfile_);
+	if (!referenceConditioning_.isDefault())
+		applyReferenceConditioning();
+	if (!effectChain_.isEmpty())
+		applyEffectChain();
+	if (shadowEnabled_)
+		processor_->startShadow(shadowBackend_);
 	connect(processor_.get(), &AudioProcessor::voiceActivityChanged, this,
 	        &MainWindow::updateVoiceActivity);
 	connect(processor_.get(), &AudioProcessor::inputLevelsChanged, this,
 	        &MainWindow::updateInputAudioLevels);
 	connect(processor_.get(), &AudioProcessor::outputLevelsChanged, this,
 	        &MainWindow::updateOutputAudioLevels);
+	connect(processor_.get(), &AudioProcessor::latencyMeasured, this,
+	        &MainWindow::showLatencyReport);
+	connect(processor_.get(), &AudioProcessor::qualityTierChanged, this,
+	        [this](QualityTier tier, double load)
+	        {
+		        ui->statusbar->showMessage(QString("Processing quality: %1 (load %2%)")
+		                                       .arg(qualityTierName(tier))
+		                                       .arg(qRound(load * 100)));
+	        });
+}
+
+void MainWindow::setRealtimeProfile(const RealtimeProfile& profile)
+{
+	realtimeProfile_ = profile;
+	if (processor_)
+		processor_->setRealtimeProfile(profile);
+}
+
+void MainWindow::setShadowBackend(Backend backend)
+{
+	shadowEnabled_ = true;
+	shadowBackend_ = backend;
+	if (processor_)
+		processor_->startShadow(backend);
+}
+
+void MainWindow::setReferenceConditioning(const ReferenceConditioning& conditioning)
+{
+	referenceConditioning_ = conditioning;
+	if (processor_)
+		applyReferenceConditioning();
+}
+
+void MainWindow::applyReferenceConditioning()
+{
+	try
+	{
+		processor_->setReferenceConditioning(referenceConditioning_);
+	}
+	catch (const std::invalid_argument& e)
+	{
+		qWarning(Gui) << "Keeping the full echo cancellation reference:" << e.what();
+	}
+}
+
+void MainWindow::setEffectChain(const QStringList& stages)
+{
+	effectChain_ = stages;
+	if (processor_)
+		applyEffectChain();
+}
+
+void MainWindow::applyEffectChain()
+{
+	try
+	{
+		processor_->setEffectChain(effectChain_);
+	}
+	catch (const std::invalid_argument& e)
+	{
+		qWarning(Gui) << "Running the backend alone:" << e.what();
+	}
+}
+
+void MainWindow::setTraceFile(const QString& fileName)
+{
+	traceFile_ = fileName;
+	if (!processor_)
+		return;
+
+	// The trace opens with the processor, restart it to record from now on
+	processor_->setTraceFile(fileName);
+	if (processor_->isOpen())
+	{
+		stopRecording();
+		startRecording();
+	}
+}
+
+void MainWindow::measureLatency()
+{
+	if (!processor_->startLatencyMeasurement())
+		qWarning(Gui) << "Unable to start a latency measurement";
+}
+
+void MainWindow::showLatencyReport(const LatencyReport& report)
+{
+	if (!report.valid)
+	{
+		qWarning(Gui).nospace() << "Latency probe not found in the capture stream (confidence "
+		                        << report.confidence << ")";
+		ui->statusbar->showMessage("Latency measurement failed");
+		return;
+	}
+
+	qInfo(Gui).nospace() << "Latency: " << report.total() << " ms capture to playout, "
+	                     << report.roundTrip << " ms device round trip, "
+	                     << report.monitorRoundTrip << " ms through the monitor";
+	qInfo(Gui).nospace() << "Latency stages: device in " << report.deviceIn << " ms, input queue "
+	                     << report.inputQueue << " ms, DSP " << report.dsp << " ms, output queue "
+	                     << report.outputQueue << " ms, device out " << report.deviceOut << " ms";
+	ui->statusbar->showMessage(QString("Latency: %1 ms").arg(qRound(report.total())));
 }
 
 void MainWindow::startRecording()
@@ -144,6 +276,7 @@ void MainWindow::startRecording()
 
 	qInfo(Gui) << "input buffer size:" << audioInput_->bufferSize();
 	qInfo(Gui) << "output buffer size:" << audioOutput_->bufferSize();
+	processor_->setDeviceBufferSizes(audioInput_->bufferSize(), audioOutput_->bufferSize());
 }
 
 void MainWindow::stopRecording()
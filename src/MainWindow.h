@@ -24,9 +24,24 @@ class MainWindow : public QMainWindow
 	Q_OBJECT
 
 public:
-	MainWindow();
+	// Float samples run the processing tract in float from the devices on, when they support it
+	explicit MainWindow(QAudioFormat::SampleType sampleType = QAudioFormat::SignedInt);
 	~MainWindow() override;
 
+	void setRealtimeProfile(const RealtimeProfile& profile);
+	// Runs the given backend in shadow of the selected one, see AudioProcessor::startShadow()
+	void setShadowBackend(Backend backend);
+	// See AudioProcessor::setReferenceConditioning(), kept across device changes
+	void setReferenceConditioning(const ReferenceConditioning& conditioning);
+	// See AudioProcessor::setEffectChain(), kept across device changes
+	void setEffectChain(const QStringList& stages);
+	// See AudioProcessor::setTraceFile(), kept across device changes. Restarts the recording.
+	void setTraceFile(const QString& fileName);
+
+public slots:
+	// See AudioProcessor::startLatencyMeasurement(), the result goes to the log and the status bar
+	void measureLatency();
+
 private slots:
 	void changeDevicesConfiguration();
 	void switchBackend();
@@ -37,12 +52,15 @@ private slots:
 	void updateVoiceActivity(bool);
 	void updateInputAudioLevels(const QVector<qreal>&);
 	void updateOutputAudioLevels(const QVector<qreal>&);
+	void showLatencyReport(const SpeexWebRTCTest::LatencyReport& report);
 
 private:
 	void initializeAudio(const QAudioDeviceInfo& inputDeviceInfo,
 	                     const QAudioDeviceInfo& outputDeviceInfo,
 	                     const QAudioDeviceInfo& monitorDeviceInfo);
 
+	void applyReferenceConditioning();
+	void applyEffectChain();
 	void startRecording();
 	void stopRecording();
 
@@ -51,6 +69,7 @@ private:
 	void setupDials(Backend backend);
 
 	Ui::MainWindow* ui = nullptr;
+	const QAudioFormat::SampleType sampleType_;
 
 	QThread audioInputThread_;
 	QThread audioOutputThread_;
@@ -62,6 +81,12 @@ private:
 	QBuffer monitorBuffer_;
 
 	QScopedPointer<AudioProcessor> processor_;
+	RealtimeProfile realtimeProfile_;
+	bool shadowEnabled_ = false;
+	Backend shadowBackend_ = Backend::Speex;
+	ReferenceConditioning referenceConditioning_;
+	QStringList effectChain_;
+	QString traceFile_;
 
 	QList<AudioLevel*> inputAudioLevels_;
 	QList<AudioLevel*> outputAudioLevels_;
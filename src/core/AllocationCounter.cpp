@@ -0,0 +1,16 @@
+#include "AllocationCounter.h"
+
+namespace {
+// Trivially initialised, so counting doesn't allocate thread-local storage on the way
+thread_local quint64 allocations = 0;
+} // namespace
+
+quint64 SpeexWebRTCTest::threadAllocations()
+{
+	return allocations;
+}
+
+void SpeexWebRTCTest::countAllocation()
+{
+	++allocations;
+}
@@ -0,0 +1,20 @@
+#ifndef _ALLOCATION_COUNTER_H_
+#define _ALLOCATION_COUNTER_H_
+
+#include <QtGlobal>
+
+namespace SpeexWebRTCTest {
+
+// Number of operator new calls made so far by the calling thread. Only the daemon counts them:
+// it links the allocation_hooks object library (daemon/AllocationHooks.cpp), which replaces the
+// global operator new. Every other program keeps the default one and this stays 0.
+// malloc() calls aren't counted, among them the growth of QByteArray, QVector and the other Qt
+// containers, which allocate through malloc() and realloc().
+quint64 threadAllocations();
+
+// Called by the operator new replacement
+void countAllocation();
+
+} // namespace SpeexWebRTCTest
+
+#endif // _ALLOCATION_COUNTER_H_
@@ -0,0 +1,326 @@
+#include "AudioEffect.h"
+
+#include "SampleConversion.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace SpeexWebRTCTest {
+
+namespace {
+const quint32 stateMagic = 0x53574653; // "SWFS"
+const quint16 stateVersion = 1;
+template <typename Sample, typename Target>
+void interleave(const SampleSpan<Sample>& span, Target* to)
+{
+	for (int channel = 0; channel < span.channels; ++channel)
+	{
+		const Sample* from = span.data + channel * span.frames;
+		for (int i = 0; i < span.frames; ++i)
+			to[i * span.channels + channel] = from[i];
+	}
+}
+
+template <typename Sample>
+void deinterleave(const Sample* from, const SampleSpan<Sample>& span)
+{
+	for (int channel = 0; channel < span.channels; ++channel)
+	{
+		Sample* to = span.data + channel * span.frames;
+		for (int i = 0; i < span.frames; ++i)
+			to[i] = from[i * span.channels + channel];
+	}
+}
+} // namespace
+
+QString qualityTierName(QualityTier tier)
+{
+	switch (tier)
+	{
+	case QualityTier::Full:
+		return "full";
+	case QualityTier::ShortEchoTail:
+		return "short_echo_tail";
+	case QualityTier::ReducedRate:
+		return "reduced_rate";
+	case QualityTier::NoNoiseSuppression:
+		return "no_noise_suppression";
+	case QualityTier::Bypass:
+		return "bypass";
+	}
+	return "unknown";
+}
+
+AudioEffect::AudioEffect(const QAudioFormat& mainFormat, const QAudioFormat& auxFormat)
+    : mainFormat_(mainFormat), auxFormat_(auxFormat)
+{
+}
+
+template <typename Main, typename Aux>
+void AudioEffect::checkSpans(const SampleSpan<Main>& main, const SampleSpan<Aux>& aux) const
+{
+	if (main.frames != int(getFrameSize()) || main.channels != mainFormat_.channelCount())
+		throw std::invalid_argument("Main frame doesn't match the effect format");
+	if (aux.data && (aux.frames != main.frames || aux.channels != auxFormat_.channelCount()))
+		throw std::invalid_argument("Aux frame doesn't match the effect format");
+}
+
+void AudioEffect::process(SampleSpan<qint16> main, SampleSpan<const qint16> aux)
+{
+	checkSpans(main, aux);
+
+	const bool planar = main.planar && main.channels > 1;
+	if (planar)
+	{
+		mainScratch_.resize(main.frames * main.channels);
+		interleave(main, mainScratch_.data());
+	}
+
+	const qint16* auxData = aux.data;
+	if (aux.data && aux.planar && aux.channels > 1)
+	{
+		auxScratch_.resize(aux.frames * aux.channels);
+		interleave(aux, auxScratch_.data());
+		auxData = auxScratch_.constData();
+	}
+
+	processInterleaved(planar ? mainScratch_.data() : main.data, auxData);
+
+	if (planar)
+		deinterleave(mainScratch_.constData(), main);
+}
+
+void AudioEffect::process(SampleSpan<float> main, SampleSpan<const float> aux)
+{
+	checkSpans(main, aux);
+
+	const bool planar = main.planar && main.channels > 1;
+	if (planar)
+	{
+		mainFloatScratch_.resize(main.frames * main.channels);
+		interleave(main, mainFloatScratch_.data());
+	}
+
+	const float* auxData = aux.data;
+	if (aux.data && aux.planar && aux.channels > 1)
+	{
+		auxFloatScratch_.resize(aux.frames * aux.channels);
+		interleave(aux, auxFloatScratch_.data());
+		auxData = auxFloatScratch_.constData();
+	}
+
+	processInterleavedFloat(planar ? mainFloatScratch_.data() : main.data, auxData);
+
+	if (planar)
+		deinterleave(mainFloatScratch_.constData(), main);
+}
+
+void AudioEffect::processInterleavedFloat(float* main, const float* aux)
+{
+	const int mainSamples = getFrameSize() * mainFormat_.channelCount();
+	mainScratch_.resize(mainSamples);
+	floatToInt16(main, mainScratch_.data(), mainSamples);
+
+	if (aux)
+	{
+		const int auxSamples = getFrameSize() * auxFormat_.channelCount();
+		auxScratch_.resize(auxSamples);
+		floatToInt16(aux, auxScratch_.data(), auxSamples);
+	}
+
+	processInterleaved(mainScratch_.data(), aux ? auxScratch_.constData() : nullptr);
+	int16ToFloat(mainScratch_.constData(), main, mainSamples);
+}
+
+void AudioEffect::processFrame(char* main, const char* aux)
+{
+	const int frames = getFrameSize();
+	const bool floatMain = mainFormat_.sampleType() == QAudioFormat::Float;
+	const bool floatAux = auxFormat_.sampleType() == QAudioFormat::Float;
+	const int auxSamples = frames * auxFormat_.channelCount();
+
+	if (floatMain)
+	{
+		SampleSpan<float> mainSpan;
+		mainSpan.data = reinterpret_cast<float*>(main);
+		mainSpan.frames = frames;
+		mainSpan.channels = mainFormat_.channelCount();
+
+		SampleSpan<const float> auxSpan;
+		if (aux)
+		{
+			auxSpan.data = reinterpret_cast<const float*>(aux);
+			if (!floatAux)
+			{
+				auxFloatScratch_.resize(auxSamples);
+				int16ToFloat(reinterpret_cast<const qint16*>(aux), auxFloatScratch_.data(),
+				             auxSamples);
+				auxSpan.data = auxFloatScratch_.constData();
+			}
+			auxSpan.frames = frames;
+			auxSpan.channels = auxFormat_.channelCount();
+		}
+		process(mainSpan, auxSpan);
+	}
+	else
+	{
+		SampleSpan<qint16> mainSpan;
+		mainSpan.data = reinterpret_cast<qint16*>(main);
+		mainSpan.frames = frames;
+		mainSpan.channels = mainFormat_.channelCount();
+
+		SampleSpan<const qint16> auxSpan;
+		if (aux)
+		{
+			auxSpan.data = reinterpret_cast<const qint16*>(aux);
+			if (floatAux)
+			{
+				auxScratch_.resize(auxSamples);
+				floatToInt16(reinterpret_cast<const float*>(aux), auxScratch_.data(), auxSamples);
+				auxSpan.data = auxScratch_.constData();
+			}
+			auxSpan.frames = frames;
+			auxSpan.channels = auxFormat_.channelCount();
+		}
+		process(mainSpan, auxSpan);
+	}
+}
+
+void AudioEffect::processFrame(QAudioBuffer& mainBuffer, const QAudioBuffer& auxBuffer)
+{
+	if (mainBuffer.frameCount() != int(getFrameSize()) ||
+	    (auxBuffer.isValid() && auxBuffer.frameCount() != mainBuffer.frameCount()))
+		throw std::invalid_argument("Frame doesn't match the effect frame size");
+
+	// The frame is read through constData(), which never detaches; data() gives the buffer the
+	// result goes to, a copy of its own if the frame is shared with other buffers
+	const char* input = mainBuffer.constData<char>();
+	char* output = mainBuffer.data<char>();
+	if (output != input)
+		std::memcpy(output, input, std::size_t(mainBuffer.byteCount()));
+
+	processFrame(output, auxBuffer.isValid() ? auxBuffer.constData<char>() : nullptr);
+}
+
+bool AudioEffect::hasSeparateReverseStream() const
+{
+	return false;
+}
+
+void AudioEffect::processReverseFrame(const char* aux)
+{
+	if (!hasSeparateReverseStream())
+		throw std::logic_error("Effect takes the far end together with the near end");
+
+	if (auxFormat_.sampleType() == QAudioFormat::Float)
+		processReverseInterleavedFloat(reinterpret_cast<const float*>(aux));
+	else
+		processReverseInterleaved(reinterpret_cast<const qint16*>(aux));
+}
+
+void AudioEffect::processReverseInterleaved(const qint16* aux)
+{
+	Q_UNUSED(aux);
+}
+
+void AudioEffect::processReverseInterleavedFloat(const float* aux)
+{
+	Q_UNUSED(aux);
+}
+
+void AudioEffect::setQualityTier(QualityTier tier)
+{
+	if (qualityTier_ == tier)
+		return;
+	qualityTier_ = tier;
+	applyQualityTier();
+}
+
+QualityTier AudioEffect::getQualityTier() const
+{
+	return qualityTier_;
+}
+
+unsigned int AudioEffect::getFrameSize() const
+{
+	return mainFormat_.sampleRate() * requiredFrameSizeMs() / 1000;
+}
+
+const QAudioFormat& AudioEffect::getMainFormat() const
+{
+	return mainFormat_;
+}
+
+const QAudioFormat& AudioEffect::getAuxFormat() const
+{
+	return auxFormat_;
+}
+
+QByteArray AudioEffect::saveState() const
+{
+	QByteArray state;
+	QDataStream out(&state, QIODevice::WriteOnly);
+	out.setByteOrder(QDataStream::LittleEndian);
+
+	out << stateMagic << stateVersion;
+	out << QByteArray(metaObject()->className());
+	out << quint32(mainFormat_.sampleRate());
+	out << quint16(mainFormat_.channelCount());
+	out << quint16(auxFormat_.channelCount());
+	out << quint32(getFrameSize());
+
+	saveAdaptiveState(out);
+	return state;
+}
+
+bool AudioEffect::restoreState(const QByteArray& state)
+{
+	QDataStream in(state);
+	in.setByteOrder(QDataStream::LittleEndian);
+
+	quint32 magic = 0;
+	quint16 version = 0;
+	in >> magic >> version;
+	if (in.status() != QDataStream::Ok || magic != stateMagic || version != stateVersion)
+		return false;
+
+	QByteArray className;
+	quint32 sampleRate = 0;
+	quint16 mainChannels = 0;
+	quint16 auxChannels = 0;
+	quint32 frameSize = 0;
+	in >> className >> sampleRate >> mainChannels >> auxChannels >> frameSize;
+
+	// Adaptive state is only meaningful for the same backend, rate and frame geometry
+	if (in.status() != QDataStream::Ok || className != metaObject()->className() ||
+	    sampleRate != quint32(mainFormat_.sampleRate()) ||
+	    mainChannels != mainFormat_.channelCount() || auxChannels != auxFormat_.channelCount() ||
+	    frameSize != getFrameSize())
+		return false;
+
+	return restoreAdaptiveState(in);
+}
+
+void AudioEffect::reset()
+{
+	qualityTier_ = QualityTier::Full;
+	voiceActive_ = false;
+	resetState();
+}
+
+void AudioEffect::saveAdaptiveState(QDataStream& out) const
+{
+	Q_UNUSED(out);
+}
+
+bool AudioEffect::restoreAdaptiveState(QDataStream& in)
+{
+	Q_UNUSED(in);
+	return true;
+}
+
+void AudioEffect::applyQualityTier()
+{
+}
+
+} // namespace SpeexWebRTCTest
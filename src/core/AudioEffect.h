@@ -0,0 +1,134 @@
+#ifndef _AUDIO_EFFECT_H_
+#define _AUDIO_EFFECT_H_
+
+#include <QAudioBuffer>
+#include <QDataStream>
+#include <QDebug>
+#include <QObject>
+#include <QVariant>
+#include <QVector>
+
+namespace SpeexWebRTCTest {
+
+// Non-owning view of one frame of samples at the rate of the effect, 16-bit or float with full
+// scale at +/-1.0. Interleaved frames hold all the channels of the first sample, then of the
+// second and so on; planar frames hold all the samples of the first channel, then of the second.
+template <typename Sample>
+struct SampleSpan
+{
+	Sample* data = nullptr;
+	int frames = 0;
+	int channels = 0;
+	bool planar = false;
+};
+
+// Processing quality steps used to shed load on an overloaded host, from full quality down to
+// passing the audio through untouched. Every tier keeps the savings of the tiers above it.
+enum class QualityTier
+{
+	Full,
+	ShortEchoTail,
+	ReducedRate,
+	NoNoiseSuppression,
+	Bypass
+};
+
+QString qualityTierName(QualityTier tier);
+
+class AudioEffect : public QObject
+{
+	Q_OBJECT
+public:
+	AudioEffect(const QAudioFormat& mainFormat, const QAudioFormat& auxFormat);
+
+	// Processes one frame of getFrameSize() samples in place. The aux span may be empty for
+	// backends which take their far end elsewhere. Interleaved spans are processed without
+	// copies, planar ones go through scratch buffers of the effect.
+	void process(SampleSpan<qint16> main, SampleSpan<const qint16> aux);
+	// Float frames are processed without going through 16-bit samples by the backends which
+	// support it, and converted around the 16-bit processing by the others
+	void process(SampleSpan<float> main, SampleSpan<const float> aux);
+	// Interleaved frames of getFrameSize() samples in the main and aux formats, 16-bit or float.
+	// An aux frame of the other sample type is converted to the one of the main frame; aux may
+	// be nullptr.
+	void processFrame(char* main, const char* aux);
+	// Adapter for Qt buffers in the main and aux formats
+	void processFrame(QAudioBuffer& mainBuffer, const QAudioBuffer& auxBuffer);
+
+	// Backends which analyse the far end on its own can take it on another thread as it
+	// arrives: processReverseFrame() may then run concurrently with processFrame() calls which
+	// are given no aux frame
+	virtual bool hasSeparateReverseStream() const;
+	// Interleaved frame of getFrameSize() samples in the aux format. Throws std::logic_error
+	// unless hasSeparateReverseStream().
+	void processReverseFrame(const char* aux);
+
+	virtual void setParameter(const QString& param, QVariant value) = 0;
+
+	// Serializes adaptive state (echo filter, noise estimate, AGC gain) into a versioned
+	// snapshot which can warm-start another instance with the same formats and frame size
+	QByteArray saveState() const;
+	bool restoreState(const QByteArray& state);
+
+	// Returns the effect to the state of a new instance with the same formats: adaptive state,
+	// parameters and quality tier, without reallocating the backend
+	void reset();
+
+	// Bypass is left to the caller, which stops calling process() altogether
+	void setQualityTier(QualityTier tier);
+	QualityTier getQualityTier() const;
+
+	unsigned int getFrameSize() const;
+	const QAudioFormat& getMainFormat() const;
+	const QAudioFormat& getAuxFormat() const;
+
+protected:
+	void setVoiceActive(bool active)
+	{
+		if (voiceActive_ != active)
+			emit voiceActivityChanged(active);
+		voiceActive_ = active;
+	}
+
+	virtual unsigned int requiredFrameSizeMs() const = 0;
+
+	// Both frames are interleaved getFrameSize() samples of the main and aux formats, aux is
+	// nullptr when the caller has no far end
+	virtual void processInterleaved(qint16* main, const qint16* aux) = 0;
+	// Same with float samples. Converts to 16-bit samples for processInterleaved() unless
+	// overridden.
+	virtual void processInterleavedFloat(float* main, const float* aux);
+	// Far end alone, for backends with a separate reverse stream
+	virtual void processReverseInterleaved(const qint16* aux);
+	virtual void processReverseInterleavedFloat(const float* aux);
+
+	virtual void saveAdaptiveState(QDataStream& out) const;
+	virtual bool restoreAdaptiveState(QDataStream& in);
+	// Resets the backend state and parameters, the quality tier is back to Full already
+	virtual void resetState() = 0;
+
+	// Reconfigures the backend for getQualityTier()
+	virtual void applyQualityTier();
+
+signals:
+	void voiceActivityChanged(bool voice);
+
+private:
+	template <typename Main, typename Aux>
+	void checkSpans(const SampleSpan<Main>& main, const SampleSpan<Aux>& aux) const;
+
+	const QAudioFormat mainFormat_;
+	const QAudioFormat auxFormat_;
+
+	bool voiceActive_ = false;
+	QualityTier qualityTier_ = QualityTier::Full;
+
+	QVector<qint16> mainScratch_;
+	QVector<qint16> auxScratch_;
+	QVector<float> mainFloatScratch_;
+	QVector<float> auxFloatScratch_;
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif //_AUDIO_EFFECT_H_
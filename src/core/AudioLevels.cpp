@@ -0,0 +1,125 @@
+#include "AudioLevels.h"
+
+#include <QAudio>
+
+#include <climits>
+
+namespace SpeexWebRTCTest {
+
+namespace {
+// This function returns the maximum possible sample value for a given audio format
+qreal getPeakValue(const QAudioFormat& format)
+{
+	// Note: Only the most common sample formats are supported
+	if (!format.isValid())
+		return qreal(0);
+
+	if (format.codec() != "audio/pcm")
+		return qreal(0);
+
+	switch (format.sampleType())
+	{
+	case QAudioFormat::Unknown:
+		break;
+	case QAudioFormat::Float:
+		if (format.sampleSize() != 32) // other sample formats are not supported
+			return qreal(0);
+		return qreal(1.00003);
+	case QAudioFormat::SignedInt:
+		if (format.sampleSize() == 32)
+			return qreal(INT_MAX);
+		if (format.sampleSize() == 16)
+			return qreal(SHRT_MAX);
+		if (format.sampleSize() == 8)
+			return qreal(CHAR_MAX);
+		break;
+	case QAudioFormat::UnSignedInt:
+		if (format.sampleSize() == 32)
+			return qreal(UINT_MAX);
+		if (format.sampleSize() == 16)
+			return qreal(USHRT_MAX);
+		if (format.sampleSize() == 8)
+			return qreal(UCHAR_MAX);
+		break;
+	}
+
+	return qreal(0);
+}
+
+template <class T>
+QVector<qreal> getBufferLevels(const T* buffer, int frames, int channels)
+{
+	QVector<qreal> max_values;
+	max_values.fill(0, channels);
+
+	for (int i = 0; i < frames; ++i)
+	{
+		for (int j = 0; j < channels; ++j)
+		{
+			qreal value = qAbs(qreal(buffer[i * channels + j]));
+			if (value > max_values.at(j))
+				max_values.replace(j, value);
+		}
+	}
+
+	return max_values;
+}
+} // namespace
+
+QVector<qreal> calculateAudioLevels(const char* data, int frames, const QAudioFormat& format)
+{
+	QVector<qreal> values;
+
+	if (!format.isValid() || format.byteOrder() != QAudioFormat::LittleEndian)
+		return values;
+
+	if (format.codec() != "audio/pcm")
+		return values;
+
+	int channelCount = format.channelCount();
+	values.fill(0, channelCount);
+	qreal peak_value = getPeakValue(format);
+	if (qFuzzyCompare(peak_value, qreal(0)))
+		return values;
+
+	switch (format.sampleType())
+	{
+	case QAudioFormat::Unknown:
+	case QAudioFormat::UnSignedInt:
+		if (format.sampleSize() == 32)
+			values = getBufferLevels(reinterpret_cast<const quint32*>(data), frames, channelCount);
+		if (format.sampleSize() == 16)
+			values = getBufferLevels(reinterpret_cast<const quint16*>(data), frames, channelCount);
+		if (format.sampleSize() == 8)
+			values = getBufferLevels(reinterpret_cast<const quint8*>(data), frames, channelCount);
+		for (int i = 0; i < values.size(); ++i)
+			values[i] = qAbs(values.at(i) - peak_value / 2) / (peak_value / 2);
+		break;
+	case QAudioFormat::Float:
+		if (format.sampleSize() == 32)
+		{
+			values = getBufferLevels(reinterpret_cast<const float*>(data), frames, channelCount);
+			for (int i = 0; i < values.size(); ++i)
+				values[i] /= peak_value;
+		}
+		break;
+	case QAudioFormat::SignedInt:
+		if (format.sampleSize() == 32)
+			values = getBufferLevels(reinterpret_cast<const qint32*>(data), frames, channelCount);
+		if (format.sampleSize() == 16)
+			values = getBufferLevels(reinterpret_cast<const qint16*>(data), frames, channelCount);
+		if (format.sampleSize() == 8)
+			values = getBufferLevels(reinterpret_cast<const qint8*>(data), frames, channelCount);
+		for (int i = 0; i < values.size(); ++i)
+			values[i] /= peak_value;
+		break;
+	}
+
+	// Convert to dBFS
+	for (auto& level : values)
+		level = QAudio::convertVolume(level, QAudio::LinearVolumeScale, QAudio::DecibelVolumeScale);
+
+	return values;
+}
+
+} // namespace SpeexWebRTCTest
@@ -0,0 +1,15 @@
+#ifndef _AUDIO_LEVELS_H_
+#define _AUDIO_LEVELS_H_
+
+#include <QAudioFormat>
+#include <QVector>
+
+namespace SpeexWebRTCTest {
+
+// Peak level in dBFS of each channel of interleaved frames of the format, empty for formats
+// which aren't supported
+QVector<qreal> calculateAudioLevels(const char* data, int frames, const QAudioFormat& format);
+
+} // namespace SpeexWebRTCTest
+
+#endif // _AUDIO_LEVELS_H_
@@ -0,0 +1,797 @@
+#include "AudioProcessor.h"
+
+#include "AudioLevels.h"
+#include "LosslessCodec.h"
+#include "LosslessWriter.h"
+#include "ShadowProcessor.h"
+#include "SpeexDSP.h"
+#include "StreamMetrics.h"
+#include "Timer.h"
+#include "WavFileWriter.h"
+#include "WebRTCDSP.h"
+
+#include <QAudioBuffer>
+#include <QDir>
+#include <QLoggingCategory>
+
+#include <stdexcept>
+
+namespace SpeexWebRTCTest {
+
+namespace {
+Q_LOGGING_CATEGORY(processor, "processor")
+
+// Frames worth of capacity reserved in each queue when memory is locked
+const int queueReserveFrames = 16;
+
+void takeFront(QByteArray& buffer, char* to, const std::size_t size)
+{
+	memcpy(to, buffer.constData(), size);
+	buffer.remove(0, size);
+}
+} // namespace
+
+AudioProcessor::AudioProcessor(const QAudioFormat& format,
+                               const QAudioFormat& monitorFormat,
+                               QBuffer& monitorDevice,
+                               QObject* parent)
+    : QIODevice(parent),
+      bufferSize_(1024),
+      format_(format),
+      monitorFormat_(monitorFormat),
+      monitorDevice_(monitorDevice),
+      latencyMeter_(format, monitorFormat)
+{
+	qRegisterMetaType<QVector<qreal>>();
+	qRegisterMetaType<SpeexWebRTCTest::QualityTier>();
+	qRegisterMetaType<SpeexWebRTCTest::LatencyReport>();
+
+	referenceMixer_.reset(new ReferenceMixer(ReferenceConditioning(), monitorFormat_));
+	switchBackend(Backend::Speex);
+
+	connect(&monitorDevice_, &QIODevice::readyRead,
+	        [this]
+	        {
+		        monitorDevice_.seek(0);
+		        const QByteArray data = monitorDevice_.readAll();
+		        {
+			        std::unique_lock<std::mutex> lock(monitorMutex_);
+			        monitorBuffer_.append(data);
+			        monitorEvent_.notify_all();
+			        trace_.writeMonitor(data.size(), monitorBuffer_.size());
+		        }
+		        latencyMeter_.recordMonitor(data.constData(), data.size());
+		        monitorDevice_.buffer().clear();
+		        monitorDevice_.seek(0);
+	        });
+
+	doWork_ = true;
+	worker_ = std::thread([this] { process(); });
+	renderWorker_ = std::thread([this] { render(); });
+}
+
+AudioProcessor::~AudioProcessor()
+{
+	doWork_ = false;
+	inputEvent_.notify_all();
+	{
+		std::unique_lock<std::mutex> lock(monitorMutex_);
+		monitorEvent_.notify_all();
+	}
+	worker_.join();
+	renderWorker_.join();
+	if (latencyAnalysis_.joinable())
+		latencyAnalysis_.join();
+}
+
+qint64 AudioProcessor::readData(char* data, qint64 maxlen)
+{
+	std::unique_lock<std::mutex> lock(outputMutex_);
+	int len = std::min((qint64)outputBuffer_.size(), maxlen);
+	takeFront(outputBuffer_, data, len);
+	trace_.writePlayback(maxlen, len, outputBuffer_.size());
+	// The probe replaces the processed output and is played at the pace the device asks for
+	if (latencyMeter_.fillOutput(data, maxlen))
+		len = maxlen;
+	return len;
+}
+
+qint64 AudioProcessor::writeData(const char* data, qint64 len)
+{
+	{
+		std::unique_lock<std::mutex> lock1(inputMutex_);
+		std::unique_lock<std::mutex> lock2(inputEventMutex_);
+		inputBuffer_.append(data, len);
+		trace_.writeCapture(len, inputBuffer_.size());
+		inputEvent_.notify_all();
+	}
+
+	if (latencyMeter_.recordCapture(data, len))
+	{
+		// The previous analysis is over, the meter accepts only one measurement at a time
+		if (latencyAnalysis_.joinable())
+			latencyAnalysis_.join();
+		latencyAnalysis_ = std::thread(
+		    [this]
+		    {
+			    const LatencyReport report =
+			        latencyMeter_.analyse(inputDeviceBytes_, outputDeviceBytes_);
+			    emit latencyMeasured(report);
+		    });
+	}
+	return len;
+}
+
+void AudioProcessor::process()
+{
+	auto statisticsStart = std::chrono::steady_clock::now();
+	ThreadStatistics statistics = ThreadStatistics::current();
+
+	while (doWork_)
+	{
+		std::unique_lock<std::mutex> processLock(processMutex_);
+
+		if (realtimeProfileChanged_)
+		{
+			applyRealtimeProfile();
+			realtimeProfileChanged_ = false;
+			statisticsStart = std::chrono::steady_clock::now();
+			statistics = ThreadStatistics::current();
+		}
+
+		const auto now = std::chrono::steady_clock::now();
+		if (now - statisticsStart >= std::chrono::seconds(1))
+		{
+			const ThreadStatistics current = ThreadStatistics::current();
+			const ThreadStatistics delta = current - statistics;
+			const double seconds = std::chrono::duration<double>(now - statisticsStart).count();
+			qDebug(processor).nospace()
+			    << "Worker: " << (delta.minorFaults + delta.majorFaults) / seconds
+			    << " page faults/s (" << delta.majorFaults << " major), "
+			    << delta.involuntarySwitches / seconds << " involuntary context switches/s";
+			statisticsStart = now;
+			statistics = current;
+		}
+
+		const std::size_t bytesToRead =
+		    bufferSize_ * format_.sampleSize() / 8 * format_.channelCount();
+		const std::size_t monitorToRead =
+		    bufferSize_ * monitorFormat_.sampleSize() / 8 * monitorFormat_.channelCount();
+
+		// The frame buffers are reused, resizing them to the same size doesn't allocate
+		bool haveFrame = false;
+		qint64 inputQueue = 0;
+
+		{
+			std::unique_lock<std::mutex> lock(inputMutex_);
+			if (inputBuffer_.size() >= bytesToRead)
+			{
+				nearFrame_.resize(bytesToRead);
+				takeFront(inputBuffer_, nearFrame_.data(), bytesToRead);
+				haveFrame = true;
+			}
+			inputQueue = inputBuffer_.size();
+		}
+
+		if (haveFrame)
+		{
+			bool farEndUnderrun = false;
+			bool farEndAnalysed = false;
+			qint64 monitorQueue = 0;
+			farFrame_.resize(monitorToRead);
+			{
+				std::unique_lock<std::mutex> lock(monitorMutex_);
+				// The render worker has already taken the far end out of the monitor queue
+				farEndAnalysed = renderBytes_ != 0;
+				QByteArray& farEnd = farEndAnalysed ? renderedBuffer_ : monitorBuffer_;
+				if (farEnd.size() >= monitorToRead)
+					takeFront(farEnd, farFrame_.data(), monitorToRead);
+				else
+				{
+					farFrame_.fill(0);
+					farEndUnderrun = true;
+				}
+				monitorQueue = monitorBuffer_.size() + renderedBuffer_.size();
+			}
+
+			if (trace_.isOpen())
+				trace_.writeFrame(nearFrame_, farFrame_, farEndUnderrun, inputQueue, monitorQueue,
+				                  bytesAvailable());
+
+			processFrame(farEndAnalysed,
+			             std::chrono::microseconds(format_.durationForBytes(inputQueue)), false);
+		}
+		else
+		{
+			processLock.unlock();
+			std::unique_lock<std::mutex> lock(inputEventMutex_);
+			inputEvent_.wait(lock);
+		}
+	}
+}
+
+void AudioProcessor::render()
+{
+	std::unique_lock<std::mutex> lock(monitorMutex_);
+	const auto frameReady = [this]
+	{ return renderBytes_ != 0 && std::size_t(monitorBuffer_.size()) >= renderBytes_; };
+
+	while (doWork_)
+	{
+		monitorEvent_.wait(lock, [&] { return !doWork_ || renderProfileChanged_ || frameReady(); });
+
+		// The effect may be replaced while the monitor queue is unlocked
+		lock.unlock();
+		std::unique_lock<std::mutex> renderLock(renderMutex_);
+		lock.lock();
+
+		if (renderProfileChanged_)
+		{
+			const RealtimeProfile profile = renderProfile_;
+			renderProfileChanged_ = false;
+			lock.unlock();
+			if (!SpeexWebRTCTest::applyRealtimeProfile(profile))
+				qWarning(processor) << "Running the render worker with a degraded realtime profile";
+			lock.lock();
+		}
+
+		if (!frameReady())
+			continue;
+
+		renderFrame_.resize(renderBytes_);
+		takeFront(monitorBuffer_, renderFrame_.data(), renderBytes_);
+		lock.unlock();
+
+		if (!bypassed_)
+		{
+			const char* reference = renderFrame_.constData();
+			if (!referenceMixer_->isPassthrough())
+			{
+				renderReference_.resize(
+				    referenceMixer_->getOutputFormat().bytesForFrames(bufferSize_));
+				referenceMixer_->process(renderFrame_.constData(), renderReference_.data(),
+				                         bufferSize_);
+				reference = renderReference_.constData();
+			}
+			dsp_->processReverseFrame(reference);
+		}
+
+		lock.lock();
+		renderedBuffer_.append(renderFrame_.constData(), renderFrame_.size());
+	}
+}
+
+void AudioProcessor::setRealtimeProfile(const RealtimeProfile& profile)
+{
+	{
+		std::unique_lock<std::mutex> lock(processMutex_);
+		realtimeProfile_ = profile;
+		realtimeProfileChanged_ = true;
+	}
+	{
+		std::unique_lock<std::mutex> lock(monitorMutex_);
+		renderProfile_ = profile;
+		renderProfileChanged_ = true;
+		monitorEvent_.notify_all();
+	}
+	// The profile is applied by the worker threads themselves
+	std::unique_lock<std::mutex> lock(inputEventMutex_);
+	inputEvent_.notify_all();
+}
+
+void AudioProcessor::applyRealtimeProfile()
+{
+	if (realtimeProfile_.lockMemory)
+	{
+		// Pre-fault the queues so that steady-state processing doesn't grow them
+		const int frameBytes = bufferSize_ * format_.sampleSize() / 8 * format_.channelCount();
+		const int monitorBytes =
+		    bufferSize_ * monitorFormat_.sampleSize() / 8 * monitorFormat_.channelCount();
+		{
+			std::unique_lock<std::mutex> lock(inputMutex_);
+			inputBuffer_.reserve(frameBytes * queueReserveFrames);
+		}
+		{
+			std::unique_lock<std::mutex> lock(monitorMutex_);
+			monitorBuffer_.reserve(monitorBytes * queueReserveFrames);
+			renderedBuffer_.reserve(monitorBytes * queueReserveFrames);
+		}
+		{
+			std::unique_lock<std::mutex> lock(outputMutex_);
+			outputBuffer_.reserve(frameBytes * queueReserveFrames);
+		}
+	}
+
+	if (!SpeexWebRTCTest::applyRealtimeProfile(realtimeProfile_))
+		qWarning(processor) << "Running the DSP worker with a degraded realtime profile";
+}
+
+void AudioProcessor::processFrame(bool farEndAnalysed,
+                                  std::chrono::nanoseconds inputQueue,
+                                  bool renderLocked)
+{
+	if (sourceEncoder_ && sourceEncoder_->isOpen())
+		sourceEncoder_->write(nearFrame_);
+
+	const auto start = std::chrono::steady_clock::now();
+
+	// Without a shadow an analysed far end isn't needed anymore
+	const QByteArray* reference = &farFrame_;
+	if (!referenceMixer_->isPassthrough() && (!farEndAnalysed || shadow_))
+	{
+		referenceFrame_.resize(referenceMixer_->getOutputFormat().bytesForFrames(bufferSize_));
+		referenceMixer_->process(farFrame_.constData(), referenceFrame_.data(), bufferSize_);
+		reference = &referenceFrame_;
+	}
+
+	// The frame is processed in place, the shadow needs a copy of the input
+	ShadowFrame shadowFrame;
+	if (shadow_)
+	{
+		shadowFrame.nearEnd = QByteArray(nearFrame_.constData(), nearFrame_.size());
+		shadowFrame.farEnd = QByteArray(reference->constData(), reference->size());
+	}
+
+	// The shadow compares CPU time, which preemption by the shadow thread doesn't inflate
+	const std::chrono::nanoseconds cpuStart =
+	    shadow_ ? threadCpuTime() : std::chrono::nanoseconds(0);
+	processBuffer(farEndAnalysed ? nullptr : reference->constData());
+	if (shadow_)
+		shadowFrame.cpuTime = threadCpuTime() - cpuStart;
+	const std::chrono::nanoseconds cost = std::chrono::steady_clock::now() - start;
+	updateQualityTier(cost, renderLocked);
+
+	if (processedEncoder_ && processedEncoder_->isOpen())
+		processedEncoder_->write(nearFrame_);
+
+	qint64 outputQueue = 0;
+	{
+		// Appending to an empty QByteArray would share the frame instead of copying it
+		std::unique_lock<std::mutex> lock(outputMutex_);
+		outputQueue = outputBuffer_.size();
+		outputBuffer_.append(nearFrame_.constData(), nearFrame_.size());
+		emit readyRead();
+	}
+
+	// The frame waits for the queued output ahead of it, and for itself to fill up before
+	if (latencyMeter_.isActive())
+		latencyMeter_.addFrame(inputQueue,
+		                       std::chrono::microseconds(format_.durationForFrames(bufferSize_)) +
+		                           cost,
+		                       std::chrono::microseconds(format_.durationForBytes(outputQueue)));
+
+	if (shadow_)
+	{
+		shadowFrame.output = QByteArray(nearFrame_.constData(), nearFrame_.size());
+		shadowFrame.captured = start;
+		shadowFrame.latency = std::chrono::steady_clock::now() - start;
+		shadow_->submit(shadowFrame);
+	}
+}
+
+void AudioProcessor::replayFrame(const QByteArray& nearEnd, const QByteArray& farEnd)
+{
+	std::unique_lock<std::mutex> lock(processMutex_);
+	std::unique_lock<std::mutex> renderLock(renderMutex_);
+	if (nearEnd.size() != format_.bytesForFrames(bufferSize_) ||
+	    farEnd.size() != monitorFormat_.bytesForFrames(bufferSize_))
+		throw std::invalid_argument("Recorded frame doesn't match the effect frame size");
+
+	nearFrame_.resize(nearEnd.size());
+	memcpy(nearFrame_.data(), nearEnd.constData(), nearEnd.size());
+	farFrame_.resize(farEnd.size());
+	memcpy(farFrame_.data(), farEnd.constData(), farEnd.size());
+	processFrame(false, std::chrono::nanoseconds(0), true);
+}
+
+void AudioProcessor::processBuffer(const char* reference)
+{
+	TIMER(qDebug(processor))
+
+	const int frames = format_.framesForBytes(nearFrame_.size());
+	QVector<qreal> inputLevels = calculateAudioLevels(nearFrame_.constData(), frames, format_);
+
+	// 16-bit or float frames, whichever the devices deliver
+	if (dsp_ && degradation_.getTier() != QualityTier::Bypass)
+		dsp_->processFrame(nearFrame_.data(), reference);
+
+	QVector<qreal> outputLevels = calculateAudioLevels(nearFrame_.constData(), frames, format_);
+
+	emit inputLevelsChanged(inputLevels);
+	emit outputLevelsChanged(outputLevels);
+}
+
+void AudioProcessor::updateQualityTier(std::chrono::nanoseconds cost, bool renderLocked)
+{
+	if (!degradationEnabled_)
+		return;
+
+	const QualityTier previous = degradation_.getTier();
+	const std::chrono::microseconds period(format_.durationForFrames(bufferSize_));
+	if (!degradation_.update(cost, period))
+		return;
+
+	const QualityTier tier = degradation_.getTier();
+	const double load = degradation_.getLoad();
+	bypassed_ = tier == QualityTier::Bypass;
+	if (tier > previous)
+		qWarning(processor).nospace() << "Overloaded at " << qRound(load * 100)
+		                              << "% of the frame period, stepping down to "
+		                              << qualityTierName(tier);
+	else
+		qInfo(processor).nospace() << "Load down to " << qRound(load * 100)
+		                           << "% of the frame period, stepping up to "
+		                           << qualityTierName(tier);
+
+	if (dsp_)
+	{
+		// The render worker may be inside the effect
+		std::unique_lock<std::mutex> renderLock(renderMutex_, std::defer_lock);
+		if (!renderLocked)
+			renderLock.lock();
+		dsp_->setQualityTier(tier);
+	}
+	emit qualityTierChanged(tier, load);
+}
+
+void AudioProcessor::clearBuffers()
+{
+	{
+		std::unique_lock<std::mutex> lock(inputMutex_);
+		inputBuffer_.clear();
+	}
+	{
+		std::unique_lock<std::mutex> lock(outputMutex_);
+		outputBuffer_.clear();
+	}
+	{
+		std::unique_lock<std::mutex> lock(monitorMutex_);
+		monitorBuffer_.clear();
+		renderedBuffer_.clear();
+	}
+}
+
+QIODevice* AudioProcessor::createRecorder(const QString& name) const
+{
+	const QString path = QDir(recordingDirectory_).filePath(name);
+
+	// Formats the codec doesn't take are still recorded, as WAV
+	if (recordingFormat_ == RecordingFormat::Lossless && isLosslessFormatSupported(format_))
+	{
+		LosslessWriter* writer = new LosslessWriter(path + ".lac", format_);
+		writer->open();
+		return writer;
+	}
+
+	WavFileWriter* writer = new WavFileWriter(path + ".wav", format_);
+	writer->open();
+	return writer;
+}
+
+ShadowProcessor* AudioProcessor::createShadow(Backend backend, bool waitWhenFull) const
+{
+	const QString path =
+	    recordingDirectory_.isEmpty() ? QString() : QDir(recordingDirectory_).filePath("shadow");
+	return new ShadowProcessor(backend, format_, referenceMixer_->getOutputFormat(), path,
+	                           waitWhenFull);
+}
+
+bool AudioProcessor::isSequential() const
+{
+	return true;
+}
+
+bool AudioProcessor::canReadLine() const
+{
+	return false;
+}
+
+qint64 AudioProcessor::bytesAvailable() const
+{
+	std::unique_lock<std::mutex> lock(outputMutex_);
+	return outputBuffer_.size();
+}
+
+bool AudioProcessor::open(QIODevice::OpenMode mode)
+{
+	std::unique_lock<std::mutex> lock(processMutex_);
+	clearBuffers();
+	latencyMeter_.reset();
+
+	if (!recordingDirectory_.isEmpty())
+	{
+		sourceEncoder_.reset(createRecorder("source"));
+		processedEncoder_.reset(createRecorder("processed"));
+	}
+
+	// Parameters set before the trace opens are recorded as a snapshot, for the replay
+	if (!traceFileName_.isEmpty() && trace_.open(traceFileName_, format_, monitorFormat_))
+	{
+		trace_.writeBackend(quint8(getCurrentBackend()));
+		for (auto it = effectParams_.constBegin(); it != effectParams_.constEnd(); ++it)
+			trace_.writeParameter(it.key(), it.value());
+	}
+
+	return QIODevice::open(mode);
+}
+
+void AudioProcessor::close()
+{
+	if (sourceEncoder_)
+	{
+		sourceEncoder_->close();
+		sourceEncoder_.reset();
+	}
+	if (processedEncoder_)
+	{
+		processedEncoder_->close();
+		processedEncoder_.reset();
+	}
+	trace_.close();
+	QIODevice::close();
+
+	for (const StageCost& cost : getStageCosts())
+	{
+		const qint64 nanoseconds = cost.total.count();
+		qInfo(processor).nospace()
+		    << "Stage " << cost.name << ": " << cost.frames << " frames, "
+		    << (cost.frames ? nanoseconds / qint64(cost.frames) / 1000 : 0) << " us per frame";
+	}
+}
+
+Backend AudioProcessor::getCurrentBackend() const
+{
+	return backend_;
+}
+
+void AudioProcessor::switchBackend(Backend backend)
+{
+	std::unique_lock<std::mutex> lock(processMutex_);
+	std::unique_lock<std::mutex> renderLock(renderMutex_);
+	clearBuffers();
+
+	// Keep the adaptive state of the outgoing backend to warm-start it when switching back
+	if (dsp_)
+		effectStates_[getCurrentBackend()] = dsp_->saveState();
+
+	createEffect(backend);
+
+	if (effectStates_.contains(backend) && !dsp_->restoreState(effectStates_.value(backend)))
+		qWarning(processor) << "Discarding incompatible DSP state snapshot";
+
+	trace_.writeBackend(quint8(backend));
+}
+
+void AudioProcessor::createEffect(Backend backend)
+{
+	const QAudioFormat& referenceFormat = referenceMixer_->getOutputFormat();
+	if (!effectChain_.isEmpty())
+	{
+		QStringList stages = effectChain_;
+		for (QString& stage : stages)
+		{
+			if (stage == "backend")
+				stage = backend == Backend::Speex ? "speex" : "webrtc";
+		}
+		dsp_.reset(EffectChain::create(stages, format_, referenceFormat));
+	}
+	else if (backend == Backend::Speex)
+		dsp_.reset(new SpeexDSP(format_, referenceFormat));
+	else
+		dsp_.reset(new WebRTCDSP(format_, referenceFormat));
+	backend_ = backend;
+	effectParams_.clear();
+
+	bufferSize_ = dsp_->getFrameSize();
+
+	dsp_->setQualityTier(degradation_.getTier());
+
+	{
+		std::unique_lock<std::mutex> lock(monitorMutex_);
+		renderBytes_ = dsp_->hasSeparateReverseStream() ? monitorFormat_.bytesForFrames(bufferSize_)
+		                                                : 0;
+		// Frames analysed by the previous effect go back for the new one
+		monitorBuffer_.prepend(renderedBuffer_);
+		renderedBuffer_.clear();
+		monitorEvent_.notify_all();
+	}
+
+	connect(dsp_.get(), &AudioEffect::voiceActivityChanged, this,
+	        &AudioProcessor::voiceActivityChanged);
+}
+
+void AudioProcessor::setReferenceConditioning(const ReferenceConditioning& conditioning)
+{
+	QScopedPointer<ReferenceMixer> mixer(new ReferenceMixer(conditioning, monitorFormat_));
+
+	std::unique_lock<std::mutex> lock(processMutex_);
+	std::unique_lock<std::mutex> renderLock(renderMutex_);
+	referenceMixer_.swap(mixer);
+
+	// Snapshots taken with another reference layout can't be restored anymore
+	effectStates_.clear();
+	createEffect(getCurrentBackend());
+
+	if (shadow_)
+	{
+		const Backend backend = shadow_->getBackend();
+		const bool waitWhenFull = shadow_->getWaitWhenFull();
+		shadow_.reset();
+		shadow_.reset(createShadow(backend, waitWhenFull));
+	}
+
+	qInfo(processor) << "Echo cancellation reference:" << monitorFormat_.channelCount()
+	                 << "monitor channels to" << referenceMixer_->getOutputFormat().channelCount();
+}
+
+void AudioProcessor::setEffectParam(const QString& param, const QVariant& value)
+{
+	// Both workers may be inside the effect, and the worker writes the trace
+	std::unique_lock<std::mutex> lock(processMutex_);
+	{
+		std::unique_lock<std::mutex> renderLock(renderMutex_);
+		dsp_->setParameter(param, value);
+	}
+	effectParams_[param] = value;
+	trace_.writeParameter(param, value);
+
+	if (shadow_)
+		shadow_->setParameter(param, value);
+}
+
+void AudioProcessor::setEffectChain(const QStringList& stages)
+{
+	for (const QString& stage : stages)
+	{
+		if (stage != "backend" && !EffectChain::stageNames().contains(stage))
+			throw std::invalid_argument("Unknown effect chain stage");
+	}
+
+	std::unique_lock<std::mutex> lock(processMutex_);
+	std::unique_lock<std::mutex> renderLock(renderMutex_);
+	clearBuffers();
+
+	// Keeps the previous effect if the stages can't make a chain, e.g. twice the same one
+	const QStringList previous = effectChain_;
+	effectChain_ = stages;
+	try
+	{
+		createEffect(backend_);
+	}
+	catch (const std::invalid_argument&)
+	{
+		effectChain_ = previous;
+		throw;
+	}
+
+	// Snapshots of another chain can't be restored anymore
+	effectStates_.clear();
+
+	if (stages.isEmpty())
+		qInfo(processor) << "Effect chain removed";
+	else
+		qInfo(processor) << "Effect chain:" << stages.join(" -> ");
+}
+
+QVector<StageCost> AudioProcessor::getStageCosts() const
+{
+	std::unique_lock<std::mutex> lock(processMutex_);
+	if (const auto* chain = dynamic_cast<const EffectChain*>(dsp_.get()))
+		return chain->getStageCosts();
+	return {};
+}
+
+void AudioProcessor::startShadow(Backend backend, bool waitWhenFull)
+{
+	std::unique_lock<std::mutex> lock(processMutex_);
+	shadow_.reset();
+	shadow_.reset(createShadow(backend, waitWhenFull));
+	qInfo(processor) << "Started shadow"
+	                 << (backend == Backend::Speex ? "Speex" : "WebRTC") << "backend";
+}
+
+void AudioProcessor::stopShadow()
+{
+	std::unique_lock<std::mutex> lock(processMutex_);
+	shadow_.reset();
+}
+
+void AudioProcessor::setShadowEffectParam(const QString& param, const QVariant& value)
+{
+	std::unique_lock<std::mutex> lock(processMutex_);
+	if (shadow_)
+		shadow_->setParameter(param, value);
+}
+
+void AudioProcessor::setTraceFile(const QString& fileName)
+{
+	std::unique_lock<std::mutex> lock(processMutex_);
+	traceFileName_ = fileName;
+}
+
+void AudioProcessor::setRecordingFormat(RecordingFormat format)
+{
+	std::unique_lock<std::mutex> lock(processMutex_);
+	recordingFormat_ = format;
+}
+
+void AudioProcessor::setRecordingDirectory(const QString& directory)
+{
+	std::unique_lock<std::mutex> lock(processMutex_);
+	recordingDirectory_ = directory;
+}
+
+QByteArray AudioProcessor::saveEffectState() const
+{
+	std::unique_lock<std::mutex> lock(processMutex_);
+	return dsp_->saveState();
+}
+
+bool AudioProcessor::restoreEffectState(const QByteArray& state)
+{
+	std::unique_lock<std::mutex> lock(processMutex_);
+	return dsp_->restoreState(state);
+}
+
+void AudioProcessor::setDegradationEnabled(bool enabled)
+{
+	std::unique_lock<std::mutex> lock(processMutex_);
+	degradationEnabled_ = enabled;
+	if (enabled || degradation_.getTier() == QualityTier::Full)
+		return;
+
+	degradation_.reset();
+	bypassed_ = false;
+	{
+		std::unique_lock<std::mutex> renderLock(renderMutex_);
+		dsp_->setQualityTier(QualityTier::Full);
+	}
+	qInfo(processor) << "Degradation disabled, back to full quality";
+	emit qualityTierChanged(QualityTier::Full, degradation_.getLoad());
+}
+
+bool AudioProcessor::startLatencyMeasurement()
+{
+	if (!latencyMeter_.start())
+		return false;
+	qInfo(processor) << "Measuring latency, the output is muted for a moment";
+	return true;
+}
+
+void AudioProcessor::setDeviceBufferSizes(int inputBytes, int outputBytes)
+{
+	inputDeviceBytes_ = inputBytes;
+	outputDeviceBytes_ = outputBytes;
+}
+
+QualityTier AudioProcessor::getQualityTier() const
+{
+	std::unique_lock<std::mutex> lock(processMutex_);
+	return degradation_.getTier();
+}
+
+double AudioProcessor::getProcessingLoad() const
+{
+	std::unique_lock<std::mutex> lock(processMutex_);
+	return degradation_.getLoad();
+}
+
+QueueDepths AudioProcessor::getQueueDepths() const
+{
+	QueueDepths depths;
+	{
+		std::unique_lock<std::mutex> lock(inputMutex_);
+		depths.input = inputBuffer_.size();
+	}
+	{
+		std::unique_lock<std::mutex> lock(monitorMutex_);
+		depths.monitor = monitorBuffer_.size() + renderedBuffer_.size();
+	}
+	{
+		std::unique_lock<std::mutex> lock(outputMutex_);
+		depths.output = outputBuffer_.size();
+	}
+	return depths;
+}
+
+} // namespace SpeexWebRTCTest
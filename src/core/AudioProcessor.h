@@ -0,0 +1,238 @@
+#ifndef _AUDIO_PROCESSOR_H_
+#define _AUDIO_PROCESSOR_H_
+
+#include "AudioEffect.h"
+#include "DegradationController.h"
+#include "EffectChain.h"
+#include "LatencyMeter.h"
+#include "RealtimeThread.h"
+#include "ReferenceMixer.h"
+#include "TraceWriter.h"
+
+#include <QAudioFormat>
+#include <QBuffer>
+#include <QIODevice>
+#include <QMap>
+#include <QScopedPointer>
+#include <QVariant>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+class QAudioBuffer;
+
+namespace SpeexWebRTCTest {
+
+class ShadowProcessor;
+
+enum class Backend
+{
+	Speex,
+	WebRTC
+};
+
+// Bytes waiting in the queues of the processor
+struct QueueDepths
+{
+	qint64 input = 0;   // captured, not processed yet
+	qint64 monitor = 0; // far end, not consumed by a frame yet
+	qint64 output = 0;  // processed, not played yet
+};
+
+enum class RecordingFormat
+{
+	Wav,
+	Lossless // See LosslessCodec.h, lossless_decode turns the recordings into WAV files
+};
+
+class AudioProcessor final : public QIODevice
+{
+	Q_OBJECT
+public:
+	explicit AudioProcessor(const QAudioFormat& format,
+	                        const QAudioFormat& monitorFormat,
+	                        QBuffer& monitorDevice,
+	                        QObject* parent = nullptr);
+
+	~AudioProcessor() override;
+
+	bool open(OpenMode mode) override;
+	void close() override;
+
+	qint64 bytesAvailable() const override;
+	bool isSequential() const override;
+	bool canReadLine() const override;
+
+	Backend getCurrentBackend() const;
+	void switchBackend(Backend);
+
+	void setEffectParam(const QString& param, const QVariant& value);
+
+	// Runs the backend inside a chain of effects (see EffectChain), named like
+	// EffectChain::stageNames() plus "backend" for the current one; an empty list runs the
+	// backend alone. Recreates the effect, so effect parameters must be set again. Throws
+	// std::invalid_argument for unknown stage names.
+	void setEffectChain(const QStringList& stages);
+	// Processing time of each stage of the chain, empty without a chain
+	QVector<StageCost> getStageCosts() const;
+
+	// Downmixes or selects channels of the monitor stream before it reaches the echo canceller
+	// (see ReferenceConditioning). Recreates the effect, so effect parameters must be set again.
+	// Throws std::invalid_argument if the monitor format doesn't have the selected channels.
+	void setReferenceConditioning(const ReferenceConditioning& conditioning);
+
+	QByteArray saveEffectState() const;
+	bool restoreEffectState(const QByteArray& state);
+
+	// Records the session into a trace file on the next open(); an empty name disables tracing
+	void setTraceFile(const QString& fileName);
+	// Format of the source and processed recordings, applied on the next open()
+	void setRecordingFormat(RecordingFormat format);
+	// Directory of the source and processed recordings, applied on the next open(), and of the
+	// shadow output, applied on the next startShadow(); an empty name disables writing them
+	void setRecordingDirectory(const QString& directory);
+
+	// Applied by the worker threads before they process their next frame
+	void setRealtimeProfile(const RealtimeProfile& profile);
+
+	// Processes one recorded frame synchronously, bypassing the capture and monitor queues. The
+	// far end is analysed together with the near end, even by effects with a separate reverse
+	// stream.
+	void replayFrame(const QByteArray& nearEnd, const QByteArray& farEnd);
+
+	// Steps the processing quality down when frames take too long for the frame period, and back
+	// up when the load drops again. Enabled by default; disabling restores full quality.
+	void setDegradationEnabled(bool enabled);
+	QualityTier getQualityTier() const;
+	double getProcessingLoad() const;
+	QueueDepths getQueueDepths() const;
+
+	// Runs a second backend on copies of the processed frames (see ShadowProcessor). Effect
+	// parameters reach both backends; setShadowEffectParam() overrides them for the shadow only.
+	// waitWhenFull makes the primary wait for a lagging shadow instead of dropping its frames,
+	// which is only acceptable for offline replays.
+	void startShadow(Backend backend, bool waitWhenFull = false);
+	void stopShadow();
+	void setShadowEffectParam(const QString& param, const QVariant& value);
+
+	// Plays a latency probe instead of the processed output and reports through
+	// latencyMeasured() once it came back through the capture and monitor streams (see
+	// LatencyMeter). Returns false if a measurement is already running or the sample format isn't
+	// supported.
+	bool startLatencyMeasurement();
+	// Device buffer sizes in bytes, the measured device round trip is split between input and
+	// output in proportion to them
+	void setDeviceBufferSizes(int inputBytes, int outputBytes);
+
+signals:
+	void voiceActivityChanged(bool);
+	// Emitted from the worker thread on every tier change, with the load which caused it
+	void qualityTierChanged(SpeexWebRTCTest::QualityTier tier, double load);
+	void inputLevelsChanged(const QVector<qreal>&);
+	void outputLevelsChanged(const QVector<qreal>&);
+	// Emitted from the analysis thread
+	void latencyMeasured(const SpeexWebRTCTest::LatencyReport& report);
+
+protected:
+	qint64 readData(char* data, qint64 maxlen) override;
+	qint64 writeData(const char* data, qint64 len) override;
+
+private:
+	void process();
+	// Analyses the far end as it arrives for effects with a separate reverse stream, so that
+	// the worker is left with the near end only
+	void render();
+	void applyRealtimeProfile();
+	// Called with the render worker locked out
+	void createEffect(Backend backend);
+	// renderLocked: the caller holds renderMutex_ already
+	void processFrame(bool farEndAnalysed, std::chrono::nanoseconds inputQueue, bool renderLocked);
+	void processBuffer(const char* reference);
+	void updateQualityTier(std::chrono::nanoseconds cost, bool renderLocked);
+	void clearBuffers();
+	// Opens name.lac or name.wav, depending on the recording format
+	QIODevice* createRecorder(const QString& name) const;
+	// Writes next to the recordings, see setRecordingDirectory()
+	ShadowProcessor* createShadow(Backend backend, bool waitWhenFull) const;
+
+	mutable std::mutex inputMutex_;
+	mutable std::mutex outputMutex_;
+	mutable std::mutex monitorMutex_;
+
+	mutable std::mutex processMutex_;
+
+	std::size_t bufferSize_;
+	const QAudioFormat format_;
+	const QAudioFormat monitorFormat_;
+	QBuffer& monitorDevice_;
+
+	QByteArray inputBuffer_;
+	QByteArray monitorBuffer_;
+	QByteArray outputBuffer_;
+
+	// Frame being processed, in place
+	QByteArray nearFrame_;
+	QByteArray farFrame_;
+
+	// The effect and the shadow get the far end in the output format of the mixer
+	QScopedPointer<ReferenceMixer> referenceMixer_;
+	QByteArray referenceFrame_;
+
+	QScopedPointer<AudioEffect> dsp_;
+	QMap<Backend, QByteArray> effectStates_;
+	Backend backend_ = Backend::Speex;
+	QStringList effectChain_;
+
+	std::thread worker_;
+	bool doWork_ = false;
+
+	// Held by the render worker while it uses the effect and the mixer
+	std::mutex renderMutex_;
+	std::thread renderWorker_;
+	QByteArray renderFrame_;
+	QByteArray renderReference_;
+	// Guarded by monitorMutex_. Monitor frames analysed by the render worker wait in
+	// renderedBuffer_ for the trace and the shadow; renderBytes_ is 0 while it is idle.
+	std::condition_variable monitorEvent_;
+	std::size_t renderBytes_ = 0;
+	QByteArray renderedBuffer_;
+	RealtimeProfile renderProfile_;
+	bool renderProfileChanged_ = false;
+
+	RealtimeProfile realtimeProfile_;
+	bool realtimeProfileChanged_ = false;
+
+	DegradationController degradation_;
+	bool degradationEnabled_ = true;
+	// The Bypass tier, for the render worker
+	std::atomic<bool> bypassed_{false};
+
+	QScopedPointer<ShadowProcessor> shadow_;
+
+	std::condition_variable inputEvent_;
+	std::mutex inputEventMutex_;
+
+	QScopedPointer<QIODevice> sourceEncoder_;
+	QScopedPointer<QIODevice> processedEncoder_;
+	RecordingFormat recordingFormat_ = RecordingFormat::Lossless;
+	QString recordingDirectory_ = ".";
+
+	TraceWriter trace_;
+	QString traceFileName_;
+	// Parameters set on the current effect, the snapshot written when the trace opens
+	QVariantMap effectParams_;
+
+	LatencyMeter latencyMeter_;
+	std::thread latencyAnalysis_;
+	std::atomic<int> inputDeviceBytes_{0};
+	std::atomic<int> outputDeviceBytes_{0};
+};
+
+} // namespace SpeexWebRTCTest
+
+Q_DECLARE_METATYPE(QVector<qreal>)
+Q_DECLARE_METATYPE(SpeexWebRTCTest::QualityTier)
+
+#endif // _AUDIO_PROCESSOR_H_
@@ -0,0 +1,76 @@
+#include "Conference.h"
+
+#include <stdexcept>
+
+namespace SpeexWebRTCTest {
+
+Conference::Conference(const QAudioFormat& legFormat, const QAudioFormat& farEndFormat)
+    : legFormat_(legFormat), farEnd_(new SpeexFarEnd(farEndFormat))
+{
+	if (legFormat.sampleRate() != farEndFormat.sampleRate())
+		throw std::invalid_argument("Legs and far end must have the same sample rate");
+}
+
+unsigned int Conference::getFrameSize() const
+{
+	return farEnd_->getFrameSize();
+}
+
+int Conference::addLeg()
+{
+	QSharedPointer<SpeexDSP> leg(new SpeexDSP(legFormat_, farEnd_));
+	for (const auto& param : parameters_)
+		leg->setParameter(param.first, param.second);
+
+	const int id = nextLegId_++;
+	legs_.insert(id, leg);
+	return id;
+}
+
+void Conference::removeLeg(int id)
+{
+	legs_.remove(id);
+}
+
+AudioEffect* Conference::leg(int id) const
+{
+	return legs_.value(id).data();
+}
+
+int Conference::legCount() const
+{
+	return legs_.size();
+}
+
+void Conference::setParameter(const QString& param, const QVariant& value)
+{
+	for (auto& leg : legs_)
+		leg->setParameter(param, value);
+
+	// Keep only the latest value of each parameter for legs joining later
+	for (int i = 0; i < parameters_.size(); ++i)
+	{
+		if (parameters_.at(i).first == param)
+		{
+			parameters_.removeAt(i);
+			break;
+		}
+	}
+	parameters_.append(qMakePair(param, value));
+}
+
+void Conference::processFrame(QMap<int, QAudioBuffer>& legs, const QAudioBuffer& farEnd)
+{
+	farEnd_->update(farEnd);
+
+	// The legs only read the shared far end, the aux buffer is ignored
+	const QAudioBuffer noAux;
+	for (auto it = legs.begin(); it != legs.end(); ++it)
+	{
+		QSharedPointer<SpeexDSP> leg = legs_.value(it.key());
+		if (leg)
+			leg->processFrame(it.value(), noAux);
+	}
+}
+
+} // namespace SpeexWebRTCTest
@@ -0,0 +1,47 @@
+#ifndef _CONFERENCE_H_
+#define _CONFERENCE_H_
+
+#include "SpeexDSP.h"
+
+#include <QMap>
+#include <QPair>
+#include <QSharedPointer>
+
+namespace SpeexWebRTCTest {
+
+// Echo cancellation for the near-end legs of a conference which all hear the same far-end mix.
+// The far end is analysed (pre-emphasis, FFT, history) once per frame and shared read-only by
+// every leg, so the reference path cost and memory don't grow with the number of legs (see
+// conference_benchmark). The legs output the same samples as independent SpeexDSP instances.
+class Conference final
+{
+public:
+	Conference(const QAudioFormat& legFormat, const QAudioFormat& farEndFormat);
+
+	unsigned int getFrameSize() const;
+
+	// Returns the id of the new leg; parameters set on the conference so far are applied to it
+	int addLeg();
+	void removeLeg(int id);
+	AudioEffect* leg(int id) const;
+	int legCount() const;
+
+	// Applies to every leg, current and future
+	void setParameter(const QString& param, const QVariant& value);
+
+	// Processes one frame of every leg in place. Legs missing from the map are skipped, but the
+	// far end is consumed regardless so that all the legs stay aligned to it.
+	void processFrame(QMap<int, QAudioBuffer>& legs, const QAudioBuffer& farEnd);
+
+private:
+	const QAudioFormat legFormat_;
+	QSharedPointer<SpeexFarEnd> farEnd_;
+
+	int nextLegId_ = 0;
+	QMap<int, QSharedPointer<SpeexDSP>> legs_;
+	QList<QPair<QString, QVariant>> parameters_;
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _CONFERENCE_H_
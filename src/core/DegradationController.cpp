@@ -0,0 +1,101 @@
+#include "DegradationController.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace SpeexWebRTCTest {
+
+DegradationController::DegradationController() : DegradationController(Settings())
+{
+}
+
+DegradationController::DegradationController(const Settings& settings)
+    : settings_(settings), recoveryHold_(settings.recoveryHold)
+{
+	if (settings_.recoveryLoad >= settings_.overloadLoad)
+		throw std::invalid_argument("Recovery load must be below the overload load");
+}
+
+bool DegradationController::update(std::chrono::nanoseconds cost, std::chrono::nanoseconds period)
+{
+	if (period.count() <= 0)
+		return false;
+
+	// Exponential average with a time constant of settings_.smoothing
+	const double alpha = double(period.count()) / (period + settings_.smoothing).count();
+	load_ += alpha * (double(cost.count()) / period.count() - load_);
+
+	// A step up which held for a whole recovery time fitted, forget the backoff
+	sinceStepUp_ += period;
+	if (steppedUp_ && sinceStepUp_ >= settings_.recoveryHold)
+	{
+		steppedUp_ = false;
+		recoveryHold_ = settings_.recoveryHold;
+	}
+
+	if (load_ > settings_.overloadLoad)
+	{
+		overloadTime_ += period;
+		recoveryTime_ = std::chrono::nanoseconds(0);
+	}
+	else if (load_ < settings_.recoveryLoad)
+	{
+		recoveryTime_ += period;
+		overloadTime_ = std::chrono::nanoseconds(0);
+	}
+	else
+	{
+		overloadTime_ = std::chrono::nanoseconds(0);
+		recoveryTime_ = std::chrono::nanoseconds(0);
+	}
+
+	if (overloadTime_ >= settings_.overloadHold && tier_ < settings_.lowestTier)
+	{
+		// Overloaded again soon after recovering: the higher tier doesn't fit, back off
+		if (steppedUp_)
+			recoveryHold_ = std::min<std::chrono::nanoseconds>(recoveryHold_ * 2,
+			                                                   settings_.maxRecoveryHold);
+		steppedUp_ = false;
+
+		setTier(QualityTier(int(tier_) + 1));
+		return true;
+	}
+
+	if (recoveryTime_ >= recoveryHold_ && tier_ > QualityTier::Full)
+	{
+		steppedUp_ = true;
+		sinceStepUp_ = std::chrono::nanoseconds(0);
+
+		setTier(QualityTier(int(tier_) - 1));
+		return true;
+	}
+
+	return false;
+}
+
+void DegradationController::reset()
+{
+	setTier(QualityTier::Full);
+	load_ = 0;
+	recoveryHold_ = settings_.recoveryHold;
+	steppedUp_ = false;
+}
+
+QualityTier DegradationController::getTier() const
+{
+	return tier_;
+}
+
+double DegradationController::getLoad() const
+{
+	return load_;
+}
+
+void DegradationController::setTier(QualityTier tier)
+{
+	tier_ = tier;
+	overloadTime_ = std::chrono::nanoseconds(0);
+	recoveryTime_ = std::chrono::nanoseconds(0);
+}
+
+} // namespace SpeexWebRTCTest
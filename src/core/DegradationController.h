@@ -0,0 +1,60 @@
+#ifndef _DEGRADATION_CONTROLLER_H_
+#define _DEGRADATION_CONTROLLER_H_
+
+#include "AudioEffect.h"
+
+#include <chrono>
+
+namespace SpeexWebRTCTest {
+
+// Picks the quality tier of one stream from its processing cost. The cost of every frame is
+// divided by the frame period and smoothed; the tier is stepped down when this load stays above
+// the overload threshold, and stepped back up when it stays below the recovery threshold for a
+// longer time. A step up that ends in a new overload doubles the recovery time, so a stream
+// whose cost sits on the edge doesn't oscillate between two tiers.
+//
+// All times are audio time (frames times the frame period), so decisions replay the same way
+// from a trace as they were made live.
+class DegradationController final
+{
+public:
+	struct Settings
+	{
+		double overloadLoad = 0.8;
+		double recoveryLoad = 0.5;
+		std::chrono::milliseconds smoothing{200};
+		std::chrono::milliseconds overloadHold{500};
+		std::chrono::milliseconds recoveryHold{5000};
+		std::chrono::milliseconds maxRecoveryHold{60000};
+		QualityTier lowestTier = QualityTier::Bypass;
+	};
+
+	DegradationController();
+	explicit DegradationController(const Settings& settings);
+
+	// Accounts one processed frame, returns true when the tier has changed
+	bool update(std::chrono::nanoseconds cost, std::chrono::nanoseconds period);
+	void reset();
+
+	QualityTier getTier() const;
+	// Smoothed processing time as a fraction of the frame period
+	double getLoad() const;
+
+private:
+	void setTier(QualityTier tier);
+
+	const Settings settings_;
+
+	QualityTier tier_ = QualityTier::Full;
+	double load_ = 0;
+
+	std::chrono::nanoseconds overloadTime_{0};
+	std::chrono::nanoseconds recoveryTime_{0};
+	std::chrono::nanoseconds sinceStepUp_{0};
+	std::chrono::nanoseconds recoveryHold_;
+	bool steppedUp_ = false;
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _DEGRADATION_CONTROLLER_H_
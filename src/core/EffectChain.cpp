@@ -0,0 +1,346 @@
+#include "EffectChain.h"
+
+#include "HighPassFilter.h"
+#include "Limiter.h"
+#include "SpeexDSP.h"
+#include "SpeexVAD.h"
+#include "WebRTCDSP.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace SpeexWebRTCTest {
+
+namespace {
+// Frame size of chains made of stages which take any frame size
+const unsigned int defaultFrameSizeMs = 10;
+} // namespace
+
+// Samples of a stage whose frame size doesn't divide the chain frame size
+template <typename Sample>
+struct EffectChain::Queues
+{
+	std::vector<Sample> input;
+	std::vector<Sample> aux;
+	// Starts with one frame of the stage of silence, the delay of the stage
+	std::vector<Sample> output;
+	bool primed = false;
+
+	void clear()
+	{
+		input.clear();
+		aux.clear();
+		output.clear();
+		primed = false;
+	}
+};
+
+struct EffectChain::Stage
+{
+	QString name;
+	std::unique_ptr<AudioEffect> effect;
+	bool needsFarEnd = false;
+	bool direct = true;
+
+	Queues<qint16> intQueues;
+	Queues<float> floatQueues;
+
+	std::atomic<quint64> frames{0};
+	std::atomic<qint64> nanoseconds{0};
+
+	template <typename Sample>
+	Queues<Sample>& queues();
+};
+
+template <>
+EffectChain::Queues<qint16>& EffectChain::Stage::queues<qint16>()
+{
+	return intQueues;
+}
+
+template <>
+EffectChain::Queues<float>& EffectChain::Stage::queues<float>()
+{
+	return floatQueues;
+}
+
+EffectChain::EffectChain(const QAudioFormat& mainFormat,
+                         const QAudioFormat& auxFormat,
+                         unsigned int frameSizeMs)
+    : AudioEffect(mainFormat, auxFormat), frameSizeMs_(frameSizeMs)
+{
+}
+
+EffectChain::~EffectChain() = default;
+
+QStringList EffectChain::stageNames()
+{
+	return {"highpass", "speex", "webrtc", "vad", "limiter"};
+}
+
+EffectChain* EffectChain::create(const QStringList& stages,
+                                 const QAudioFormat& mainFormat,
+                                 const QAudioFormat& auxFormat)
+{
+	// The backends fix their frame size, the chain is framed like the longest one
+	std::vector<std::unique_ptr<AudioEffect>> effects(stages.size());
+	unsigned int frameSizeMs = 0;
+	for (int i = 0; i < stages.size(); ++i)
+	{
+		const QString& name = stages.at(i);
+		if (name == "speex")
+			effects[i].reset(new SpeexDSP(mainFormat, auxFormat));
+		else if (name == "webrtc")
+			effects[i].reset(new WebRTCDSP(mainFormat, auxFormat));
+		else if (name == "vad")
+			effects[i].reset(new SpeexVAD(mainFormat));
+		else if (!stageNames().contains(name))
+			throw std::invalid_argument("Unknown effect chain stage");
+
+		if (effects[i])
+			frameSizeMs = std::max(frameSizeMs, effects[i]->getFrameSize() * 1000 /
+			                                        unsigned(mainFormat.sampleRate()));
+	}
+	if (frameSizeMs == 0)
+		frameSizeMs = defaultFrameSizeMs;
+
+	std::unique_ptr<EffectChain> chain(new EffectChain(mainFormat, auxFormat, frameSizeMs));
+	for (int i = 0; i < stages.size(); ++i)
+	{
+		const QString& name = stages.at(i);
+		if (name == "highpass")
+			effects[i].reset(new HighPassFilter(mainFormat, frameSizeMs));
+		else if (name == "limiter")
+			effects[i].reset(new Limiter(mainFormat, frameSizeMs));
+		chain->addStage(name, effects[i].release(), name == "speex" || name == "webrtc");
+	}
+	return chain.release();
+}
+
+void EffectChain::addStage(const QString& name, AudioEffect* effect, bool needsFarEnd)
+{
+	std::unique_ptr<AudioEffect> owned(effect);
+
+	const QAudioFormat& main = effect->getMainFormat();
+	const QAudioFormat& aux = effect->getAuxFormat();
+	if (main.sampleRate() != getMainFormat().sampleRate() ||
+	    main.channelCount() != getMainFormat().channelCount())
+		throw std::invalid_argument("Stage doesn't have the main format of the chain");
+	if (needsFarEnd && (aux.sampleRate() != getAuxFormat().sampleRate() ||
+	                    aux.channelCount() != getAuxFormat().channelCount()))
+		throw std::invalid_argument("Stage doesn't have the aux format of the chain");
+	for (const auto& stage : stages_)
+	{
+		if (stage->name == name)
+			throw std::invalid_argument("Effect chain stage names must be unique");
+	}
+
+	std::unique_ptr<Stage> stage(new Stage);
+	stage->name = name;
+	stage->needsFarEnd = needsFarEnd;
+	stage->direct = getFrameSize() % effect->getFrameSize() == 0;
+	stage->effect = std::move(owned);
+	stage->effect->setQualityTier(getQualityTier());
+
+	connect(stage->effect.get(), &AudioEffect::voiceActivityChanged,
+	        [this](bool active) { setVoiceActive(active); });
+	stages_.push_back(std::move(stage));
+}
+
+void EffectChain::setParameter(const QString& param, QVariant value)
+{
+	const int separator = param.indexOf('.');
+	if (separator > 0)
+	{
+		const QString name = param.left(separator);
+		for (const auto& stage : stages_)
+		{
+			if (stage->name == name)
+			{
+				stage->effect->setParameter(param.mid(separator + 1), value);
+				return;
+			}
+		}
+		throw std::invalid_argument("Unknown effect chain stage");
+	}
+
+	bool accepted = false;
+	for (const auto& stage : stages_)
+	{
+		try
+		{
+			stage->effect->setParameter(param, value);
+			accepted = true;
+		}
+		catch (const std::invalid_argument&)
+		{
+		}
+	}
+	if (!accepted)
+		throw std::invalid_argument("Invalid param");
+}
+
+QVector<StageCost> EffectChain::getStageCosts() const
+{
+	QVector<StageCost> costs;
+	for (const auto& stage : stages_)
+	{
+		StageCost cost;
+		cost.name = stage->name;
+		cost.frames = stage->frames;
+		cost.total = std::chrono::nanoseconds(stage->nanoseconds);
+		costs.append(cost);
+	}
+	return costs;
+}
+
+unsigned int EffectChain::requiredFrameSizeMs() const
+{
+	return frameSizeMs_;
+}
+
+void EffectChain::processInterleaved(qint16* main, const qint16* aux)
+{
+	run(main, aux);
+}
+
+void EffectChain::processInterleavedFloat(float* main, const float* aux)
+{
+	run(main, aux);
+}
+
+void EffectChain::saveAdaptiveState(QDataStream& out) const
+{
+	out << quint32(stages_.size());
+	for (const auto& stage : stages_)
+		out << stage->name << stage->effect->saveState();
+}
+
+bool EffectChain::restoreAdaptiveState(QDataStream& in)
+{
+	quint32 count = 0;
+	in >> count;
+	if (in.status() != QDataStream::Ok || count != stages_.size())
+		return false;
+
+	for (const auto& stage : stages_)
+	{
+		QString name;
+		QByteArray state;
+		in >> name >> state;
+		if (in.status() != QDataStream::Ok || name != stage->name ||
+		    !stage->effect->restoreState(state))
+			return false;
+	}
+	return true;
+}
+
+void EffectChain::resetState()
+{
+	for (const auto& stage : stages_)
+	{
+		stage->effect->reset();
+		stage->intQueues.clear();
+		stage->floatQueues.clear();
+	}
+}
+
+void EffectChain::applyQualityTier()
+{
+	for (const auto& stage : stages_)
+		stage->effect->setQualityTier(getQualityTier());
+}
+
+template <typename Sample>
+void EffectChain::run(Sample* main, const Sample* aux)
+{
+	for (const auto& stage : stages_)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		if (stage->direct)
+			runDirect(*stage, main, aux);
+		else
+			runQueued(*stage, stage->queues<Sample>(), main, aux);
+		stage->nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(
+		                          std::chrono::steady_clock::now() - start)
+		                          .count();
+	}
+}
+
+template <typename Sample>
+void EffectChain::runDirect(Stage& stage, Sample* main, const Sample* aux)
+{
+	const int frameSize = int(stage.effect->getFrameSize());
+	const int mainSamples = frameSize * getMainFormat().channelCount();
+	const int auxSamples = frameSize * getAuxFormat().channelCount();
+
+	SampleSpan<Sample> mainSpan;
+	mainSpan.frames = frameSize;
+	mainSpan.channels = getMainFormat().channelCount();
+	SampleSpan<const Sample> auxSpan;
+	auxSpan.frames = frameSize;
+	auxSpan.channels = getAuxFormat().channelCount();
+
+	// In place, one stage frame after the other
+	const int pieces = int(getFrameSize()) / frameSize;
+	for (int piece = 0; piece < pieces; ++piece)
+	{
+		mainSpan.data = main + piece * mainSamples;
+		auxSpan.data = stage.needsFarEnd && aux ? aux + piece * auxSamples : nullptr;
+		stage.effect->process(mainSpan, auxSpan);
+	}
+	stage.frames += quint64(pieces);
+}
+
+template <typename Sample>
+void EffectChain::runQueued(Stage& stage, Queues<Sample>& queues, Sample* main, const Sample* aux)
+{
+	const int frameSize = int(stage.effect->getFrameSize());
+	const int mainSamples = frameSize * getMainFormat().channelCount();
+	const int auxSamples = frameSize * getAuxFormat().channelCount();
+	const int chainMainSamples = int(getFrameSize()) * getMainFormat().channelCount();
+	const int chainAuxSamples = int(getFrameSize()) * getAuxFormat().channelCount();
+
+	if (!queues.primed)
+	{
+		queues.output.assign(mainSamples, Sample(0));
+		queues.primed = true;
+	}
+	queues.input.insert(queues.input.end(), main, main + chainMainSamples);
+	if (stage.needsFarEnd)
+	{
+		// Silence stands in for a missing far end, the queue must stay in step
+		if (aux)
+			queues.aux.insert(queues.aux.end(), aux, aux + chainAuxSamples);
+		else
+			queues.aux.insert(queues.aux.end(), chainAuxSamples, Sample(0));
+	}
+
+	SampleSpan<Sample> mainSpan;
+	mainSpan.frames = frameSize;
+	mainSpan.channels = getMainFormat().channelCount();
+	SampleSpan<const Sample> auxSpan;
+	auxSpan.frames = frameSize;
+	auxSpan.channels = getAuxFormat().channelCount();
+
+	int pieces = 0;
+	for (; int(queues.input.size()) - pieces * mainSamples >= mainSamples; ++pieces)
+	{
+		mainSpan.data = queues.input.data() + pieces * mainSamples;
+		if (stage.needsFarEnd)
+			auxSpan.data = queues.aux.data() + pieces * auxSamples;
+		stage.effect->process(mainSpan, auxSpan);
+	}
+	stage.frames += quint64(pieces);
+
+	const auto processedEnd = queues.input.begin() + pieces * mainSamples;
+	queues.output.insert(queues.output.end(), queues.input.begin(), processedEnd);
+	queues.input.erase(queues.input.begin(), processedEnd);
+	if (stage.needsFarEnd)
+		queues.aux.erase(queues.aux.begin(), queues.aux.begin() + pieces * auxSamples);
+
+	std::copy(queues.output.begin(), queues.output.begin() + chainMainSamples, main);
+	queues.output.erase(queues.output.begin(), queues.output.begin() + chainMainSamples);
+}
+
+} // namespace SpeexWebRTCTest
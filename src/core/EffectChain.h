@@ -0,0 +1,83 @@
+#ifndef _EFFECT_CHAIN_H_
+#define _EFFECT_CHAIN_H_
+
+#include "AudioEffect.h"
+
+#include <QStringList>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace SpeexWebRTCTest {
+
+struct StageCost
+{
+	QString name;
+	quint64 frames = 0; // frames of the stage, not of the chain
+	std::chrono::nanoseconds total{0};
+};
+
+// Runs several effects one after the other on the same frame, e.g. a high-pass filter, the Speex
+// noise suppression, the WebRTC echo canceller and a limiter. Stages share the main and aux
+// formats of the chain and work in place on the chain frame; a stage whose frame size divides the
+// chain frame size processes it piece by piece, the others go through queues which delay their
+// output by one of their frames. Only the stages which need the far end get the aux frame.
+//
+// Parameters named "stage.param" go to the named stage only, other ones to every stage which
+// accepts them.
+class EffectChain final : public AudioEffect
+{
+	Q_OBJECT
+public:
+	EffectChain(const QAudioFormat& mainFormat,
+	            const QAudioFormat& auxFormat,
+	            unsigned int frameSizeMs);
+	~EffectChain() override;
+
+	// Stages of create(): highpass, speex, webrtc, vad and limiter
+	static QStringList stageNames();
+	// Builds a chain of the named stages, framed like its longest stage; the filter and the
+	// limiter take the chain frame size. Throws std::invalid_argument for unknown names and what
+	// the stage constructors throw.
+	static EffectChain* create(const QStringList& stages,
+	                           const QAudioFormat& mainFormat,
+	                           const QAudioFormat& auxFormat);
+
+	// Takes ownership of the effect, which must have the formats of the chain (the aux one only
+	// if it needs the far end). Throws std::invalid_argument otherwise or if the name is taken.
+	void addStage(const QString& name, AudioEffect* effect, bool needsFarEnd);
+
+	void setParameter(const QString& param, QVariant value) override;
+
+	// Thread-safe, for monitoring while the chain runs
+	QVector<StageCost> getStageCosts() const;
+
+private:
+	struct Stage;
+	template <typename Sample>
+	struct Queues;
+
+	unsigned int requiredFrameSizeMs() const override;
+	void processInterleaved(qint16* main, const qint16* aux) override;
+	void processInterleavedFloat(float* main, const float* aux) override;
+	void saveAdaptiveState(QDataStream& out) const override;
+	bool restoreAdaptiveState(QDataStream& in) override;
+	void resetState() override;
+	void applyQualityTier() override;
+
+	template <typename Sample>
+	void run(Sample* main, const Sample* aux);
+	template <typename Sample>
+	void runDirect(Stage& stage, Sample* main, const Sample* aux);
+	template <typename Sample>
+	void runQueued(Stage& stage, Queues<Sample>& queues, Sample* main, const Sample* aux);
+
+	const unsigned int frameSizeMs_;
+	std::vector<std::unique_ptr<Stage>> stages_;
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _EFFECT_CHAIN_H_
@@ -0,0 +1,213 @@
+#include "EffectPool.h"
+
+#include "SpeexDSP.h"
+#include "WebRTCDSP.h"
+
+#include <QLoggingCategory>
+
+namespace SpeexWebRTCTest {
+
+namespace {
+Q_LOGGING_CATEGORY(Pool, "pool")
+} // namespace
+
+EffectPool::EffectPool(int defaultTarget) : defaultTarget_(defaultTarget)
+{
+	worker_ = std::thread([this] { refill(); });
+}
+
+EffectPool::~EffectPool()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		doWork_ = false;
+	}
+	workAvailable_.notify_one();
+	worker_.join();
+
+	for (const Slot& slot : slots_)
+	{
+		qDeleteAll(slot.ready);
+		qDeleteAll(slot.returned);
+	}
+}
+
+void EffectPool::reserve(Backend backend,
+                         const QAudioFormat& mainFormat,
+                         const QAudioFormat& auxFormat,
+                         int count)
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		slotOf(backend, mainFormat, auxFormat).target = count;
+	}
+	workAvailable_.notify_one();
+}
+
+QSharedPointer<AudioEffect> EffectPool::acquire(Backend backend,
+                                                const QAudioFormat& mainFormat,
+                                                const QAudioFormat& auxFormat)
+{
+	AudioEffect* effect = nullptr;
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		Slot& slot = slotOf(backend, mainFormat, auxFormat);
+		if (!slot.ready.empty())
+		{
+			effect = slot.ready.back();
+			slot.ready.pop_back();
+		}
+	}
+	workAvailable_.notify_one();
+
+	if (effect)
+		++hits_;
+	else
+	{
+		++misses_;
+		qDebug(Pool) << "No ready instance, creating one on the setup path";
+		effect = create(backend, mainFormat, auxFormat);
+	}
+
+	const Key key = keyOf(backend, mainFormat, auxFormat);
+	return QSharedPointer<AudioEffect>(effect,
+	                                   [this, key](AudioEffect* effect) { release(key, effect); });
+}
+
+quint64 EffectPool::hits() const
+{
+	return hits_;
+}
+
+quint64 EffectPool::misses() const
+{
+	return misses_;
+}
+
+EffectPool::Key EffectPool::keyOf(Backend backend,
+                                  const QAudioFormat& mainFormat,
+                                  const QAudioFormat& auxFormat)
+{
+	return Key(int(backend), mainFormat.sampleRate(), mainFormat.channelCount(),
+	           int(mainFormat.sampleType()), auxFormat.sampleRate(), auxFormat.channelCount(),
+	           int(auxFormat.sampleType()));
+}
+
+AudioEffect* EffectPool::create(Backend backend,
+                                const QAudioFormat& mainFormat,
+                                const QAudioFormat& auxFormat)
+{
+	if (backend == Backend::Speex)
+		return new SpeexDSP(mainFormat, auxFormat);
+	return new WebRTCDSP(mainFormat, auxFormat);
+}
+
+EffectPool::Slot& EffectPool::slotOf(Backend backend,
+                                     const QAudioFormat& mainFormat,
+                                     const QAudioFormat& auxFormat)
+{
+	const Key key = keyOf(backend, mainFormat, auxFormat);
+	auto it = slots_.find(key);
+	if (it == slots_.end())
+	{
+		Slot slot;
+		slot.backend = backend;
+		slot.mainFormat = mainFormat;
+		slot.auxFormat = auxFormat;
+		slot.target = defaultTarget_;
+		it = slots_.insert(key, slot);
+	}
+	return it.value();
+}
+
+void EffectPool::release(const Key& key, AudioEffect* effect)
+{
+	// The next owner shouldn't get the signals meant for the previous one
+	effect->disconnect();
+
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		slots_[key].returned.push_back(effect);
+	}
+	workAvailable_.notify_one();
+}
+
+bool EffectPool::hasWork() const
+{
+	for (const Slot& slot : slots_)
+	{
+		if (!slot.returned.empty() || int(slot.ready.size()) + slot.creating < slot.target)
+			return true;
+	}
+	return false;
+}
+
+void EffectPool::refill()
+{
+	// One instance at a time, the lock is released while it is created or reset. Slots are never
+	// removed, so a reference stays valid across the unlocked part.
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (true)
+	{
+		workAvailable_.wait(lock, [this] { return !doWork_ || hasWork(); });
+		if (!doWork_)
+			return;
+
+		for (Slot& slot : slots_)
+		{
+			const bool wanted = int(slot.ready.size()) + slot.creating < slot.target;
+
+			// Returned instances are cheaper to bring back than new ones to create
+			if (!slot.returned.empty())
+			{
+				AudioEffect* effect = slot.returned.back();
+				slot.returned.pop_back();
+				if (wanted)
+					++slot.creating;
+
+				lock.unlock();
+				if (wanted)
+					effect->reset();
+				else
+					delete effect;
+				lock.lock();
+
+				if (wanted)
+				{
+					--slot.creating;
+					slot.ready.push_back(effect);
+				}
+				break;
+			}
+
+			if (wanted)
+			{
+				++slot.creating;
+				const Backend backend = slot.backend;
+				const QAudioFormat mainFormat = slot.mainFormat;
+				const QAudioFormat auxFormat = slot.auxFormat;
+
+				lock.unlock();
+				AudioEffect* effect = nullptr;
+				try
+				{
+					effect = create(backend, mainFormat, auxFormat);
+				}
+				catch (const std::exception& e)
+				{
+					qWarning(Pool) << "Unable to create a pooled instance:" << e.what();
+				}
+				lock.lock();
+
+				--slot.creating;
+				if (effect)
+					slot.ready.push_back(effect);
+				else
+					slot.target = 0; // Don't retry a configuration the backend refuses
+				break;
+			}
+		}
+	}
+}
+
+} // namespace SpeexWebRTCTest
@@ -0,0 +1,88 @@
+#ifndef _EFFECT_POOL_H_
+#define _EFFECT_POOL_H_
+
+#include "AudioEffect.h"
+#include "AudioProcessor.h"
+
+#include <QAudioFormat>
+#include <QMap>
+#include <QSharedPointer>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace SpeexWebRTCTest {
+
+// Keeps ready instances of the effects so that streams don't allocate and initialise their
+// backend on the setup path. Every configuration (backend, rate, channels and sample types of
+// both formats, which also fix the frame size) has its own target count; a worker thread creates
+// instances until the target is met and resets the ones given back, so acquire() only takes an
+// instance off a list. The pool must outlive the instances it hands out.
+class EffectPool final
+{
+public:
+	// The default target applies to every configuration once it has been acquired
+	explicit EffectPool(int defaultTarget = 0);
+	~EffectPool();
+
+	// Keeps count instances of the configuration ready, created in the background
+	void reserve(Backend backend,
+	             const QAudioFormat& mainFormat,
+	             const QAudioFormat& auxFormat,
+	             int count);
+
+	// Hands out a ready instance, or creates one on the calling thread when there is none. The
+	// instance goes back to the pool when the last reference is dropped. Throws what the effect
+	// constructor throws.
+	QSharedPointer<AudioEffect> acquire(Backend backend,
+	                                    const QAudioFormat& mainFormat,
+	                                    const QAudioFormat& auxFormat);
+
+	quint64 hits() const;
+	quint64 misses() const;
+
+private:
+	using Key = std::tuple<int, int, int, int, int, int, int>;
+
+	struct Slot
+	{
+		Backend backend;
+		QAudioFormat mainFormat;
+		QAudioFormat auxFormat;
+		int target = 0;
+		int creating = 0;
+		std::vector<AudioEffect*> ready;
+		std::vector<AudioEffect*> returned;
+	};
+
+	static Key keyOf(Backend backend,
+	                 const QAudioFormat& mainFormat,
+	                 const QAudioFormat& auxFormat);
+	static AudioEffect* create(Backend backend,
+	                           const QAudioFormat& mainFormat,
+	                           const QAudioFormat& auxFormat);
+
+	Slot& slotOf(Backend backend, const QAudioFormat& mainFormat, const QAudioFormat& auxFormat);
+	void release(const Key& key, AudioEffect* effect);
+	bool hasWork() const;
+	void refill();
+
+	const int defaultTarget_;
+
+	mutable std::mutex mutex_;
+	std::condition_variable workAvailable_;
+	QMap<Key, Slot> slots_;
+	bool doWork_ = true;
+	std::thread worker_;
+
+	std::atomic<quint64> hits_{0};
+	std::atomic<quint64> misses_{0};
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _EFFECT_POOL_H_
@@ -0,0 +1,104 @@
+#include "HighPassFilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace SpeexWebRTCTest {
+
+namespace {
+const int defaultCutoffHz = 80;
+const double pi = 3.14159265358979323846;
+
+qint16 toSample(float value, qint16)
+{
+	return qint16(std::lround(std::max(-32768.0f, std::min(32767.0f, value))));
+}
+
+float toSample(float value, float)
+{
+	return value;
+}
+} // namespace
+
+HighPassFilter::HighPassFilter(const QAudioFormat& format, unsigned int frameSizeMs)
+    : AudioEffect(format, format), frameSizeMs_(frameSizeMs),
+      state_(2 * format.channelCount(), 0.0f)
+{
+	design(defaultCutoffHz);
+}
+
+void HighPassFilter::setParameter(const QString& param, QVariant value)
+{
+	if (param == "highpass_cutoff_hz")
+	{
+		const int cutoff = value.toInt();
+		if (cutoff <= 0 || cutoff >= getMainFormat().sampleRate() / 2)
+			throw std::invalid_argument("Cutoff frequency out of range");
+		design(cutoff);
+	}
+	else
+		throw std::invalid_argument("Invalid param");
+}
+
+unsigned int HighPassFilter::requiredFrameSizeMs() const
+{
+	return frameSizeMs_;
+}
+
+void HighPassFilter::processInterleaved(qint16* main, const qint16* aux)
+{
+	Q_UNUSED(aux);
+	filter(main, 32768.0f);
+}
+
+void HighPassFilter::processInterleavedFloat(float* main, const float* aux)
+{
+	Q_UNUSED(aux);
+	filter(main, 1.0f);
+}
+
+void HighPassFilter::resetState()
+{
+	std::fill(state_.begin(), state_.end(), 0.0f);
+	design(defaultCutoffHz);
+}
+
+void HighPassFilter::design(int cutoffHz)
+{
+	// Audio EQ cookbook high-pass with Q = 1/sqrt(2)
+	const double w0 = 2 * pi * cutoffHz / getMainFormat().sampleRate();
+	const double alpha = std::sin(w0) / std::sqrt(2.0);
+	const double cosine = std::cos(w0);
+	const double a0 = 1 + alpha;
+	b0_ = float((1 + cosine) / 2 / a0);
+	b1_ = float(-(1 + cosine) / a0);
+	b2_ = b0_;
+	a1_ = float(-2 * cosine / a0);
+	a2_ = float((1 - alpha) / a0);
+}
+
+template <typename Sample>
+void HighPassFilter::filter(Sample* main, float scale)
+{
+	const int channels = getMainFormat().channelCount();
+	const int frames = int(getFrameSize());
+	for (int channel = 0; channel < channels; ++channel)
+	{
+		float s1 = state_[2 * channel];
+		float s2 = state_[2 * channel + 1];
+		for (int i = 0; i < frames; ++i)
+		{
+			Sample& sample = main[i * channels + channel];
+			const float x = float(sample) / scale;
+			const float y = b0_ * x + s1;
+			s1 = b1_ * x - a1_ * y + s2;
+			s2 = b2_ * x - a2_ * y;
+			sample = toSample(y * scale, Sample());
+		}
+		state_[2 * channel] = s1;
+		state_[2 * channel + 1] = s2;
+	}
+}
+
+} // namespace SpeexWebRTCTest
@@ -0,0 +1,40 @@
+#ifndef _HIGH_PASS_FILTER_H_
+#define _HIGH_PASS_FILTER_H_
+
+#include "AudioEffect.h"
+
+#include <vector>
+
+namespace SpeexWebRTCTest {
+
+// Second order Butterworth high-pass removing DC offset and rumble ahead of the other stages of an
+// effect chain. Takes any frame size; the aux frame is ignored.
+class HighPassFilter final : public AudioEffect
+{
+	Q_OBJECT
+public:
+	HighPassFilter(const QAudioFormat& format, unsigned int frameSizeMs);
+
+	void setParameter(const QString& param, QVariant value) override;
+
+private:
+	unsigned int requiredFrameSizeMs() const override;
+	void processInterleaved(qint16* main, const qint16* aux) override;
+	void processInterleavedFloat(float* main, const float* aux) override;
+	void resetState() override;
+
+	void design(int cutoffHz);
+	// Full scale is +/-scale
+	template <typename Sample>
+	void filter(Sample* main, float scale);
+
+	const unsigned int frameSizeMs_;
+
+	float b0_ = 1, b1_ = 0, b2_ = 0, a1_ = 0, a2_ = 0;
+	// Two delay elements per channel (transposed direct form II)
+	std::vector<float> state_;
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _HIGH_PASS_FILTER_H_
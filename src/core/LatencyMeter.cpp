@@ -0,0 +1,236 @@
+#include "LatencyMeter.h"
+
+#include <algorithm>
+
+namespace SpeexWebRTCTest {
+
+namespace {
+
+double toMs(std::chrono::nanoseconds duration)
+{
+	return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+bool isSupported(const QAudioFormat& format)
+{
+	return (format.sampleType() == QAudioFormat::SignedInt && format.sampleSize() == 16) ||
+	       (format.sampleType() == QAudioFormat::Float && format.sampleSize() == 32);
+}
+
+} // namespace
+
+double LatencyReport::total() const
+{
+	return deviceIn + inputQueue + dsp + outputQueue + deviceOut;
+}
+
+void LatencyMeter::Recording::append(const char* data,
+                                     int bytes,
+                                     const QAudioFormat& format,
+                                     TimePoint arrival)
+{
+	const int frames = format.framesForBytes(bytes);
+	const int channels = format.channelCount();
+	const int offset = samples.size();
+	samples.resize(offset + frames);
+
+	if (format.sampleType() == QAudioFormat::Float)
+	{
+		const float* from = reinterpret_cast<const float*>(data);
+		for (int i = 0; i < frames; ++i)
+			samples[offset + i] = from[i * channels];
+	}
+	else
+	{
+		const qint16* from = reinterpret_cast<const qint16*>(data);
+		for (int i = 0; i < frames; ++i)
+			samples[offset + i] = from[i * channels] / 32768.0f;
+	}
+	chunks.emplace_back(samples.size(), arrival);
+}
+
+LatencyMeter::TimePoint LatencyMeter::Recording::arrivalOf(int sample, int sampleRate) const
+{
+	// The last sample of a chunk arrives with it, earlier ones that much sooner
+	const auto chunk =
+	    std::upper_bound(chunks.begin(), chunks.end(), sample,
+	                     [](int sample, const std::pair<int, TimePoint>& chunk)
+	                     { return sample < chunk.first; });
+	if (chunk == chunks.end())
+		return chunks.back().second;
+	return chunk->second - std::chrono::nanoseconds(qint64(chunk->first - 1 - sample) *
+	                                                1000000000 / sampleRate);
+}
+
+LatencyMeter::LatencyMeter(const QAudioFormat& format,
+                           const QAudioFormat& monitorFormat,
+                           std::chrono::milliseconds maxLatency)
+    : format_(format),
+      monitorFormat_(monitorFormat),
+      recordingLength_(probe_.getLength() + format.framesForDuration(maxLatency.count() * 1000))
+{
+}
+
+bool LatencyMeter::start()
+{
+	if (!isSupported(format_))
+		return false;
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (state_ != State::Idle)
+		return false;
+
+	capture_ = Recording();
+	monitor_ = Recording();
+	capture_.samples.reserve(recordingLength_ + format_.sampleRate());
+	monitor_.samples.reserve(recordingLength_ + format_.sampleRate());
+	inputQueue_ = dsp_ = outputQueue_ = std::chrono::nanoseconds(0);
+	frames_ = 0;
+	probePosition_ = 0;
+	state_ = State::Starting;
+	active_ = true;
+	return true;
+}
+
+void LatencyMeter::reset()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (state_ == State::Recorded)
+		return;
+	state_ = State::Idle;
+	active_ = false;
+}
+
+bool LatencyMeter::isActive() const
+{
+	return active_;
+}
+
+bool LatencyMeter::fillOutput(char* data, int bytes)
+{
+	if (!active_)
+		return false;
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (state_ == State::Starting)
+	{
+		// Arrivals are measured from the moment the probe is handed to the device
+		probeStart_ = std::chrono::steady_clock::now();
+		state_ = State::Playing;
+	}
+	else if (state_ != State::Playing)
+		return false;
+
+	const int frames = format_.framesForBytes(bytes);
+	const int channels = format_.channelCount();
+	const QVector<float>& sequence = probe_.getSequence();
+	for (int i = 0; i < frames; ++i, ++probePosition_)
+	{
+		const float sample = probePosition_ < sequence.size() ? sequence.at(probePosition_) : 0;
+		for (int channel = 0; channel < channels; ++channel)
+		{
+			if (format_.sampleType() == QAudioFormat::Float)
+				reinterpret_cast<float*>(data)[i * channels + channel] = sample;
+			else
+				reinterpret_cast<qint16*>(data)[i * channels + channel] = qint16(sample * 32767);
+		}
+	}
+	return true;
+}
+
+bool LatencyMeter::recordCapture(const char* data, int bytes)
+{
+	if (!active_)
+		return false;
+
+	const TimePoint arrival = std::chrono::steady_clock::now();
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (state_ != State::Playing)
+		return false;
+
+	capture_.append(data, bytes, format_, arrival);
+	if (capture_.samples.size() < recordingLength_)
+		return false;
+
+	state_ = State::Recorded;
+	return true;
+}
+
+void LatencyMeter::recordMonitor(const char* data, int bytes)
+{
+	if (!active_ || !isSupported(monitorFormat_))
+		return;
+
+	const TimePoint arrival = std::chrono::steady_clock::now();
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (state_ == State::Playing && monitor_.samples.size() < recordingLength_)
+		monitor_.append(data, bytes, monitorFormat_, arrival);
+}
+
+void LatencyMeter::addFrame(std::chrono::nanoseconds inputQueue,
+                            std::chrono::nanoseconds dsp,
+                            std::chrono::nanoseconds outputQueue)
+{
+	if (!active_)
+		return;
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (state_ != State::Playing)
+		return;
+
+	inputQueue_ += inputQueue;
+	dsp_ += dsp;
+	outputQueue_ += outputQueue;
+	++frames_;
+}
+
+double LatencyMeter::roundTripOf(const Recording& recording,
+                                 int sampleRate,
+                                 double* confidence) const
+{
+	const int offset = probe_.detect(recording.samples, confidence);
+	if (offset < 0)
+		return -1;
+	return toMs(recording.arrivalOf(offset, sampleRate) - probeStart_);
+}
+
+LatencyReport LatencyMeter::analyse(int inputBufferBytes, int outputBufferBytes)
+{
+	// The recordings are complete, the device threads don't touch them anymore
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (state_ != State::Recorded)
+			return LatencyReport();
+	}
+
+	LatencyReport report;
+	report.roundTrip = roundTripOf(capture_, format_.sampleRate(), &report.confidence);
+	double monitorConfidence = 0;
+	if (!monitor_.samples.isEmpty())
+		report.monitorRoundTrip =
+		    roundTripOf(monitor_, monitorFormat_.sampleRate(), &monitorConfidence);
+
+	report.valid = report.roundTrip >= 0;
+	if (report.valid)
+	{
+		const int bufferBytes = inputBufferBytes + outputBufferBytes;
+		const double inputShare = bufferBytes > 0 ? double(inputBufferBytes) / bufferBytes : 0.5;
+		report.deviceIn = report.roundTrip * inputShare;
+		report.deviceOut = report.roundTrip - report.deviceIn;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (frames_ > 0)
+		{
+			report.inputQueue = toMs(inputQueue_) / frames_;
+			report.dsp = toMs(dsp_) / frames_;
+			report.outputQueue = toMs(outputQueue_) / frames_;
+		}
+		state_ = State::Idle;
+		active_ = false;
+	}
+	return report;
+}
+
+} // namespace SpeexWebRTCTest
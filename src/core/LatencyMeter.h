@@ -0,0 +1,118 @@
+#ifndef _LATENCY_METER_H_
+#define _LATENCY_METER_H_
+
+#include "LatencyProbe.h"
+
+#include <QAudioFormat>
+#include <QMetaType>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace SpeexWebRTCTest {
+
+// Capture to playout latency of the processing tract, in milliseconds
+struct LatencyReport
+{
+	bool valid = false;
+	// Probe handed to the output device until it arrives in the capture stream, over the
+	// acoustic path; and the same for the monitor stream, -1 when the probe wasn't found there
+	double roundTrip = 0;
+	double monitorRoundTrip = -1;
+	double confidence = 0;
+
+	// The device stages split the round trip in proportion to the device buffer sizes, the others
+	// are averaged over the frames processed while the probe was out
+	double deviceIn = 0;
+	double inputQueue = 0;
+	double dsp = 0;
+	double outputQueue = 0;
+	double deviceOut = 0;
+
+	double total() const;
+};
+
+// One latency measurement at a time: plays a LatencyProbe into the output stream, records the
+// capture and monitor streams until the probe had time to come back, then finds it in both.
+// The output is muted after the probe so that it isn't captured a second time through the
+// processed loopback. Thread-safe, each stream may be fed from its own thread.
+class LatencyMeter final
+{
+public:
+	LatencyMeter(const QAudioFormat& format,
+	             const QAudioFormat& monitorFormat,
+	             std::chrono::milliseconds maxLatency = std::chrono::milliseconds(1000));
+
+	// Returns false if a measurement is already running
+	bool start();
+	// Abandons a measurement which is still recording, one being analysed finishes on its own
+	void reset();
+	bool isActive() const;
+
+	// Overwrites an outgoing chunk in the output format with the probe, then silence. Returns
+	// false, leaving the chunk alone, when no measurement is playing.
+	bool fillOutput(char* data, int bytes);
+	// Returns true for the chunk which completes the recording, after which analyse() is due
+	bool recordCapture(const char* data, int bytes);
+	void recordMonitor(const char* data, int bytes);
+	// Stages of one processed frame; dsp includes the framing delay
+	void addFrame(std::chrono::nanoseconds inputQueue,
+	              std::chrono::nanoseconds dsp,
+	              std::chrono::nanoseconds outputQueue);
+
+	// Correlates the recordings and ends the measurement. Takes a while for long recordings, so
+	// it shouldn't run on a device thread.
+	LatencyReport analyse(int inputBufferBytes, int outputBufferBytes);
+
+private:
+	enum class State
+	{
+		Idle,
+		Starting,
+		Playing,
+		Recorded
+	};
+
+	using TimePoint = std::chrono::steady_clock::time_point;
+
+	// Mono recording of the first channel, with the arrival time of every chunk after its last
+	// sample
+	struct Recording
+	{
+		QVector<float> samples;
+		std::vector<std::pair<int, TimePoint>> chunks;
+
+		void append(const char* data, int bytes, const QAudioFormat& format, TimePoint arrival);
+		TimePoint arrivalOf(int sample, int sampleRate) const;
+	};
+
+	double roundTripOf(const Recording& recording, int sampleRate, double* confidence) const;
+
+	const QAudioFormat format_;
+	const QAudioFormat monitorFormat_;
+	const LatencyProbe probe_;
+	const int recordingLength_;
+
+	mutable std::mutex mutex_;
+	std::atomic<bool> active_{false};
+	State state_ = State::Idle;
+	TimePoint probeStart_;
+	int probePosition_ = 0;
+
+	Recording capture_;
+	Recording monitor_;
+
+	std::chrono::nanoseconds inputQueue_{0};
+	std::chrono::nanoseconds dsp_{0};
+	std::chrono::nanoseconds outputQueue_{0};
+	int frames_ = 0;
+};
+
+} // namespace SpeexWebRTCTest
+
+Q_DECLARE_METATYPE(SpeexWebRTCTest::LatencyReport)
+
+#endif // _LATENCY_METER_H_
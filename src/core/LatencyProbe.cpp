@@ -0,0 +1,132 @@
+#include "LatencyProbe.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <stdexcept>
+#include <vector>
+
+namespace SpeexWebRTCTest {
+
+namespace {
+
+using Complex = std::complex<double>;
+
+// Feedback masks of maximal length Galois LFSRs, by order
+const quint32 lfsrMasks[] = {0x240, 0x500, 0x829, 0x100D, 0x2015, 0x6000, 0xD008};
+const int minimumOrder = 10;
+const int maximumOrder = 16;
+
+// In-place iterative radix-2 transform, size must be a power of two
+void fft(std::vector<Complex>& data, bool inverse)
+{
+	const std::size_t size = data.size();
+	for (std::size_t i = 1, j = 0; i < size; ++i)
+	{
+		std::size_t bit = size >> 1;
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j)
+			std::swap(data[i], data[j]);
+	}
+
+	for (std::size_t length = 2; length <= size; length <<= 1)
+	{
+		const double angle = 2 * M_PI / length * (inverse ? 1 : -1);
+		const Complex step(std::cos(angle), std::sin(angle));
+		for (std::size_t start = 0; start < size; start += length)
+		{
+			Complex twiddle(1);
+			for (std::size_t k = 0; k < length / 2; ++k)
+			{
+				const Complex even = data[start + k];
+				const Complex odd = data[start + k + length / 2] * twiddle;
+				data[start + k] = even + odd;
+				data[start + k + length / 2] = even - odd;
+				twiddle *= step;
+			}
+		}
+	}
+}
+
+} // namespace
+
+constexpr double LatencyProbe::minimumConfidence;
+
+LatencyProbe::LatencyProbe(int order, float amplitude)
+{
+	if (order < minimumOrder || order > maximumOrder)
+		throw std::invalid_argument("Unsupported maximum length sequence order");
+
+	const quint32 mask = lfsrMasks[order - minimumOrder];
+	const int length = (1 << order) - 1;
+	sequence_.resize(length);
+
+	quint32 state = 1;
+	for (int i = 0; i < length; ++i)
+	{
+		sequence_[i] = (state & 1) ? amplitude : -amplitude;
+		state = (state & 1) ? (state >> 1) ^ mask : state >> 1;
+	}
+}
+
+const QVector<float>& LatencyProbe::getSequence() const
+{
+	return sequence_;
+}
+
+int LatencyProbe::getLength() const
+{
+	return sequence_.size();
+}
+
+int LatencyProbe::detect(const QVector<float>& recording, double* confidence) const
+{
+	if (confidence)
+		*confidence = 0;
+	if (recording.size() < sequence_.size())
+		return -1;
+
+	// Linear correlation needs room for both signals
+	std::size_t size = 1;
+	while (size < std::size_t(recording.size() + sequence_.size()))
+		size <<= 1;
+
+	std::vector<Complex> recorded(size);
+	std::vector<Complex> probe(size);
+	for (int i = 0; i < recording.size(); ++i)
+		recorded[i] = recording.at(i);
+	for (int i = 0; i < sequence_.size(); ++i)
+		probe[i] = sequence_.at(i);
+
+	fft(recorded, false);
+	fft(probe, false);
+	for (std::size_t i = 0; i < size; ++i)
+		recorded[i] *= std::conj(probe[i]);
+	fft(recorded, true);
+
+	// Only offsets at which the whole sequence fits in the recording
+	const int offsets = recording.size() - sequence_.size() + 1;
+	int peak = 0;
+	double peakValue = 0;
+	double energy = 0;
+	for (int i = 0; i < offsets; ++i)
+	{
+		const double value = std::abs(recorded[i].real());
+		energy += value * value;
+		if (value > peakValue)
+		{
+			peak = i;
+			peakValue = value;
+		}
+	}
+
+	const double rms = std::sqrt((energy - peakValue * peakValue) / std::max(offsets - 1, 1));
+	const double ratio = rms > 0 ? peakValue / rms : 0;
+	if (confidence)
+		*confidence = ratio;
+	return ratio >= minimumConfidence ? peak : -1;
+}
+
+} // namespace SpeexWebRTCTest
@@ -0,0 +1,34 @@
+#ifndef _LATENCY_PROBE_H_
+#define _LATENCY_PROBE_H_
+
+#include <QVector>
+
+namespace SpeexWebRTCTest {
+
+// Maximum length sequence for latency measurements. The sequence is played from a known point of
+// the output stream and found again in a recording by FFT cross-correlation; its flat spectrum
+// and single autocorrelation peak keep the match sharp over a reverberant acoustic path.
+class LatencyProbe final
+{
+public:
+	// The sequence is 2^order - 1 samples long, order 10 to 16. Throws std::invalid_argument for
+	// other orders.
+	explicit LatencyProbe(int order = 14, float amplitude = 0.25f);
+
+	// Samples of +/-amplitude
+	const QVector<float>& getSequence() const;
+	int getLength() const;
+
+	// Offset of the sequence in the recording, or -1 when the correlation peak doesn't stand out
+	// from the rest by minimumConfidence (peak to RMS ratio of the cross-correlation)
+	int detect(const QVector<float>& recording, double* confidence = nullptr) const;
+
+	static constexpr double minimumConfidence = 8;
+
+private:
+	QVector<float> sequence_;
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _LATENCY_PROBE_H_
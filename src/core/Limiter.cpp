@@ -0,0 +1,99 @@
+#include "Limiter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace SpeexWebRTCTest {
+
+namespace {
+const int defaultThresholdDb = -1;
+const int defaultReleaseMs = 50;
+} // namespace
+
+Limiter::Limiter(const QAudioFormat& format, unsigned int frameSizeMs)
+    : AudioEffect(format, format), frameSizeMs_(frameSizeMs)
+{
+	resetState();
+}
+
+void Limiter::setParameter(const QString& param, QVariant value)
+{
+	if (param == "limiter_threshold_db")
+		threshold_ = std::pow(10.0f, std::min(value.toInt(), 0) / 20.0f);
+	else if (param == "limiter_release_ms")
+		setRelease(value.toInt());
+	else
+		throw std::invalid_argument("Invalid param");
+}
+
+unsigned int Limiter::requiredFrameSizeMs() const
+{
+	return frameSizeMs_;
+}
+
+void Limiter::processInterleaved(qint16* main, const qint16* aux)
+{
+	Q_UNUSED(aux);
+	limit(main, 32768.0f);
+}
+
+void Limiter::processInterleavedFloat(float* main, const float* aux)
+{
+	Q_UNUSED(aux);
+	limit(main, 1.0f);
+}
+
+void Limiter::saveAdaptiveState(QDataStream& out) const
+{
+	out << gain_;
+}
+
+bool Limiter::restoreAdaptiveState(QDataStream& in)
+{
+	float gain = 1;
+	in >> gain;
+	if (in.status() != QDataStream::Ok)
+		return false;
+	gain_ = gain;
+	return true;
+}
+
+void Limiter::resetState()
+{
+	threshold_ = std::pow(10.0f, defaultThresholdDb / 20.0f);
+	setRelease(defaultReleaseMs);
+	gain_ = 1;
+}
+
+void Limiter::setRelease(int releaseMs)
+{
+	// Per-sample coefficient of the recovery towards unity gain
+	const float samples = std::max(releaseMs, 1) * getMainFormat().sampleRate() / 1000.0f;
+	release_ = std::exp(-1.0f / samples);
+}
+
+template <typename Sample>
+void Limiter::limit(Sample* main, float scale)
+{
+	const int channels = getMainFormat().channelCount();
+	const int frames = int(getFrameSize());
+	const float threshold = threshold_ * scale;
+	for (int i = 0; i < frames; ++i)
+	{
+		Sample* frame = main + i * channels;
+		float peak = 0;
+		for (int channel = 0; channel < channels; ++channel)
+			peak = std::max(peak, std::abs(float(frame[channel])));
+
+		const float target = peak > threshold ? threshold / peak : 1.0f;
+		gain_ = target < gain_ ? target : target + (gain_ - target) * release_;
+		if (gain_ < 1.0f)
+		{
+			for (int channel = 0; channel < channels; ++channel)
+				frame[channel] = Sample(frame[channel] * gain_);
+		}
+	}
+}
+
+} // namespace SpeexWebRTCTest
@@ -0,0 +1,41 @@
+#ifndef _LIMITER_H_
+#define _LIMITER_H_
+
+#include "AudioEffect.h"
+
+namespace SpeexWebRTCTest {
+
+// Peak limiter for the end of an effect chain, after the gain control: the gain drops at once to
+// keep every sample under the threshold and recovers exponentially. All the channels share the
+// gain. Takes any frame size; the aux frame is ignored.
+class Limiter final : public AudioEffect
+{
+	Q_OBJECT
+public:
+	Limiter(const QAudioFormat& format, unsigned int frameSizeMs);
+
+	void setParameter(const QString& param, QVariant value) override;
+
+private:
+	unsigned int requiredFrameSizeMs() const override;
+	void processInterleaved(qint16* main, const qint16* aux) override;
+	void processInterleavedFloat(float* main, const float* aux) override;
+	void saveAdaptiveState(QDataStream& out) const override;
+	bool restoreAdaptiveState(QDataStream& in) override;
+	void resetState() override;
+
+	void setRelease(int releaseMs);
+	// Full scale is +/-scale
+	template <typename Sample>
+	void limit(Sample* main, float scale);
+
+	const unsigned int frameSizeMs_;
+
+	float threshold_ = 1;
+	float release_ = 0;
+	float gain_ = 1;
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _LIMITER_H_
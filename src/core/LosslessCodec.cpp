@@ -0,0 +1,670 @@
+#include "LosslessCodec.h"
+
+#include <QtEndian>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace SpeexWebRTCTest {
+
+namespace {
+
+// Block payload header: frame count (quint32) and flags (quint8)
+const int blockHeaderSize = 5;
+// Decoders refuse longer blocks, a corrupt frame count would allocate gigabytes otherwise
+const quint32 maxBlockFrames = 1 << 20;
+
+// LPC orders tried by the encoder, and the bits of a quantised coefficient
+const int lpcOrders[] = {2, 4, 8, 12};
+const int maxLpcOrder = 12;
+const int lpcPrecision = 14;
+const int maxFixedOrder = 4;
+const int maxPartitionOrder = 6;
+// Partitions are not split below this many residuals, their parameter wouldn't pay off
+const int minPartitionSize = 32;
+const int maxRiceParameter = 30;
+// Predictions whose residual grows beyond this are not coded, the subframe falls back to verbatim
+const qint64 maxResidual = (qint64(1) << 30) - 1;
+
+enum SubframeType : quint32
+{
+	SubframeConstant,
+	SubframeVerbatim,
+	SubframeFixed,
+	SubframeLpc
+};
+
+quint32 mask(int bits)
+{
+	return bits >= 32 ? 0xffffffffu : (1u << bits) - 1;
+}
+
+quint32 zigzag(qint32 value)
+{
+	return (quint32(value) << 1) ^ quint32(value >> 31);
+}
+
+qint32 unzigzag(quint32 value)
+{
+	return qint32(value >> 1) ^ -qint32(value & 1);
+}
+
+class BitWriter
+{
+public:
+	void write(quint32 value, int bits)
+	{
+		if (bits == 0)
+			return;
+		accumulator_ = (accumulator_ << bits) | (value & mask(bits));
+		count_ += bits;
+		while (count_ >= 8)
+		{
+			count_ -= 8;
+			bytes_.append(char(accumulator_ >> count_));
+		}
+	}
+
+	void writeSigned(qint32 value, int bits) { write(quint32(value), bits); }
+
+	void writeRice(quint32 value, int parameter)
+	{
+		// Unary quotient (zeros terminated by a one), then the low bits
+		quint32 quotient = value >> parameter;
+		for (; quotient >= 31; quotient -= 31)
+			write(0, 31);
+		write(1, quotient + 1);
+		write(value, parameter);
+	}
+
+	// Pads the last byte with zeros
+	QByteArray& finish()
+	{
+		if (count_ > 0)
+			write(0, 8 - count_);
+		return bytes_;
+	}
+
+private:
+	QByteArray bytes_;
+	quint64 accumulator_ = 0;
+	int count_ = 0;
+};
+
+class BitReader
+{
+public:
+	BitReader(const char* data, int size)
+	    : data_(reinterpret_cast<const uchar*>(data)), size_(size)
+	{
+	}
+
+	// Reading past the end returns zeros and sets failed()
+	quint32 read(int bits)
+	{
+		if (bits == 0)
+			return 0;
+		while (count_ < bits)
+		{
+			if (position_ >= size_)
+			{
+				failed_ = true;
+				return 0;
+			}
+			accumulator_ = (accumulator_ << 8) | data_[position_++];
+			count_ += 8;
+		}
+		count_ -= bits;
+		return quint32(accumulator_ >> count_) & mask(bits);
+	}
+
+	qint32 readSigned(int bits)
+	{
+		const quint32 value = read(bits);
+		if (bits == 0 || bits >= 32)
+			return qint32(value);
+		return qint32(value << (32 - bits)) >> (32 - bits);
+	}
+
+	quint32 readRice(int parameter)
+	{
+		const quint32 maxQuotient = 0xffffffffu >> parameter;
+		quint32 quotient = 0;
+		while (read(1) == 0)
+		{
+			if (failed_ || quotient++ == maxQuotient)
+			{
+				failed_ = true;
+				return 0;
+			}
+		}
+		return (quotient << parameter) | read(parameter);
+	}
+
+	bool failed() const { return failed_; }
+
+private:
+	const uchar* data_;
+	int size_;
+	int position_ = 0;
+	quint64 accumulator_ = 0;
+	int count_ = 0;
+	bool failed_ = false;
+};
+
+qint32 readSample(const uchar* data, int sampleSize)
+{
+	quint32 packed;
+	switch (sampleSize)
+	{
+	case 8:
+		return qint32(data[0]) - 128;
+	case 16:
+		return qFromLittleEndian<qint16>(data);
+	case 24:
+		// Packed into the top bytes, the arithmetic shift extends the sign
+		packed = quint32(data[0]) << 8 | quint32(data[1]) << 16 | quint32(data[2]) << 24;
+		return qint32(packed) >> 8;
+	default:
+		// 32-bit integer or the bit pattern of a float
+		return qFromLittleEndian<qint32>(data);
+	}
+}
+
+void writeSample(uchar* data, int sampleSize, qint32 sample)
+{
+	switch (sampleSize)
+	{
+	case 8:
+		data[0] = uchar(sample + 128);
+		break;
+	case 16:
+		qToLittleEndian<qint16>(qint16(sample), data);
+		break;
+	case 24:
+		data[0] = uchar(sample);
+		data[1] = uchar(sample >> 8);
+		data[2] = uchar(sample >> 16);
+		break;
+	default:
+		qToLittleEndian<qint32>(sample, data);
+		break;
+	}
+}
+
+// Rice coding of a residual: 2^order partitions of about the same length. The boundaries of a
+// partition are those of two partitions of the next order, so their sums merge pairwise.
+struct RicePlan
+{
+	int order = 0;
+	std::vector<int> parameters;
+	quint64 bits = ~quint64(0);
+};
+
+int partitionBegin(int count, int order, int partition)
+{
+	return int(qint64(count) * partition >> order);
+}
+
+int partitionEnd(int count, int order, int partition)
+{
+	return partitionBegin(count, order, partition + 1);
+}
+
+// Cost estimate of a partition: the low bits, the terminating ones and about sum / 2^k zeros
+int bestParameter(quint64 sum, int count, quint64& bits)
+{
+	int best = 0;
+	bits = ~quint64(0);
+	for (int parameter = 0; parameter <= maxRiceParameter; ++parameter)
+	{
+		const quint64 cost = quint64(count) * (parameter + 1) + (sum >> parameter);
+		if (cost < bits)
+		{
+			bits = cost;
+			best = parameter;
+		}
+		else
+			break;
+	}
+	return best;
+}
+
+RicePlan planRice(const std::vector<quint32>& residual)
+{
+	const int count = int(residual.size());
+	int maxOrder = 0;
+	while (maxOrder < maxPartitionOrder && (count >> (maxOrder + 1)) >= minPartitionSize)
+		++maxOrder;
+
+	std::vector<quint64> sums(std::size_t(1) << maxOrder, 0);
+	for (int partition = 0; partition < (1 << maxOrder); ++partition)
+	{
+		const int end = partitionEnd(count, maxOrder, partition);
+		for (int i = partitionBegin(count, maxOrder, partition); i < end; ++i)
+			sums[partition] += residual[i];
+	}
+
+	RicePlan best;
+	for (int order = maxOrder; order >= 0; --order)
+	{
+		RicePlan plan;
+		plan.order = order;
+		plan.bits = 3;
+		for (int partition = 0; partition < (1 << order); ++partition)
+		{
+			const int size = partitionEnd(count, order, partition) -
+			                 partitionBegin(count, order, partition);
+			quint64 bits;
+			plan.parameters.push_back(bestParameter(sums[partition], size, bits));
+			plan.bits += 5 + bits;
+		}
+		if (plan.bits < best.bits)
+			best = std::move(plan);
+
+		for (int partition = 0; partition < (1 << order) / 2; ++partition)
+			sums[partition] = sums[2 * partition] + sums[2 * partition + 1];
+	}
+	return best;
+}
+
+void writeResidual(BitWriter& writer, const std::vector<quint32>& residual, const RicePlan& plan)
+{
+	const int count = int(residual.size());
+	writer.write(quint32(plan.order), 3);
+	for (int partition = 0; partition < (1 << plan.order); ++partition)
+	{
+		const int parameter = plan.parameters[partition];
+		writer.write(quint32(parameter), 5);
+		const int end = partitionEnd(count, plan.order, partition);
+		for (int i = partitionBegin(count, plan.order, partition); i < end; ++i)
+			writer.writeRice(residual[i], parameter);
+	}
+}
+
+bool readResidual(BitReader& reader, qint32* residual, int count)
+{
+	const int order = int(reader.read(3));
+	if (order > maxPartitionOrder)
+		return false;
+	for (int partition = 0; partition < (1 << order); ++partition)
+	{
+		const int parameter = int(reader.read(5));
+		if (parameter > maxRiceParameter)
+			return false;
+		const int end = partitionEnd(count, order, partition);
+		for (int i = partitionBegin(count, order, partition); i < end; ++i)
+			residual[i] = unzigzag(reader.readRice(parameter));
+		if (reader.failed())
+			return false;
+	}
+	return true;
+}
+
+// Prediction of the fixed polynomial predictors (those of FLAC)
+qint64 fixedPrediction(const qint32* x, int i, int order)
+{
+	switch (order)
+	{
+	case 0:
+		return 0;
+	case 1:
+		return x[i - 1];
+	case 2:
+		return 2 * qint64(x[i - 1]) - x[i - 2];
+	case 3:
+		return 3 * (qint64(x[i - 1]) - x[i - 2]) + x[i - 3];
+	default:
+		return 4 * (qint64(x[i - 1]) + x[i - 3]) - 6 * qint64(x[i - 2]) - x[i - 4];
+	}
+}
+
+qint64 lpcPrediction(const qint32* x, int i, const std::vector<qint32>& coefficients, int shift)
+{
+	qint64 sum = 0;
+	for (std::size_t j = 0; j < coefficients.size(); ++j)
+		sum += qint64(coefficients[j]) * x[i - 1 - int(j)];
+	return sum >> shift;
+}
+
+// Encoding of one channel of a block
+struct Subframe
+{
+	SubframeType type = SubframeVerbatim;
+	int order = 0;
+	int shift = 0;
+	std::vector<qint32> coefficients;
+	std::vector<quint32> residual;
+	RicePlan plan;
+	quint64 bits = ~quint64(0);
+};
+
+// Fills the residual, returns false if it doesn't fit the coding
+template <typename Predict>
+bool computeResidual(const qint32* x, int n, int order, std::vector<quint32>& residual,
+                     Predict predict)
+{
+	residual.resize(n - order);
+	for (int i = order; i < n; ++i)
+	{
+		const qint64 value = x[i] - predict(i);
+		if (value > maxResidual || value < -maxResidual)
+			return false;
+		residual[i - order] = zigzag(qint32(value));
+	}
+	return true;
+}
+
+void tryFixed(const qint32* x, int n, int bits, Subframe& best)
+{
+	if (n <= maxFixedOrder)
+		return;
+
+	// Picks the order with the smallest sum of absolute residuals
+	quint64 sums[maxFixedOrder + 1] = {};
+	for (int i = maxFixedOrder; i < n; ++i)
+	{
+		for (int order = 0; order <= maxFixedOrder; ++order)
+		{
+			const qint64 value = x[i] - fixedPrediction(x, i, order);
+			sums[order] += quint64(value < 0 ? -value : value);
+		}
+	}
+	const int order = int(std::min_element(sums, sums + maxFixedOrder + 1) - sums);
+
+	Subframe candidate;
+	candidate.type = SubframeFixed;
+	candidate.order = order;
+	if (!computeResidual(x, n, order, candidate.residual,
+	                     [&](int i) { return fixedPrediction(x, i, order); }))
+		return;
+
+	candidate.plan = planRice(candidate.residual);
+	candidate.bits = 2 + 3 + quint64(order) * bits + candidate.plan.bits;
+	if (candidate.bits < best.bits)
+		best = std::move(candidate);
+}
+
+// Predictor coefficients of every order up to maxOrder (Levinson-Durbin recursion)
+std::vector<std::vector<double>> computeLpc(const double* autocorrelation, int maxOrder)
+{
+	std::vector<std::vector<double>> predictors;
+	std::vector<double> lpc(maxOrder, 0.0);
+	double error = autocorrelation[0];
+	for (int i = 0; i < maxOrder; ++i)
+	{
+		double reflection = -autocorrelation[i + 1];
+		for (int j = 0; j < i; ++j)
+			reflection -= lpc[j] * autocorrelation[i - j];
+		reflection /= error;
+
+		lpc[i] = reflection;
+		int j = 0;
+		for (; j < i / 2; ++j)
+		{
+			const double tmp = lpc[j];
+			lpc[j] += reflection * lpc[i - 1 - j];
+			lpc[i - 1 - j] += reflection * tmp;
+		}
+		if (i & 1)
+			lpc[j] += lpc[j] * reflection;
+		error *= 1.0 - reflection * reflection;
+
+		std::vector<double> predictor(i + 1);
+		for (int k = 0; k <= i; ++k)
+			predictor[k] = -lpc[k];
+		predictors.push_back(predictor);
+		if (error <= 0)
+			break;
+	}
+	return predictors;
+}
+
+// Quantises the coefficients to lpcPrecision bits, carrying the rounding error over
+int quantiseLpc(const std::vector<double>& predictor, std::vector<qint32>& coefficients)
+{
+	double peak = 0;
+	for (double coefficient : predictor)
+		peak = std::max(peak, std::abs(coefficient));
+	if (peak <= 0)
+		return -1;
+
+	int exponent;
+	std::frexp(peak, &exponent);
+	const int shift = std::min(15, std::max(0, lpcPrecision - 1 - exponent));
+	const qint32 limit = (1 << (lpcPrecision - 1)) - 1;
+
+	coefficients.resize(predictor.size());
+	double error = 0;
+	for (std::size_t i = 0; i < predictor.size(); ++i)
+	{
+		error += predictor[i] * (1 << shift);
+		const qint32 quantised = qint32(std::lround(error));
+		coefficients[i] = std::max(-limit - 1, std::min(limit, quantised));
+		error -= coefficients[i];
+	}
+	return shift;
+}
+
+void tryLpc(const qint32* x, int n, int bits, Subframe& best)
+{
+	if (n <= 2 * maxLpcOrder)
+		return;
+
+	// Autocorrelation of the signal under a Welch window
+	std::vector<double> windowed(n);
+	for (int i = 0; i < n; ++i)
+	{
+		const double t = (2.0 * i - (n - 1)) / (n + 1);
+		windowed[i] = x[i] * (1 - t * t);
+	}
+	double autocorrelation[maxLpcOrder + 1];
+	for (int lag = 0; lag <= maxLpcOrder; ++lag)
+	{
+		double sum = 0;
+		for (int i = lag; i < n; ++i)
+			sum += windowed[i] * windowed[i - lag];
+		autocorrelation[lag] = sum;
+	}
+	if (autocorrelation[0] <= 0)
+		return;
+
+	const std::vector<std::vector<double>> predictors = computeLpc(autocorrelation, maxLpcOrder);
+	for (int order : lpcOrders)
+	{
+		if (order > int(predictors.size()))
+			break;
+
+		Subframe candidate;
+		candidate.type = SubframeLpc;
+		candidate.order = order;
+		candidate.shift = quantiseLpc(predictors[order - 1], candidate.coefficients);
+		if (candidate.shift < 0)
+			continue;
+		if (!computeResidual(x, n, order, candidate.residual, [&](int i) {
+			    return lpcPrediction(x, i, candidate.coefficients, candidate.shift);
+		    }))
+			continue;
+
+		candidate.plan = planRice(candidate.residual);
+		candidate.bits =
+		    2 + 5 + 4 + 5 + quint64(order) * (lpcPrecision + bits) + candidate.plan.bits;
+		if (candidate.bits < best.bits)
+			best = std::move(candidate);
+	}
+}
+
+void encodeChannel(BitWriter& writer, const qint32* x, int n, int bits)
+{
+	if (std::all_of(x, x + n, [x](qint32 sample) { return sample == x[0]; }))
+	{
+		writer.write(SubframeConstant, 2);
+		writer.writeSigned(x[0], bits);
+		return;
+	}
+
+	Subframe best;
+	best.bits = 2 + quint64(n) * bits;
+	if (bits <= 24)
+	{
+		tryFixed(x, n, bits, best);
+		tryLpc(x, n, bits, best);
+	}
+
+	writer.write(best.type, 2);
+	switch (best.type)
+	{
+	case SubframeFixed:
+		writer.write(quint32(best.order), 3);
+		break;
+	case SubframeLpc:
+		writer.write(quint32(best.order - 1), 5);
+		writer.write(lpcPrecision - 1, 4);
+		writer.write(quint32(best.shift), 5);
+		for (qint32 coefficient : best.coefficients)
+			writer.writeSigned(coefficient, lpcPrecision);
+		break;
+	default:
+		for (int i = 0; i < n; ++i)
+			writer.writeSigned(x[i], bits);
+		return;
+	}
+
+	for (int i = 0; i < best.order; ++i)
+		writer.writeSigned(x[i], bits);
+	writeResidual(writer, best.residual, best.plan);
+}
+
+bool decodeChannel(BitReader& reader, qint32* x, int n, int bits)
+{
+	const SubframeType type = static_cast<SubframeType>(reader.read(2));
+	if (type == SubframeConstant)
+	{
+		std::fill(x, x + n, reader.readSigned(bits));
+		return !reader.failed();
+	}
+	if (type == SubframeVerbatim)
+	{
+		for (int i = 0; i < n; ++i)
+			x[i] = reader.readSigned(bits);
+		return !reader.failed();
+	}
+
+	int order;
+	int shift = 0;
+	std::vector<qint32> coefficients;
+	if (type == SubframeFixed)
+	{
+		order = int(reader.read(3));
+		if (order > maxFixedOrder)
+			return false;
+	}
+	else
+	{
+		order = int(reader.read(5)) + 1;
+		const int precision = int(reader.read(4)) + 1;
+		shift = int(reader.read(5));
+		coefficients.resize(order);
+		for (qint32& coefficient : coefficients)
+			coefficient = reader.readSigned(precision);
+	}
+	if (order > n)
+		return false;
+
+	for (int i = 0; i < order; ++i)
+		x[i] = reader.readSigned(bits);
+	if (!readResidual(reader, x + order, n - order))
+		return false;
+
+	for (int i = order; i < n; ++i)
+	{
+		const qint64 prediction = type == SubframeFixed ? fixedPrediction(x, i, order)
+		                                                : lpcPrediction(x, i, coefficients, shift);
+		x[i] = qint32(x[i] + prediction);
+	}
+	return true;
+}
+
+QByteArray blockHeader(int frames, quint8 flags)
+{
+	QByteArray header(blockHeaderSize, Qt::Uninitialized);
+	qToLittleEndian<quint32>(quint32(frames), reinterpret_cast<uchar*>(header.data()));
+	header[4] = char(flags);
+	return header;
+}
+
+} // namespace
+
+bool isLosslessFormatSupported(const QAudioFormat& format)
+{
+	const int sampleSize = format.sampleSize();
+	return format.channelCount() > 0 &&
+	       ((sampleSize == 8 && format.sampleType() == QAudioFormat::UnSignedInt) ||
+	        ((sampleSize == 16 || sampleSize == 24 || sampleSize == 32) &&
+	         format.sampleType() == QAudioFormat::SignedInt &&
+	         format.byteOrder() == QAudioFormat::LittleEndian) ||
+	        (sampleSize == 32 && format.sampleType() == QAudioFormat::Float &&
+	         format.byteOrder() == QAudioFormat::LittleEndian));
+}
+
+QByteArray encodeLosslessBlock(const QAudioFormat& format, const char* data, int frames)
+{
+	const int channels = format.channelCount();
+	const int sampleSize = format.sampleSize();
+	const int bytesPerSample = sampleSize / 8;
+	const uchar* samples = reinterpret_cast<const uchar*>(data);
+
+	BitWriter writer;
+	std::vector<qint32> channel(frames);
+	for (int c = 0; c < channels; ++c)
+	{
+		for (int i = 0; i < frames; ++i)
+			channel[i] = readSample(samples + (i * channels + c) * bytesPerSample, sampleSize);
+		encodeChannel(writer, channel.data(), frames, sampleSize);
+	}
+	return blockHeader(frames, 0) + writer.finish();
+}
+
+QByteArray droppedLosslessBlock(int frames)
+{
+	return blockHeader(frames, LosslessBlockDropped);
+}
+
+bool isLosslessBlockDropped(const QByteArray& block)
+{
+	return block.size() >= blockHeaderSize && (quint8(block[4]) & LosslessBlockDropped);
+}
+
+bool decodeLosslessBlock(const QAudioFormat& format, const QByteArray& block, QByteArray& pcm)
+{
+	if (block.size() < blockHeaderSize)
+		return false;
+
+	const quint32 frames =
+	    qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(block.constData()));
+	const quint8 flags = quint8(block[4]);
+	if (frames > maxBlockFrames)
+		return false;
+
+	const int channels = format.channelCount();
+	const int sampleSize = format.sampleSize();
+	const int bytesPerSample = sampleSize / 8;
+	pcm.resize(int(frames) * channels * bytesPerSample);
+	uchar* samples = reinterpret_cast<uchar*>(pcm.data());
+
+	std::vector<qint32> channel(frames, 0);
+	BitReader reader(block.constData() + blockHeaderSize, block.size() - blockHeaderSize);
+	for (int c = 0; c < channels; ++c)
+	{
+		// Dropped blocks decode to silence (zero samples, 128 for unsigned 8-bit ones)
+		if (!(flags & LosslessBlockDropped) &&
+		    !decodeChannel(reader, channel.data(), int(frames), sampleSize))
+			return false;
+		for (int i = 0; i < int(frames); ++i)
+			writeSample(samples + (i * channels + c) * bytesPerSample, sampleSize, channel[i]);
+	}
+	return true;
+}
+
+} // namespace SpeexWebRTCTest
@@ -0,0 +1,42 @@
+#ifndef _LOSSLESS_CODEC_H_
+#define _LOSSLESS_CODEC_H_
+
+#include <QAudioFormat>
+#include <QByteArray>
+
+namespace SpeexWebRTCTest {
+
+// Lossless recording layout: a header with the magic, the version, the stream format (as in
+// TraceFormat.h) and the block length in frames (quint32), then blocks, each one prefixed with
+// its size (quint32). A block starts with its frame count (quint32) and flags (quint8); unless it
+// was dropped, a bit stream with one subframe per channel follows.
+//
+// A subframe is constant, verbatim, a fixed polynomial predictor of order 0 to 4 or a quantised
+// LPC predictor of order 1 to 32, followed by the prediction residual. The residual is split into
+// 2^n partitions, each one Rice coded with its own parameter. Only integer samples of up to 24
+// bits are predicted; 32-bit integer and float samples are stored verbatim.
+const quint32 losslessMagic = 0x414c5753; // "SWLA"
+const quint16 losslessVersion = 1;
+
+enum LosslessBlockFlag : quint8
+{
+	// The encoder couldn't keep up and dropped the block, decoders play silence instead
+	LosslessBlockDropped = 1
+};
+
+// 8-bit unsigned, 16, 24 and 32-bit signed and 32-bit float samples, in little endian
+bool isLosslessFormatSupported(const QAudioFormat& format);
+
+// Encodes frames of interleaved samples in the given format into a block payload
+QByteArray encodeLosslessBlock(const QAudioFormat& format, const char* data, int frames);
+// Payload of a dropped block of the given length
+QByteArray droppedLosslessBlock(int frames);
+bool isLosslessBlockDropped(const QByteArray& block);
+
+// Decodes a block payload into interleaved samples; dropped blocks decode to silence. Returns
+// false if the payload is corrupt.
+bool decodeLosslessBlock(const QAudioFormat& format, const QByteArray& block, QByteArray& pcm);
+
+} // namespace SpeexWebRTCTest
+
+#endif // _LOSSLESS_CODEC_H_
@@ -0,0 +1,91 @@
+#include "LosslessReader.h"
+
+#include "LosslessCodec.h"
+#include "TraceFormat.h"
+
+namespace SpeexWebRTCTest {
+
+LosslessReader::LosslessReader(const QString& fileName)
+    : file_(fileName)
+{
+}
+
+bool LosslessReader::open()
+{
+	if (!file_.open(QIODevice::ReadOnly))
+	{
+		error_ = file_.errorString();
+		return false;
+	}
+
+	fileStream_.setDevice(&file_);
+	fileStream_.setByteOrder(QDataStream::LittleEndian);
+
+	quint32 magic;
+	quint16 version;
+	fileStream_ >> magic >> version;
+	if (magic != losslessMagic || version != losslessVersion)
+	{
+		error_ = QStringLiteral("Not a lossless recording or unsupported version");
+		return false;
+	}
+
+	format_ = readTraceFormat(fileStream_);
+	quint32 blockFrames;
+	fileStream_ >> blockFrames;
+
+	if (fileStream_.status() != QDataStream::Ok)
+	{
+		error_ = QStringLiteral("Truncated recording header");
+		return false;
+	}
+	if (!isLosslessFormatSupported(format_))
+	{
+		error_ = QStringLiteral("Unsupported sample format");
+		return false;
+	}
+	return true;
+}
+
+const QAudioFormat& LosslessReader::getFormat() const
+{
+	return format_;
+}
+
+bool LosslessReader::readBlock(QByteArray& pcm)
+{
+	if (file_.atEnd())
+		return false;
+
+	quint32 size;
+	fileStream_ >> size;
+	if (fileStream_.status() != QDataStream::Ok || size > quint64(file_.bytesAvailable()))
+	{
+		error_ = QStringLiteral("Truncated recording block");
+		return false;
+	}
+
+	QByteArray block(int(size), Qt::Uninitialized);
+	fileStream_.readRawData(block.data(), int(size));
+	if (!decodeLosslessBlock(format_, block, pcm))
+	{
+		error_ = QStringLiteral("Corrupted recording block");
+		return false;
+	}
+
+	if (isLosslessBlockDropped(block))
+		++droppedBlocks_;
+	return true;
+}
+
+quint64 LosslessReader::droppedBlocks() const
+{
+	return droppedBlocks_;
+}
+
+QString LosslessReader::errorString() const
+{
+	return error_;
+}
+
+} // namespace SpeexWebRTCTest
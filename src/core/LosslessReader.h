@@ -0,0 +1,40 @@
+#ifndef _LOSSLESS_READER_H_
+#define _LOSSLESS_READER_H_
+
+#include <QAudioFormat>
+#include <QByteArray>
+#include <QDataStream>
+#include <QFile>
+
+namespace SpeexWebRTCTest {
+
+// Streams a lossless recording written by LosslessWriter back as PCM, one block at a time
+class LosslessReader final
+{
+public:
+	explicit LosslessReader(const QString& fileName);
+
+	bool open();
+
+	const QAudioFormat& getFormat() const;
+
+	// Decodes the next block into interleaved samples in getFormat(); dropped blocks decode to
+	// silence. Returns false at the end of the recording or on error (see errorString()).
+	bool readBlock(QByteArray& pcm);
+	// Dropped blocks read so far
+	quint64 droppedBlocks() const;
+	QString errorString() const;
+
+private:
+	QFile file_;
+	QDataStream fileStream_;
+
+	QAudioFormat format_;
+	quint64 droppedBlocks_ = 0;
+
+	QString error_;
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _LOSSLESS_READER_H_
@@ -0,0 +1,189 @@
+#include "LosslessWriter.h"
+
+#include "LosslessCodec.h"
+#include "TraceFormat.h"
+
+#include <QDataStream>
+#include <QLoggingCategory>
+
+#include <algorithm>
+
+namespace SpeexWebRTCTest {
+
+namespace {
+Q_LOGGING_CATEGORY(Recording, "recording")
+
+const int blockFrames = 4096;
+// Blocks submitted but not written yet, see LosslessWriter
+const int maxReorderBlocks = 64;
+
+void writeBlock(QDataStream& out, const QByteArray& block)
+{
+	out << quint32(block.size());
+	out.writeRawData(block.constData(), block.size());
+}
+
+// Dropped blocks are whole blocks, except for the last one of a recording
+void writeDroppedBlocks(QDataStream& out, quint64 frames)
+{
+	while (frames > 0)
+	{
+		const int blockLength = int(std::min<quint64>(frames, blockFrames));
+		writeBlock(out, droppedLosslessBlock(blockLength));
+		frames -= quint64(blockLength);
+	}
+}
+} // namespace
+
+LosslessWriter::LosslessWriter(const QString& fileName,
+                               const QAudioFormat& format,
+                               RecordingPool& pool,
+                               QObject* parent)
+    : QIODevice(parent), file_(fileName), format_(format), pool_(pool),
+      frameBytes_(format.bytesPerFrame())
+{
+}
+
+LosslessWriter::~LosslessWriter()
+{
+	close();
+}
+
+bool LosslessWriter::open()
+{
+	if (!isLosslessFormatSupported(format_))
+	{
+		setErrorString("Lossless recordings support only 8-bit unsigned samples, 16, 24 or 32-bit "
+		               "signed samples or 32-bit float samples (in little endian)");
+		return false;
+	}
+	if (!file_.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		setErrorString(file_.errorString());
+		return false;
+	}
+
+	QDataStream out(&file_);
+	out.setByteOrder(QDataStream::LittleEndian);
+	out << losslessMagic << losslessVersion;
+	writeTraceFormat(out, format_);
+	out << quint32(blockFrames);
+
+	block_.clear();
+	nextSequence_ = 0;
+	droppedFrames_ = 0;
+	nextWritten_ = 0;
+	droppedBlocks_ = 0;
+	return QIODevice::open(WriteOnly);
+}
+
+void LosslessWriter::close()
+{
+	if (!isOpen())
+		return;
+
+	block_.truncate(block_.size() / frameBytes_ * frameBytes_);
+	if (!block_.isEmpty())
+		submitBlock(block_);
+	block_.clear();
+
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		blockWritten_.wait(lock, [this] { return nextWritten_ == nextSequence_; });
+
+		QDataStream out(&file_);
+		out.setByteOrder(QDataStream::LittleEndian);
+		writeDroppedBlocks(out, droppedFrames_);
+		droppedFrames_ = 0;
+	}
+	file_.close();
+	QIODevice::close();
+
+	if (droppedBlocks_ > 0)
+		qWarning(Recording).noquote() << "Dropped" << droppedBlocks_.load() << "blocks of"
+		                              << file_.fileName() << "- encoders are too slow";
+}
+
+bool LosslessWriter::isSequential() const
+{
+	return true;
+}
+
+quint64 LosslessWriter::droppedBlocks() const
+{
+	return droppedBlocks_;
+}
+
+qint64 LosslessWriter::readData(char* data, qint64 maxSize)
+{
+	Q_UNUSED(data);
+	Q_UNUSED(maxSize);
+	return -1;
+}
+
+qint64 LosslessWriter::writeData(const char* data, qint64 maxSize)
+{
+	block_.append(data, int(maxSize));
+
+	const int blockBytes = blockFrames * frameBytes_;
+	if (block_.size() >= blockBytes)
+	{
+		int offset = 0;
+		for (; block_.size() - offset >= blockBytes; offset += blockBytes)
+			submitBlock(block_.mid(offset, blockBytes));
+		block_.remove(0, offset);
+	}
+	return maxSize;
+}
+
+void LosslessWriter::submitBlock(const QByteArray& pcm)
+{
+	const int frames = pcm.size() / frameBytes_;
+
+	bool windowFull;
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		windowFull = nextSequence_ - nextWritten_ >= quint64(maxReorderBlocks);
+	}
+
+	if (!windowFull)
+	{
+		const quint64 sequence = nextSequence_;
+		const quint64 droppedFramesBefore = droppedFrames_;
+		const bool queued = pool_.submit(
+		    std::size_t(pcm.size()), [this, sequence, droppedFramesBefore, frames, pcm] {
+			    complete(sequence, {droppedFramesBefore,
+			                        encodeLosslessBlock(format_, pcm.constData(), frames)});
+		    });
+		if (queued)
+		{
+			++nextSequence_;
+			droppedFrames_ = 0;
+			return;
+		}
+	}
+
+	// Keeps the block's place so that the recording stays in sync with the others
+	++droppedBlocks_;
+	droppedFrames_ += quint64(frames);
+}
+
+void LosslessWriter::complete(quint64 sequence, const EncodedBlock& block)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	encoded_[sequence] = block;
+
+	QDataStream out(&file_);
+	out.setByteOrder(QDataStream::LittleEndian);
+	while (!encoded_.empty() && encoded_.begin()->first == nextWritten_)
+	{
+		const EncodedBlock& next = encoded_.begin()->second;
+		writeDroppedBlocks(out, next.droppedFramesBefore);
+		writeBlock(out, next.payload);
+		encoded_.erase(encoded_.begin());
+		++nextWritten_;
+	}
+	blockWritten_.notify_all();
+}
+
+} // namespace SpeexWebRTCTest
@@ -0,0 +1,74 @@
+#ifndef _LOSSLESS_WRITER_H_
+#define _LOSSLESS_WRITER_H_
+
+#include "RecordingPool.h"
+
+#include <QAudioFormat>
+#include <QFile>
+#include <QIODevice>
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+
+namespace SpeexWebRTCTest {
+
+// Records a stream in the lossless format (see LosslessCodec.h). Written audio is cut into blocks
+// that the pool encodes in the background; encoded blocks are put back in order and written by
+// whichever worker completes the next one. At most 64 blocks wait to be written, so that one slow
+// block can't make the ones completed after it pile up. Blocks beyond that, or that the pool
+// refuses (the encoders are behind and its memory budget is used up), are recorded as dropped:
+// they take no job and no reorder slot, only a count of frames written out ahead of the next
+// encoded block. Writes must come from a single thread.
+class LosslessWriter final : public QIODevice
+{
+	Q_OBJECT
+public:
+	LosslessWriter(const QString& fileName,
+	               const QAudioFormat& format,
+	               RecordingPool& pool = RecordingPool::shared(),
+	               QObject* parent = nullptr);
+	~LosslessWriter() override;
+
+	bool open();
+	// Encodes what is left and waits for the pending blocks
+	void close() override;
+	bool isSequential() const override;
+
+	quint64 droppedBlocks() const;
+
+protected:
+	qint64 readData(char* data, qint64 maxSize) override;
+	qint64 writeData(const char* data, qint64 maxSize) override;
+
+private:
+	struct EncodedBlock
+	{
+		quint64 droppedFramesBefore;
+		QByteArray payload;
+	};
+
+	void submitBlock(const QByteArray& pcm);
+	void complete(quint64 sequence, const EncodedBlock& block);
+
+	QFile file_;
+	const QAudioFormat format_;
+	RecordingPool& pool_;
+	const int frameBytes_;
+
+	QByteArray block_;
+	quint64 nextSequence_ = 0;
+	quint64 droppedFrames_ = 0; // since the last encoded block
+
+	std::mutex mutex_;
+	std::condition_variable blockWritten_;
+	std::map<quint64, EncodedBlock> encoded_; // completed ahead of an earlier block
+	quint64 nextWritten_ = 0;
+
+	std::atomic<quint64> droppedBlocks_{0};
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _LOSSLESS_WRITER_H_
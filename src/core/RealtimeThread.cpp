@@ -0,0 +1,201 @@
+#include "RealtimeThread.h"
+
+#include <QLoggingCategory>
+#include <QStringList>
+
+#ifdef Q_OS_LINUX
+#include <alloca.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace SpeexWebRTCTest {
+
+namespace {
+Q_LOGGING_CATEGORY(Realtime, "realtime")
+
+// CPU_SET() is undefined for ids the cpu_set_t can't hold
+#ifdef Q_OS_LINUX
+const int maxCpus = CPU_SETSIZE;
+#else
+const int maxCpus = 1024;
+#endif
+} // namespace
+
+bool RealtimeProfile::isDefault() const
+{
+	return policy == Policy::Default && cpus.isEmpty() && !lockMemory;
+}
+
+RealtimeProfile::Policy RealtimeProfile::parsePolicy(const QString& name, bool* ok)
+{
+	if (ok)
+		*ok = true;
+
+	const QString lower = name.toLower();
+	if (lower == "fifo")
+		return Policy::Fifo;
+	if (lower == "rr")
+		return Policy::RoundRobin;
+	if (lower != "default" && ok)
+		*ok = false;
+	return Policy::Default;
+}
+
+QVector<int> RealtimeProfile::parseCpuList(const QString& list, bool* ok)
+{
+	QVector<int> cpus;
+	bool valid = true;
+
+	for (const QString& item : list.split(',', QString::SkipEmptyParts))
+	{
+		const QStringList range = item.trimmed().split('-');
+		bool firstOk = false;
+		bool lastOk = false;
+		const int first = range.first().toInt(&firstOk);
+		const int last = range.size() == 2 ? range.last().toInt(&lastOk) : first;
+		if (range.size() == 1)
+			lastOk = firstOk;
+
+		if (!firstOk || !lastOk || range.size() > 2 || first < 0 || last < first ||
+		    last >= maxCpus)
+		{
+			valid = false;
+			break;
+		}
+
+		for (int cpu = first; cpu <= last; ++cpu)
+			cpus.append(cpu);
+	}
+
+	if (ok)
+		*ok = valid;
+	return valid ? cpus : QVector<int>();
+}
+
+#ifdef Q_OS_LINUX
+
+bool applyRealtimeProfile(const RealtimeProfile& profile)
+{
+	bool applied = true;
+
+	if (profile.lockMemory)
+	{
+		// Locks the DSP state and queues that are already allocated and everything allocated later
+		if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+		{
+			qWarning(Realtime) << "Unable to lock memory:" << strerror(errno)
+			                   << "(raise RLIMIT_MEMLOCK or grant CAP_IPC_LOCK)";
+			applied = false;
+		}
+	}
+
+	prefaultStack(profile.prefaultStackSize);
+
+	if (!profile.cpus.isEmpty())
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (int cpu : profile.cpus)
+		{
+			if (cpu >= 0 && cpu < maxCpus)
+				CPU_SET(cpu, &set);
+			else
+				qWarning(Realtime) << "Ignoring CPU" << cpu << "- ids go up to" << maxCpus - 1;
+		}
+
+		const int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+		if (error != 0)
+		{
+			qWarning(Realtime) << "Unable to set CPU affinity to" << profile.cpus << ":"
+			                   << strerror(error);
+			applied = false;
+		}
+	}
+
+	if (profile.policy != RealtimeProfile::Policy::Default)
+	{
+		const int policy =
+		    profile.policy == RealtimeProfile::Policy::Fifo ? SCHED_FIFO : SCHED_RR;
+		const int minPriority = sched_get_priority_min(policy);
+		const int maxPriority = sched_get_priority_max(policy);
+
+		sched_param param{};
+		param.sched_priority = profile.priority > 0 ? profile.priority
+		                                            : (minPriority + maxPriority) / 2;
+		param.sched_priority = qBound(minPriority, param.sched_priority, maxPriority);
+
+		const int error = pthread_setschedparam(pthread_self(), policy, &param);
+		if (error != 0)
+		{
+			qWarning(Realtime) << "Unable to set realtime priority" << param.sched_priority << ":"
+			                   << strerror(error) << "(raise RLIMIT_RTPRIO or grant CAP_SYS_NICE)";
+			applied = false;
+		}
+	}
+
+	if (applied)
+		qInfo(Realtime) << "Realtime profile applied";
+	return applied;
+}
+
+void prefaultStack(std::size_t size)
+{
+	if (size == 0)
+		return;
+
+	volatile char* stack = static_cast<volatile char*>(alloca(size));
+	const std::size_t pageSize = sysconf(_SC_PAGESIZE);
+	for (std::size_t i = 0; i < size; i += pageSize)
+		stack[i] = 0;
+}
+
+ThreadStatistics ThreadStatistics::current()
+{
+	ThreadStatistics statistics;
+	rusage usage{};
+	if (getrusage(RUSAGE_THREAD, &usage) == 0)
+	{
+		statistics.minorFaults = usage.ru_minflt;
+		statistics.majorFaults = usage.ru_majflt;
+		statistics.voluntarySwitches = usage.ru_nvcsw;
+		statistics.involuntarySwitches = usage.ru_nivcsw;
+	}
+	return statistics;
+}
+
+#else
+
+bool applyRealtimeProfile(const RealtimeProfile& profile)
+{
+	if (!profile.isDefault())
+		qWarning(Realtime) << "Realtime profiles are not supported on this platform";
+	return profile.isDefault();
+}
+
+void prefaultStack(std::size_t) {}
+
+ThreadStatistics ThreadStatistics::current()
+{
+	return {};
+}
+
+#endif
+
+ThreadStatistics ThreadStatistics::operator-(const ThreadStatistics& other) const
+{
+	ThreadStatistics result;
+	result.minorFaults = minorFaults - other.minorFaults;
+	result.majorFaults = majorFaults - other.majorFaults;
+	result.voluntarySwitches = voluntarySwitches - other.voluntarySwitches;
+	result.involuntarySwitches = involuntarySwitches - other.involuntarySwitches;
+	return result;
+}
+
+} // namespace SpeexWebRTCTest
@@ -0,0 +1,57 @@
+#ifndef _REALTIME_THREAD_H_
+#define _REALTIME_THREAD_H_
+
+#include <QString>
+#include <QVector>
+
+#include <cstddef>
+
+namespace SpeexWebRTCTest {
+
+// Scheduling setup for a latency-critical thread. The default profile leaves the thread untouched.
+struct RealtimeProfile
+{
+	enum class Policy
+	{
+		Default,
+		Fifo,
+		RoundRobin
+	};
+
+	Policy policy = Policy::Default;
+	int priority = 0;  // 1..99 for Fifo and RoundRobin, 0 picks the middle of the range
+	QVector<int> cpus; // CPUs the thread may run on, empty keeps the inherited affinity
+	bool lockMemory = false;
+	std::size_t prefaultStackSize = 256 * 1024;
+
+	bool isDefault() const;
+
+	// Parses "fifo", "rr" or "default"
+	static Policy parsePolicy(const QString& name, bool* ok = nullptr);
+	// Parses a CPU list such as "2,3" or "4-7". Ids must be below CPU_SETSIZE (1024 on Linux).
+	static QVector<int> parseCpuList(const QString& list, bool* ok = nullptr);
+};
+
+// Applies the profile to the calling thread. Each part is tried independently: on missing
+// privileges or an unsupported platform a warning is logged and the remaining parts still apply.
+// Returns true if everything was applied.
+bool applyRealtimeProfile(const RealtimeProfile& profile);
+
+// Touches the given amount of stack so that its pages are resident (and locked with mlockall)
+void prefaultStack(std::size_t size);
+
+// Per-thread scheduler and memory counters of the calling thread
+struct ThreadStatistics
+{
+	long minorFaults = 0;
+	long majorFaults = 0;
+	long voluntarySwitches = 0;
+	long involuntarySwitches = 0;
+
+	static ThreadStatistics current();
+	ThreadStatistics operator-(const ThreadStatistics& other) const;
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _REALTIME_THREAD_H_
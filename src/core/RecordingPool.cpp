@@ -0,0 +1,72 @@
+#include "RecordingPool.h"
+
+#include <algorithm>
+
+namespace SpeexWebRTCTest {
+
+namespace {
+const std::size_t sharedMaxPendingBytes = 16 * 1024 * 1024;
+} // namespace
+
+RecordingPool::RecordingPool(int threads, std::size_t maxPendingBytes)
+    : maxPendingBytes_(maxPendingBytes)
+{
+	for (int i = 0; i < std::max(threads, 1); ++i)
+		workers_.emplace_back([this] { work(); });
+}
+
+RecordingPool::~RecordingPool()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		doWork_ = false;
+	}
+	jobAvailable_.notify_all();
+
+	// The workers drain the queue before exiting
+	for (std::thread& worker : workers_)
+		worker.join();
+}
+
+RecordingPool& RecordingPool::shared()
+{
+	static RecordingPool pool(int(std::thread::hardware_concurrency() / 2),
+	                          sharedMaxPendingBytes);
+	return pool;
+}
+
+bool RecordingPool::submit(std::size_t bytes, std::function<void()> job)
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (bytes > 0 && pendingBytes_ + bytes > maxPendingBytes_)
+			return false;
+
+		pendingBytes_ += bytes;
+		jobs_.push_back({bytes, std::move(job)});
+	}
+	jobAvailable_.notify_one();
+	return true;
+}
+
+void RecordingPool::work()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (true)
+	{
+		jobAvailable_.wait(lock, [this] { return !jobs_.empty() || !doWork_; });
+		if (jobs_.empty())
+			break;
+
+		Job job = std::move(jobs_.front());
+		jobs_.pop_front();
+
+		lock.unlock();
+		job.run();
+		lock.lock();
+
+		pendingBytes_ -= job.bytes;
+	}
+}
+
+} // namespace SpeexWebRTCTest
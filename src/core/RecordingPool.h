@@ -0,0 +1,51 @@
+#ifndef _RECORDING_POOL_H_
+#define _RECORDING_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace SpeexWebRTCTest {
+
+// Worker threads encoding recordings in the background. The memory held by queued jobs is
+// bounded: every job declares the bytes it keeps alive, and submit() refuses jobs once the
+// budget is used up, so recordings drop data instead of growing without bound when the encoders
+// can't keep up. Jobs run in no particular order across the workers.
+class RecordingPool final
+{
+public:
+	RecordingPool(int threads, std::size_t maxPendingBytes);
+	~RecordingPool();
+
+	// Shared by all recordings: half the hardware threads and 16 MB of pending audio
+	static RecordingPool& shared();
+
+	// Queues the job unless its bytes exceed what is left of the budget; jobs of 0 bytes are
+	// always accepted. The bytes are given back once the job has run.
+	bool submit(std::size_t bytes, std::function<void()> job);
+
+private:
+	struct Job
+	{
+		std::size_t bytes;
+		std::function<void()> run;
+	};
+
+	void work();
+
+	const std::size_t maxPendingBytes_;
+
+	std::mutex mutex_;
+	std::condition_variable jobAvailable_;
+	std::deque<Job> jobs_;
+	std::size_t pendingBytes_ = 0;
+	bool doWork_ = true;
+	std::vector<std::thread> workers_;
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _RECORDING_POOL_H_
@@ -0,0 +1,215 @@
+#include "ReferenceMixer.h"
+
+#include <QStringList>
+
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define REFERENCE_MIXER_SSE2
+#endif
+
+namespace SpeexWebRTCTest {
+
+namespace {
+
+void downmixStereo(const qint16* from, qint16* to, int frames)
+{
+	int i = 0;
+#ifdef REFERENCE_MIXER_SSE2
+	// Pairwise sums of 32 bits, halved and packed back to 16 bits
+	const __m128i ones = _mm_set1_epi16(1);
+	for (; i + 8 <= frames; i += 8)
+	{
+		const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from + 2 * i));
+		const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from + 2 * i + 8));
+		const __m128i lowSums = _mm_srai_epi32(_mm_madd_epi16(low, ones), 1);
+		const __m128i highSums = _mm_srai_epi32(_mm_madd_epi16(high, ones), 1);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(to + i), _mm_packs_epi32(lowSums, highSums));
+	}
+#endif
+	for (; i < frames; ++i)
+		to[i] = qint16((from[2 * i] + from[2 * i + 1]) >> 1);
+}
+
+void downmixStereo(const float* from, float* to, int frames)
+{
+	int i = 0;
+#ifdef REFERENCE_MIXER_SSE2
+	const __m128 half = _mm_set1_ps(0.5f);
+	for (; i + 4 <= frames; i += 4)
+	{
+		const __m128 low = _mm_loadu_ps(from + 2 * i);
+		const __m128 high = _mm_loadu_ps(from + 2 * i + 4);
+		const __m128 left = _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0));
+		const __m128 right = _mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1));
+		_mm_storeu_ps(to + i, _mm_mul_ps(_mm_add_ps(left, right), half));
+	}
+#endif
+	for (; i < frames; ++i)
+		to[i] = (from[2 * i] + from[2 * i + 1]) * 0.5f;
+}
+
+template <typename Sample, typename Sum>
+void downmix(const Sample* from, Sample* to, int frames, int channels)
+{
+	if (channels == 2)
+	{
+		downmixStereo(from, to, frames);
+		return;
+	}
+
+	for (int i = 0; i < frames; ++i)
+	{
+		Sum sum = 0;
+		for (int channel = 0; channel < channels; ++channel)
+			sum += from[i * channels + channel];
+		to[i] = Sample(sum / channels);
+	}
+}
+
+} // namespace
+
+bool ReferenceConditioning::isDefault() const
+{
+	return mode == Mode::Full;
+}
+
+int ReferenceConditioning::outputChannels(int inputChannels) const
+{
+	switch (mode)
+	{
+	case Mode::Full:
+		return inputChannels;
+	case Mode::Downmix:
+		return 1;
+	case Mode::Select:
+		return channels.size();
+	}
+	return inputChannels;
+}
+
+ReferenceConditioning ReferenceConditioning::parse(const QString& spec, bool* ok)
+{
+	if (ok)
+		*ok = true;
+
+	ReferenceConditioning conditioning;
+	const QString lower = spec.trimmed().toLower();
+	if (lower == "full")
+		return conditioning;
+	if (lower == "mono")
+	{
+		conditioning.mode = Mode::Downmix;
+		return conditioning;
+	}
+
+	conditioning.mode = Mode::Select;
+	if (lower == "left")
+		conditioning.channels = {0};
+	else if (lower == "right")
+		conditioning.channels = {1};
+	else
+	{
+		for (const QString& item : lower.split(','))
+		{
+			bool valid = false;
+			const int channel = item.trimmed().toInt(&valid);
+			if (!valid || channel < 0)
+			{
+				if (ok)
+					*ok = false;
+				return ReferenceConditioning();
+			}
+			conditioning.channels.append(channel);
+		}
+	}
+	return conditioning;
+}
+
+ReferenceMixer::ReferenceMixer(const ReferenceConditioning& conditioning,
+                               const QAudioFormat& inputFormat)
+    : inputFormat_(inputFormat), outputFormat_(inputFormat)
+{
+	if (inputFormat_.sampleType() == QAudioFormat::Float ? inputFormat_.sampleSize() != 32
+	                                                      : inputFormat_.sampleSize() != 16)
+		throw std::invalid_argument("Reference must have 16-bit or float samples");
+
+	const int inputChannels = inputFormat_.channelCount();
+	switch (conditioning.mode)
+	{
+	case ReferenceConditioning::Mode::Full:
+		for (int channel = 0; channel < inputChannels; ++channel)
+			channels_.append(channel);
+		break;
+	case ReferenceConditioning::Mode::Downmix:
+		// Downmixing a single channel is a copy
+		downmix_ = inputChannels > 1;
+		if (!downmix_)
+			channels_ = {0};
+		break;
+	case ReferenceConditioning::Mode::Select:
+		channels_ = conditioning.channels;
+		if (channels_.isEmpty())
+			throw std::invalid_argument("No reference channel selected");
+		for (int channel : channels_)
+		{
+			if (channel < 0 || channel >= inputChannels)
+				throw std::invalid_argument("Selected reference channel doesn't exist");
+		}
+		break;
+	}
+
+	outputFormat_.setChannelCount(conditioning.outputChannels(inputChannels));
+
+	passthrough_ = !downmix_ && channels_.size() == inputChannels;
+	for (int channel = 0; passthrough_ && channel < channels_.size(); ++channel)
+		passthrough_ = channels_.at(channel) == channel;
+}
+
+bool ReferenceMixer::isPassthrough() const
+{
+	return passthrough_;
+}
+
+const QAudioFormat& ReferenceMixer::getInputFormat() const
+{
+	return inputFormat_;
+}
+
+const QAudioFormat& ReferenceMixer::getOutputFormat() const
+{
+	return outputFormat_;
+}
+
+void ReferenceMixer::process(const char* from, char* to, int frames) const
+{
+	const bool isFloat = inputFormat_.sampleType() == QAudioFormat::Float;
+	if (downmix_ && isFloat)
+		downmix<float, float>(reinterpret_cast<const float*>(from), reinterpret_cast<float*>(to),
+		                      frames, inputFormat_.channelCount());
+	else if (downmix_)
+		downmix<qint16, int>(reinterpret_cast<const qint16*>(from), reinterpret_cast<qint16*>(to),
+		                     frames, inputFormat_.channelCount());
+	else if (passthrough_)
+		memcpy(to, from, inputFormat_.bytesForFrames(frames));
+	else if (isFloat)
+		select(reinterpret_cast<const float*>(from), reinterpret_cast<float*>(to), frames);
+	else
+		select(reinterpret_cast<const qint16*>(from), reinterpret_cast<qint16*>(to), frames);
+}
+
+template <typename Sample>
+void ReferenceMixer::select(const Sample* from, Sample* to, int frames) const
+{
+	const int inputChannels = inputFormat_.channelCount();
+	const int outputChannels = channels_.size();
+	for (int i = 0; i < frames; ++i)
+	{
+		for (int channel = 0; channel < outputChannels; ++channel)
+			to[i * outputChannels + channel] = from[i * inputChannels + channels_.at(channel)];
+	}
+}
+
+} // namespace SpeexWebRTCTest
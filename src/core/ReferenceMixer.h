@@ -0,0 +1,60 @@
+#ifndef _REFERENCE_MIXER_H_
+#define _REFERENCE_MIXER_H_
+
+#include <QAudioFormat>
+#include <QString>
+#include <QVector>
+
+namespace SpeexWebRTCTest {
+
+// How the far-end reference is conditioned before it reaches the echo canceller. Each reference
+// channel costs a full set of adaptive filters, and a mono reference is usually good enough.
+struct ReferenceConditioning
+{
+	enum class Mode
+	{
+		Full,    // every channel, multichannel echo cancellation
+		Downmix, // average of all the channels
+		Select   // the listed channels only, in that order
+	};
+
+	Mode mode = Mode::Full;
+	QVector<int> channels;
+
+	bool isDefault() const;
+	int outputChannels(int inputChannels) const;
+
+	// Parses "full", "mono", "left", "right" or a list of channel indices such as "0" or "1,0"
+	static ReferenceConditioning parse(const QString& spec, bool* ok = nullptr);
+};
+
+// Applies a ReferenceConditioning to interleaved 16-bit or float frames. Stereo downmix, the
+// common case, uses SSE2 where available.
+class ReferenceMixer final
+{
+public:
+	// Throws std::invalid_argument when a selected channel doesn't exist in the input format
+	ReferenceMixer(const ReferenceConditioning& conditioning, const QAudioFormat& inputFormat);
+
+	const QAudioFormat& getInputFormat() const;
+	const QAudioFormat& getOutputFormat() const;
+	// True when the output is a copy of the input
+	bool isPassthrough() const;
+
+	// Frames of the input format to as many frames of the output format
+	void process(const char* from, char* to, int frames) const;
+
+private:
+	template <typename Sample>
+	void select(const Sample* from, Sample* to, int frames) const;
+
+	const QAudioFormat inputFormat_;
+	QAudioFormat outputFormat_;
+	bool downmix_ = false;
+	bool passthrough_ = false;
+	QVector<int> channels_;
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _REFERENCE_MIXER_H_
@@ -0,0 +1,70 @@
+#include "SampleConversion.h"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SAMPLE_CONVERSION_SSE2
+#endif
+
+namespace SpeexWebRTCTest {
+
+namespace {
+const float int16Scale = 32768.f;
+const float floatScale = 1.f / 32768.f;
+
+inline qint16 toInt16(float sample)
+{
+	const float scaled = std::nearbyint(sample * int16Scale);
+	// NaNs end up at the positive limit, like in the SSE2 version
+	if (!(scaled < 32767.f))
+		return 32767;
+	if (scaled <= -32768.f)
+		return -32768;
+	return qint16(scaled);
+}
+} // namespace
+
+void int16ToFloat(const qint16* from, float* to, int count)
+{
+	int i = 0;
+#ifdef SAMPLE_CONVERSION_SSE2
+	const __m128 scale = _mm_set1_ps(floatScale);
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from + i));
+		// Sign extension: the samples go to the upper halves, then shift back down
+		const __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+		const __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+		_mm_storeu_ps(to + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+		_mm_storeu_ps(to + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+	}
+#endif
+	for (; i < count; ++i)
+		to[i] = from[i] * floatScale;
+}
+
+void floatToInt16(const float* from, qint16* to, int count)
+{
+	int i = 0;
+#ifdef SAMPLE_CONVERSION_SSE2
+	// Rounds to nearest in the default MXCSR mode, and the pack saturates to the 16-bit range.
+	// Clamping first keeps huge values and NaNs away from the integer indefinite value.
+	const __m128 scale = _mm_set1_ps(int16Scale);
+	const __m128 maxValue = _mm_set1_ps(32767.f);
+	const __m128 minValue = _mm_set1_ps(-32768.f);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128 low = _mm_mul_ps(_mm_loadu_ps(from + i), scale);
+		__m128 high = _mm_mul_ps(_mm_loadu_ps(from + i + 4), scale);
+		low = _mm_max_ps(_mm_min_ps(low, maxValue), minValue);
+		high = _mm_max_ps(_mm_min_ps(high, maxValue), minValue);
+		const __m128i samples = _mm_packs_epi32(_mm_cvtps_epi32(low), _mm_cvtps_epi32(high));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(to + i), samples);
+	}
+#endif
+	for (; i < count; ++i)
+		to[i] = toInt16(from[i]);
+}
+
+} // namespace SpeexWebRTCTest
@@ -0,0 +1,17 @@
+#ifndef _SAMPLE_CONVERSION_H_
+#define _SAMPLE_CONVERSION_H_
+
+#include <QtGlobal>
+
+namespace SpeexWebRTCTest {
+
+// Conversions between 16-bit and float samples, full scale at +/-1.0. Used where a frame crosses
+// from one sample type to the other, so that the float pipeline converts at most once per edge.
+// SSE2 where available, with a scalar fallback.
+void int16ToFloat(const qint16* from, float* to, int count);
+// Rounds to the nearest value and clips to the 16-bit range
+void floatToInt16(const float* from, qint16* to, int count);
+
+} // namespace SpeexWebRTCTest
+
+#endif // _SAMPLE_CONVERSION_H_
@@ -0,0 +1,255 @@
+#include "ShadowProcessor.h"
+
+#include "AudioLevels.h"
+#include "SpeexDSP.h"
+#include "StreamMetrics.h"
+#include "WebRTCDSP.h"
+
+#include <QLoggingCategory>
+
+#include <algorithm>
+
+namespace SpeexWebRTCTest {
+
+namespace {
+Q_LOGGING_CATEGORY(Shadow, "shadow")
+
+// Primary frames the shadow may fall behind before frames are dropped
+const std::size_t maxQueuedFrames = 50;
+// Levels are clamped so that digital silence doesn't dominate the differences
+const qreal minLevelDb = -100;
+
+qreal peakLevel(const QByteArray& data, const QAudioFormat& format)
+{
+	qreal level = minLevelDb;
+	const int frames = format.framesForBytes(data.size());
+	for (qreal channelLevel : calculateAudioLevels(data.constData(), frames, format))
+		level = std::max(level, channelLevel);
+	return level;
+}
+} // namespace
+
+ShadowProcessor::ShadowProcessor(Backend backend,
+                                 const QAudioFormat& format,
+                                 const QAudioFormat& monitorFormat,
+                                 const QString& outputPath,
+                                 bool waitWhenFull)
+    : backend_(backend), format_(format), monitorFormat_(monitorFormat), waitWhenFull_(waitWhenFull)
+{
+	if (backend_ == Backend::Speex)
+		dsp_.reset(new SpeexDSP(format_, monitorFormat_));
+	else
+		dsp_.reset(new WebRTCDSP(format_, monitorFormat_));
+
+	if (outputPath.isEmpty())
+	{
+		doWork_ = true;
+		worker_ = std::thread([this] { process(); });
+		return;
+	}
+
+	encoder_.reset(new WavFileWriter(outputPath + ".wav", format_));
+	encoder_->open();
+
+	statsFile_.setFileName(outputPath + ".csv");
+	if (statsFile_.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+	{
+		stats_.setDevice(&statsFile_);
+		stats_ << "frame,primary_cpu_us,shadow_cpu_us,primary_latency_us,shadow_latency_us,"
+		          "primary_level_dbfs,shadow_level_dbfs,level_difference_db\n";
+	}
+	else
+		qWarning(Shadow) << "Unable to write shadow statistics:" << statsFile_.errorString();
+
+	doWork_ = true;
+	worker_ = std::thread([this] { process(); });
+}
+
+ShadowProcessor::~ShadowProcessor()
+{
+	{
+		std::unique_lock<std::mutex> lock(queueMutex_);
+		doWork_ = false;
+	}
+	queueEvent_.notify_all();
+	worker_.join();
+
+	writeSummary();
+	if (encoder_)
+		encoder_->close();
+	stats_.flush();
+	statsFile_.close();
+}
+
+Backend ShadowProcessor::getBackend() const
+{
+	return backend_;
+}
+
+unsigned int ShadowProcessor::getFrameSize() const
+{
+	return dsp_->getFrameSize();
+}
+
+bool ShadowProcessor::getWaitWhenFull() const
+{
+	return waitWhenFull_;
+}
+
+void ShadowProcessor::setParameter(const QString& param, const QVariant& value)
+{
+	std::unique_lock<std::mutex> lock(dspMutex_);
+	try
+	{
+		dsp_->setParameter(param, value);
+	}
+	catch (const std::invalid_argument&)
+	{
+		qDebug(Shadow) << "Shadow backend ignores parameter" << param;
+	}
+}
+
+void ShadowProcessor::submit(const ShadowFrame& frame)
+{
+	{
+		std::unique_lock<std::mutex> lock(queueMutex_);
+		if (waitWhenFull_)
+			queueEvent_.wait(lock, [this] { return queue_.size() < maxQueuedFrames; });
+		else if (queue_.size() >= maxQueuedFrames)
+		{
+			if (dropped_++ == 0)
+				qWarning(Shadow) << "Shadow backend can't keep up, dropping frames";
+			return;
+		}
+		queue_.push_back(frame);
+	}
+	queueEvent_.notify_all();
+}
+
+quint64 ShadowProcessor::droppedFrames() const
+{
+	std::unique_lock<std::mutex> lock(queueMutex_);
+	return dropped_;
+}
+
+void ShadowProcessor::process()
+{
+	while (true)
+	{
+		ShadowFrame frame;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex_);
+			queueEvent_.wait(lock, [this] { return !queue_.empty() || !doWork_; });
+			if (queue_.empty())
+				break;
+			frame = queue_.front();
+			queue_.pop_front();
+		}
+		queueEvent_.notify_all();
+
+		nearPending_.append(frame.nearEnd);
+		farPending_.append(frame.farEnd);
+		frame.nearEnd.clear();
+		frame.farEnd.clear();
+		comparePending_.push_back(frame);
+
+		processPending();
+	}
+}
+
+void ShadowProcessor::processPending()
+{
+	const int frameBytes = format_.bytesForFrames(getFrameSize());
+	const int monitorBytes = monitorFormat_.bytesForFrames(getFrameSize());
+
+	while (nearPending_.size() >= frameBytes && farPending_.size() >= monitorBytes)
+	{
+		nearFrame_.resize(frameBytes);
+		farFrame_.resize(monitorBytes);
+		memcpy(nearFrame_.data(), nearPending_.constData(), frameBytes);
+		memcpy(farFrame_.data(), farPending_.constData(), monitorBytes);
+		nearPending_.remove(0, frameBytes);
+		farPending_.remove(0, monitorBytes);
+
+		std::chrono::nanoseconds cost{0};
+		{
+			std::unique_lock<std::mutex> lock(dspMutex_);
+			const std::chrono::nanoseconds start = threadCpuTime();
+			dsp_->processFrame(nearFrame_.data(), farFrame_.constData());
+			cost = threadCpuTime() - start;
+		}
+
+		if (encoder_)
+			encoder_->write(nearFrame_);
+		shadowOutput_.append(nearFrame_.constData(), frameBytes);
+		costs_.push_back({frameBytes, double(cost.count()) / frameBytes});
+	}
+
+	// A primary frame is compared as soon as the shadow has produced all of its samples
+	while (!comparePending_.empty() &&
+	       shadowOutput_.size() >= comparePending_.front().output.size())
+	{
+		compare(comparePending_.front());
+		comparePending_.pop_front();
+	}
+}
+
+void ShadowProcessor::compare(const ShadowFrame& frame)
+{
+	const int bytes = frame.output.size();
+	const QByteArray shadowOutput = shadowOutput_.left(bytes);
+	shadowOutput_.remove(0, bytes);
+
+	const double primaryCost = frame.cpuTime.count() / 1e3;
+	const double shadowCost = consumeCost(bytes) / 1e3;
+	const double primaryLatency = frame.latency.count() / 1e3;
+	const double shadowLatency =
+	    std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - frame.captured)
+	        .count();
+	const qreal primaryLevel = peakLevel(frame.output, format_);
+	const qreal shadowLevel = peakLevel(shadowOutput, format_);
+
+	if (stats_.device())
+		stats_ << frames_ << "," << primaryCost << "," << shadowCost << "," << primaryLatency << ","
+		       << shadowLatency << "," << primaryLevel << "," << shadowLevel << ","
+		       << shadowLevel - primaryLevel << "\n";
+
+	++frames_;
+	primaryCostSum_ += primaryCost;
+	shadowCostSum_ += shadowCost;
+	primaryLatencySum_ += primaryLatency;
+	shadowLatencySum_ += shadowLatency;
+	levelDifferenceSum_ += qAbs(shadowLevel - primaryLevel);
+}
+
+double ShadowProcessor::consumeCost(int bytes)
+{
+	double cost = 0;
+	while (bytes > 0 && !costs_.empty())
+	{
+		Cost& front = costs_.front();
+		const int taken = std::min(bytes, front.bytes);
+		cost += taken * front.nsPerByte;
+		bytes -= taken;
+		front.bytes -= taken;
+		if (front.bytes == 0)
+			costs_.pop_front();
+	}
+	return cost;
+}
+
+void ShadowProcessor::writeSummary()
+{
+	if (frames_ == 0)
+		return;
+
+	qInfo(Shadow).nospace() << "Shadow " << (backend_ == Backend::Speex ? "Speex" : "WebRTC")
+	                        << " backend over " << frames_ << " frames (" << dropped_
+	                        << " dropped): " << primaryCostSum_ / frames_ << " vs "
+	                        << shadowCostSum_ / frames_ << " us CPU, "
+	                        << primaryLatencySum_ / frames_ << " vs " << shadowLatencySum_ / frames_
+	                        << " us latency, " << levelDifferenceSum_ / frames_
+	                        << " dB mean output level difference";
+}
+
+} // namespace SpeexWebRTCTest
@@ -0,0 +1,116 @@
+#ifndef _SHADOW_PROCESSOR_H_
+#define _SHADOW_PROCESSOR_H_
+
+#include "AudioEffect.h"
+#include "AudioProcessor.h"
+#include "WavFileWriter.h"
+
+#include <QAudioFormat>
+#include <QFile>
+#include <QScopedPointer>
+#include <QTextStream>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace SpeexWebRTCTest {
+
+// One frame of the primary processing tract, as handed over to the shadow
+struct ShadowFrame
+{
+	QByteArray nearEnd;
+	QByteArray farEnd;
+	QByteArray output;
+	// When the primary tract took the frame off the capture queue
+	std::chrono::steady_clock::time_point captured;
+	// Thread CPU time of the primary effect on the frame, see threadCpuTime()
+	std::chrono::nanoseconds cpuTime{0};
+	std::chrono::nanoseconds latency{0};
+};
+
+// Runs a secondary backend on copies of the frames processed by AudioProcessor, on a thread of
+// its own. The secondary output is written to <outputPath>.wav, and <outputPath>.csv gets one
+// line per primary frame comparing CPU time, latency and output level of both backends over the
+// same samples; an empty path only logs the summary. Backends with different frame sizes are
+// compared by re-chunking the shadow output to the primary frames.
+//
+// submit() only queues the frame: when the shadow falls behind, frames are dropped (or, for
+// offline replays, submit() waits) so that the primary tract is never delayed.
+class ShadowProcessor final
+{
+public:
+	ShadowProcessor(Backend backend,
+	                const QAudioFormat& format,
+	                const QAudioFormat& monitorFormat,
+	                const QString& outputPath,
+	                bool waitWhenFull = false);
+	~ShadowProcessor();
+
+	Backend getBackend() const;
+	unsigned int getFrameSize() const;
+	bool getWaitWhenFull() const;
+
+	// Parameters unknown to the shadow backend are ignored
+	void setParameter(const QString& param, const QVariant& value);
+
+	void submit(const ShadowFrame& frame);
+
+	quint64 droppedFrames() const;
+
+private:
+	// Shadow CPU time of a run of output samples, to share it out among primary frames
+	struct Cost
+	{
+		int bytes;
+		double nsPerByte;
+	};
+
+	void process();
+	void processPending();
+	void compare(const ShadowFrame& frame);
+	double consumeCost(int bytes);
+	void writeSummary();
+
+	const Backend backend_;
+	const QAudioFormat format_;
+	const QAudioFormat monitorFormat_;
+	const bool waitWhenFull_;
+
+	std::mutex dspMutex_;
+	QScopedPointer<AudioEffect> dsp_;
+
+	mutable std::mutex queueMutex_;
+	std::condition_variable queueEvent_;
+	std::deque<ShadowFrame> queue_;
+	quint64 dropped_ = 0;
+	bool doWork_ = false;
+
+	// Worker thread only
+	QByteArray nearPending_;
+	QByteArray farPending_;
+	QByteArray nearFrame_;
+	QByteArray farFrame_;
+	QByteArray shadowOutput_;
+	std::deque<ShadowFrame> comparePending_;
+	std::deque<Cost> costs_;
+
+	QScopedPointer<WavFileWriter> encoder_;
+	QFile statsFile_;
+	QTextStream stats_;
+
+	quint64 frames_ = 0;
+	double primaryCostSum_ = 0;
+	double shadowCostSum_ = 0;
+	double primaryLatencySum_ = 0;
+	double shadowLatencySum_ = 0;
+	double levelDifferenceSum_ = 0;
+
+	std::thread worker_;
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _SHADOW_PROCESSOR_H_
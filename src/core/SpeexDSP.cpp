@@ -0,0 +1,551 @@
+#include "SpeexDSP.h"
+
+#include "SampleConversion.h"
+#include "Timer.h"
+
+#include <speex/speex_echo.h>
+#include <speex/speex_preprocess.h>
+#include <speex/speex_resampler.h>
+
+#include <QLoggingCategory>
+
+#include <algorithm>
+
+namespace SpeexWebRTCTest {
+
+namespace {
+Q_LOGGING_CATEGORY(Speex, "speex")
+int on = 1;
+int off = 0;
+
+const unsigned int frameSizeMs = 25;
+const int echoTailFrames = 10;
+
+// Sparse decimation used to shorten the evaluated echo tail of an overloaded stream
+const spx_int32_t degradedSparseDecimation = 8;
+// The half-rate pipeline of QualityTier::ReducedRate needs a wideband signal to start with
+const int minReducedRateSampleRate = 16000;
+// Frames of latency the pipeline may add
+const int maxPipelineDepth = 4;
+
+// Preprocessor settings which map directly onto a speex_preprocess_ctl() request
+const QMap<QString, int>& preprocessRequests()
+{
+	static const QMap<QString, int> requests = {
+	    {"noise_reduction_max_attenuation", SPEEX_PREPROCESS_SET_NOISE_SUPPRESS},
+	    {"echo_cancellation_max_attenuation", SPEEX_PREPROCESS_SET_ECHO_SUPPRESS},
+	    {"gain_control_enabled", SPEEX_PREPROCESS_SET_AGC},
+	    {"gain_control_level", SPEEX_PREPROCESS_SET_AGC_TARGET},
+	    {"gain_control_max_gain", SPEEX_PREPROCESS_SET_AGC_MAX_GAIN},
+	    {"gain_control_max_increment", SPEEX_PREPROCESS_SET_AGC_INCREMENT},
+	    {"gain_control_max_decrement", SPEEX_PREPROCESS_SET_AGC_DECREMENT},
+	};
+	return requests;
+}
+} // namespace
+
+SpeexFarEnd::SpeexFarEnd(const QAudioFormat& format) : format_(format)
+{
+	reference_ = speex_echo_reference_init(getFrameSize(), getFrameSize() * echoTailFrames,
+	                                       format_.channelCount());
+}
+
+SpeexFarEnd::~SpeexFarEnd()
+{
+	speex_echo_reference_destroy(reference_);
+}
+
+unsigned int SpeexFarEnd::getFrameSize() const
+{
+	return format_.sampleRate() * frameSizeMs / 1000;
+}
+
+const QAudioFormat& SpeexFarEnd::getFormat() const
+{
+	return format_;
+}
+
+void SpeexFarEnd::update(const QAudioBuffer& farEnd)
+{
+	Q_ASSERT(farEnd.frameCount() == int(getFrameSize()));
+	if (farEnd.format().sampleType() == QAudioFormat::Float)
+		update(farEnd.constData<float>());
+	else
+		update(farEnd.constData<qint16>());
+}
+
+void SpeexFarEnd::update(const qint16* farEnd)
+{
+	speex_echo_reference_update(reference_, farEnd);
+}
+
+void SpeexFarEnd::update(const float* farEnd)
+{
+	speex_echo_reference_update_float(reference_, farEnd);
+}
+
+SpeexDSP::SpeexDSP(const QAudioFormat& mainFormat, const QAudioFormat& auxFormat)
+    : AudioEffect(mainFormat, auxFormat)
+{
+	echo_ = speex_echo_state_init_mc(getFrameSize(), getFrameSize() * echoTailFrames,
+	                                 getMainFormat().channelCount(), getAuxFormat().channelCount());
+	initialize();
+}
+
+SpeexDSP::SpeexDSP(const QAudioFormat& mainFormat, QSharedPointer<SpeexFarEnd> farEnd)
+    : AudioEffect(mainFormat, farEnd->getFormat()), farEnd_(farEnd)
+{
+	if (farEnd_->getFrameSize() != getFrameSize())
+		throw std::invalid_argument("Far-end analyser has a different frame size");
+
+	echo_ = speex_echo_state_init_shared(getFrameSize(), getFrameSize() * echoTailFrames,
+	                                     getMainFormat().channelCount(), farEnd_->reference_);
+	initialize();
+}
+
+void SpeexDSP::initialize()
+{
+	preprocess_ = speex_preprocess_state_init(getFrameSize(), getMainFormat().sampleRate());
+	configure(preprocess_, echo_, getMainFormat().sampleRate());
+}
+
+void SpeexDSP::configure(SpeexPreprocessState* preprocess, SpeexEchoState* echo, int sampleRate)
+{
+	speex_preprocess_ctl(preprocess, SPEEX_PREPROCESS_SET_VAD, &on);
+	speex_preprocess_ctl(preprocess, SPEEX_PREPROCESS_SET_DENOISE, &off);
+	speex_preprocess_ctl(preprocess, SPEEX_PREPROCESS_SET_AGC, &off);
+
+	for (auto it = preprocessSettings_.begin(); it != preprocessSettings_.end(); ++it)
+		speex_preprocess_ctl(preprocess, it.key(), &it.value());
+
+	std::int32_t rate = sampleRate;
+	speex_echo_ctl(echo, SPEEX_ECHO_SET_SAMPLING_RATE, &rate);
+}
+
+SpeexDSP::~SpeexDSP()
+{
+	stopPipeline();
+	speex_preprocess_state_destroy(preprocess_);
+	speex_echo_state_destroy(echo_);
+
+	if (reducedEcho_)
+	{
+		speex_preprocess_state_destroy(reducedPreprocess_);
+		speex_echo_state_destroy(reducedEcho_);
+		speex_resampler_destroy(nearDownsampler_);
+		speex_resampler_destroy(farDownsampler_);
+		speex_resampler_destroy(upsampler_);
+	}
+}
+
+void SpeexDSP::processInterleaved(qint16* main, const qint16* aux)
+{
+	TIMER(qDebug(Speex))
+
+	qDebug(Speex).noquote() << QString("got %1 near-end samples (%2ms)%3")
+	                               .arg(getFrameSize())
+	                               .arg(frameSizeMs)
+	                               .arg(aux ? " and as many far-end samples" : "");
+
+	Q_ASSERT(farEnd_ || aux);
+
+	if (pipelineDepth_ > 0)
+	{
+		const int mainSamples = getFrameSize() * getMainFormat().channelCount();
+		PipelineSlot& slot = currentPipelineSlot();
+		std::copy(main, main + mainSamples, slot.main.begin());
+		std::copy(aux, aux + getFrameSize() * getAuxFormat().channelCount(), slot.aux.begin());
+		slot.isFloat = false;
+		slot.cancelEcho = aecEnabled && !reducedRateActive_;
+
+		// The echo canceller runs on the pipeline thread
+		if (reducedRateActive_)
+			processReducedRate(slot.main.data(), aux);
+		else
+			setVoiceActive(speex_preprocess_run(preprocess_, slot.main.data()) == 1);
+
+		takePipelineOutput(advancePipeline(), main);
+		return;
+	}
+
+	if (reducedRateActive_)
+	{
+		processReducedRate(main, aux);
+		return;
+	}
+
+	bool voiceActive = (speex_preprocess_run(preprocess_, main) == 1);
+	setVoiceActive(voiceActive);
+
+	// A shared far end has been analysed by SpeexFarEnd::update() already
+	if (aecEnabled)
+		speex_echo_cancellation(echo_, main, farEnd_ ? nullptr : aux, main);
+}
+
+void SpeexDSP::processInterleavedFloat(float* main, const float* aux)
+{
+	TIMER(qDebug(Speex))
+
+	Q_ASSERT(farEnd_ || aux);
+
+	// The half-rate pipeline works on 16-bit samples
+	if (reducedRateActive_)
+	{
+		AudioEffect::processInterleavedFloat(main, aux);
+		return;
+	}
+
+	if (pipelineDepth_ > 0)
+	{
+		const int mainSamples = getFrameSize() * getMainFormat().channelCount();
+		PipelineSlot& slot = currentPipelineSlot();
+		std::copy(main, main + mainSamples, slot.mainFloat.begin());
+		std::copy(aux, aux + getFrameSize() * getAuxFormat().channelCount(),
+		          slot.auxFloat.begin());
+		slot.isFloat = true;
+		slot.cancelEcho = aecEnabled;
+
+		setVoiceActive(speex_preprocess_run_float(preprocess_, slot.mainFloat.data()) == 1);
+
+		takePipelineOutput(advancePipeline(), main);
+		return;
+	}
+
+	// Same as processInterleaved() without the 16-bit conversions and clipping of libspeexdsp
+	bool voiceActive = (speex_preprocess_run_float(preprocess_, main) == 1);
+	setVoiceActive(voiceActive);
+
+	if (aecEnabled)
+		speex_echo_cancellation_float(echo_, main, farEnd_ ? nullptr : aux, main);
+}
+
+void SpeexDSP::setParameter(const QString& param, QVariant value)
+{
+	if (param == "noise_reduction_enabled")
+		denoiseEnabled_ = value.toBool();
+	else if (param == "echo_cancellation_enabled")
+		aecEnabled = value.toBool();
+	else if (param == "echo_cancellation_sparse_decimation")
+	{
+		// Filter partitions with negligible energy are skipped and adapted every N-th frame only
+		sparseDecimation_ = value.toInt();
+	}
+	else if (param == "pipeline_depth")
+	{
+		setPipelineDepth(value.toInt());
+		return;
+	}
+	else if (preprocessRequests().contains(param))
+	{
+		// Kept to configure the half-rate preprocessor the same way when it is created
+		const int request = preprocessRequests().value(param);
+		spx_int32_t setting = value.toInt();
+		preprocessSettings_.insert(request, setting);
+		speex_preprocess_ctl(preprocess_, request, &setting);
+		if (reducedPreprocess_)
+			speex_preprocess_ctl(reducedPreprocess_, request, &setting);
+		return;
+	}
+	else
+		throw std::invalid_argument("Invalid param");
+
+	applyQualityTier();
+}
+
+void SpeexDSP::resetState()
+{
+	setPipelineDepth(0);
+	preprocessSettings_.clear();
+	denoiseEnabled_ = false;
+	sparseDecimation_ = 0;
+	aecEnabled = false;
+	reducedRateActive_ = false;
+
+	// A shared far end keeps its history, it belongs to the other legs too
+	speex_echo_state_reset(echo_);
+	speex_preprocess_state_reset(preprocess_);
+	configure(preprocess_, echo_, getMainFormat().sampleRate());
+	if (reducedEcho_)
+	{
+		speex_echo_state_reset(reducedEcho_);
+		speex_preprocess_state_reset(reducedPreprocess_);
+		configure(reducedPreprocess_, reducedEcho_, getMainFormat().sampleRate() / 2);
+	}
+	applyQualityTier();
+}
+
+void SpeexDSP::applyQualityTier()
+{
+	const QualityTier tier = getQualityTier();
+	drainPipeline();
+
+	const bool reduceRate = tier >= QualityTier::ReducedRate && canReduceRate();
+	if (reduceRate && !reducedRateActive_)
+	{
+		if (!reducedEcho_)
+			createReducedRatePipeline();
+		speex_resampler_reset_mem(nearDownsampler_);
+		speex_resampler_reset_mem(farDownsampler_);
+		speex_resampler_reset_mem(upsampler_);
+	}
+	reducedRateActive_ = reduceRate;
+
+	// A shorter tail is evaluated by skipping the partitions which hold no echo energy
+	spx_int32_t decimation = sparseDecimation_;
+	if (tier >= QualityTier::ShortEchoTail && decimation == 0)
+		decimation = degradedSparseDecimation;
+	spx_int32_t denoise = denoiseEnabled_ && tier < QualityTier::NoNoiseSuppression;
+
+	// SET_SPARSE makes every partition active again, only a new decimation is worth that
+	if (decimation != appliedSparseDecimation_)
+	{
+		speex_echo_ctl(echo_, SPEEX_ECHO_SET_SPARSE, &decimation);
+		if (reducedEcho_)
+			speex_echo_ctl(reducedEcho_, SPEEX_ECHO_SET_SPARSE, &decimation);
+		appliedSparseDecimation_ = decimation;
+	}
+	speex_preprocess_ctl(preprocess_, SPEEX_PREPROCESS_SET_DENOISE, &denoise);
+	if (reducedPreprocess_)
+		speex_preprocess_ctl(reducedPreprocess_, SPEEX_PREPROCESS_SET_DENOISE, &denoise);
+}
+
+bool SpeexDSP::canReduceRate() const
+{
+	// A shared far-end analyser runs at the full rate
+	return !farEnd_ && getFrameSize() % 2 == 0 &&
+	       getMainFormat().sampleRate() >= minReducedRateSampleRate;
+}
+
+void SpeexDSP::createReducedRatePipeline()
+{
+	const int frameSize = getFrameSize() / 2;
+	const int sampleRate = getMainFormat().sampleRate();
+	const int mainChannels = getMainFormat().channelCount();
+	const int auxChannels = getAuxFormat().channelCount();
+	int error = 0;
+
+	reducedEcho_ =
+	    speex_echo_state_init_mc(frameSize, frameSize * echoTailFrames, mainChannels, auxChannels);
+	speex_echo_ctl(reducedEcho_, SPEEX_ECHO_SET_SPARSE, &appliedSparseDecimation_);
+	reducedPreprocess_ = speex_preprocess_state_init(frameSize, sampleRate / 2);
+	configure(reducedPreprocess_, reducedEcho_, sampleRate / 2);
+
+	nearDownsampler_ = speex_resampler_init(mainChannels, sampleRate, sampleRate / 2,
+	                                        SPEEX_RESAMPLER_QUALITY_VOIP, &error);
+	farDownsampler_ = speex_resampler_init(auxChannels, sampleRate, sampleRate / 2,
+	                                       SPEEX_RESAMPLER_QUALITY_VOIP, &error);
+	upsampler_ = speex_resampler_init(mainChannels, sampleRate / 2, sampleRate,
+	                                  SPEEX_RESAMPLER_QUALITY_VOIP, &error);
+
+	reducedNear_.resize(frameSize * mainChannels);
+	reducedFar_.resize(frameSize * auxChannels);
+
+	qInfo(Speex) << "Created a half-rate pipeline at" << sampleRate / 2 << "Hz";
+}
+
+void SpeexDSP::processReducedRate(qint16* main, const qint16* aux)
+{
+	spx_uint32_t inLength = getFrameSize();
+	spx_uint32_t outLength = getFrameSize() / 2;
+	speex_resampler_process_interleaved_int(nearDownsampler_, main, &inLength, reducedNear_.data(),
+	                                        &outLength);
+
+	bool voiceActive = (speex_preprocess_run(reducedPreprocess_, reducedNear_.data()) == 1);
+	setVoiceActive(voiceActive);
+
+	if (aecEnabled)
+	{
+		inLength = getFrameSize();
+		outLength = getFrameSize() / 2;
+		speex_resampler_process_interleaved_int(farDownsampler_, aux, &inLength, reducedFar_.data(),
+		                                        &outLength);
+		speex_echo_cancellation(reducedEcho_, reducedNear_.data(), reducedFar_.data(),
+		                        reducedNear_.data());
+	}
+
+	inLength = getFrameSize() / 2;
+	outLength = getFrameSize();
+	speex_resampler_process_interleaved_int(upsampler_, reducedNear_.data(), &inLength, main,
+	                                        &outLength);
+}
+
+void SpeexDSP::setPipelineDepth(int depth)
+{
+	if (depth < 0 || depth > maxPipelineDepth)
+		throw std::invalid_argument("Invalid pipeline depth");
+	// The shared far end moves on with the other legs, it can't wait for a delayed canceller
+	if (depth > 0 && farEnd_)
+		throw std::invalid_argument("Pipelining needs a far end of its own");
+	if (depth == pipelineDepth_)
+		return;
+
+	stopPipeline();
+	pipelineDepth_ = depth;
+	pipelineSlots_.clear();
+	if (depth == 0)
+	{
+		qInfo(Speex) << "Pipelining disabled";
+		return;
+	}
+
+	const int mainSamples = getFrameSize() * getMainFormat().channelCount();
+	const int auxSamples = getFrameSize() * getAuxFormat().channelCount();
+	pipelineSlots_.resize(depth + 1);
+	for (PipelineSlot& slot : pipelineSlots_)
+	{
+		slot.main.resize(mainSamples);
+		slot.aux.resize(auxSamples);
+		slot.mainFloat.resize(mainSamples);
+		slot.auxFloat.resize(auxSamples);
+	}
+	qInfo(Speex).nospace() << "Pipelining the echo canceller, " << depth << " frames ("
+	                       << depth * frameSizeMs << "ms) of added latency";
+}
+
+void SpeexDSP::stopPipeline()
+{
+	if (pipelineThread_.joinable())
+	{
+		{
+			std::unique_lock<std::mutex> lock(pipelineMutex_);
+			pipelineStop_ = true;
+		}
+		pipelineWork_.notify_one();
+		pipelineThread_.join();
+	}
+	pipelineStop_ = false;
+	pipelineSubmitted_ = 0;
+	pipelineCompleted_ = 0;
+}
+
+void SpeexDSP::drainPipeline() const
+{
+	std::unique_lock<std::mutex> lock(pipelineMutex_);
+	pipelineDone_.wait(lock, [this] { return pipelineCompleted_ == pipelineSubmitted_; });
+}
+
+void SpeexDSP::runPipeline()
+{
+	std::unique_lock<std::mutex> lock(pipelineMutex_);
+	for (;;)
+	{
+		pipelineWork_.wait(
+		    lock, [this] { return pipelineStop_ || pipelineCompleted_ < pipelineSubmitted_; });
+		if (pipelineStop_)
+			return;
+
+		PipelineSlot& slot = pipelineSlots_[pipelineCompleted_ % pipelineSlots_.size()];
+		lock.unlock();
+		if (slot.cancelEcho && slot.isFloat)
+		{
+			speex_echo_cancellation_float(echo_, slot.mainFloat.data(), slot.auxFloat.constData(),
+			                              slot.mainFloat.data());
+		}
+		else if (slot.cancelEcho)
+		{
+			speex_echo_cancellation(echo_, slot.main.data(), slot.aux.constData(),
+			                        slot.main.data());
+		}
+		lock.lock();
+
+		++pipelineCompleted_;
+		pipelineDone_.notify_one();
+	}
+}
+
+SpeexDSP::PipelineSlot& SpeexDSP::currentPipelineSlot()
+{
+	if (!pipelineThread_.joinable())
+		pipelineThread_ = std::thread(&SpeexDSP::runPipeline, this);
+
+	// Free: its frame left the pipeline on an earlier call. Only this thread writes the count.
+	return pipelineSlots_[pipelineSubmitted_ % pipelineSlots_.size()];
+}
+
+const SpeexDSP::PipelineSlot* SpeexDSP::advancePipeline()
+{
+	std::unique_lock<std::mutex> lock(pipelineMutex_);
+	++pipelineSubmitted_;
+	pipelineWork_.notify_one();
+	if (pipelineSubmitted_ <= quint64(pipelineDepth_))
+		return nullptr;
+
+	const quint64 oldest = pipelineSubmitted_ - pipelineDepth_ - 1;
+	pipelineDone_.wait(lock, [this, oldest] { return pipelineCompleted_ > oldest; });
+	return &pipelineSlots_[oldest % pipelineSlots_.size()];
+}
+
+void SpeexDSP::takePipelineOutput(const PipelineSlot* slot, qint16* main) const
+{
+	const int samples = getFrameSize() * getMainFormat().channelCount();
+	if (!slot)
+		std::fill(main, main + samples, 0);
+	else if (slot->isFloat)
+		floatToInt16(slot->mainFloat.constData(), main, samples);
+	else
+		std::copy(slot->main.begin(), slot->main.end(), main);
+}
+
+void SpeexDSP::takePipelineOutput(const PipelineSlot* slot, float* main) const
+{
+	const int samples = getFrameSize() * getMainFormat().channelCount();
+	if (!slot)
+		std::fill(main, main + samples, 0.0f);
+	else if (slot->isFloat)
+		std::copy(slot->mainFloat.begin(), slot->mainFloat.end(), main);
+	else
+		int16ToFloat(slot->main.constData(), main, samples);
+}
+
+unsigned int SpeexDSP::requiredFrameSizeMs() const
+{
+	return frameSizeMs;
+}
+
+void SpeexDSP::saveAdaptiveState(QDataStream& out) const
+{
+	spx_int32_t size = 0;
+	drainPipeline();
+
+	speex_echo_ctl(echo_, SPEEX_ECHO_GET_STATE_SIZE, &size);
+	QByteArray echoState(size, Qt::Uninitialized);
+	speex_echo_ctl(echo_, SPEEX_ECHO_GET_STATE, echoState.data());
+
+	speex_preprocess_ctl(preprocess_, SPEEX_PREPROCESS_GET_STATE_SIZE, &size);
+	QByteArray preprocessState(size, Qt::Uninitialized);
+	speex_preprocess_ctl(preprocess_, SPEEX_PREPROCESS_GET_STATE, preprocessState.data());
+
+	out << echoState << preprocessState;
+}
+
+bool SpeexDSP::restoreAdaptiveState(QDataStream& in)
+{
+	QByteArray echoState;
+	QByteArray preprocessState;
+	in >> echoState >> preprocessState;
+	if (in.status() != QDataStream::Ok)
+		return false;
+
+	spx_int32_t echoSize = 0;
+	spx_int32_t preprocessSize = 0;
+	drainPipeline();
+	speex_echo_ctl(echo_, SPEEX_ECHO_GET_STATE_SIZE, &echoSize);
+	speex_preprocess_ctl(preprocess_, SPEEX_PREPROCESS_GET_STATE_SIZE, &preprocessSize);
+	if (echoState.size() != echoSize || preprocessState.size() != preprocessSize)
+		return false;
+
+	// Both ctls check the snapshot header before they write anything, so only a preprocessor
+	// mismatch after a successful echo restore needs undoing
+	QByteArray previousEchoState(echoSize, Qt::Uninitialized);
+	speex_echo_ctl(echo_, SPEEX_ECHO_GET_STATE, previousEchoState.data());
+	if (speex_echo_ctl(echo_, SPEEX_ECHO_SET_STATE, echoState.data()) != 0)
+		return false;
+	if (speex_preprocess_ctl(preprocess_, SPEEX_PREPROCESS_SET_STATE, preprocessState.data()) != 0)
+	{
+		speex_echo_ctl(echo_, SPEEX_ECHO_SET_STATE, previousEchoState.data());
+		return false;
+	}
+	return true;
+}
+
+} // namespace SpeexWebRTCTest
@@ -0,0 +1,148 @@
+#ifndef _SPEEXDSP_EFFECT_H_
+#define _SPEEXDSP_EFFECT_H_
+
+#include "AudioEffect.h"
+
+#include <QMap>
+#include <QSharedPointer>
+#include <QVector>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct SpeexPreprocessState_;
+typedef struct SpeexPreprocessState_ SpeexPreprocessState;
+struct SpeexEchoState_;
+typedef struct SpeexEchoState_ SpeexEchoState;
+struct SpeexEchoReference_;
+typedef struct SpeexEchoReference_ SpeexEchoReference;
+struct SpeexResamplerState_;
+typedef struct SpeexResamplerState_ SpeexResamplerState;
+
+namespace SpeexWebRTCTest {
+
+// Far-end analysis shared by the echo cancellers of all the SpeexDSP instances that hear the same
+// far-end signal (conference mode). update() must be called once per frame before any of them
+// processes that frame.
+class SpeexFarEnd final
+{
+public:
+	explicit SpeexFarEnd(const QAudioFormat& format);
+	~SpeexFarEnd();
+
+	unsigned int getFrameSize() const;
+	const QAudioFormat& getFormat() const;
+
+	void update(const QAudioBuffer& farEnd);
+	// Interleaved getFrameSize() samples of the format
+	void update(const qint16* farEnd);
+	void update(const float* farEnd);
+
+private:
+	friend class SpeexDSP;
+
+	const QAudioFormat format_;
+	SpeexEchoReference* reference_ = nullptr;
+};
+
+// "pipeline_depth" splits a frame between two threads for configurations which don't fit one
+// core's frame budget (many channels, long echo tails): the preprocessor (noise suppression,
+// AGC, VAD) runs on the calling thread while the echo canceller works on the previous frame on a
+// thread of the effect. The output is delayed by that many frames, silence at first, and the
+// voice activity leads it by as much. Frames in flight are dropped when the depth changes.
+class SpeexDSP final : public AudioEffect
+{
+	Q_OBJECT
+public:
+	SpeexDSP(const QAudioFormat& mainFormat, const QAudioFormat& auxFormat);
+	// Conference mode: the aux frame passed to process() is ignored, the far end comes from the
+	// shared analyser instead
+	SpeexDSP(const QAudioFormat& mainFormat, QSharedPointer<SpeexFarEnd> farEnd);
+	~SpeexDSP() override;
+
+	void setParameter(const QString& param, QVariant value) override;
+
+private:
+	// One frame between the two pipeline stages, in the sample type it was given
+	struct PipelineSlot
+	{
+		QVector<qint16> main;
+		QVector<qint16> aux;
+		QVector<float> mainFloat;
+		QVector<float> auxFloat;
+		bool isFloat = false;
+		// Off for frames which need no echo cancellation or went through the half-rate pipeline
+		bool cancelEcho = false;
+	};
+
+	unsigned int requiredFrameSizeMs() const override;
+	void processInterleaved(qint16* main, const qint16* aux) override;
+	void processInterleavedFloat(float* main, const float* aux) override;
+
+	void saveAdaptiveState(QDataStream& out) const override;
+	bool restoreAdaptiveState(QDataStream& in) override;
+	void resetState() override;
+	void applyQualityTier() override;
+
+	void initialize();
+	void configure(SpeexPreprocessState* preprocess, SpeexEchoState* echo, int sampleRate);
+	bool canReduceRate() const;
+	void createReducedRatePipeline();
+	void processReducedRate(qint16* main, const qint16* aux);
+
+	void setPipelineDepth(int depth);
+	void stopPipeline();
+	// Waits for the pipeline thread to be done with the frames handed over, before echo_ is used
+	// on the calling thread
+	void drainPipeline() const;
+	void runPipeline();
+	PipelineSlot& currentPipelineSlot();
+	// Hands over the current slot and returns the one of the frame leaving the pipeline, nullptr
+	// while the pipeline fills up
+	const PipelineSlot* advancePipeline();
+	void takePipelineOutput(const PipelineSlot* slot, qint16* main) const;
+	void takePipelineOutput(const PipelineSlot* slot, float* main) const;
+
+	SpeexPreprocessState* preprocess_ = nullptr;
+	SpeexEchoState* echo_ = nullptr;
+	QSharedPointer<SpeexFarEnd> farEnd_;
+
+	// Half-rate pipeline used from QualityTier::ReducedRate down, created on first use
+	SpeexPreprocessState* reducedPreprocess_ = nullptr;
+	SpeexEchoState* reducedEcho_ = nullptr;
+	SpeexResamplerState* nearDownsampler_ = nullptr;
+	SpeexResamplerState* farDownsampler_ = nullptr;
+	SpeexResamplerState* upsampler_ = nullptr;
+	QVector<qint16> reducedNear_;
+	QVector<qint16> reducedFar_;
+	bool reducedRateActive_ = false;
+
+	// Settings as requested, before the quality tier overrides them
+	QMap<int, qint32> preprocessSettings_;
+	bool denoiseEnabled_ = false;
+	qint32 sparseDecimation_ = 0;
+	// Decimation echo_ and reducedEcho_ run with, after the quality tier
+	qint32 appliedSparseDecimation_ = 0;
+
+	bool aecEnabled = false;
+
+	// Added latency in frames, 0 processes each frame on the calling thread only
+	int pipelineDepth_ = 0;
+	// Frame n goes into slot n % (depth + 1)
+	std::vector<PipelineSlot> pipelineSlots_;
+	mutable std::mutex pipelineMutex_;
+	std::condition_variable pipelineWork_;
+	mutable std::condition_variable pipelineDone_;
+	quint64 pipelineSubmitted_ = 0;
+	quint64 pipelineCompleted_ = 0;
+	bool pipelineStop_ = false;
+	// Started by the first pipelined frame, so that it inherits the scheduling and CPU affinity of
+	// the processing thread
+	std::thread pipelineThread_;
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _SPEEXDSP_EFFECT_H_
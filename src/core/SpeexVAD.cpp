@@ -0,0 +1,95 @@
+#include "SpeexVAD.h"
+
+#include <speex/speex_preprocess.h>
+
+#include <stdexcept>
+
+namespace SpeexWebRTCTest {
+
+namespace {
+// Same framing as SpeexDSP, so that the decisions line up frame for frame
+const unsigned int frameSizeMs = 25;
+// Hysteresis of the preprocessor, in percent of speech probability
+const spx_int32_t defaultProbabilityStart = 35;
+const spx_int32_t defaultProbabilityContinue = 20;
+
+template <typename Sample>
+const Sample* downmix(const Sample* frame, int frames, int channels, QVector<Sample>& mono)
+{
+	if (channels == 1)
+		return frame;
+
+	mono.resize(frames);
+	for (int i = 0; i < frames; ++i)
+	{
+		float sum = 0;
+		for (int channel = 0; channel < channels; ++channel)
+			sum += frame[i * channels + channel];
+		mono[i] = Sample(sum / channels);
+	}
+	return mono.constData();
+}
+} // namespace
+
+SpeexVAD::SpeexVAD(const QAudioFormat& format) : AudioEffect(format, format)
+{
+	vad_ = speex_vad_state_init(getFrameSize(), getMainFormat().sampleRate());
+	if (!vad_)
+		throw std::invalid_argument("VAD-only analysis isn't available for this format");
+}
+
+SpeexVAD::~SpeexVAD()
+{
+	speex_vad_state_destroy(vad_);
+}
+
+void SpeexVAD::setParameter(const QString& param, QVariant value)
+{
+	spx_int32_t setting = value.toInt();
+	if (param == "vad_probability_start")
+		speex_vad_ctl(vad_, SPEEX_PREPROCESS_SET_PROB_START, &setting);
+	else if (param == "vad_probability_continue")
+		speex_vad_ctl(vad_, SPEEX_PREPROCESS_SET_PROB_CONTINUE, &setting);
+	else if (param == "vad_hangover_ms")
+	{
+		// Rounded up to whole frames
+		setting = (setting + frameSizeMs - 1) / frameSizeMs;
+		speex_vad_ctl(vad_, SPEEX_VAD_SET_HANGOVER, &setting);
+	}
+	else
+		throw std::invalid_argument("Invalid param");
+}
+
+unsigned int SpeexVAD::requiredFrameSizeMs() const
+{
+	return frameSizeMs;
+}
+
+void SpeexVAD::processInterleaved(qint16* main, const qint16* aux)
+{
+	Q_UNUSED(aux);
+	const qint16* frame =
+	    downmix<qint16>(main, getFrameSize(), getMainFormat().channelCount(), mono_);
+	setVoiceActive(speex_vad_run(vad_, frame) == 1);
+}
+
+void SpeexVAD::processInterleavedFloat(float* main, const float* aux)
+{
+	Q_UNUSED(aux);
+	const float* frame =
+	    downmix<float>(main, getFrameSize(), getMainFormat().channelCount(), monoFloat_);
+	setVoiceActive(speex_vad_run_float(vad_, frame) == 1);
+}
+
+void SpeexVAD::resetState()
+{
+	spx_int32_t start = defaultProbabilityStart;
+	spx_int32_t proceed = defaultProbabilityContinue;
+	spx_int32_t hangover = 0;
+	speex_vad_ctl(vad_, SPEEX_PREPROCESS_SET_PROB_START, &start);
+	speex_vad_ctl(vad_, SPEEX_PREPROCESS_SET_PROB_CONTINUE, &proceed);
+	speex_vad_ctl(vad_, SPEEX_VAD_SET_HANGOVER, &hangover);
+	speex_vad_state_reset(vad_);
+}
+
+} // namespace SpeexWebRTCTest
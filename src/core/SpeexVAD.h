@@ -0,0 +1,41 @@
+#ifndef _SPEEXVAD_EFFECT_H_
+#define _SPEEXVAD_EFFECT_H_
+
+#include "AudioEffect.h"
+
+#include <QVector>
+
+struct SpeexVadState_;
+typedef struct SpeexVadState_ SpeexVadState;
+
+namespace SpeexWebRTCTest {
+
+// Voice activity detection alone, for legs which only need the decisions (talker detection,
+// recording triggers). Uses the speech probability estimator of the Speex preprocessor without
+// its noise suppression and synthesis, at the same frame size as SpeexDSP; the audio is left
+// untouched and the aux frame is ignored.
+class SpeexVAD final : public AudioEffect
+{
+	Q_OBJECT
+public:
+	explicit SpeexVAD(const QAudioFormat& format);
+	~SpeexVAD() override;
+
+	void setParameter(const QString& param, QVariant value) override;
+
+private:
+	unsigned int requiredFrameSizeMs() const override;
+	void processInterleaved(qint16* main, const qint16* aux) override;
+	void processInterleavedFloat(float* main, const float* aux) override;
+	void resetState() override;
+
+	SpeexVadState* vad_ = nullptr;
+
+	// Multichannel frames are downmixed before the analysis
+	QVector<qint16> mono_;
+	QVector<float> monoFloat_;
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _SPEEXVAD_EFFECT_H_
@@ -0,0 +1,91 @@
+#include "StreamMetrics.h"
+
+#include "AllocationCounter.h"
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace SpeexWebRTCTest {
+
+namespace {
+// The audio thread is the only writer, a plain store is enough and avoids a locked instruction
+template <typename T>
+void add(std::atomic<T>& counter, T value)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+} // namespace
+
+std::chrono::nanoseconds threadCpuTime()
+{
+#if defined(Q_OS_WIN)
+	FILETIME creation, exit, kernel, user;
+	if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+		return std::chrono::nanoseconds(0);
+	const auto ticks = [](const FILETIME& time)
+	{ return (quint64(time.dwHighDateTime) << 32) | time.dwLowDateTime; };
+	// 100 ns units
+	return std::chrono::nanoseconds((ticks(kernel) + ticks(user)) * 100);
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+	timespec time;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0)
+		return std::chrono::nanoseconds(0);
+	return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+#else
+	return std::chrono::nanoseconds(0);
+#endif
+}
+
+double StreamMetricsSnapshot::vadRatio() const
+{
+	return frames ? double(voiceFrames) / frames : 0;
+}
+
+void StreamMetrics::beginFrame()
+{
+	frameStart_ = std::chrono::steady_clock::now();
+	cpuStart_ = threadCpuTime();
+	allocationsStart_ = threadAllocations();
+}
+
+void StreamMetrics::endFrame(std::chrono::nanoseconds period, bool voice)
+{
+	const quint64 allocations = threadAllocations() - allocationsStart_;
+	const std::chrono::nanoseconds cpu = threadCpuTime() - cpuStart_;
+	const std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - frameStart_;
+
+	add(frames_, quint64(1));
+	add(cpuNanoseconds_, qint64(cpu.count()));
+	add(processingNanoseconds_, qint64(elapsed.count()));
+	if (elapsed > period)
+		add(deadlineMisses_, quint64(1));
+	if (voice)
+		add(voiceFrames_, quint64(1));
+	add(allocations_, allocations);
+}
+
+void StreamMetrics::setQueueDepths(quint64 inputFrames, quint64 outputFrames)
+{
+	inputQueueFrames_.store(inputFrames, std::memory_order_relaxed);
+	outputQueueFrames_.store(outputFrames, std::memory_order_relaxed);
+}
+
+StreamMetricsSnapshot StreamMetrics::snapshot() const
+{
+	StreamMetricsSnapshot snapshot;
+	snapshot.frames = frames_.load(std::memory_order_relaxed);
+	snapshot.cpuTime = std::chrono::nanoseconds(cpuNanoseconds_.load(std::memory_order_relaxed));
+	snapshot.processingTime =
+	    std::chrono::nanoseconds(processingNanoseconds_.load(std::memory_order_relaxed));
+	snapshot.deadlineMisses = deadlineMisses_.load(std::memory_order_relaxed);
+	snapshot.voiceFrames = voiceFrames_.load(std::memory_order_relaxed);
+	snapshot.allocations = allocations_.load(std::memory_order_relaxed);
+	snapshot.inputQueueFrames = inputQueueFrames_.load(std::memory_order_relaxed);
+	snapshot.outputQueueFrames = outputQueueFrames_.load(std::memory_order_relaxed);
+	return snapshot;
+}
+
+} // namespace SpeexWebRTCTest
@@ -0,0 +1,65 @@
+#ifndef _STREAM_METRICS_H_
+#define _STREAM_METRICS_H_
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <chrono>
+
+namespace SpeexWebRTCTest {
+
+// CPU time used so far by the calling thread, zero on platforms which don't tell
+std::chrono::nanoseconds threadCpuTime();
+
+struct StreamMetricsSnapshot
+{
+	quint64 frames = 0;
+	// Thread CPU time and wall time spent processing frames
+	std::chrono::nanoseconds cpuTime{0};
+	std::chrono::nanoseconds processingTime{0};
+	// Frames which took longer than the frame period
+	quint64 deadlineMisses = 0;
+	// Frames processed while the effect reported voice, see AudioEffect::voiceActivityChanged()
+	quint64 voiceFrames = 0;
+	// operator new calls of the audio thread while processing frames
+	quint64 allocations = 0;
+	// Frames waiting before and after the effect when the last frame was done
+	quint64 inputQueueFrames = 0;
+	quint64 outputQueueFrames = 0;
+
+	double vadRatio() const;
+};
+
+// Resource accounting of one processing stream. The audio thread records with relaxed atomic
+// stores only, so it never waits for a reader; snapshot() may be called from any thread, its
+// counters are each consistent but not taken at the same instant.
+class StreamMetrics final
+{
+public:
+	// Audio thread, around the processing of every frame
+	void beginFrame();
+	void endFrame(std::chrono::nanoseconds period, bool voice);
+	// Audio thread, queue depths in frames
+	void setQueueDepths(quint64 inputFrames, quint64 outputFrames);
+
+	StreamMetricsSnapshot snapshot() const;
+
+private:
+	// Only touched by the audio thread
+	std::chrono::steady_clock::time_point frameStart_;
+	std::chrono::nanoseconds cpuStart_{0};
+	quint64 allocationsStart_ = 0;
+
+	std::atomic<quint64> frames_{0};
+	std::atomic<qint64> cpuNanoseconds_{0};
+	std::atomic<qint64> processingNanoseconds_{0};
+	std::atomic<quint64> deadlineMisses_{0};
+	std::atomic<quint64> voiceFrames_{0};
+	std::atomic<quint64> allocations_{0};
+	std::atomic<quint64> inputQueueFrames_{0};
+	std::atomic<quint64> outputQueueFrames_{0};
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _STREAM_METRICS_H_
@@ -0,0 +1,56 @@
+#ifndef _TRACE_FORMAT_H_
+#define _TRACE_FORMAT_H_
+
+#include <QAudioFormat>
+#include <QDataStream>
+
+namespace SpeexWebRTCTest {
+
+// Session trace layout: a header with both stream formats, then qCompress()ed blocks, each one
+// prefixed with its compressed size (quint32). A decompressed block is a sequence of events:
+// [quint8 type][quint64 nanoseconds since the trace was opened][payload]
+const quint32 traceMagic = 0x52545753; // "SWTR"
+const quint16 traceVersion = 1;
+
+enum class TraceEvent : quint8
+{
+	Backend,      // quint8 backend
+	Parameter,    // QString name, QVariant value
+	CaptureWrite, // quint32 bytes, quint32 input queue bytes
+	MonitorWrite, // quint32 bytes, quint32 monitor queue bytes
+	PlaybackRead, // quint32 requested, quint32 returned, quint32 output queue bytes
+	Frame         // quint32 input, monitor and output queue bytes, bool far-end underrun,
+	              // QByteArray near-end, QByteArray far-end
+};
+
+inline void writeTraceFormat(QDataStream& out, const QAudioFormat& format)
+{
+	out << quint32(format.sampleRate());
+	out << quint16(format.channelCount());
+	out << quint16(format.sampleSize());
+	out << quint8(format.sampleType());
+	out << quint8(format.byteOrder());
+}
+
+inline QAudioFormat readTraceFormat(QDataStream& in)
+{
+	quint32 sampleRate;
+	quint16 channelCount;
+	quint16 sampleSize;
+	quint8 sampleType;
+	quint8 byteOrder;
+	in >> sampleRate >> channelCount >> sampleSize >> sampleType >> byteOrder;
+
+	QAudioFormat format;
+	format.setSampleRate(sampleRate);
+	format.setChannelCount(channelCount);
+	format.setSampleSize(sampleSize);
+	format.setCodec("audio/pcm");
+	format.setSampleType(static_cast<QAudioFormat::SampleType>(sampleType));
+	format.setByteOrder(static_cast<QAudioFormat::Endian>(byteOrder));
+	return format;
+}
+
+} // namespace SpeexWebRTCTest
+
+#endif // _TRACE_FORMAT_H_
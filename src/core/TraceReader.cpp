@@ -0,0 +1,147 @@
+#include "TraceReader.h"
+
+namespace SpeexWebRTCTest {
+
+TraceReader::TraceReader(const QString& fileName)
+    : file_(fileName)
+{
+}
+
+bool TraceReader::open()
+{
+	if (!file_.open(QIODevice::ReadOnly))
+	{
+		error_ = file_.errorString();
+		return false;
+	}
+
+	fileStream_.setDevice(&file_);
+	fileStream_.setByteOrder(QDataStream::LittleEndian);
+
+	quint32 magic;
+	quint16 version;
+	fileStream_ >> magic >> version;
+	if (magic != traceMagic || version != traceVersion)
+	{
+		error_ = QStringLiteral("Not a session trace or unsupported version");
+		return false;
+	}
+
+	format_ = readTraceFormat(fileStream_);
+	monitorFormat_ = readTraceFormat(fileStream_);
+
+	if (fileStream_.status() != QDataStream::Ok)
+	{
+		error_ = QStringLiteral("Truncated trace header");
+		return false;
+	}
+
+	blockStream_.setByteOrder(QDataStream::LittleEndian);
+	return true;
+}
+
+const QAudioFormat& TraceReader::getFormat() const
+{
+	return format_;
+}
+
+const QAudioFormat& TraceReader::getMonitorFormat() const
+{
+	return monitorFormat_;
+}
+
+bool TraceReader::readEvent(TraceRecord& record)
+{
+	if (!block_.isOpen() || block_.atEnd())
+	{
+		if (!readBlock())
+			return false;
+	}
+
+	quint8 type;
+	quint64 timestamp;
+	blockStream_ >> type >> timestamp;
+
+	record = TraceRecord();
+	record.type = static_cast<TraceEvent>(type);
+	record.timestamp = timestamp;
+
+	quint32 a, b, c;
+	switch (record.type)
+	{
+	case TraceEvent::Backend:
+		blockStream_ >> record.backend;
+		break;
+	case TraceEvent::Parameter:
+		blockStream_ >> record.name >> record.value;
+		break;
+	case TraceEvent::CaptureWrite:
+		blockStream_ >> a >> b;
+		record.bytes = a;
+		record.inputQueue = b;
+		break;
+	case TraceEvent::MonitorWrite:
+		blockStream_ >> a >> b;
+		record.bytes = a;
+		record.monitorQueue = b;
+		break;
+	case TraceEvent::PlaybackRead:
+		blockStream_ >> a >> b >> c;
+		record.requested = a;
+		record.bytes = b;
+		record.outputQueue = c;
+		break;
+	case TraceEvent::Frame:
+		blockStream_ >> a >> b >> c;
+		record.inputQueue = a;
+		record.monitorQueue = b;
+		record.outputQueue = c;
+		blockStream_ >> record.farEndUnderrun >> record.nearEnd >> record.farEnd;
+		break;
+	default:
+		error_ = QStringLiteral("Unknown trace event %1").arg(type);
+		return false;
+	}
+
+	if (blockStream_.status() != QDataStream::Ok)
+	{
+		error_ = QStringLiteral("Corrupted trace block");
+		return false;
+	}
+
+	return true;
+}
+
+QString TraceReader::errorString() const
+{
+	return error_;
+}
+
+bool TraceReader::readBlock()
+{
+	if (file_.atEnd())
+		return false;
+
+	quint32 size;
+	fileStream_ >> size;
+	QByteArray compressed(size, Qt::Uninitialized);
+	if (fileStream_.readRawData(compressed.data(), size) != int(size))
+	{
+		error_ = QStringLiteral("Truncated trace block");
+		return false;
+	}
+
+	block_.close();
+	block_.setData(qUncompress(compressed));
+	if (block_.data().isEmpty())
+	{
+		error_ = QStringLiteral("Unable to decompress trace block");
+		return false;
+	}
+	block_.open(QIODevice::ReadOnly);
+	blockStream_.setDevice(&block_);
+	blockStream_.resetStatus();
+	return true;
+}
+
+} // namespace SpeexWebRTCTest
@@ -0,0 +1,67 @@
+#ifndef _TRACE_READER_H_
+#define _TRACE_READER_H_
+
+#include "TraceFormat.h"
+
+#include <QAudioFormat>
+#include <QBuffer>
+#include <QDataStream>
+#include <QFile>
+#include <QVariant>
+
+namespace SpeexWebRTCTest {
+
+// One decoded trace event; only the fields relevant to its type are set
+struct TraceRecord
+{
+	TraceEvent type = TraceEvent::Frame;
+	quint64 timestamp = 0; // nanoseconds since the trace was opened
+
+	quint8 backend = 0;
+	QString name;
+	QVariant value;
+
+	qint64 bytes = 0;
+	qint64 requested = 0;
+	qint64 inputQueue = 0;
+	qint64 monitorQueue = 0;
+	qint64 outputQueue = 0;
+
+	bool farEndUnderrun = false;
+	QByteArray nearEnd;
+	QByteArray farEnd;
+};
+
+// Reads a session trace recorded by TraceWriter
+class TraceReader final
+{
+public:
+	explicit TraceReader(const QString& fileName);
+
+	bool open();
+
+	const QAudioFormat& getFormat() const;
+	const QAudioFormat& getMonitorFormat() const;
+
+	// Returns false at the end of the trace or on error (see errorString())
+	bool readEvent(TraceRecord& record);
+	QString errorString() const;
+
+private:
+	bool readBlock();
+
+	QFile file_;
+	QDataStream fileStream_;
+
+	QAudioFormat format_;
+	QAudioFormat monitorFormat_;
+
+	QBuffer block_;
+	QDataStream blockStream_;
+
+	QString error_;
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _TRACE_READER_H_
@@ -0,0 +1,197 @@
+#include "TraceWriter.h"
+
+#include <QLoggingCategory>
+
+namespace SpeexWebRTCTest {
+
+namespace {
+Q_LOGGING_CATEGORY(Trace, "trace")
+
+// Uncompressed size of a block handed over to the compressor thread
+const int blockSize = 64 * 1024;
+// Blocks waiting for compression before new ones are dropped (the disk can't keep up)
+const std::size_t maxPendingBlocks = 64;
+} // namespace
+
+TraceWriter::~TraceWriter()
+{
+	close();
+}
+
+bool TraceWriter::open(const QString& fileName,
+                       const QAudioFormat& format,
+                       const QAudioFormat& monitorFormat)
+{
+	close();
+
+	std::unique_lock<std::mutex> lock(mutex_);
+
+	file_.setFileName(fileName);
+	if (!file_.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		qWarning(Trace).noquote() << "Unable to open" << fileName << ":" << file_.errorString();
+		return false;
+	}
+
+	QDataStream out(&file_);
+	out.setByteOrder(QDataStream::LittleEndian);
+	out << traceMagic << traceVersion;
+	writeTraceFormat(out, format);
+	writeTraceFormat(out, monitorFormat);
+
+	block_.buffer().clear();
+	block_.open(QIODevice::WriteOnly);
+	blockStream_.setDevice(&block_);
+	blockStream_.setByteOrder(QDataStream::LittleEndian);
+
+	droppedBlocks_ = 0;
+	start_ = std::chrono::steady_clock::now();
+	open_ = true;
+
+	compressor_ = std::thread([this] { compress(); });
+	return true;
+}
+
+void TraceWriter::close()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (!open_)
+			return;
+
+		if (block_.size() > 0)
+			pendingBlocks_.push_back(block_.data());
+		block_.close();
+
+		open_ = false;
+		blockEvent_.notify_all();
+	}
+
+	// The compressor drains the pending blocks before exiting
+	compressor_.join();
+	file_.close();
+
+	if (droppedBlocks_ > 0)
+		qWarning(Trace) << "Dropped" << droppedBlocks_ << "trace blocks, disk is too slow";
+}
+
+bool TraceWriter::isOpen() const
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	return open_;
+}
+
+void TraceWriter::writeBackend(quint8 backend)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (!open_)
+		return;
+	beginEvent(TraceEvent::Backend);
+	blockStream_ << backend;
+	endEvent();
+}
+
+void TraceWriter::writeParameter(const QString& name, const QVariant& value)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (!open_)
+		return;
+	beginEvent(TraceEvent::Parameter);
+	blockStream_ << name << value;
+	endEvent();
+}
+
+void TraceWriter::writeCapture(qint64 bytes, qint64 inputQueue)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (!open_)
+		return;
+	beginEvent(TraceEvent::CaptureWrite);
+	blockStream_ << quint32(bytes) << quint32(inputQueue);
+	endEvent();
+}
+
+void TraceWriter::writeMonitor(qint64 bytes, qint64 monitorQueue)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (!open_)
+		return;
+	beginEvent(TraceEvent::MonitorWrite);
+	blockStream_ << quint32(bytes) << quint32(monitorQueue);
+	endEvent();
+}
+
+void TraceWriter::writePlayback(qint64 requested, qint64 returned, qint64 outputQueue)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (!open_)
+		return;
+	beginEvent(TraceEvent::PlaybackRead);
+	blockStream_ << quint32(requested) << quint32(returned) << quint32(outputQueue);
+	endEvent();
+}
+
+void TraceWriter::writeFrame(const QByteArray& nearEnd,
+                             const QByteArray& farEnd,
+                             bool farEndUnderrun,
+                             qint64 inputQueue,
+                             qint64 monitorQueue,
+                             qint64 outputQueue)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (!open_)
+		return;
+	beginEvent(TraceEvent::Frame);
+	blockStream_ << quint32(inputQueue) << quint32(monitorQueue) << quint32(outputQueue);
+	blockStream_ << farEndUnderrun << nearEnd << farEnd;
+	endEvent();
+}
+
+void TraceWriter::beginEvent(TraceEvent type)
+{
+	auto timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+	    std::chrono::steady_clock::now() - start_);
+	blockStream_ << quint8(type) << quint64(timestamp.count());
+}
+
+void TraceWriter::endEvent()
+{
+	if (block_.size() < blockSize)
+		return;
+
+	if (pendingBlocks_.size() < maxPendingBlocks)
+	{
+		pendingBlocks_.push_back(block_.data());
+		blockEvent_.notify_all();
+	}
+	else
+		++droppedBlocks_;
+
+	block_.buffer().clear();
+	block_.seek(0);
+}
+
+void TraceWriter::compress()
+{
+	QDataStream out(&file_);
+	out.setByteOrder(QDataStream::LittleEndian);
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (true)
+	{
+		blockEvent_.wait(lock, [this] { return !pendingBlocks_.empty() || !open_; });
+		if (pendingBlocks_.empty())
+			break;
+
+		QByteArray block = std::move(pendingBlocks_.front());
+		pendingBlocks_.pop_front();
+
+		lock.unlock();
+		QByteArray compressed = qCompress(block);
+		out << quint32(compressed.size());
+		out.writeRawData(compressed.constData(), compressed.size());
+		lock.lock();
+	}
+}
+
+} // namespace SpeexWebRTCTest
@@ -0,0 +1,68 @@
+#ifndef _TRACE_WRITER_H_
+#define _TRACE_WRITER_H_
+
+#include "TraceFormat.h"
+
+#include <QAudioFormat>
+#include <QBuffer>
+#include <QDataStream>
+#include <QFile>
+#include <QVariant>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace SpeexWebRTCTest {
+
+// Records a session trace (see TraceFormat.h). Events are serialized by the calling thread into
+// an in-memory block; full blocks are compressed and written to disk by a background thread.
+// All methods are thread-safe, and recording methods are no-ops while the trace is closed.
+class TraceWriter final
+{
+public:
+	TraceWriter() = default;
+	~TraceWriter();
+
+	bool open(const QString& fileName, const QAudioFormat& format, const QAudioFormat& monitorFormat);
+	void close();
+	bool isOpen() const;
+
+	void writeBackend(quint8 backend);
+	void writeParameter(const QString& name, const QVariant& value);
+	void writeCapture(qint64 bytes, qint64 inputQueue);
+	void writeMonitor(qint64 bytes, qint64 monitorQueue);
+	void writePlayback(qint64 requested, qint64 returned, qint64 outputQueue);
+	void writeFrame(const QByteArray& nearEnd,
+	                const QByteArray& farEnd,
+	                bool farEndUnderrun,
+	                qint64 inputQueue,
+	                qint64 monitorQueue,
+	                qint64 outputQueue);
+
+private:
+	void beginEvent(TraceEvent type);
+	void endEvent();
+	void compress();
+
+	mutable std::mutex mutex_;
+	bool open_ = false;
+
+	QFile file_;
+	std::chrono::steady_clock::time_point start_;
+
+	QBuffer block_;
+	QDataStream blockStream_;
+
+	std::deque<QByteArray> pendingBlocks_;
+	std::size_t droppedBlocks_ = 0;
+
+	std::thread compressor_;
+	std::condition_variable blockEvent_;
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _TRACE_WRITER_H_
@@ -0,0 +1,193 @@
+#include "VirtualAudioDevice.h"
+
+#include <QCoreApplication>
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+namespace SpeexWebRTCTest {
+
+VirtualDeviceGroup::VirtualDeviceGroup(std::chrono::microseconds maxLead) : maxLead_(maxLead) {}
+
+int VirtualDeviceGroup::join()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	positions_.push_back(std::chrono::microseconds(0));
+	active_.push_back(true);
+	return int(positions_.size()) - 1;
+}
+
+void VirtualDeviceGroup::leave(int device)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	active_[device] = false;
+}
+
+void VirtualDeviceGroup::setPosition(int device, std::chrono::microseconds position)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	positions_[device] = position;
+}
+
+bool VirtualDeviceGroup::mayAdvance(int device, std::chrono::microseconds position) const
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	for (std::size_t i = 0; i < positions_.size(); ++i)
+	{
+		if (int(i) != device && active_[i] && position - positions_[i] > maxLead_)
+			return false;
+	}
+	return true;
+}
+
+VirtualAudioDevice::VirtualAudioDevice(Direction direction,
+                                       const QAudioFormat& format,
+                                       QIODevice& device,
+                                       const VirtualDeviceSettings& settings,
+                                       VirtualDeviceGroup* group,
+                                       QObject* parent)
+    : QThread(parent),
+      direction_(direction),
+      format_(format),
+      device_(device),
+      settings_(settings),
+      group_(group),
+      groupIndex_(group ? group->join() : -1),
+      periodFrames_(format.framesForDuration(settings.period.count())),
+      doWork_(true)
+{
+	if (periodFrames_ <= 0)
+		throw std::invalid_argument("Device period is shorter than a sample");
+}
+
+VirtualAudioDevice::~VirtualAudioDevice()
+{
+	stop();
+}
+
+void VirtualAudioDevice::setSource(Source source)
+{
+	source_ = std::move(source);
+}
+
+void VirtualAudioDevice::setSink(Sink sink)
+{
+	sink_ = std::move(sink);
+}
+
+void VirtualAudioDevice::stop()
+{
+	doWork_ = false;
+	wait();
+}
+
+quint64 VirtualAudioDevice::callbacks() const
+{
+	return callbacks_;
+}
+
+quint64 VirtualAudioDevice::frames() const
+{
+	return callbacks_ * quint64(periodFrames_);
+}
+
+quint64 VirtualAudioDevice::shortTransfers() const
+{
+	return shortTransfers_;
+}
+
+std::chrono::microseconds VirtualAudioDevice::maxLateness() const
+{
+	return std::chrono::microseconds(maxLatenessUs_);
+}
+
+void VirtualAudioDevice::run()
+{
+	const qint64 periodBytes = format_.bytesForFrames(periodFrames_);
+	QByteArray buffer(int(periodBytes), 0);
+
+	std::mt19937 random(settings_.seed);
+	std::uniform_int_distribution<qint64> jitter(0, settings_.jitter.count());
+
+	// Wall time of one period on the device clock
+	const std::chrono::duration<double, std::micro> interval(
+	    format_.durationForFrames(periodFrames_) / (1 + settings_.driftPpm * 1e-6));
+	const auto start = std::chrono::steady_clock::now();
+
+	while (doWork_)
+	{
+		const quint64 callback = callbacks_;
+		// Time of the group at the end of the callback: a fast clock delivers more audio
+		const std::chrono::microseconds position(
+		    qint64(format_.durationForFrames(qint64(callback + 1) * periodFrames_) /
+		           (1 + settings_.driftPpm * 1e-6)));
+
+		if (settings_.freeRunning)
+		{
+			if (group_ && !group_->mayAdvance(groupIndex_, position))
+			{
+				QCoreApplication::processEvents();
+				QThread::yieldCurrentThread();
+				continue;
+			}
+		}
+		else
+		{
+			// A device delivers a period once it has been recorded or played
+			const auto due =
+			    start +
+			    std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			        interval * double(callback + 1)) +
+			    std::chrono::microseconds(jitter(random));
+			std::this_thread::sleep_until(due);
+			const qint64 lateness = std::chrono::duration_cast<std::chrono::microseconds>(
+			                            std::chrono::steady_clock::now() - due)
+			                            .count();
+			maxLatenessUs_ = std::max(maxLatenessUs_.load(), lateness);
+		}
+
+		transfer(buffer.data(), periodBytes);
+
+		callbacks_ = callback + 1;
+		if (group_)
+			group_->setPosition(groupIndex_, position);
+		QCoreApplication::processEvents();
+	}
+
+	if (group_)
+		group_->leave(groupIndex_);
+}
+
+void VirtualAudioDevice::transfer(char* data, qint64 bytes)
+{
+	if (direction_ == Direction::Capture)
+	{
+		if (source_)
+			source_(data, periodFrames_);
+		else
+			std::fill(data, data + bytes, 0);
+		if (device_.write(data, bytes) < bytes)
+			++shortTransfers_;
+		return;
+	}
+
+	qint64 read = std::max(device_.read(data, bytes), qint64(0));
+	// Free-running playback waits for the processor instead of playing silence
+	while (settings_.freeRunning && read < bytes && doWork_)
+	{
+		QCoreApplication::processEvents();
+		QThread::yieldCurrentThread();
+		read += std::max(device_.read(data + read, bytes - read), qint64(0));
+	}
+	if (read < bytes)
+	{
+		++shortTransfers_;
+		std::fill(data + read, data + bytes, 0);
+	}
+	if (sink_)
+		sink_(data, periodFrames_);
+}
+
+} // namespace SpeexWebRTCTest
@@ -0,0 +1,118 @@
+#ifndef _VIRTUAL_AUDIO_DEVICE_H_
+#define _VIRTUAL_AUDIO_DEVICE_H_
+
+#include <QAudioFormat>
+#include <QIODevice>
+#include <QThread>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace SpeexWebRTCTest {
+
+struct VirtualDeviceSettings
+{
+	// Audio exchanged per callback
+	std::chrono::microseconds period{10000};
+	// Every callback comes up to this late, uniformly distributed; lateness doesn't accumulate
+	std::chrono::microseconds jitter{0};
+	// Rate error of the device clock against the steady clock, or against the other devices of
+	// the group when free-running; positive runs fast
+	double driftPpm = 0;
+	// Calls back as fast as the group allows instead of in real time, see VirtualDeviceGroup
+	bool freeRunning = false;
+	quint32 seed = 1;
+};
+
+// Keeps free-running devices together: none gets more than maxLead of audio ahead of the slowest
+// one, so the queues of the processor stay bounded however fast the devices run. Devices which
+// aren't free-running only report their position.
+class VirtualDeviceGroup final
+{
+public:
+	explicit VirtualDeviceGroup(std::chrono::microseconds maxLead = std::chrono::milliseconds(100));
+
+	int join();
+	void leave(int device);
+	void setPosition(int device, std::chrono::microseconds position);
+	bool mayAdvance(int device, std::chrono::microseconds position) const;
+
+private:
+	const std::chrono::microseconds maxLead_;
+	mutable std::mutex mutex_;
+	std::vector<std::chrono::microseconds> positions_;
+	std::vector<bool> active_;
+};
+
+// In-process stand-in for a sound card, driving a QIODevice from a thread of its own the way
+// QtMultimedia does: a capture device writes one period from its source into the device per
+// callback (QAudioInput in push mode), a playback device reads one period from the device into its
+// sink (QAudioOutput in pull mode), playing silence for what the device doesn't deliver.
+//
+// Objects living in the device thread get their events after every callback, so a QBuffer moved
+// there before start() emits readyRead() on that thread like a monitor device would. The sources
+// and sinks are called on the device thread too.
+class VirtualAudioDevice final : public QThread
+{
+	Q_OBJECT
+public:
+	enum class Direction
+	{
+		Capture,
+		Playback
+	};
+
+	using Source = std::function<void(char* data, int frames)>;
+	using Sink = std::function<void(const char* data, int frames)>;
+
+	// Throws std::invalid_argument if the period is shorter than a sample
+	VirtualAudioDevice(Direction direction,
+	                   const QAudioFormat& format,
+	                   QIODevice& device,
+	                   const VirtualDeviceSettings& settings,
+	                   VirtualDeviceGroup* group = nullptr,
+	                   QObject* parent = nullptr);
+	~VirtualAudioDevice() override;
+
+	// Before start(); the defaults capture silence and discard what is played
+	void setSource(Source source);
+	void setSink(Sink sink);
+
+	void stop();
+
+	quint64 callbacks() const;
+	quint64 frames() const;
+	// Writes the device didn't take entirely, or reads it didn't fill
+	quint64 shortTransfers() const;
+	// How late the callbacks of a real-time device ran after their due time
+	std::chrono::microseconds maxLateness() const;
+
+protected:
+	void run() override;
+
+private:
+	void transfer(char* data, qint64 bytes);
+
+	const Direction direction_;
+	const QAudioFormat format_;
+	QIODevice& device_;
+	const VirtualDeviceSettings settings_;
+	VirtualDeviceGroup* const group_;
+	const int groupIndex_;
+	const int periodFrames_;
+
+	Source source_;
+	Sink sink_;
+
+	std::atomic<bool> doWork_{false};
+	std::atomic<quint64> callbacks_{0};
+	std::atomic<quint64> shortTransfers_{0};
+	std::atomic<qint64> maxLatenessUs_{0};
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _VIRTUAL_AUDIO_DEVICE_H_
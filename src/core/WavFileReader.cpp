@@ -0,0 +1,77 @@
+#include "WavFileReader.h"
+
+#include <QDataStream>
+#include <QFile>
+
+#include <cstring>
+
+namespace SpeexWebRTCTest {
+
+namespace {
+const quint16 pcmFormat = 1;
+const quint16 floatFormat = 3;
+} // namespace
+
+bool readWavFile(const QString& fileName, WavData& wav)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QDataStream in(&file);
+	in.setByteOrder(QDataStream::LittleEndian);
+
+	char riff[4], wave[4];
+	quint32 riffSize;
+	in.readRawData(riff, 4);
+	in >> riffSize;
+	in.readRawData(wave, 4);
+	if (memcmp(riff, "RIFF", 4) != 0 || memcmp(wave, "WAVE", 4) != 0)
+		return false;
+
+	bool hasFormat = false;
+	while (!in.atEnd())
+	{
+		char id[4];
+		quint32 size;
+		in.readRawData(id, 4);
+		in >> size;
+
+		if (memcmp(id, "fmt ", 4) == 0)
+		{
+			quint16 audioFormat, channels, blockAlign, bitsPerSample;
+			quint32 sampleRate, byteRate;
+			in >> audioFormat >> channels >> sampleRate >> byteRate >> blockAlign >> bitsPerSample;
+			in.skipRawData(size - 16);
+
+			QAudioFormat::SampleType sampleType;
+			if (audioFormat == floatFormat && bitsPerSample == 32)
+				sampleType = QAudioFormat::Float;
+			else if (audioFormat == pcmFormat && bitsPerSample == 8)
+				sampleType = QAudioFormat::UnSignedInt;
+			else if (audioFormat == pcmFormat && bitsPerSample > 8 && bitsPerSample % 8 == 0)
+				sampleType = QAudioFormat::SignedInt;
+			else
+				return false;
+
+			wav.format.setSampleRate(sampleRate);
+			wav.format.setChannelCount(channels);
+			wav.format.setSampleSize(bitsPerSample);
+			wav.format.setCodec("audio/pcm");
+			wav.format.setByteOrder(QAudioFormat::LittleEndian);
+			wav.format.setSampleType(sampleType);
+			hasFormat = true;
+		}
+		else if (memcmp(id, "data", 4) == 0)
+		{
+			wav.samples.resize(size);
+			wav.samples.resize(in.readRawData(wav.samples.data(), size));
+			return hasFormat;
+		}
+		else
+			in.skipRawData(size + (size & 1));
+	}
+	return false;
+}
+
+} // namespace SpeexWebRTCTest
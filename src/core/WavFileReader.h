@@ -0,0 +1,22 @@
+#ifndef _WAV_FILE_READER_H_
+#define _WAV_FILE_READER_H_
+
+#include <QAudioFormat>
+#include <QByteArray>
+#include <QString>
+
+namespace SpeexWebRTCTest {
+
+struct WavData
+{
+	QAudioFormat format;
+	QByteArray samples;
+};
+
+// Reads a whole PCM WAV file in one of the formats WavFileWriter writes (8-bit unsigned, 16-bit or
+// more signed or 32-bit float samples), skipping unknown chunks
+bool readWavFile(const QString& fileName, WavData& wav);
+
+} // namespace SpeexWebRTCTest
+
+#endif // _WAV_FILE_READER_H_
@@ -17,6 +17,8 @@ bool WavFileWriter::hasSupportedFormat()
 {
 	return (format_.sampleSize() == 8 && format_.sampleType() == QAudioFormat::UnSignedInt) ||
 	       (format_.sampleSize() > 8 && format_.sampleType() == QAudioFormat::SignedInt &&
+	        format_.byteOrder() == QAudioFormat::LittleEndian) ||
+	       (format_.sampleSize() == 32 && format_.sampleType() == QAudioFormat::Float &&
 	        format_.byteOrder() == QAudioFormat::LittleEndian);
 }
 
@@ -25,8 +27,8 @@ bool WavFileWriter::open()
 	if (!hasSupportedFormat())
 	{
 		setErrorString(
-		    "Wav PCM supports only 8-bit unsigned samples "
-		    "or 16-bit (or more) signed samples (in little endian)");
+		    "Wav PCM supports only 8-bit unsigned samples, "
+		    "16-bit (or more) signed samples or 32-bit float samples (in little endian)");
 		return false;
 	}
 	else
@@ -51,7 +53,8 @@ void WavFileWriter::writeHeader()
 	// Format description chunk
 	out.writeRawData("fmt ", 4);
 	out << quint32(16); // "fmt " chunk size (always 16 for PCM)
-	out << quint16(1);  // data format (1 => PCM)
+	// data format (1 => PCM, 3 => IEEE float, which readers accept with the PCM header layout)
+	out << quint16(format_.sampleType() == QAudioFormat::Float ? 3 : 1);
 	out << quint16(format_.channelCount());
 	out << quint32(format_.sampleRate());
 	out << quint32(format_.sampleRate() * format_.channelCount() * format_.sampleSize() /
@@ -0,0 +1,297 @@
+#include "WebRTCDSP.h"
+
+#include "Timer.h"
+
+#include <webrtc/api/audio/audio_frame.h>
+#include <webrtc/modules/audio_processing/include/audio_processing.h>
+
+#include <QLoggingCategory>
+
+namespace SpeexWebRTCTest {
+
+namespace {
+
+using NoiseSuppressionLevel = webrtc::AudioProcessing::Config::NoiseSuppression::Level;
+
+Q_LOGGING_CATEGORY(WebRTC, "webrtc")
+
+// Internal processing rate caps, APM accepts only these two
+const int fullProcessingRate = 48000;
+const int reducedProcessingRate = 32000;
+
+void applyQualityTier(webrtc::AudioProcessing::Config& config,
+                      QualityTier tier,
+                      bool noiseSuppressionEnabled)
+{
+	// The mobile echo canceller models a much shorter tail at a fraction of the cost
+	config.echo_canceller.mobile_mode = tier >= QualityTier::ShortEchoTail;
+	config.pipeline.maximum_internal_processing_rate =
+	    tier >= QualityTier::ReducedRate ? reducedProcessingRate : fullProcessingRate;
+	config.noise_suppression.enabled =
+	    noiseSuppressionEnabled && tier < QualityTier::NoNoiseSuppression;
+}
+
+void convert(const qint16* from, int frames, const QAudioFormat& format, webrtc::AudioFrame& to)
+{
+	to.num_channels_ = format.channelCount();
+	to.sample_rate_hz_ = format.sampleRate();
+	to.samples_per_channel_ = frames;
+	memcpy(to.mutable_data(), from, frames * format.channelCount() * sizeof(qint16));
+}
+
+// Mono frames are used in place, the channels of other frames are split into planar
+template <typename Sample>
+void splitChannels(Sample* from, int frames, int channels, QVector<float>& planar,
+                   QVector<Sample*>& pointers)
+{
+	pointers.resize(channels);
+	if (channels == 1)
+	{
+		pointers[0] = from;
+		return;
+	}
+
+	planar.resize(frames * channels);
+	for (int channel = 0; channel < channels; ++channel)
+	{
+		float* to = planar.data() + channel * frames;
+		for (int i = 0; i < frames; ++i)
+			to[i] = from[i * channels + channel];
+		pointers[channel] = to;
+	}
+}
+
+webrtc::AudioProcessing::Config defaultConfig()
+{
+	webrtc::AudioProcessing::Config config;
+
+	config.voice_detection.enabled = true;
+
+	config.noise_suppression.enabled = false;
+	config.noise_suppression.level = NoiseSuppressionLevel::kLow;
+
+	config.echo_canceller.enabled = false;
+	config.echo_canceller.mobile_mode = false;
+	config.residual_echo_detector.enabled = false;
+
+	config.gain_controller2.enabled = false;
+	config.gain_controller2.adaptive_digital.enabled = true;
+	config.gain_controller2.adaptive_digital.level_estimator =
+	    webrtc::AudioProcessing::Config::GainController2::kRms;
+	config.gain_controller2.adaptive_digital.use_saturation_protector = true;
+	config.gain_controller2.adaptive_digital.extra_saturation_margin_db = 1;
+
+	return config;
+}
+
+} // namespace
+
+WebRTCDSP::WebRTCDSP(const QAudioFormat& mainFormat, const QAudioFormat& auxFormat)
+    : AudioEffect(mainFormat, auxFormat),
+      mainFrame_(new webrtc::AudioFrame),
+      auxFrame_(new webrtc::AudioFrame)
+{
+	apm_ = webrtc::AudioProcessingBuilder().Create();
+
+	if (!apm_)
+		throw std::runtime_error("failed to create webrtc::AudioProcessing instance");
+
+	apm_->ApplyConfig(defaultConfig());
+}
+
+WebRTCDSP::~WebRTCDSP()
+{
+	delete apm_;
+}
+
+QString errorDescription(int error)
+{
+	switch (error)
+	{
+	case webrtc::AudioProcessing::kNoError:
+		return "no error";
+	case webrtc::AudioProcessing::kUnspecifiedError:
+		return "unspecified error";
+	case webrtc::AudioProcessing::kCreationFailedError:
+		return "creation failed";
+	case webrtc::AudioProcessing::kUnsupportedComponentError:
+		return "unsupported component";
+	case webrtc::AudioProcessing::kUnsupportedFunctionError:
+		return "unsupported function";
+	case webrtc::AudioProcessing::kNullPointerError:
+		return "null pointer";
+	case webrtc::AudioProcessing::kBadParameterError:
+		return "bad parameter";
+	case webrtc::AudioProcessing::kBadSampleRateError:
+		return "bad sample rate";
+	case webrtc::AudioProcessing::kBadDataLengthError:
+		return "bad data length";
+	case webrtc::AudioProcessing::kBadNumberChannelsError:
+		return "bad number of channels";
+	case webrtc::AudioProcessing::kFileError:
+		return "file error";
+	case webrtc::AudioProcessing::kStreamParameterNotSetError:
+		return "stream parameter not set";
+	case webrtc::AudioProcessing::kNotEnabledError:
+		return "not enabled";
+	case webrtc::AudioProcessing::kBadStreamParameterWarning:
+		return "bad stream parameter (non-fatal)";
+	default:
+		return "unexpected error";
+	}
+}
+
+void WebRTCDSP::processInterleaved(qint16* main, const qint16* aux)
+{
+	TIMER(qDebug(WebRTC))
+
+	qDebug(WebRTC).noquote() << QString("got %1 near-end samples at %2 Hz (%3ms)%4")
+	                                .arg(getFrameSize())
+	                                .arg(getMainFormat().sampleRate())
+	                                .arg(requiredFrameSizeMs())
+	                                .arg(aux ? " and as many far-end samples" : "");
+
+	Q_ASSERT(getMainFormat().sampleRate() == getAuxFormat().sampleRate());
+
+	// The frames are kept across calls, a fresh webrtc::AudioFrame is zeroed on first write
+	convert(main, getFrameSize(), getMainFormat(), *mainFrame_);
+
+	if (aux)
+		processReverseInterleaved(aux);
+	if (echoCancellationEnabled_)
+		apm_->set_stream_delay_ms(100);
+
+	const int error = apm_->ProcessStream(mainFrame_.get());
+	if (error != 0)
+	{
+		qCritical(WebRTC).noquote() << "ProcessStream() error:" << errorDescription(error);
+		return;
+	}
+
+	Q_ASSERT(mainFrame_->samples_per_channel_ == getFrameSize());
+	memcpy(main, mainFrame_->data(),
+	       mainFrame_->samples_per_channel_ * mainFrame_->num_channels_ * sizeof(qint16));
+
+	setVoiceActive(*apm_->GetStatistics().voice_detected);
+}
+
+void WebRTCDSP::processInterleavedFloat(float* main, const float* aux)
+{
+	TIMER(qDebug(WebRTC))
+
+	Q_ASSERT(getMainFormat().sampleRate() == getAuxFormat().sampleRate());
+
+	const int frames = getFrameSize();
+	const int channels = getMainFormat().channelCount();
+	const webrtc::StreamConfig mainConfig(getMainFormat().sampleRate(), channels);
+
+	if (aux)
+		processReverseInterleavedFloat(aux);
+	if (echoCancellationEnabled_)
+		apm_->set_stream_delay_ms(100);
+
+	// APM may process in place, mono frames never leave the caller's buffer
+	splitChannels(main, frames, channels, mainPlanar_, mainChannels_);
+	const int error = apm_->ProcessStream(mainChannels_.constData(), mainConfig, mainConfig,
+	                                      mainChannels_.constData());
+	if (error != 0)
+	{
+		qCritical(WebRTC).noquote() << "ProcessStream() error:" << errorDescription(error);
+		return;
+	}
+
+	if (channels > 1)
+	{
+		for (int channel = 0; channel < channels; ++channel)
+		{
+			const float* from = mainChannels_.at(channel);
+			for (int i = 0; i < frames; ++i)
+				main[i * channels + channel] = from[i];
+		}
+	}
+
+	setVoiceActive(*apm_->GetStatistics().voice_detected);
+}
+
+bool WebRTCDSP::hasSeparateReverseStream() const
+{
+	// APM guards its render and capture sides with separate locks
+	return true;
+}
+
+void WebRTCDSP::processReverseInterleaved(const qint16* aux)
+{
+	if (!echoCancellationEnabled_)
+		return;
+
+	convert(aux, getFrameSize(), getAuxFormat(), *auxFrame_);
+	const int error = apm_->ProcessReverseStream(auxFrame_.get());
+	if (error != 0)
+		qWarning(WebRTC).noquote() << "ProcessReverseStream() error:" << errorDescription(error);
+}
+
+void WebRTCDSP::processReverseInterleavedFloat(const float* aux)
+{
+	if (!echoCancellationEnabled_)
+		return;
+
+	// Only analysed, the reverse stream isn't rendered from APM's output
+	const webrtc::StreamConfig auxConfig(getAuxFormat().sampleRate(),
+	                                     getAuxFormat().channelCount());
+	splitChannels(aux, getFrameSize(), getAuxFormat().channelCount(), auxPlanar_, auxChannels_);
+	const int error = apm_->AnalyzeReverseStream(auxChannels_.constData(), auxConfig);
+	if (error != 0)
+		qWarning(WebRTC).noquote() << "AnalyzeReverseStream() error:" << errorDescription(error);
+}
+
+void WebRTCDSP::setParameter(const QString& param, QVariant value)
+{
+	auto config = apm_->GetConfig();
+	if (param == "noise_reduction_enabled")
+		noiseSuppressionEnabled_ = value.toBool();
+	else if (param == "noise_reduction_suppression_level")
+		config.noise_suppression.level =
+		    static_cast<NoiseSuppressionLevel>(NoiseSuppressionLevel::kLow + value.toUInt());
+	else if (param == "gain_control_enabled")
+		config.gain_controller2.enabled = value.toBool();
+	else if (param == "echo_cancellation_enabled")
+	{
+		config.echo_canceller.enabled = value.toBool();
+		config.residual_echo_detector.enabled = value.toBool();
+		echoCancellationEnabled_ = value.toBool();
+	}
+	else if (param == "gain_control_target_level")
+		return;
+	else if (param == "gain_control_max_gain")
+		return;
+	else if (param == "echo_cancellation_suppression_level")
+		return;
+	else
+		throw std::invalid_argument("Invalid param");
+	SpeexWebRTCTest::applyQualityTier(config, getQualityTier(), noiseSuppressionEnabled_);
+	apm_->ApplyConfig(config);
+}
+
+void WebRTCDSP::resetState()
+{
+	noiseSuppressionEnabled_ = false;
+	echoCancellationEnabled_ = false;
+
+	// Drops the adaptive state of all the submodules, then the parameters
+	apm_->Initialize();
+	apm_->ApplyConfig(defaultConfig());
+}
+
+void WebRTCDSP::applyQualityTier()
+{
+	auto config = apm_->GetConfig();
+	SpeexWebRTCTest::applyQualityTier(config, getQualityTier(), noiseSuppressionEnabled_);
+	apm_->ApplyConfig(config);
+}
+
+unsigned int WebRTCDSP::requiredFrameSizeMs() const
+{
+	return 10;
+}
+
+} // namespace SpeexWebRTCTest
@@ -0,0 +1,56 @@
+#ifndef _WEBRTC_EFFECT_H_
+#define _WEBRTC_EFFECT_H_
+
+#include "AudioEffect.h"
+
+#include <QScopedPointer>
+#include <QVector>
+
+#include <atomic>
+
+namespace webrtc {
+class AudioFrame;
+class AudioProcessing;
+} // namespace webrtc
+
+namespace SpeexWebRTCTest {
+
+class WebRTCDSP final : public AudioEffect
+{
+	Q_OBJECT
+public:
+	WebRTCDSP(const QAudioFormat& mainFormat, const QAudioFormat& auxFormat);
+	~WebRTCDSP() override;
+
+	void setParameter(const QString& param, QVariant value) override;
+	bool hasSeparateReverseStream() const override;
+
+private:
+	unsigned int requiredFrameSizeMs() const override;
+	void processInterleaved(qint16* main, const qint16* aux) override;
+	void processInterleavedFloat(float* main, const float* aux) override;
+	void processReverseInterleaved(const qint16* aux) override;
+	void processReverseInterleavedFloat(const float* aux) override;
+	void resetState() override;
+	void applyQualityTier() override;
+
+	webrtc::AudioProcessing* apm_;
+	QScopedPointer<webrtc::AudioFrame> mainFrame_;
+	QScopedPointer<webrtc::AudioFrame> auxFrame_;
+
+	// The float interface of APM takes one array per channel. The aux buffers belong to the
+	// reverse stream, which may run on another thread.
+	QVector<float> mainPlanar_;
+	QVector<float> auxPlanar_;
+	QVector<float*> mainChannels_;
+	QVector<const float*> auxChannels_;
+
+	// As requested, before the quality tier overrides it
+	bool noiseSuppressionEnabled_ = false;
+	// Checked by both streams without going through the APM config
+	std::atomic<bool> echoCancellationEnabled_{false};
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _WEBRTC_EFFECT_H_
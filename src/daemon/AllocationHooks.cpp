@@ -0,0 +1,80 @@
+// Global operator new and delete replacement which counts the allocations of each thread (see
+// core/AllocationCounter.h). Built as the allocation_hooks object library and linked into the
+// daemon only, so the GUI and the tools keep the default operators.
+
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+void* allocate(std::size_t size) noexcept
+{
+	SpeexWebRTCTest::countAllocation();
+	return std::malloc(size == 0 ? 1 : size);
+}
+
+void* allocateOrThrow(std::size_t size)
+{
+	for (;;)
+	{
+		if (void* p = allocate(size))
+			return p;
+
+		const std::new_handler handler = std::get_new_handler();
+		if (!handler)
+			throw std::bad_alloc();
+		handler();
+	}
+}
+} // namespace
+
+void* operator new(std::size_t size)
+{
+	return allocateOrThrow(size);
+}
+
+void* operator new[](std::size_t size)
+{
+	return allocateOrThrow(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return allocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	std::free(p);
+}
@@ -0,0 +1,191 @@
+#include "ControlServer.h"
+
+#include <QCoreApplication>
+#include <QLoggingCategory>
+
+namespace SpeexWebRTCTest {
+
+namespace {
+Q_LOGGING_CATEGORY(Control, "daemon.control")
+
+QByteArray error(const QString& message)
+{
+	return "ERROR " + message.toUtf8();
+}
+
+// Parameters take the same value types as the GUI sends: booleans for switches, integers for dials
+QVariant parseValue(const QByteArray& value)
+{
+	if (value == "true" || value == "false")
+		return value == "true";
+
+	bool ok = false;
+	int intValue = value.toInt(&ok);
+	if (ok)
+		return intValue;
+
+	double doubleValue = value.toDouble(&ok);
+	if (ok)
+		return doubleValue;
+
+	return QString::fromUtf8(value);
+}
+} // namespace
+
+ControlServer::ControlServer(EffectPool& pool, QObject* parent) : QObject(parent), pool_(pool)
+{
+	connect(&server_, &QLocalServer::newConnection, this, &ControlServer::acceptConnection);
+}
+
+ControlServer::~ControlServer()
+{
+	streams_.clear();
+}
+
+bool ControlServer::listen(const QString& path)
+{
+	QLocalServer::removeServer(path);
+	server_.setSocketOptions(QLocalServer::UserAccessOption);
+	return server_.listen(path);
+}
+
+QString ControlServer::errorString() const
+{
+	return server_.errorString();
+}
+
+QList<QSharedPointer<DaemonStream>> ControlServer::streams() const
+{
+	return streams_.values();
+}
+
+void ControlServer::acceptConnection()
+{
+	while (QLocalSocket* socket = server_.nextPendingConnection())
+	{
+		qDebug(Control) << "Client connected";
+		connect(socket, &QLocalSocket::readyRead, this, [this, socket] { readCommands(socket); });
+		connect(socket, &QLocalSocket::disconnected, this,
+		        [this, socket]
+		        {
+			        qDebug(Control) << "Client disconnected";
+			        destroyStreams(socket);
+			        socket->deleteLater();
+		        });
+	}
+}
+
+void ControlServer::readCommands(QLocalSocket* socket)
+{
+	while (socket->canReadLine())
+	{
+		const QByteArray line = socket->readLine().trimmed();
+		if (line.isEmpty())
+			continue;
+
+		const QByteArray reply = handleCommand(socket, line.simplified().split(' '));
+		socket->write(reply + "\n");
+	}
+}
+
+QByteArray ControlServer::handleCommand(QLocalSocket* socket, const QList<QByteArray>& args)
+{
+	const QByteArray& command = args.first();
+
+	if (command == "create")
+	{
+		if (args.size() < 2)
+			return error("usage: create <speex|webrtc> [rate] [channels] [reference channels]");
+
+		QStringList fields;
+		for (const QByteArray& arg : args.mid(1))
+			fields.append(QString::fromUtf8(arg));
+		StreamSpec spec;
+		try
+		{
+			spec = StreamSpec::parse(fields);
+		}
+		catch (const std::invalid_argument& e)
+		{
+			return error(e.what());
+		}
+
+		const quint32 id = nextStreamId_++;
+		const QString prefix =
+		    QString("/speex-webrtc-%1-%2").arg(QCoreApplication::applicationPid()).arg(id);
+
+		QSharedPointer<DaemonStream> stream;
+		try
+		{
+			stream.reset(
+			    new DaemonStream(id, pool_, spec.backend, spec.format, spec.referenceFormat));
+		}
+		catch (const std::exception& e)
+		{
+			return error(e.what());
+		}
+
+		if (!stream->start(prefix))
+			return error(stream->errorString());
+
+		streams_.insert(id, stream);
+		owners_.insert(id, socket);
+		qInfo(Control) << "Created stream" << id << "with" << args.at(1) << "backend";
+		return "OK " + QByteArray::number(id) + " " + QByteArray::number(stream->frameSize()) + " " +
+		       prefix.toUtf8();
+	}
+
+	if (args.size() < 2)
+		return error("missing stream id");
+
+	const quint32 id = args.at(1).toUInt();
+	QSharedPointer<DaemonStream> stream = streams_.value(id);
+	if (!stream)
+		return error("no such stream");
+
+	if (command == "set")
+	{
+		if (args.size() != 4)
+			return error("usage: set <id> <parameter> <value>");
+		try
+		{
+			stream->setParameter(QString::fromUtf8(args.at(2)), parseValue(args.at(3)));
+		}
+		catch (const std::exception& e)
+		{
+			return error(e.what());
+		}
+		return "OK";
+	}
+
+	if (command == "stats")
+	{
+		return "OK " + QByteArray::number(stream->frames()) + " " +
+		       QByteArray::number(stream->underruns()) + " " +
+		       QByteArray::number(stream->overruns()) + " " +
+		       qualityTierName(stream->qualityTier()).toUtf8() + " " +
+		       QByteArray::number(stream->loadPercent());
+	}
+
+	if (command == "destroy")
+	{
+		streams_.remove(id);
+		owners_.remove(id);
+		qInfo(Control) << "Destroyed stream" << id;
+		return "OK";
+	}
+
+	return error("unknown command " + command);
+}
+
+void ControlServer::destroyStreams(QLocalSocket* socket)
+{
+	for (quint32 id : owners_.keys(socket))
+	{
+		streams_.remove(id);
+		owners_.remove(id);
+		qInfo(Control) << "Destroyed stream" << id << "of a disconnected client";
+	}
+}
+
+} // namespace SpeexWebRTCTest
@@ -0,0 +1,50 @@
+#ifndef _CONTROL_SERVER_H_
+#define _CONTROL_SERVER_H_
+
+#include "DaemonStream.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QMap>
+#include <QSharedPointer>
+
+namespace SpeexWebRTCTest {
+
+// Line-based control protocol on a local socket. Every request gets one reply line starting with
+// "OK" or "ERROR <message>":
+//   create <speex|webrtc> [sample rate] [channels] [reference channels]
+//                                      -> OK <id> <frame size> <ring prefix>
+//   set <id> <parameter> <value>       -> OK
+//   stats <id>                         -> OK <frames> <underruns> <overruns> <quality tier>
+//                                         <load in % of the frame period>
+//   destroy <id>                       -> OK
+// Streams are destroyed when the connection which created them is closed. Their effects come from
+// the pool, which must outlive the server.
+class ControlServer final : public QObject
+{
+	Q_OBJECT
+public:
+	explicit ControlServer(EffectPool& pool, QObject* parent = nullptr);
+	~ControlServer() override;
+
+	bool listen(const QString& path);
+	QString errorString() const;
+
+	QList<QSharedPointer<DaemonStream>> streams() const;
+
+private:
+	void acceptConnection();
+	void readCommands(QLocalSocket* socket);
+	QByteArray handleCommand(QLocalSocket* socket, const QList<QByteArray>& args);
+	void destroyStreams(QLocalSocket* socket);
+
+	EffectPool& pool_;
+	QLocalServer server_;
+	quint32 nextStreamId_ = 1;
+	QMap<quint32, QSharedPointer<DaemonStream>> streams_;
+	QMap<quint32, QLocalSocket*> owners_;
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _CONTROL_SERVER_H_
@@ -0,0 +1,252 @@
+#include "DaemonStream.h"
+
+#include <QLoggingCategory>
+
+#include <stdexcept>
+
+namespace SpeexWebRTCTest {
+
+namespace {
+Q_LOGGING_CATEGORY(Stream, "daemon.stream")
+
+// Ring capacity in frames, enough to absorb a client that is a few frames ahead
+const int ringFrames = 32;
+// Wake-up period of an idle worker, bounds the time needed to stop it
+const int idleTimeoutMs = 100;
+
+QAudioFormat makeFormat(int sampleRate, int channels)
+{
+	QAudioFormat format;
+	format.setSampleRate(sampleRate);
+	format.setChannelCount(channels);
+	format.setSampleSize(16);
+	format.setCodec("audio/pcm");
+	format.setByteOrder(QAudioFormat::LittleEndian);
+	format.setSampleType(QAudioFormat::SignedInt);
+	return format;
+}
+} // namespace
+
+StreamSpec StreamSpec::parse(const QStringList& fields)
+{
+	if (fields.isEmpty() || fields.size() > 4)
+		throw std::invalid_argument(
+		    "expected <speex|webrtc> [rate] [channels] [reference channels]");
+
+	StreamSpec spec;
+	if (fields.at(0) == "speex")
+		spec.backend = Backend::Speex;
+	else if (fields.at(0) == "webrtc")
+		spec.backend = Backend::WebRTC;
+	else
+		throw std::invalid_argument("unknown backend " + fields.at(0).toStdString());
+
+	const int sampleRate = fields.size() > 1 ? fields.at(1).toInt() : 48000;
+	const int channels = fields.size() > 2 ? fields.at(2).toInt() : 1;
+	const int referenceChannels = fields.size() > 3 ? fields.at(3).toInt() : 2;
+	if (sampleRate <= 0 || channels <= 0 || referenceChannels <= 0)
+		throw std::invalid_argument("invalid format");
+
+	spec.format = makeFormat(sampleRate, channels);
+	spec.referenceFormat = makeFormat(sampleRate, referenceChannels);
+	return spec;
+}
+
+DaemonStream::DaemonStream(quint32 id,
+                           EffectPool& pool,
+                           Backend backend,
+                           const QAudioFormat& format,
+                           const QAudioFormat& referenceFormat)
+    : id_(id),
+      backend_(backend),
+      format_(format),
+      referenceFormat_(referenceFormat),
+      dsp_(pool.acquire(backend, format, referenceFormat))
+{
+	// Emitted on the worker, the effect goes back to the pool with the stream
+	voiceActivity_ = QObject::connect(dsp_.data(), &AudioEffect::voiceActivityChanged,
+	                                  [this](bool voice) { voiceActive_ = voice; });
+}
+
+DaemonStream::~DaemonStream()
+{
+	stop();
+	QObject::disconnect(voiceActivity_);
+}
+
+bool DaemonStream::start(const QString& ringPrefix)
+{
+	const int frameBytes = format_.bytesForFrames(frameSize());
+	const int referenceBytes = referenceFormat_.bytesForFrames(frameSize());
+
+	if (!nearEnd_.create(ringPrefix + "-near", frameBytes * ringFrames))
+		error_ = nearEnd_.errorString();
+	else if (!farEnd_.create(ringPrefix + "-far", referenceBytes * ringFrames))
+		error_ = farEnd_.errorString();
+	else if (!output_.create(ringPrefix + "-out", frameBytes * ringFrames))
+		error_ = output_.errorString();
+
+	if (!error_.isEmpty())
+	{
+		nearEnd_.close();
+		farEnd_.close();
+		output_.close();
+		return false;
+	}
+
+	doWork_ = true;
+	worker_ = std::thread([this] { process(); });
+	return true;
+}
+
+void DaemonStream::stop()
+{
+	if (!worker_.joinable())
+		return;
+
+	doWork_ = false;
+	nearEnd_.hangUp();
+	worker_.join();
+
+	// Wake up a client blocked on processed audio
+	output_.hangUp();
+
+	nearEnd_.close();
+	farEnd_.close();
+	output_.close();
+}
+
+quint32 DaemonStream::id() const
+{
+	return id_;
+}
+
+Backend DaemonStream::backend() const
+{
+	return backend_;
+}
+
+unsigned int DaemonStream::frameSize() const
+{
+	return dsp_->getFrameSize();
+}
+
+QString DaemonStream::errorString() const
+{
+	return error_;
+}
+
+void DaemonStream::setParameter(const QString& param, const QVariant& value)
+{
+	std::unique_lock<std::mutex> lock(dspMutex_);
+	dsp_->setParameter(param, value);
+}
+
+quint64 DaemonStream::frames() const
+{
+	return frames_;
+}
+
+quint64 DaemonStream::underruns() const
+{
+	return underruns_;
+}
+
+quint64 DaemonStream::overruns() const
+{
+	return overruns_;
+}
+
+QualityTier DaemonStream::qualityTier() const
+{
+	return QualityTier(qualityTier_.load());
+}
+
+int DaemonStream::loadPercent() const
+{
+	return loadPercent_;
+}
+
+StreamMetricsSnapshot DaemonStream::metrics() const
+{
+	return metrics_.snapshot();
+}
+
+void DaemonStream::process()
+{
+	const std::size_t frameBytes = format_.bytesForFrames(frameSize());
+	const std::size_t referenceBytes = referenceFormat_.bytesForFrames(frameSize());
+
+	const std::chrono::microseconds period(format_.durationForFrames(frameSize()));
+
+	// Frames are processed in place in these buffers, nothing is allocated per frame
+	QByteArray nearEnd(frameBytes, 0);
+	QByteArray farEnd(referenceBytes, 0);
+
+	SampleSpan<qint16> nearSpan;
+	nearSpan.data = reinterpret_cast<qint16*>(nearEnd.data());
+	nearSpan.frames = frameSize();
+	nearSpan.channels = format_.channelCount();
+
+	SampleSpan<const qint16> farSpan;
+	farSpan.data = reinterpret_cast<const qint16*>(farEnd.constData());
+	farSpan.frames = frameSize();
+	farSpan.channels = referenceFormat_.channelCount();
+
+	while (doWork_)
+	{
+		if (!nearEnd_.waitForData(frameBytes, idleTimeoutMs))
+		{
+			if (nearEnd_.isHungUp())
+				break;
+			continue;
+		}
+
+		nearEnd_.read(nearEnd.data(), frameBytes);
+
+		// A late reference is replaced with silence, like in AudioProcessor
+		if (farEnd_.readAvailable() >= referenceBytes)
+			farEnd_.read(farEnd.data(), referenceBytes);
+		else
+		{
+			farEnd.fill(0);
+			++underruns_;
+		}
+
+		metrics_.beginFrame();
+		{
+			std::unique_lock<std::mutex> lock(dspMutex_);
+			const auto start = std::chrono::steady_clock::now();
+			if (degradation_.getTier() != QualityTier::Bypass)
+				dsp_->process(nearSpan, farSpan);
+
+			if (degradation_.update(std::chrono::steady_clock::now() - start, period))
+			{
+				const QualityTier tier = degradation_.getTier();
+				qInfo(Stream).nospace()
+				    << "Stream " << id_ << " at " << qRound(degradation_.getLoad() * 100)
+				    << "% of the frame period, switching to " << qualityTierName(tier);
+				dsp_->setQualityTier(tier);
+				qualityTier_ = int(tier);
+			}
+			loadPercent_ = qRound(degradation_.getLoad() * 100);
+		}
+		metrics_.endFrame(period, voiceActive_);
+
+		// Never write a partial frame, the client reads whole frames only
+		if (output_.writeAvailable() >= frameBytes)
+			output_.write(nearEnd.constData(), frameBytes);
+		else
+			++overruns_;
+		metrics_.setQueueDepths(nearEnd_.readAvailable() / frameBytes,
+		                        output_.readAvailable() / frameBytes);
+
+		++frames_;
+	}
+
+	qDebug(Stream) << "Stream" << id_ << "finished after" << frames_.load() << "frames,"
+	               << underruns_.load() << "far-end underruns," << overruns_.load()
+	               << "output overruns";
+}
+
+} // namespace SpeexWebRTCTest
@@ -0,0 +1,102 @@
+#ifndef _DAEMON_STREAM_H_
+#define _DAEMON_STREAM_H_
+
+#include "AudioEffect.h"
+#include "AudioProcessor.h"
+#include "DegradationController.h"
+#include "EffectPool.h"
+#include "SharedRing.h"
+#include "StreamMetrics.h"
+
+#include <QAudioFormat>
+#include <QSharedPointer>
+#include <QStringList>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace SpeexWebRTCTest {
+
+// Backend and formats of a stream as the create command and --prewarm give them:
+// <speex|webrtc> [rate] [channels] [reference channels], 48 kHz mono with a stereo reference by
+// default
+struct StreamSpec
+{
+	Backend backend = Backend::Speex;
+	QAudioFormat format;
+	QAudioFormat referenceFormat;
+
+	// Throws std::invalid_argument for an unknown backend or an invalid format
+	static StreamSpec parse(const QStringList& fields);
+};
+
+// One processing stream of the daemon. The client writes near-end frames into "<prefix>-near"
+// and the far-end reference into "<prefix>-far", and reads processed frames from "<prefix>-out".
+// A dedicated worker sleeps on the near-end doorbell and processes one frame per wake-up.
+class DaemonStream final
+{
+public:
+	// The effect comes from the pool, which must outlive the stream
+	DaemonStream(quint32 id,
+	             EffectPool& pool,
+	             Backend backend,
+	             const QAudioFormat& format,
+	             const QAudioFormat& referenceFormat);
+	~DaemonStream();
+
+	bool start(const QString& ringPrefix);
+	void stop();
+
+	quint32 id() const;
+	Backend backend() const;
+	unsigned int frameSize() const;
+	QString errorString() const;
+
+	// Throws what the effect throws, std::invalid_argument for unknown parameters or bad values
+	void setParameter(const QString& param, const QVariant& value);
+
+	quint64 frames() const;
+	quint64 underruns() const;
+	quint64 overruns() const;
+	QualityTier qualityTier() const;
+	// Smoothed processing time in percent of the frame period
+	int loadPercent() const;
+	// Resource usage of the worker, see StreamMetrics
+	StreamMetricsSnapshot metrics() const;
+
+private:
+	void process();
+
+	const quint32 id_;
+	const Backend backend_;
+	const QAudioFormat format_;
+	const QAudioFormat referenceFormat_;
+
+	std::mutex dspMutex_;
+	QSharedPointer<AudioEffect> dsp_;
+	QMetaObject::Connection voiceActivity_;
+	std::atomic<bool> voiceActive_{false};
+
+	SharedRing nearEnd_;
+	SharedRing farEnd_;
+	SharedRing output_;
+	QString error_;
+
+	std::thread worker_;
+	std::atomic<bool> doWork_{false};
+
+	std::atomic<quint64> frames_{0};
+	std::atomic<quint64> underruns_{0};
+	std::atomic<quint64> overruns_{0};
+
+	DegradationController degradation_;
+	std::atomic<int> qualityTier_{int(QualityTier::Full)};
+	std::atomic<int> loadPercent_{0};
+
+	StreamMetrics metrics_;
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _DAEMON_STREAM_H_
@@ -0,0 +1,213 @@
+#include "MetricsServer.h"
+
+#include <QLocalSocket>
+#include <QTcpSocket>
+
+#include <functional>
+#include <vector>
+
+namespace SpeexWebRTCTest {
+
+namespace {
+// Requests are a GET line and a few headers, anything longer isn't a scraper
+const int maxRequestBytes = 8192;
+
+struct StreamMetric
+{
+	const char* name;
+	const char* type;
+	const char* help;
+	std::function<QByteArray(const DaemonStream&, const StreamMetricsSnapshot&)> value;
+};
+
+QByteArray seconds(std::chrono::nanoseconds time)
+{
+	return QByteArray::number(time.count() / 1e9, 'f', 6);
+}
+
+const std::vector<StreamMetric>& streamMetrics()
+{
+	static const std::vector<StreamMetric> metrics = {
+	    {"frames_total", "counter", "Frames processed.",
+	     [](const DaemonStream&, const StreamMetricsSnapshot& metrics)
+	     { return QByteArray::number(metrics.frames); }},
+	    {"cpu_seconds_total", "counter", "CPU time of the worker thread processing frames.",
+	     [](const DaemonStream&, const StreamMetricsSnapshot& metrics)
+	     { return seconds(metrics.cpuTime); }},
+	    {"processing_seconds_total", "counter", "Wall time spent processing frames.",
+	     [](const DaemonStream&, const StreamMetricsSnapshot& metrics)
+	     { return seconds(metrics.processingTime); }},
+	    {"deadline_misses_total", "counter", "Frames which took longer than the frame period.",
+	     [](const DaemonStream&, const StreamMetricsSnapshot& metrics)
+	     { return QByteArray::number(metrics.deadlineMisses); }},
+	    {"voice_frames_total", "counter", "Frames processed while the effect detected voice.",
+	     [](const DaemonStream&, const StreamMetricsSnapshot& metrics)
+	     { return QByteArray::number(metrics.voiceFrames); }},
+	    {"vad_ratio", "gauge", "Fraction of the frames with voice.",
+	     [](const DaemonStream&, const StreamMetricsSnapshot& metrics)
+	     { return QByteArray::number(metrics.vadRatio(), 'f', 4); }},
+	    {"allocations_total", "counter", "operator new calls of the worker thread in the effect.",
+	     [](const DaemonStream&, const StreamMetricsSnapshot& metrics)
+	     { return QByteArray::number(metrics.allocations); }},
+	    {"input_queue_frames", "gauge", "Near-end frames waiting for the worker.",
+	     [](const DaemonStream&, const StreamMetricsSnapshot& metrics)
+	     { return QByteArray::number(metrics.inputQueueFrames); }},
+	    {"output_queue_frames", "gauge", "Processed frames waiting for the client.",
+	     [](const DaemonStream&, const StreamMetricsSnapshot& metrics)
+	     { return QByteArray::number(metrics.outputQueueFrames); }},
+	    {"underruns_total", "counter", "Frames processed without a far end.",
+	     [](const DaemonStream& stream, const StreamMetricsSnapshot&)
+	     { return QByteArray::number(stream.underruns()); }},
+	    {"overruns_total", "counter", "Processed frames dropped because the client lagged.",
+	     [](const DaemonStream& stream, const StreamMetricsSnapshot&)
+	     { return QByteArray::number(stream.overruns()); }},
+	    {"load_ratio", "gauge", "Smoothed processing time over the frame period.",
+	     [](const DaemonStream& stream, const StreamMetricsSnapshot&)
+	     { return QByteArray::number(stream.loadPercent() / 100.0, 'f', 2); }},
+	    {"quality_tier", "gauge", "Quality tier, 0 for full quality up to 4 for bypass.",
+	     [](const DaemonStream& stream, const StreamMetricsSnapshot&)
+	     { return QByteArray::number(int(stream.qualityTier())); }},
+	};
+	return metrics;
+}
+
+void writeHeader(QByteArray& out, const QByteArray& name, const char* type, const char* help)
+{
+	out += "# HELP " + name + " " + help + "\n";
+	out += "# TYPE " + name + " " + type + "\n";
+}
+} // namespace
+
+MetricsServer::MetricsServer(const ControlServer& control,
+                             const EffectPool& pool,
+                             QObject* parent)
+    : QObject(parent), control_(control), pool_(pool)
+{
+	connect(&localServer_, &QLocalServer::newConnection, this,
+	        [this]
+	        {
+		        while (QLocalSocket* socket = localServer_.nextPendingConnection())
+		        {
+			        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+			        serve(socket);
+		        }
+	        });
+	connect(&tcpServer_, &QTcpServer::newConnection, this,
+	        [this]
+	        {
+		        while (QTcpSocket* socket = tcpServer_.nextPendingConnection())
+		        {
+			        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+			        serve(socket);
+		        }
+	        });
+}
+
+bool MetricsServer::listen(const QString& address)
+{
+	if (address.contains('/'))
+	{
+		QLocalServer::removeServer(address);
+		localServer_.setSocketOptions(QLocalServer::UserAccessOption);
+		if (!localServer_.listen(address))
+		{
+			error_ = localServer_.errorString();
+			return false;
+		}
+		return true;
+	}
+
+	const int separator = address.lastIndexOf(':');
+	const QHostAddress host = separator < 0 ? QHostAddress(QHostAddress::LocalHost)
+	                                        : QHostAddress(address.left(separator));
+	bool ok = false;
+	const quint16 port = address.mid(separator + 1).toUShort(&ok);
+	if (!ok || host.isNull())
+	{
+		error_ = "Invalid address " + address;
+		return false;
+	}
+	if (!tcpServer_.listen(host, port))
+	{
+		error_ = tcpServer_.errorString();
+		return false;
+	}
+	return true;
+}
+
+QString MetricsServer::errorString() const
+{
+	return error_;
+}
+
+QByteArray MetricsServer::render() const
+{
+	const QList<QSharedPointer<DaemonStream>> streams = control_.streams();
+
+	// Counters of a stream come from one snapshot
+	QVector<StreamMetricsSnapshot> snapshots;
+	for (const auto& stream : streams)
+		snapshots.append(stream->metrics());
+
+	QByteArray out;
+	for (const StreamMetric& metric : streamMetrics())
+	{
+		const QByteArray name = QByteArray("speex_webrtc_stream_") + metric.name;
+		writeHeader(out, name, metric.type, metric.help);
+		for (int i = 0; i < streams.size(); ++i)
+		{
+			const DaemonStream& stream = *streams.at(i);
+			out += name + "{stream=\"" + QByteArray::number(stream.id()) + "\",backend=\"" +
+			       (stream.backend() == Backend::Speex ? "speex" : "webrtc") + "\"} " +
+			       metric.value(stream, snapshots.at(i)) + "\n";
+		}
+	}
+
+	writeHeader(out, "speex_webrtc_streams", "gauge", "Streams being processed.");
+	out += "speex_webrtc_streams " + QByteArray::number(streams.size()) + "\n";
+	writeHeader(out, "speex_webrtc_pool_hits_total", "counter",
+	            "Streams which got a ready effect from the pool.");
+	out += "speex_webrtc_pool_hits_total " + QByteArray::number(pool_.hits()) + "\n";
+	writeHeader(out, "speex_webrtc_pool_misses_total", "counter",
+	            "Streams which had to create their effect.");
+	out += "speex_webrtc_pool_misses_total " + QByteArray::number(pool_.misses()) + "\n";
+	return out;
+}
+
+void MetricsServer::serve(QIODevice* socket)
+{
+	QSharedPointer<QByteArray> request(new QByteArray);
+	connect(socket, &QIODevice::readyRead, this,
+	        [this, socket, request]
+	        {
+		        request->append(socket->readAll());
+		        if (!request->contains("\r\n\r\n") && !request->contains("\n\n"))
+		        {
+			        if (request->size() > maxRequestBytes)
+				        socket->close();
+			        return;
+		        }
+
+		        // Request line: GET <path>[?query] HTTP/1.x
+		        const QList<QByteArray> fields =
+		            request->left(request->indexOf('\n')).simplified().split(' ');
+		        const QByteArray path = fields.value(1).split('?').first();
+
+		        QByteArray status = "200 OK";
+		        QByteArray body;
+		        if (fields.first() != "GET")
+			        status = "405 Method Not Allowed";
+		        else if (path != "/metrics" && path != "/")
+			        status = "404 Not Found";
+		        else
+			        body = render();
+
+		        socket->write("HTTP/1.0 " + status + "\r\n" +
+		                      "Content-Type: text/plain; version=0.0.4\r\n" +
+		                      "Content-Length: " + QByteArray::number(body.size()) + "\r\n" +
+		                      "Connection: close\r\n\r\n" + body);
+		        socket->close();
+	        });
+}
+
+} // namespace SpeexWebRTCTest
@@ -0,0 +1,38 @@
+#ifndef _METRICS_SERVER_H_
+#define _METRICS_SERVER_H_
+
+#include "ControlServer.h"
+
+#include <QLocalServer>
+#include <QTcpServer>
+
+namespace SpeexWebRTCTest {
+
+// Serves the stream metrics in the Prometheus text format to HTTP GET requests, on a local
+// socket (curl --unix-socket) or a TCP port. Every request gets a fresh snapshot of the streams,
+// the audio threads are never locked. The control server and the pool must outlive it.
+class MetricsServer final : public QObject
+{
+	Q_OBJECT
+public:
+	MetricsServer(const ControlServer& control, const EffectPool& pool, QObject* parent = nullptr);
+
+	// A path listens on a local socket, "[host:]port" on TCP with localhost as the default host
+	bool listen(const QString& address);
+	QString errorString() const;
+
+	QByteArray render() const;
+
+private:
+	void serve(QIODevice* socket);
+
+	const ControlServer& control_;
+	const EffectPool& pool_;
+	QLocalServer localServer_;
+	QTcpServer tcpServer_;
+	QString error_;
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _METRICS_SERVER_H_
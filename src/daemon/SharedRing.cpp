@@ -0,0 +1,283 @@
+#include "SharedRing.h"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <ctime>
+
+namespace SpeexWebRTCTest {
+
+namespace {
+const std::uint32_t ringMagic = 0x52575353; // "SSWR"
+
+int futexWait(std::atomic<std::uint32_t>* word, std::uint32_t expected, int timeoutMs)
+{
+	timespec timeout;
+	timeout.tv_sec = timeoutMs / 1000;
+	timeout.tv_nsec = (timeoutMs % 1000) * 1000000L;
+	// Shared (non-private) futex, the word lives in memory mapped by several processes
+	return syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(word), FUTEX_WAIT, expected,
+	               timeoutMs < 0 ? nullptr : &timeout, nullptr, 0);
+}
+
+void futexWake(std::atomic<std::uint32_t>* word)
+{
+	syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr,
+	        nullptr, 0);
+}
+
+std::size_t roundUpToPowerOfTwo(std::size_t value)
+{
+	std::size_t result = 1;
+	while (result < value)
+		result <<= 1;
+	return result;
+}
+} // namespace
+
+// Indices are free-running byte counters; the producer and consumer sides live on separate
+// cache lines so the two processes don't bounce a line on every frame
+struct SharedRing::Header
+{
+	std::uint32_t magic;
+	std::uint32_t capacity;
+	std::atomic<std::uint32_t> hungUp;
+
+	alignas(64) std::atomic<std::uint32_t> writeIndex;
+	std::atomic<std::uint32_t> doorbell;
+	std::atomic<std::uint32_t> waiting; // set while the consumer sleeps, saves the wake syscall
+
+	alignas(64) std::atomic<std::uint32_t> readIndex;
+};
+
+SharedRing::~SharedRing()
+{
+	close();
+}
+
+bool SharedRing::create(const QString& name, std::size_t capacity)
+{
+	close();
+
+	capacity = roundUpToPowerOfTwo(capacity);
+	const std::size_t size = sizeof(Header) + capacity;
+	const QByteArray path = name.toLocal8Bit();
+
+	int fd = shm_open(path.constData(), O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+	if (fd < 0)
+	{
+		error_ = QString("shm_open(%1): %2").arg(name, strerror(errno));
+		return false;
+	}
+
+	if (ftruncate(fd, size) != 0)
+	{
+		error_ = QString("ftruncate(%1): %2").arg(name, strerror(errno));
+		::close(fd);
+		shm_unlink(path.constData());
+		return false;
+	}
+
+	if (!map(fd, size))
+	{
+		shm_unlink(path.constData());
+		return false;
+	}
+
+	header_->magic = ringMagic;
+	header_->capacity = capacity;
+	header_->hungUp = 0;
+	header_->writeIndex = 0;
+	header_->doorbell = 0;
+	header_->waiting = 0;
+	header_->readIndex = 0;
+
+	name_ = name;
+	owner_ = true;
+	return true;
+}
+
+bool SharedRing::attach(const QString& name)
+{
+	close();
+
+	int fd = shm_open(name.toLocal8Bit().constData(), O_RDWR, 0);
+	if (fd < 0)
+	{
+		error_ = QString("shm_open(%1): %2").arg(name, strerror(errno));
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || std::size_t(info.st_size) < sizeof(Header))
+	{
+		error_ = QString("%1 is not a shared ring").arg(name);
+		::close(fd);
+		return false;
+	}
+
+	if (!map(fd, info.st_size))
+		return false;
+
+	if (header_->magic != ringMagic || sizeof(Header) + header_->capacity > mappedSize_)
+	{
+		error_ = QString("%1 is not a shared ring").arg(name);
+		close();
+		return false;
+	}
+
+	name_ = name;
+	owner_ = false;
+	return true;
+}
+
+bool SharedRing::map(int fd, std::size_t size)
+{
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (memory == MAP_FAILED)
+	{
+		error_ = QString("mmap: %1").arg(strerror(errno));
+		return false;
+	}
+
+	header_ = static_cast<Header*>(memory);
+	data_ = static_cast<char*>(memory) + sizeof(Header);
+	mappedSize_ = size;
+	return true;
+}
+
+void SharedRing::close()
+{
+	if (!header_)
+		return;
+
+	munmap(header_, mappedSize_);
+	if (owner_)
+		shm_unlink(name_.toLocal8Bit().constData());
+
+	header_ = nullptr;
+	data_ = nullptr;
+	mappedSize_ = 0;
+	owner_ = false;
+}
+
+bool SharedRing::isOpen() const
+{
+	return header_ != nullptr;
+}
+
+const QString& SharedRing::name() const
+{
+	return name_;
+}
+
+QString SharedRing::errorString() const
+{
+	return error_;
+}
+
+std::size_t SharedRing::readAvailable() const
+{
+	return header_->writeIndex.load(std::memory_order_acquire) -
+	       header_->readIndex.load(std::memory_order_relaxed);
+}
+
+std::size_t SharedRing::writeAvailable() const
+{
+	return header_->capacity - (header_->writeIndex.load(std::memory_order_relaxed) -
+	                            header_->readIndex.load(std::memory_order_acquire));
+}
+
+std::size_t SharedRing::write(const char* data, std::size_t size)
+{
+	const std::uint32_t capacity = header_->capacity;
+	const std::uint32_t writeIndex = header_->writeIndex.load(std::memory_order_relaxed);
+	size = std::min(size, writeAvailable());
+
+	const std::uint32_t offset = writeIndex & (capacity - 1);
+	const std::size_t first = std::min<std::size_t>(size, capacity - offset);
+	memcpy(data_ + offset, data, first);
+	memcpy(data_, data + first, size - first);
+
+	header_->writeIndex.store(writeIndex + size, std::memory_order_release);
+	header_->doorbell.fetch_add(1);
+	if (header_->waiting.load())
+		futexWake(&header_->doorbell);
+	return size;
+}
+
+std::size_t SharedRing::read(char* data, std::size_t size)
+{
+	const std::uint32_t capacity = header_->capacity;
+	const std::uint32_t readIndex = header_->readIndex.load(std::memory_order_relaxed);
+	size = std::min(size, readAvailable());
+
+	const std::uint32_t offset = readIndex & (capacity - 1);
+	const std::size_t first = std::min<std::size_t>(size, capacity - offset);
+	memcpy(data, data_ + offset, first);
+	memcpy(data + first, data_, size - first);
+
+	header_->readIndex.store(readIndex + size, std::memory_order_release);
+	return size;
+}
+
+bool SharedRing::waitForData(std::size_t size, int timeoutMs)
+{
+	// Wake-ups which don't bring enough data, and interrupted waits, don't extend the timeout
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+	while (true)
+	{
+		int remainingMs = -1;
+		if (timeoutMs >= 0)
+		{
+			const auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(
+			    deadline - std::chrono::steady_clock::now());
+			if (remaining.count() <= 0)
+				return readAvailable() >= size;
+			remainingMs = int((remaining.count() + 999) / 1000);
+		}
+
+		const std::uint32_t doorbell = header_->doorbell.load();
+		header_->waiting.store(1);
+		if (readAvailable() >= size)
+		{
+			header_->waiting.store(0);
+			return true;
+		}
+		if (isHungUp())
+		{
+			header_->waiting.store(0);
+			return false;
+		}
+
+		const bool timedOut = futexWait(&header_->doorbell, doorbell, remainingMs) != 0 &&
+		                      errno == ETIMEDOUT;
+		header_->waiting.store(0);
+		if (timedOut)
+			return readAvailable() >= size;
+	}
+}
+
+void SharedRing::hangUp()
+{
+	header_->hungUp.store(1, std::memory_order_release);
+	header_->doorbell.fetch_add(1);
+	futexWake(&header_->doorbell);
+}
+
+bool SharedRing::isHungUp() const
+{
+	return header_->hungUp.load(std::memory_order_acquire) != 0;
+}
+
+} // namespace SpeexWebRTCTest
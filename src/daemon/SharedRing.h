@@ -0,0 +1,65 @@
+#ifndef _SHARED_RING_H_
+#define _SHARED_RING_H_
+
+#include <QString>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace SpeexWebRTCTest {
+
+// Single-producer single-consumer byte ring in POSIX shared memory. Every write rings a futex
+// doorbell stored next to the indices, so the consumer in another process sleeps in the kernel
+// instead of polling, and no file descriptors have to be passed between processes.
+class SharedRing final
+{
+public:
+	SharedRing() = default;
+	~SharedRing();
+
+	SharedRing(const SharedRing&) = delete;
+	SharedRing& operator=(const SharedRing&) = delete;
+
+	// Creates (and owns) a new segment; capacity is rounded up to a power of two
+	bool create(const QString& name, std::size_t capacity);
+	// Maps a segment created by another process
+	bool attach(const QString& name);
+	void close();
+
+	bool isOpen() const;
+	const QString& name() const;
+	QString errorString() const;
+
+	std::size_t readAvailable() const;
+	std::size_t writeAvailable() const;
+
+	// Both return the number of bytes transferred, which is less than size if the ring is
+	// empty or full. Writes wake up the consumer.
+	std::size_t write(const char* data, std::size_t size);
+	std::size_t read(char* data, std::size_t size);
+
+	// Blocks until at least size bytes can be read, the peer hangs up or the timeout expires
+	bool waitForData(std::size_t size, int timeoutMs);
+
+	// Marks the ring as abandoned and wakes up the consumer
+	void hangUp();
+	bool isHungUp() const;
+
+private:
+	struct Header;
+
+	bool map(int fd, std::size_t size);
+
+	QString name_;
+	QString error_;
+	bool owner_ = false;
+
+	Header* header_ = nullptr;
+	char* data_ = nullptr;
+	std::size_t mappedSize_ = 0;
+};
+
+} // namespace SpeexWebRTCTest
+
+#endif // _SHARED_RING_H_
@@ -0,0 +1,108 @@
+// Headless processing daemon. Local clients create streams over the control socket and exchange
+// audio through shared-memory rings (see ControlServer.h and DaemonStream.h).
+
+#include "ControlServer.h"
+#include "MetricsServer.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QLoggingCategory>
+#include <QSocketNotifier>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <csignal>
+
+using namespace SpeexWebRTCTest;
+
+namespace {
+Q_LOGGING_CATEGORY(Daemon, "daemon")
+
+int signalSockets[2];
+
+// Only async-signal-safe calls here, the event loop picks the byte up (Qt self-pipe pattern)
+void notifySignal(int)
+{
+	char byte = 1;
+	(void)::write(signalSockets[0], &byte, sizeof(byte));
+}
+
+// <speex|webrtc>:<rate>:<channels>:<reference channels>, see StreamSpec
+bool prewarm(EffectPool& pool, const QString& spec, int count)
+{
+	try
+	{
+		const StreamSpec stream = StreamSpec::parse(spec.split(':'));
+		pool.reserve(stream.backend, stream.format, stream.referenceFormat, count);
+	}
+	catch (const std::invalid_argument&)
+	{
+		return false;
+	}
+	return true;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Speex/WebRTC audio processing daemon");
+	parser.addHelpOption();
+	QCommandLineOption socketOption("socket", "Control socket path.", "path",
+	                                "/tmp/speex_webrtc_daemon.sock");
+	QCommandLineOption poolOption(
+	    "pool", "Ready effect instances kept for every stream configuration in use.", "count", "0");
+	QCommandLineOption prewarmOption(
+	    "prewarm",
+	    "Stream configuration to keep --pool instances of from the start, can be repeated.",
+	    "backend:rate:channels:reference channels");
+	QCommandLineOption metricsOption(
+	    "metrics",
+	    "Serve Prometheus metrics of the streams on a local socket path or a [host:]port.",
+	    "address");
+	parser.addOptions({socketOption, poolOption, prewarmOption, metricsOption});
+	parser.process(app);
+
+	// Call setup bursts take their effects from the pool instead of initialising them
+	const int poolSize = qMax(parser.value(poolOption).toInt(), 0);
+	EffectPool pool(poolSize);
+	for (const QString& spec : parser.values(prewarmOption))
+	{
+		if (!prewarm(pool, spec, qMax(poolSize, 1)))
+			qWarning(Daemon).noquote() << "Invalid stream configuration" << spec;
+	}
+
+	ControlServer server(pool);
+	if (!server.listen(parser.value(socketOption)))
+	{
+		qCritical(Daemon).noquote() << "Unable to listen on" << parser.value(socketOption) << ":"
+		                            << server.errorString();
+		return 1;
+	}
+
+	MetricsServer metrics(server, pool);
+	if (parser.isSet(metricsOption))
+	{
+		if (!metrics.listen(parser.value(metricsOption)))
+		{
+			qCritical(Daemon).noquote() << "Unable to serve metrics on" << parser.value(metricsOption)
+			                            << ":" << metrics.errorString();
+			return 1;
+		}
+		qInfo(Daemon).noquote() << "Serving metrics on" << parser.value(metricsOption);
+	}
+
+	// Streams unlink their shared memory segments on destruction, so leave the event loop cleanly
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, signalSockets) != 0)
+		qFatal("Unable to create the signal socket pair");
+	QSocketNotifier signalNotifier(signalSockets[1], QSocketNotifier::Read);
+	QObject::connect(&signalNotifier, &QSocketNotifier::activated, &app, &QCoreApplication::quit);
+	std::signal(SIGINT, notifySignal);
+	std::signal(SIGTERM, notifySignal);
+
+	qInfo(Daemon).noquote() << "Listening on" << parser.value(socketOption);
+	return app.exec();
+}
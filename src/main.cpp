@@ -78,8 +78,67 @@ int main(int argc, char* argv[])
 		app.setStyleSheet(ts.readAll());
 	}
 
-	MainWindow window;
+	QCommandLineParser parser;
+	parser.addHelpOption();
+	QCommandLineOption rtPolicyOption("rt-policy",
+	                                  "Scheduling policy of the DSP worker: fifo, rr or default.",
+	                                  "policy", "default");
+	QCommandLineOption rtPriorityOption("rt-priority", "Realtime priority of the DSP worker.",
+	                                    "priority", "0");
+	QCommandLineOption rtCpusOption("rt-cpus", "CPUs to pin the DSP worker to, e.g. 2,3 or 4-7.",
+	                                "cpus");
+	QCommandLineOption rtLockOption("rt-mlock", "Lock and pre-fault the process memory.");
+	QCommandLineOption shadowOption(
+	    "shadow", "Backend to run in shadow of the selected one: speex or webrtc.", "backend");
+	QCommandLineOption floatOption("float", "Capture, process and play back 32-bit float samples.");
+	QCommandLineOption referenceOption(
+	    "reference",
+	    "Echo cancellation reference: full, mono, left, right or a list of monitor channels.",
+	    "channels", "full");
+	QCommandLineOption chainOption(
+	    "chain", "Effects to run around the backend, e.g. highpass,backend,limiter.", "stages");
+	QCommandLineOption latencyOption("measure-latency",
+	                                 "Measure the latency once the audio has settled.");
+	QCommandLineOption traceOption("trace", "Record the session into a trace file for replay.",
+	                               "file");
+	parser.addOptions({rtPolicyOption, rtPriorityOption, rtCpusOption, rtLockOption, shadowOption,
+	                   floatOption, referenceOption, chainOption, latencyOption, traceOption});
+	parser.process(app);
+
+	RealtimeProfile profile;
+	bool ok = true;
+	profile.policy = RealtimeProfile::parsePolicy(parser.value(rtPolicyOption), &ok);
+	if (!ok)
+		qWarning() << "Unknown scheduling policy" << parser.value(rtPolicyOption);
+	profile.priority = parser.value(rtPriorityOption).toInt();
+	profile.cpus = RealtimeProfile::parseCpuList(parser.value(rtCpusOption), &ok);
+	if (!ok)
+		qWarning() << "Invalid CPU list" << parser.value(rtCpusOption);
+	profile.lockMemory = parser.isSet(rtLockOption);
+
+	const ReferenceConditioning reference =
+	    ReferenceConditioning::parse(parser.value(referenceOption), &ok);
+	if (!ok)
+		qWarning() << "Invalid echo cancellation reference" << parser.value(referenceOption);
+
+	MainWindow window(parser.isSet(floatOption) ? QAudioFormat::Float : QAudioFormat::SignedInt);
+	window.setRealtimeProfile(profile);
+	window.setReferenceConditioning(reference);
+	if (parser.isSet(chainOption))
+		window.setEffectChain(parser.value(chainOption).split(',', QString::SkipEmptyParts));
+	if (parser.value(shadowOption) == "speex")
+		window.setShadowBackend(Backend::Speex);
+	else if (parser.value(shadowOption) == "webrtc")
+		window.setShadowBackend(Backend::WebRTC);
+	else if (parser.isSet(shadowOption))
+		qWarning() << "Unknown shadow backend" << parser.value(shadowOption);
+	if (parser.isSet(traceOption))
+		window.setTraceFile(parser.value(traceOption));
 	window.show();
 
+	// Leave the devices and the echo canceller time to settle
+	if (parser.isSet(latencyOption))
+		QTimer::singleShot(3000, &window, &MainWindow::measureLatency);
+
 	return app.exec();
 }
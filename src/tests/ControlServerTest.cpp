@@ -0,0 +1,120 @@
+// Checks the control protocol of the daemon against an in-process ControlServer: requests the
+// effect rejects get an ERROR reply, and the server keeps serving the stream afterwards.
+
+#include "daemon/ControlServer.h"
+
+#include <QCoreApplication>
+#include <QLocalSocket>
+#include <QTemporaryDir>
+#include <QTimer>
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+using namespace SpeexWebRTCTest;
+
+namespace {
+
+const int replyTimeoutMs = 5000;
+
+QByteArray request(QLocalSocket& socket, const QByteArray& command)
+{
+	socket.write(command + "\n");
+	socket.flush();
+	while (!socket.canReadLine())
+	{
+		if (!socket.waitForReadyRead(replyTimeoutMs))
+			return "ERROR no reply from the server";
+	}
+	return socket.readLine().trimmed();
+}
+
+// Blocking client, run on a thread of its own while the server runs the event loop
+int runClient(const QString& path)
+{
+	QLocalSocket socket;
+	socket.connectToServer(path);
+	if (!socket.waitForConnected(replyTimeoutMs))
+	{
+		std::cerr << "Unable to connect: " << socket.errorString().toStdString() << "\n";
+		return 1;
+	}
+
+	const QByteArray createReply = request(socket, "create speex");
+	const QList<QByteArray> created = createReply.split(' ');
+	if (created.first() != "OK")
+	{
+		std::cerr << "create speex: " << createReply.toStdString() << "\n";
+		return 1;
+	}
+	const QByteArray id = created.value(1);
+
+	const struct
+	{
+		QByteArray command;
+		QByteArray expected;
+	} checks[] = {
+	    {QByteArray("set ") + id + " no_such_parameter 1", "ERROR"},
+	    {QByteArray("set ") + id + " pipeline_depth 99", "ERROR"},
+	    {QByteArray("set ") + id, "ERROR"},
+	    {QByteArray("stats ") + id, "OK"},
+	    {QByteArray("set ") + id + " noise_reduction_enabled true", "OK"},
+	    {QByteArray("destroy ") + id, "OK"},
+	};
+
+	int failures = 0;
+	for (const auto& check : checks)
+	{
+		const QByteArray reply = request(socket, check.command);
+		if (!reply.startsWith(check.expected))
+		{
+			std::cerr << check.command.toStdString() << ": expected "
+			          << check.expected.toStdString() << ", got \"" << reply.toStdString()
+			          << "\"\n";
+			++failures;
+		}
+	}
+	return failures == 0 ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QTemporaryDir directory;
+	const QString path = directory.path() + "/control.sock";
+
+	EffectPool pool;
+	ControlServer server(pool);
+	if (!server.listen(path))
+	{
+		std::cerr << "Unable to listen: " << server.errorString().toStdString() << "\n";
+		return 1;
+	}
+
+	std::atomic<bool> done{false};
+	int result = 1;
+	std::thread client(
+	    [&]
+	    {
+		    result = runClient(path);
+		    done = true;
+	    });
+
+	QTimer poll;
+	QObject::connect(&poll, &QTimer::timeout, &app,
+	                 [&]
+	                 {
+		                 if (done)
+			                 app.quit();
+	                 });
+	poll.start(10);
+	app.exec();
+	client.join();
+
+	std::cout << (result == 0 ? "PASS" : "FAIL") << "\n";
+	return result;
+}
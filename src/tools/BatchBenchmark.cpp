@@ -0,0 +1,205 @@
+// Measures how many noise suppression streams one core sustains in realtime, processing the
+// streams one at a time (one SpeexPreprocessState each) and in lockstep batches of several
+// streams (SpeexPreprocessBatch). Also checks that both give the same output.
+
+#include <speex/speex_preprocess.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+const int frameSizeMs = 25;
+const double pi = 3.14159265358979323846;
+
+// Background noise of a different level per stream, with bursts of a modulated tone standing in
+// for speech, so that the noise estimators and the VAD don't all follow the same path
+std::vector<spx_int16_t> makeStream(std::mt19937& random, int sampleRate, int samples, int index)
+{
+	std::normal_distribution<float> noise(0.0f, 150.0f * (1 + index % 4));
+	const double pitch = 2 * pi * (120.0 + 15.0 * (index % 7)) / sampleRate;
+	const int burst = sampleRate / 2;
+
+	std::vector<spx_int16_t> stream(samples);
+	for (int i = 0; i < samples; ++i)
+	{
+		float sample = noise(random);
+		if ((i / burst + index) % 3 == 0)
+			sample += float(5000 * std::sin(pitch * i) * std::sin(pi * (i % burst) / burst));
+		stream[i] = spx_int16_t(std::max(-32767.0f, std::min(32767.0f, sample)));
+	}
+	return stream;
+}
+
+struct Result
+{
+	double usPerStreamFrame = 0;
+	std::vector<std::vector<spx_int16_t>> output;
+};
+
+Result runSingle(const std::vector<std::vector<spx_int16_t>>& input, int frameSize,
+                 int sampleRate)
+{
+	const int streams = int(input.size());
+	const int frames = int(input.front().size()) / frameSize;
+	spx_int32_t on = 1;
+
+	std::vector<SpeexPreprocessState*> states(streams);
+	for (auto& state : states)
+	{
+		state = speex_preprocess_state_init(frameSize, sampleRate);
+		speex_preprocess_ctl(state, SPEEX_PREPROCESS_SET_VAD, &on);
+	}
+
+	Result result;
+	result.output = input;
+
+	QElapsedTimer timer;
+	timer.start();
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		for (int stream = 0; stream < streams; ++stream)
+			speex_preprocess_run(states[stream], result.output[stream].data() + frame * frameSize);
+	}
+	result.usPerStreamFrame = timer.nsecsElapsed() / 1e3 / frames / streams;
+
+	for (auto state : states)
+		speex_preprocess_state_destroy(state);
+	return result;
+}
+
+Result runBatched(const std::vector<std::vector<spx_int16_t>>& input, int frameSize,
+                  int sampleRate, int lanes)
+{
+	const int streams = int(input.size());
+	const int frames = int(input.front().size()) / frameSize;
+	const int batchCount = (streams + lanes - 1) / lanes;
+	spx_int32_t on = 1;
+
+	std::vector<SpeexPreprocessBatch*> batches(batchCount);
+	for (auto& batch : batches)
+	{
+		batch = speex_preprocess_batch_init(lanes, frameSize, sampleRate);
+		speex_preprocess_batch_ctl(batch, SPEEX_PREPROCESS_SET_VAD, &on);
+	}
+
+	Result result;
+	result.output = input;
+
+	// The last batch may be partly empty, its spare lanes process silence
+	std::vector<spx_int16_t> spare(lanes * frameSize);
+	std::vector<spx_int16_t*> frame(lanes);
+	std::vector<int> vad(lanes);
+
+	QElapsedTimer timer;
+	timer.start();
+	for (int index = 0; index < frames; ++index)
+	{
+		for (int batch = 0; batch < batchCount; ++batch)
+		{
+			for (int lane = 0; lane < lanes; ++lane)
+			{
+				const int stream = batch * lanes + lane;
+				frame[lane] = stream < streams
+				                  ? result.output[stream].data() + index * frameSize
+				                  : spare.data() + lane * frameSize;
+			}
+			speex_preprocess_batch_run(batches[batch], frame.data(), vad.data());
+		}
+	}
+	result.usPerStreamFrame = timer.nsecsElapsed() / 1e3 / frames / streams;
+
+	for (auto batch : batches)
+		speex_preprocess_batch_destroy(batch);
+	return result;
+}
+
+int maxDifference(const Result& a, const Result& b)
+{
+	int difference = 0;
+	for (size_t stream = 0; stream < a.output.size(); ++stream)
+	{
+		for (size_t i = 0; i < a.output[stream].size(); ++i)
+			difference = std::max(difference, std::abs(a.output[stream][i] - b.output[stream][i]));
+	}
+	return difference;
+}
+
+QList<int> parseIntList(const QString& value)
+{
+	QList<int> list;
+	for (const QString& item : value.split(','))
+	{
+		bool ok = false;
+		const int number = item.toInt(&ok);
+		if (ok && number > 0)
+			list.append(number);
+	}
+	return list;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription(
+	    "Benchmarks batched against one-at-a-time Speex noise suppression");
+	parser.addHelpOption();
+	QCommandLineOption rateOption("rate", "Sample rate.", "hz", "48000");
+	QCommandLineOption secondsOption("seconds", "Length of every stream.", "s", "10");
+	QCommandLineOption streamsOption("streams", "Number of streams.", "count", "64");
+	QCommandLineOption lanesOption("lanes", "Streams per batch.", "list", "8,16");
+	parser.addOptions({rateOption, secondsOption, streamsOption, lanesOption});
+	parser.process(app);
+
+	const int sampleRate = parser.value(rateOption).toInt();
+	const int seconds = parser.value(secondsOption).toInt();
+	const int streams = parser.value(streamsOption).toInt();
+	const QList<int> lanes = parseIntList(parser.value(lanesOption));
+	if (sampleRate <= 0 || seconds <= 0 || streams <= 0 || lanes.isEmpty())
+		parser.showHelp(1);
+
+	const int frameSize = sampleRate * frameSizeMs / 1000;
+	SpeexPreprocessBatch* probe = speex_preprocess_batch_init(1, frameSize, sampleRate);
+	if (!probe)
+	{
+		std::cerr << "This speexdsp build doesn't support preprocessor batches\n";
+		return 1;
+	}
+	speex_preprocess_batch_destroy(probe);
+
+	std::mt19937 random(1);
+	std::vector<std::vector<spx_int16_t>> input;
+	for (int stream = 0; stream < streams; ++stream)
+		input.push_back(makeStream(random, sampleRate, sampleRate * seconds, stream));
+
+	// Streams per core: the frame period divided by the time one stream frame takes
+	const double frameUs = frameSizeMs * 1000.0;
+	std::cout << "mode lanes us_per_stream_frame streams_per_core speedup max_sample_difference\n";
+	std::cout << std::fixed << std::setprecision(1);
+
+	const Result single = runSingle(input, frameSize, sampleRate);
+	std::cout << "single 1 " << single.usPerStreamFrame << " "
+	          << frameUs / single.usPerStreamFrame << " 1.00 0\n";
+
+	for (int laneCount : lanes)
+	{
+		const Result batched = runBatched(input, frameSize, sampleRate, laneCount);
+		std::cout << "batched " << laneCount << " " << batched.usPerStreamFrame << " "
+		          << frameUs / batched.usPerStreamFrame << " " << std::setprecision(2)
+		          << single.usPerStreamFrame / batched.usPerStreamFrame << std::setprecision(1)
+		          << " " << maxDifference(single, batched) << "\n";
+	}
+	return 0;
+}
@@ -0,0 +1,215 @@
+// Measures what sharing the far-end analysis saves in conference mode: CPU time and heap of each
+// echo canceller leg, with independent cancellers which all analyse the same far end and with
+// cancellers created from a shared SpeexEchoReference (see Conference). Every leg hears the far
+// end through an echo path of its own, and the outputs of both modes are compared sample by
+// sample, as the shared cancellers are expected to be bit-identical. Costs are thread CPU time,
+// the lowest of a few runs, so that other load on the machine doesn't blur the comparison.
+
+#include "StreamMetrics.h"
+
+#include <speex/speex_echo.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace SpeexWebRTCTest;
+
+namespace {
+
+const int frameSizeMs = 25;
+const int runs = 3;
+
+struct Scene
+{
+	int sampleRate = 0;
+	int channels = 0;
+	// Interleaved far end
+	std::vector<spx_int16_t> farEnd;
+	std::vector<std::vector<spx_int16_t>> nearEnds;
+};
+
+Scene makeScene(int sampleRate, int channels, int legs, int seconds)
+{
+	std::mt19937 random(1);
+	Scene scene;
+	scene.sampleRate = sampleRate;
+	scene.channels = channels;
+
+	const int samples = sampleRate * seconds;
+	std::uniform_int_distribution<int> noise(-4000, 4000);
+	scene.farEnd.resize(samples * channels);
+	for (auto& sample : scene.farEnd)
+		sample = spx_int16_t(noise(random));
+
+	// Each leg gets the downmixed far end back with a delay and a level of its own
+	std::uniform_int_distribution<int> delayMs(5, 40);
+	std::uniform_real_distribution<float> level(0.2f, 0.6f);
+	std::uniform_int_distribution<int> local(-100, 100);
+	for (int leg = 0; leg < legs; ++leg)
+	{
+		const int delay = sampleRate * delayMs(random) / 1000;
+		const float gain = level(random) / channels;
+		std::vector<spx_int16_t> nearEnd(samples);
+		for (int i = 0; i < samples; ++i)
+		{
+			float echo = 0;
+			if (i >= delay)
+			{
+				for (int channel = 0; channel < channels; ++channel)
+					echo += scene.farEnd[(i - delay) * channels + channel];
+			}
+			nearEnd[i] = spx_int16_t(gain * echo + local(random));
+		}
+		scene.nearEnds.push_back(nearEnd);
+	}
+	return scene;
+}
+
+std::size_t heapBytes()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+	return mallinfo2().uordblks;
+#elif defined(__GLIBC__)
+	return unsigned(mallinfo().uordblks);
+#else
+	return 0;
+#endif
+}
+
+struct Result
+{
+	double usPerLegFrame = 0;
+	double heapKbPerLeg = 0;
+	std::vector<std::vector<spx_int16_t>> output;
+};
+
+Result run(const Scene& scene, int legs, int tailMs, bool shared)
+{
+	const int frameSize = scene.sampleRate * frameSizeMs / 1000;
+	const int filterLength = scene.sampleRate * tailMs / 1000;
+	const int frames = int(scene.nearEnds.front().size()) / frameSize;
+	spx_int32_t sampleRate = scene.sampleRate;
+
+	// The shared analyser is paid once, whatever the number of legs
+	SpeexEchoReference* reference =
+	    shared ? speex_echo_reference_init(frameSize, filterLength, scene.channels) : nullptr;
+
+	const std::size_t heapBefore = heapBytes();
+	std::vector<SpeexEchoState*> cancellers;
+	for (int leg = 0; leg < legs; ++leg)
+	{
+		SpeexEchoState* echo =
+		    shared ? speex_echo_state_init_shared(frameSize, filterLength, 1, reference)
+		           : speex_echo_state_init_mc(frameSize, filterLength, 1, scene.channels);
+		speex_echo_ctl(echo, SPEEX_ECHO_SET_SAMPLING_RATE, &sampleRate);
+		cancellers.push_back(echo);
+	}
+
+	Result result;
+	result.heapKbPerLeg = double(heapBytes() - heapBefore) / 1024 / legs;
+	result.output.assign(legs, std::vector<spx_int16_t>(frames * frameSize));
+
+	const std::chrono::nanoseconds start = threadCpuTime();
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		const spx_int16_t* farEnd = scene.farEnd.data() + frame * frameSize * scene.channels;
+		if (reference)
+			speex_echo_reference_update(reference, farEnd);
+		for (int leg = 0; leg < legs; ++leg)
+		{
+			speex_echo_cancellation(cancellers[leg],
+			                        scene.nearEnds[leg].data() + frame * frameSize,
+			                        shared ? nullptr : farEnd,
+			                        result.output[leg].data() + frame * frameSize);
+		}
+	}
+	const std::chrono::nanoseconds elapsed = threadCpuTime() - start;
+	result.usPerLegFrame = elapsed.count() / 1e3 / frames / legs;
+
+	for (SpeexEchoState* echo : cancellers)
+		speex_echo_state_destroy(echo);
+	if (reference)
+		speex_echo_reference_destroy(reference);
+	return result;
+}
+
+Result bestOf(const Scene& scene, int legs, int tailMs, bool shared)
+{
+	Result best = run(scene, legs, tailMs, shared);
+	for (int i = 1; i < runs; ++i)
+	{
+		Result result = run(scene, legs, tailMs, shared);
+		if (result.usPerLegFrame < best.usPerLegFrame)
+			best = std::move(result);
+	}
+	return best;
+}
+
+QList<int> parseIntList(const QString& value)
+{
+	QList<int> list;
+	for (const QString& item : value.split(','))
+	{
+		bool ok = false;
+		const int number = item.toInt(&ok);
+		if (ok && number > 0)
+			list.append(number);
+	}
+	return list;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription(
+	    "Benchmarks Speex echo cancellers sharing their far-end analysis against independent ones");
+	parser.addHelpOption();
+	QCommandLineOption rateOption("rate", "Sample rate.", "hz", "48000");
+	QCommandLineOption channelsOption("channels", "Far-end channels.", "count", "2");
+	QCommandLineOption legsOption("legs", "Numbers of legs to compare.", "list", "1,4,16");
+	QCommandLineOption tailOption("tail", "Filter length.", "ms", "250");
+	QCommandLineOption secondsOption("seconds", "Length of the synthetic scene.", "s", "20");
+	parser.addOptions({rateOption, channelsOption, legsOption, tailOption, secondsOption});
+	parser.process(app);
+
+	const int sampleRate = parser.value(rateOption).toInt();
+	const int channels = parser.value(channelsOption).toInt();
+	const QList<int> legCounts = parseIntList(parser.value(legsOption));
+	const int tailMs = parser.value(tailOption).toInt();
+	const int seconds = parser.value(secondsOption).toInt();
+	if (sampleRate <= 0 || channels <= 0 || legCounts.isEmpty() || tailMs <= 0 || seconds <= 0)
+		parser.showHelp(1);
+
+	const int maxLegs = *std::max_element(legCounts.begin(), legCounts.end());
+	std::cout << "Synthesizing " << seconds << " s scene for " << maxLegs << " legs...\n";
+	const Scene scene = makeScene(sampleRate, channels, maxLegs, seconds);
+
+	std::cout << "legs independent_us_per_leg shared_us_per_leg cpu_saved_pct "
+	             "independent_kb_per_leg shared_kb_per_leg identical\n";
+	std::cout << std::fixed << std::setprecision(1);
+	for (int legs : legCounts)
+	{
+		const Result independent = bestOf(scene, legs, tailMs, false);
+		const Result shared = bestOf(scene, legs, tailMs, true);
+		std::cout << legs << " " << independent.usPerLegFrame << " " << shared.usPerLegFrame
+		          << " " << 100 * (1 - shared.usPerLegFrame / independent.usPerLegFrame) << " "
+		          << independent.heapKbPerLeg << " " << shared.heapKbPerLeg << " "
+		          << (independent.output == shared.output ? "yes" : "no") << "\n";
+	}
+	return 0;
+}
@@ -0,0 +1,180 @@
+// Streams WAV files through the processing daemon: the near-end file (and optionally a far-end
+// reference file) goes in through shared memory, the processed audio is written to a WAV file.
+
+#include "WavFileReader.h"
+#include "WavFileWriter.h"
+#include "daemon/SharedRing.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QLocalSocket>
+
+#include <algorithm>
+#include <iostream>
+
+using namespace SpeexWebRTCTest;
+
+namespace {
+
+// Frames written ahead of the processed audio read back
+const int framesInFlight = 4;
+const int replyTimeoutMs = 5000;
+
+QByteArray request(QLocalSocket& socket, const QByteArray& command)
+{
+	socket.write(command + "\n");
+	socket.flush();
+	while (!socket.canReadLine())
+	{
+		if (!socket.waitForReadyRead(replyTimeoutMs))
+			return "ERROR no reply from the daemon";
+	}
+	return socket.readLine().trimmed();
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Streams WAV files through the processing daemon");
+	parser.addHelpOption();
+	parser.addPositionalArgument("near", "Near-end (microphone) WAV file");
+	parser.addPositionalArgument("output", "Processed WAV file");
+	QCommandLineOption socketOption("socket", "Control socket path.", "path",
+	                                "/tmp/speex_webrtc_daemon.sock");
+	QCommandLineOption backendOption("backend", "Processing backend: speex or webrtc.", "backend",
+	                                 "speex");
+	QCommandLineOption farOption("far", "Far-end (reference) WAV file.", "file");
+	QCommandLineOption paramOption("param", "Effect parameter, e.g. echo_cancellation_enabled=true.",
+	                               "name=value");
+	parser.addOptions({socketOption, backendOption, farOption, paramOption});
+	parser.process(app);
+
+	if (parser.positionalArguments().size() != 2)
+		parser.showHelp(1);
+
+	// The daemon streams carry 16-bit samples
+	WavData nearEnd;
+	if (!readWavFile(parser.positionalArguments().at(0), nearEnd) ||
+	    nearEnd.format.sampleSize() != 16)
+	{
+		std::cerr << "Unable to read a 16-bit PCM WAV file from "
+		          << parser.positionalArguments().at(0).toStdString() << "\n";
+		return 1;
+	}
+
+	WavData farEnd;
+	farEnd.format = nearEnd.format;
+	farEnd.format.setChannelCount(2);
+	if (parser.isSet(farOption))
+	{
+		if (!readWavFile(parser.value(farOption), farEnd) || farEnd.format.sampleSize() != 16 ||
+		    farEnd.format.sampleRate() != nearEnd.format.sampleRate())
+		{
+			std::cerr << "The far-end file must be a 16-bit PCM WAV file with the same sample rate\n";
+			return 1;
+		}
+	}
+
+	QLocalSocket socket;
+	socket.connectToServer(parser.value(socketOption));
+	if (!socket.waitForConnected(replyTimeoutMs))
+	{
+		std::cerr << "Unable to connect to the daemon: " << socket.errorString().toStdString()
+		          << "\n";
+		return 1;
+	}
+
+	const QByteArray reply =
+	    request(socket, "create " + parser.value(backendOption).toUtf8() + " " +
+	                        QByteArray::number(nearEnd.format.sampleRate()) + " " +
+	                        QByteArray::number(nearEnd.format.channelCount()) + " " +
+	                        QByteArray::number(farEnd.format.channelCount()));
+	const QList<QByteArray> created = reply.split(' ');
+	if (created.size() != 4 || created.first() != "OK")
+	{
+		std::cerr << "Unable to create a stream: " << reply.toStdString() << "\n";
+		return 1;
+	}
+
+	const QByteArray streamId = created.at(1);
+	const int frameSize = created.at(2).toInt();
+	const QString prefix = QString::fromUtf8(created.at(3));
+
+	for (const QString& param : parser.values(paramOption))
+	{
+		const QStringList nameValue = param.split('=');
+		if (nameValue.size() != 2)
+			continue;
+		const QByteArray result = request(socket, "set " + streamId + " " +
+		                                              nameValue.first().toUtf8() + " " +
+		                                              nameValue.last().toUtf8());
+		if (result != "OK")
+			std::cerr << "Unable to set " << param.toStdString() << ": " << result.toStdString()
+			          << "\n";
+	}
+
+	SharedRing nearRing, farRing, outRing;
+	if (!nearRing.attach(prefix + "-near") || !farRing.attach(prefix + "-far") ||
+	    !outRing.attach(prefix + "-out"))
+	{
+		std::cerr << "Unable to attach the stream rings\n";
+		return 1;
+	}
+
+	const int frameBytes = nearEnd.format.bytesForFrames(frameSize);
+	const int farFrameBytes = farEnd.format.bytesForFrames(frameSize);
+	const int frames = nearEnd.samples.size() / frameBytes;
+	const QByteArray silence(farFrameBytes, 0);
+
+	WavFileWriter writer(parser.positionalArguments().at(1), nearEnd.format);
+	writer.open();
+	QByteArray processed(frameBytes, 0);
+
+	QElapsedTimer timer;
+	timer.start();
+
+	int written = 0;
+	int read = 0;
+	while (read < frames)
+	{
+		while (written < frames && written - read < framesInFlight)
+		{
+			const qint64 farOffset = qint64(written) * farFrameBytes;
+			if (farOffset + farFrameBytes <= farEnd.samples.size())
+				farRing.write(farEnd.samples.constData() + farOffset, farFrameBytes);
+			else
+				farRing.write(silence.constData(), farFrameBytes);
+
+			// The near-end frame goes last, it rings the doorbell the daemon worker sleeps on
+			nearRing.write(nearEnd.samples.constData() + qint64(written) * frameBytes, frameBytes);
+			++written;
+		}
+
+		if (!outRing.waitForData(frameBytes, replyTimeoutMs))
+		{
+			std::cerr << "The daemon stopped delivering processed audio\n";
+			break;
+		}
+		outRing.read(processed.data(), frameBytes);
+		writer.write(processed);
+		++read;
+	}
+
+	const double seconds = timer.nsecsElapsed() / 1e9;
+	writer.close();
+	nearRing.hangUp();
+
+	const double audioSeconds = double(frames) * frameSize / nearEnd.format.sampleRate();
+	std::cout << "Processed " << read << " frames (" << audioSeconds << " s of audio) in "
+	          << seconds << " s, " << (seconds > 0 ? audioSeconds / seconds : 0) << "x realtime\n";
+	std::cout << "Daemon stats (frames underruns overruns tier load%): "
+	          << request(socket, "stats " + streamId).mid(3).toStdString() << "\n";
+
+	request(socket, "destroy " + streamId);
+	return read == frames ? 0 : 1;
+}
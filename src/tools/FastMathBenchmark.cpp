@@ -0,0 +1,187 @@
+// Checks the approximations of the preprocessor gain computation (speexdsp built with
+// SPEEXDSP_FAST_MATH) against the exact path and measures what they save per frame. Two states
+// get the same input frame by frame, one with the approximations turned off, and the output
+// difference is reported as the largest sample difference and as a signal to difference ratio.
+// Exits with 1 when the largest difference exceeds the tolerance.
+
+#include <speex/speex_preprocess.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+const int frameSizeMs = 20;
+const double pi = 3.14159265358979323846;
+
+// White noise at the given level, with bursts of a vibrato tone standing in for speech
+std::vector<spx_int16_t> makeSignal(std::mt19937& random, int sampleRate, int samples,
+                                    float noiseLevel)
+{
+	std::normal_distribution<float> noise(0.0f, noiseLevel);
+	const int burst = sampleRate * 3 / 4;
+
+	std::vector<spx_int16_t> signal(samples);
+	double phase = 0;
+	for (int i = 0; i < samples; ++i)
+	{
+		phase += 2 * pi * 150 * (1 + 0.05 * std::sin(2 * pi * 4 * i / sampleRate)) / sampleRate;
+		float sample = noise(random);
+		if ((i / burst) % 2 == 0)
+		{
+			const double envelope = std::sin(pi * (i % burst) / burst);
+			sample += float(4000 * envelope * (std::sin(phase) + 0.5 * std::sin(3 * phase)));
+		}
+		signal[i] = spx_int16_t(std::max(-32767.0f, std::min(32767.0f, sample)));
+	}
+	return signal;
+}
+
+struct Comparison
+{
+	double exactUs = 0;
+	double fastUs = 0;
+	int maxDifference = 0;
+	double differenceDb = 0;
+	double vadAgreement = 0;
+};
+
+Comparison compare(const std::vector<spx_int16_t>& signal, int frameSize, int sampleRate)
+{
+	spx_int32_t on = 1;
+	spx_int32_t off = 0;
+	SpeexPreprocessState* exact = speex_preprocess_state_init(frameSize, sampleRate);
+	SpeexPreprocessState* fast = speex_preprocess_state_init(frameSize, sampleRate);
+	speex_preprocess_ctl(exact, SPEEX_PREPROCESS_SET_FAST_MATH, &off);
+	speex_preprocess_ctl(exact, SPEEX_PREPROCESS_SET_VAD, &on);
+	speex_preprocess_ctl(fast, SPEEX_PREPROCESS_SET_VAD, &on);
+
+	const int frames = int(signal.size()) / frameSize;
+	std::vector<spx_int16_t> exactFrame(frameSize);
+	std::vector<spx_int16_t> fastFrame(frameSize);
+	qint64 exactNs = 0;
+	qint64 fastNs = 0;
+	double outputEnergy = 0;
+	double differenceEnergy = 0;
+	int agreeing = 0;
+
+	Comparison comparison;
+	QElapsedTimer timer;
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		std::copy(signal.begin() + frame * frameSize, signal.begin() + (frame + 1) * frameSize,
+		          exactFrame.begin());
+		fastFrame = exactFrame;
+
+		// Alternating frame by frame keeps both runs under the same cache and clock conditions
+		timer.start();
+		const int exactVad = speex_preprocess_run(exact, exactFrame.data());
+		exactNs += timer.nsecsElapsed();
+		timer.start();
+		const int fastVad = speex_preprocess_run(fast, fastFrame.data());
+		fastNs += timer.nsecsElapsed();
+
+		agreeing += exactVad == fastVad;
+		for (int i = 0; i < frameSize; ++i)
+		{
+			const int difference = std::abs(exactFrame[i] - fastFrame[i]);
+			comparison.maxDifference = std::max(comparison.maxDifference, difference);
+			outputEnergy += double(exactFrame[i]) * exactFrame[i];
+			differenceEnergy += double(difference) * difference;
+		}
+	}
+
+	comparison.exactUs = exactNs / 1e3 / frames;
+	comparison.fastUs = fastNs / 1e3 / frames;
+	comparison.differenceDb = 10 * std::log10(outputEnergy / std::max(differenceEnergy, 1.0));
+	comparison.vadAgreement = 100.0 * agreeing / frames;
+
+	speex_preprocess_state_destroy(exact);
+	speex_preprocess_state_destroy(fast);
+	return comparison;
+}
+
+QList<int> parseIntList(const QString& value)
+{
+	QList<int> list;
+	for (const QString& item : value.split(','))
+	{
+		bool ok = false;
+		const int number = item.toInt(&ok);
+		if (ok && number > 0)
+			list.append(number);
+	}
+	return list;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription(
+	    "Compares the approximated Speex preprocessor gain computation with the exact one");
+	parser.addHelpOption();
+	QCommandLineOption ratesOption("rates", "Sample rates.", "list", "16000,48000");
+	QCommandLineOption secondsOption("seconds", "Length of the signal.", "s", "30");
+	QCommandLineOption noiseOption("noise", "Noise levels (standard deviation).", "list",
+	                               "30,300,1500");
+	QCommandLineOption toleranceOption("tolerance", "Largest sample difference accepted.",
+	                                   "samples", "16");
+	parser.addOptions({ratesOption, secondsOption, noiseOption, toleranceOption});
+	parser.process(app);
+
+	const QList<int> rates = parseIntList(parser.value(ratesOption));
+	const QList<int> noiseLevels = parseIntList(parser.value(noiseOption));
+	const int seconds = parser.value(secondsOption).toInt();
+	const int tolerance = parser.value(toleranceOption).toInt();
+	if (rates.isEmpty() || noiseLevels.isEmpty() || seconds <= 0 || tolerance < 0)
+		parser.showHelp(1);
+
+	SpeexPreprocessState* probe = speex_preprocess_state_init(160, 8000);
+	spx_int32_t fastMath = 0;
+	speex_preprocess_ctl(probe, SPEEX_PREPROCESS_GET_FAST_MATH, &fastMath);
+	speex_preprocess_state_destroy(probe);
+	if (!fastMath)
+	{
+		std::cerr << "This speexdsp build doesn't have the approximations, configure it with "
+		             "SPEEXDSP_FAST_MATH\n";
+		return 1;
+	}
+
+	std::cout << "rate noise exact_us_per_frame fast_us_per_frame speedup max_sample_difference "
+	             "difference_db vad_agreement_pct\n";
+	std::cout << std::fixed << std::setprecision(1);
+
+	bool withinTolerance = true;
+	std::mt19937 random(1);
+	for (int rate : rates)
+	{
+		const int frameSize = rate * frameSizeMs / 1000;
+		for (int noiseLevel : noiseLevels)
+		{
+			const std::vector<spx_int16_t> signal =
+			    makeSignal(random, rate, rate * seconds, float(noiseLevel));
+			const Comparison comparison = compare(signal, frameSize, rate);
+			withinTolerance = withinTolerance && comparison.maxDifference <= tolerance;
+
+			std::cout << rate << " " << noiseLevel << " " << std::setprecision(2)
+			          << comparison.exactUs << " " << comparison.fastUs << " "
+			          << comparison.exactUs / comparison.fastUs << " "
+			          << comparison.maxDifference << " " << std::setprecision(1)
+			          << comparison.differenceDb << " " << comparison.vadAgreement << "\n";
+		}
+	}
+	return withinTolerance ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+// Checks the latency measurement of AudioProcessor against an in-process loopback with known
+// delays. Simulated devices exchange one period of samples with the processor on a timer: the
+// output device pulls the processed output, delays it by the device output latency and plays it
+// into an echo path, which reaches the capture device and a stereo monitor device with their own
+// input latencies.
+
+#include "AudioProcessor.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QTimer>
+
+#include <deque>
+#include <iostream>
+#include <random>
+
+using namespace SpeexWebRTCTest;
+
+namespace {
+
+QAudioFormat makeFormat(int channels)
+{
+	QAudioFormat format;
+	format.setSampleRate(48000);
+	format.setChannelCount(channels);
+	format.setSampleSize(16);
+	format.setCodec("audio/pcm");
+	format.setByteOrder(QAudioFormat::LittleEndian);
+	format.setSampleType(QAudioFormat::SignedInt);
+	return format;
+}
+
+// Fixed delay line, primed with silence
+class Delay
+{
+public:
+	explicit Delay(int samples) : samples_(samples, 0) {}
+
+	qint16 push(qint16 sample)
+	{
+		samples_.push_back(sample);
+		const qint16 delayed = samples_.front();
+		samples_.pop_front();
+		return delayed;
+	}
+
+private:
+	std::deque<qint16> samples_;
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Measures the latency of a simulated loopback");
+	parser.addHelpOption();
+	QCommandLineOption backendOption("backend", "Backend: speex or webrtc.", "backend", "speex");
+	QCommandLineOption periodOption("period", "Device period.", "ms", "10");
+	QCommandLineOption deviceInOption("device-in", "Capture device latency.", "ms", "20");
+	QCommandLineOption deviceOutOption("device-out", "Output device latency.", "ms", "30");
+	QCommandLineOption monitorInOption("monitor-in", "Monitor device latency.", "ms", "10");
+	QCommandLineOption acousticOption("acoustic", "Echo path delay.", "ms", "2");
+	parser.addOptions({backendOption, periodOption, deviceInOption, deviceOutOption,
+	                   monitorInOption, acousticOption});
+	parser.process(app);
+
+	const QString backend = parser.value(backendOption);
+	const int periodMs = parser.value(periodOption).toInt();
+	if ((backend != "speex" && backend != "webrtc") || periodMs <= 0)
+		parser.showHelp(1);
+
+	const QAudioFormat format = makeFormat(1);
+	const QAudioFormat monitorFormat = makeFormat(2);
+	const auto samplesFor = [&](const QCommandLineOption& option)
+	{ return format.framesForDuration(parser.value(option).toLongLong() * 1000); };
+	const int period = format.framesForDuration(periodMs * 1000);
+
+	// The device latencies are known here, the round trip is split in proportion to them
+	QBuffer monitorDevice;
+	AudioProcessor processor(format, monitorFormat, monitorDevice);
+	processor.switchBackend(backend == "speex" ? Backend::Speex : Backend::WebRTC);
+	processor.setDeviceBufferSizes(format.bytesForFrames(samplesFor(deviceInOption)),
+	                               format.bytesForFrames(samplesFor(deviceOutOption)));
+	processor.open(QIODevice::ReadWrite | QIODevice::Truncate);
+	monitorDevice.open(QIODevice::ReadWrite | QIODevice::Truncate);
+
+	Delay deviceOut(samplesFor(deviceOutOption));
+	Delay acoustic(samplesFor(acousticOption));
+	Delay deviceIn(samplesFor(deviceInOption));
+	Delay monitorIn(samplesFor(monitorInOption));
+
+	std::mt19937 random(1);
+	std::normal_distribution<float> noise(0.0f, 30.0f);
+
+	QVector<qint16> played(period);
+	QVector<qint16> captured(period);
+	QVector<qint16> monitored(period * 2);
+
+	QTimer timer;
+	timer.setTimerType(Qt::PreciseTimer);
+	QObject::connect(&timer, &QTimer::timeout,
+	                 [&]
+	                 {
+		                 // What was played during the last period is delivered at its end
+		                 processor.write(reinterpret_cast<const char*>(captured.constData()),
+		                                 format.bytesForFrames(period));
+		                 monitorDevice.write(reinterpret_cast<const char*>(monitored.constData()),
+		                                     monitorFormat.bytesForFrames(period));
+
+		                 // Whatever the processor doesn't deliver in time is played as silence
+		                 played.fill(0);
+		                 processor.read(reinterpret_cast<char*>(played.data()),
+		                                format.bytesForFrames(period));
+
+		                 for (int i = 0; i < period; ++i)
+		                 {
+			                 const qint16 out = deviceOut.push(played.at(i));
+			                 const float echo = 0.5f * acoustic.push(out) + noise(random);
+			                 captured[i] = deviceIn.push(qint16(qBound(-32767.0f, echo, 32767.0f)));
+			                 monitored[2 * i] = monitored[2 * i + 1] = monitorIn.push(out);
+		                 }
+	                 });
+
+	QObject::connect(&processor, &AudioProcessor::latencyMeasured, &app,
+	                 [&](const LatencyReport& report)
+	                 {
+		                 std::cout << "expected_round_trip "
+		                           << parser.value(deviceOutOption).toDouble() +
+		                                  parser.value(acousticOption).toDouble() +
+		                                  parser.value(deviceInOption).toDouble()
+		                           << "\n";
+		                 if (!report.valid)
+		                 {
+			                 std::cout << "probe not found, confidence " << report.confidence
+			                           << "\n";
+			                 app.exit(1);
+			                 return;
+		                 }
+		                 std::cout << "round_trip " << report.roundTrip << "\n"
+		                           << "monitor_round_trip " << report.monitorRoundTrip << "\n"
+		                           << "confidence " << report.confidence << "\n"
+		                           << "device_in " << report.deviceIn << "\n"
+		                           << "input_queue " << report.inputQueue << "\n"
+		                           << "dsp " << report.dsp << "\n"
+		                           << "output_queue " << report.outputQueue << "\n"
+		                           << "device_out " << report.deviceOut << "\n"
+		                           << "total " << report.total() << "\n";
+		                 app.quit();
+	                 });
+
+	timer.start(periodMs);
+	QTimer::singleShot(1000, [&] { processor.startLatencyMeasurement(); });
+	return app.exec();
+}
@@ -0,0 +1,71 @@
+// Decodes a lossless recording (source.lac, processed.lac) written by AudioProcessor into a WAV
+// file and prints its length, the compression ratio against PCM and the blocks the encoders
+// dropped, which are decoded as silence.
+
+#include "LosslessReader.h"
+#include "WavFileWriter.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFileInfo>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+using namespace SpeexWebRTCTest;
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Decodes a lossless recording into a WAV file");
+	parser.addHelpOption();
+	parser.addPositionalArgument("recording", "Lossless recording (.lac)");
+	parser.addPositionalArgument("output", "WAV file");
+	parser.process(app);
+
+	if (parser.positionalArguments().size() != 2)
+		parser.showHelp(1);
+
+	const QString input = parser.positionalArguments().at(0);
+	LosslessReader reader(input);
+	if (!reader.open())
+	{
+		std::cerr << "Unable to open recording: " << reader.errorString().toStdString() << "\n";
+		return 1;
+	}
+
+	WavFileWriter writer(parser.positionalArguments().at(1), reader.getFormat());
+	if (!writer.open())
+	{
+		std::cerr << "Unable to open output: " << writer.errorString().toStdString() << "\n";
+		return 1;
+	}
+
+	qint64 pcmBytes = 0;
+	QByteArray pcm;
+	while (reader.readBlock(pcm))
+	{
+		writer.write(pcm);
+		pcmBytes += pcm.size();
+	}
+	writer.close();
+
+	if (!reader.errorString().isEmpty())
+	{
+		std::cerr << "Stopped early: " << reader.errorString().toStdString() << "\n";
+		return 1;
+	}
+
+	const QAudioFormat& format = reader.getFormat();
+	const qint64 compressedBytes = QFileInfo(input).size();
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "Frames: " << pcmBytes / format.bytesPerFrame() << " ("
+	          << double(format.durationForBytes(pcmBytes)) / 1e6 << " s)\n";
+	std::cout << "Size: " << compressedBytes << " bytes, " << pcmBytes << " bytes as PCM, ratio "
+	          << double(pcmBytes) / std::max<qint64>(compressedBytes, 1) << "\n";
+	std::cout << "Dropped blocks: " << reader.droppedBlocks() << "\n";
+	return 0;
+}
@@ -0,0 +1,548 @@
+// Searches effect parameters offline. Every combination of a parameter grid, or a random sample of
+// them, is run over a corpus of recordings through AudioEffect::setParameter(), spread over worker
+// threads, and the combinations are ranked by objective metrics:
+// - erle_db: input to output energy ratio over the frames with far-end activity
+// - speech_sdr_db: how much of the output is not a scaled copy of the input, over the frames with
+//   near-end activity and a quiet far end; a proxy for speech distortion which the AGC gain
+//   doesn't affect
+// - level_std_db: standard deviation of the output level over the same frames
+// - us_per_frame: processing cost, measured with all the workers busy
+// The default ranking is by erle_db + speech_sdr_db - level_std_db. Frames are classified by their
+// level above the noise floor of each recording, so single-talk recordings give the cleanest
+// numbers. Recordings are WAV files (a near end with an optional far end) or session traces.
+
+#include "SampleConversion.h"
+#include "SpeexDSP.h"
+#include "TraceReader.h"
+#include "WavFileReader.h"
+#include "WebRTCDSP.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QPair>
+#include <QStringList>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace SpeexWebRTCTest;
+
+namespace {
+
+// Frames this far above the noise floor of a recording count as active
+const double activityDb = 10;
+const double maxSdrDb = 40;
+
+// Near and far end as interleaved float samples
+struct Recording
+{
+	QString name;
+	QAudioFormat nearFormat;
+	QAudioFormat farFormat;
+	std::vector<float> nearEnd;
+	std::vector<float> farEnd;
+
+	// Per frame of the effect
+	int frames = 0;
+	int warmupFrames = 0;
+	std::vector<char> farActive;
+	std::vector<char> nearActive;
+};
+
+struct Parameter
+{
+	QString name;
+	QList<QVariant> values;
+};
+
+struct Result
+{
+	quint64 combination = 0;
+	double erleDb = NAN;
+	double sdrDb = NAN;
+	double levelStdDb = NAN;
+	double usPerFrame = 0;
+	double score = 0;
+};
+
+QAudioFormat makeFloatFormat(int sampleRate, int channels)
+{
+	QAudioFormat format;
+	format.setSampleRate(sampleRate);
+	format.setChannelCount(channels);
+	format.setSampleSize(32);
+	format.setCodec("audio/pcm");
+	format.setByteOrder(QAudioFormat::LittleEndian);
+	format.setSampleType(QAudioFormat::Float);
+	return format;
+}
+
+// Appends 16-bit or float samples as float ones
+bool appendSamples(const QAudioFormat& format, const QByteArray& data, std::vector<float>& to)
+{
+	const std::size_t offset = to.size();
+	if (format.sampleType() == QAudioFormat::Float && format.sampleSize() == 32)
+	{
+		to.resize(offset + data.size() / sizeof(float));
+		memcpy(to.data() + offset, data.constData(), (to.size() - offset) * sizeof(float));
+		return true;
+	}
+	if (format.sampleType() == QAudioFormat::SignedInt && format.sampleSize() == 16)
+	{
+		to.resize(offset + data.size() / sizeof(qint16));
+		int16ToFloat(reinterpret_cast<const qint16*>(data.constData()), to.data() + offset,
+		             int(to.size() - offset));
+		return true;
+	}
+	return false;
+}
+
+bool loadTrace(const QString& fileName, Recording& recording)
+{
+	TraceReader reader(fileName);
+	if (!reader.open())
+		return false;
+
+	recording.nearFormat = reader.getFormat();
+	recording.farFormat = reader.getMonitorFormat();
+	TraceRecord record;
+	while (reader.readEvent(record))
+	{
+		if (record.type != TraceEvent::Frame)
+			continue;
+		if (!appendSamples(recording.nearFormat, record.nearEnd, recording.nearEnd) ||
+		    !appendSamples(recording.farFormat, record.farEnd, recording.farEnd))
+			return false;
+
+		// Far-end underruns leave a gap, filled with silence to stay aligned with the near end
+		const std::size_t frames = recording.nearEnd.size() / recording.nearFormat.channelCount();
+		recording.farEnd.resize(frames * recording.farFormat.channelCount(), 0.0f);
+	}
+	return reader.errorString().isEmpty();
+}
+
+// Either a session trace or near.wav[,far.wav]
+bool loadRecording(const QString& argument, Recording& recording)
+{
+	const QStringList files = argument.split(',');
+	recording.name = QFileInfo(files.first()).fileName();
+	if (files.size() == 1 && !files.first().endsWith(".wav", Qt::CaseInsensitive))
+	{
+		if (!loadTrace(files.first(), recording))
+			return false;
+	}
+	else
+	{
+		WavData nearEnd;
+		if (files.size() > 2 || !readWavFile(files.first(), nearEnd) ||
+		    !appendSamples(nearEnd.format, nearEnd.samples, recording.nearEnd))
+			return false;
+		recording.nearFormat = nearEnd.format;
+
+		WavData farEnd;
+		if (files.size() == 2)
+		{
+			if (!readWavFile(files.last(), farEnd) ||
+			    !appendSamples(farEnd.format, farEnd.samples, recording.farEnd))
+				return false;
+			recording.farFormat = farEnd.format;
+		}
+		else
+			recording.farFormat = makeFloatFormat(nearEnd.format.sampleRate(), 1);
+	}
+
+	if (recording.farFormat.sampleRate() != recording.nearFormat.sampleRate())
+		return false;
+	recording.nearFormat = makeFloatFormat(recording.nearFormat.sampleRate(),
+	                                       recording.nearFormat.channelCount());
+	recording.farFormat = makeFloatFormat(recording.farFormat.sampleRate(),
+	                                      recording.farFormat.channelCount());
+	return !recording.nearEnd.empty();
+}
+
+double energy(const float* samples, int count)
+{
+	double sum = 0;
+	for (int i = 0; i < count; ++i)
+		sum += double(samples[i]) * samples[i];
+	return sum;
+}
+
+double levelDb(double energy, int count)
+{
+	return 10 * std::log10(energy / count + 1e-12);
+}
+
+// Frames more than activityDb above the 10th percentile of the frame levels
+std::vector<char> classifyFrames(const std::vector<float>& samples, int frameSamples, int frames)
+{
+	if (frames == 0)
+		return {};
+
+	std::vector<double> levels(frames);
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		const float* data = samples.data() + std::size_t(frame) * frameSamples;
+		levels[frame] = levelDb(energy(data, frameSamples), frameSamples);
+	}
+
+	std::vector<double> sorted = levels;
+	std::nth_element(sorted.begin(), sorted.begin() + frames / 10, sorted.end());
+	const double threshold = std::max(sorted[frames / 10], -90.0) + activityDb;
+
+	std::vector<char> active(frames);
+	for (int frame = 0; frame < frames; ++frame)
+		active[frame] = levels[frame] > threshold;
+	return active;
+}
+
+void prepare(Recording& recording, int frameSize, double warmupSeconds)
+{
+	const int nearSamples = frameSize * recording.nearFormat.channelCount();
+	const int farSamples = frameSize * recording.farFormat.channelCount();
+	const int nearFrames = int(recording.nearEnd.size()) / nearSamples;
+	// A missing or short far end is silence
+	recording.farEnd.resize(std::size_t(nearFrames) * farSamples, 0.0f);
+
+	recording.frames = nearFrames;
+	recording.warmupFrames = int(warmupSeconds * recording.nearFormat.sampleRate() / frameSize);
+	recording.nearActive = classifyFrames(recording.nearEnd, nearSamples, nearFrames);
+	recording.farActive = classifyFrames(recording.farEnd, farSamples, nearFrames);
+}
+
+std::unique_ptr<AudioEffect> createEffect(const QString& backend, const Recording& recording)
+{
+	if (backend == "webrtc")
+		return std::unique_ptr<AudioEffect>(
+		    new WebRTCDSP(recording.nearFormat, recording.farFormat));
+	return std::unique_ptr<AudioEffect>(new SpeexDSP(recording.nearFormat, recording.farFormat));
+}
+
+// Same value types as the effect parameters: booleans for switches, integers for dials
+QVariant parseValue(const QString& value)
+{
+	if (value == "true" || value == "false")
+		return value == "true";
+
+	bool ok = false;
+	const int intValue = value.toInt(&ok);
+	if (ok)
+		return intValue;
+	return value;
+}
+
+// name=a,b,c or name=first:last[:step]
+bool parseParameter(const QString& argument, Parameter& parameter)
+{
+	const int separator = argument.indexOf('=');
+	if (separator <= 0)
+		return false;
+	parameter.name = argument.left(separator);
+	const QString values = argument.mid(separator + 1);
+
+	const QStringList range = values.split(':');
+	if (range.size() == 2 || range.size() == 3)
+	{
+		bool ok[3] = {true, true, true};
+		const int first = range[0].toInt(&ok[0]);
+		const int last = range[1].toInt(&ok[1]);
+		const int step = range.size() == 3 ? range[2].toInt(&ok[2]) : 1;
+		if (!ok[0] || !ok[1] || !ok[2] || step == 0 || (last - first) / step < 0)
+			return false;
+		for (int value = first; step > 0 ? value <= last : value >= last; value += step)
+			parameter.values.append(value);
+		return true;
+	}
+
+	for (const QString& value : values.split(','))
+		parameter.values.append(parseValue(value));
+	return !parameter.values.isEmpty();
+}
+
+// The combination index counts in a mixed radix, one digit per parameter
+QList<QPair<QString, QVariant>> combinationOf(const QList<Parameter>& parameters, quint64 index)
+{
+	QList<QPair<QString, QVariant>> combination;
+	for (const Parameter& parameter : parameters)
+	{
+		const quint64 count = quint64(parameter.values.size());
+		combination.append(qMakePair(parameter.name, parameter.values.at(int(index % count))));
+		index /= count;
+	}
+	return combination;
+}
+
+Result evaluate(const QString& backend,
+                const QList<QPair<QString, QVariant>>& combination,
+                const std::vector<Recording>& recordings)
+{
+	Result result;
+	double erleSum = 0, sdrSum = 0, levelStdSum = 0;
+	int erleCount = 0, talkCount = 0;
+	qint64 elapsed = 0;
+	qint64 processedFrames = 0;
+
+	QElapsedTimer timer;
+	for (const Recording& recording : recordings)
+	{
+		std::unique_ptr<AudioEffect> effect = createEffect(backend, recording);
+		for (const auto& setting : combination)
+			effect->setParameter(setting.first, setting.second);
+
+		const int frameSize = int(effect->getFrameSize());
+		const int nearSamples = frameSize * recording.nearFormat.channelCount();
+		const int farSamples = frameSize * recording.farFormat.channelCount();
+
+		std::vector<float> frame(nearSamples);
+		SampleSpan<float> mainSpan;
+		mainSpan.data = frame.data();
+		mainSpan.frames = frameSize;
+		mainSpan.channels = recording.nearFormat.channelCount();
+		SampleSpan<const float> auxSpan;
+		auxSpan.frames = frameSize;
+		auxSpan.channels = recording.farFormat.channelCount();
+
+		double farInput = 0, farOutput = 0;
+		double sdr = 0, levelSum = 0, levelSquares = 0;
+		int talkFrames = 0;
+		for (int index = 0; index < recording.frames; ++index)
+		{
+			const float* input = recording.nearEnd.data() + std::size_t(index) * nearSamples;
+			std::copy(input, input + nearSamples, frame.begin());
+			auxSpan.data = recording.farEnd.data() + std::size_t(index) * farSamples;
+
+			timer.start();
+			effect->process(mainSpan, auxSpan);
+			elapsed += timer.nsecsElapsed();
+			++processedFrames;
+
+			// The echo canceller and the noise estimate converge during the warm-up
+			if (index < recording.warmupFrames)
+				continue;
+
+			const double inputEnergy = energy(input, nearSamples);
+			const double outputEnergy = energy(frame.data(), nearSamples);
+			if (recording.farActive[index])
+			{
+				farInput += inputEnergy;
+				farOutput += outputEnergy;
+			}
+			else if (recording.nearActive[index] && inputEnergy > 0)
+			{
+				// Output energy left once the best scaled copy of the input is taken out
+				double correlation = 0;
+				for (int i = 0; i < nearSamples; ++i)
+					correlation += double(input[i]) * frame[i];
+				const double copyEnergy = correlation * correlation / inputEnergy;
+				const double residual = std::max(outputEnergy - copyEnergy, 1e-12);
+				sdr += std::min(maxSdrDb, 10 * std::log10(copyEnergy / residual + 1e-12));
+
+				const double level = levelDb(outputEnergy, nearSamples);
+				levelSum += level;
+				levelSquares += level * level;
+				++talkFrames;
+			}
+		}
+
+		if (farInput > 0)
+		{
+			erleSum += 10 * std::log10(farInput / std::max(farOutput, 1e-12));
+			++erleCount;
+		}
+		if (talkFrames > 0)
+		{
+			const double mean = levelSum / talkFrames;
+			sdrSum += sdr / talkFrames;
+			levelStdSum += std::sqrt(std::max(levelSquares / talkFrames - mean * mean, 0.0));
+			++talkCount;
+		}
+	}
+
+	if (erleCount > 0)
+		result.erleDb = erleSum / erleCount;
+	if (talkCount > 0)
+	{
+		result.sdrDb = sdrSum / talkCount;
+		result.levelStdDb = levelStdSum / talkCount;
+	}
+	result.usPerFrame = processedFrames > 0 ? elapsed / 1e3 / processedFrames : 0;
+	result.score = (std::isnan(result.erleDb) ? 0 : result.erleDb) +
+	               (std::isnan(result.sdrDb) ? 0 : result.sdrDb - result.levelStdDb);
+	return result;
+}
+
+// Larger is better; missing metrics rank last
+double rankValue(const Result& result, const QString& metric)
+{
+	double value = result.score;
+	if (metric == "erle")
+		value = result.erleDb;
+	else if (metric == "sdr")
+		value = result.sdrDb;
+	else if (metric == "stability")
+		value = -result.levelStdDb;
+	else if (metric == "cpu")
+		value = -result.usPerFrame;
+	return std::isnan(value) ? -HUGE_VAL : value;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription(
+	    "Ranks effect parameter combinations by objective metrics over a corpus of recordings");
+	parser.addHelpOption();
+	parser.addPositionalArgument("recordings",
+	                             "Session traces, or near.wav,far.wav pairs (the far end is "
+	                             "optional). 16-bit or float samples.",
+	                             "recordings...");
+	QCommandLineOption backendOption("backend", "Backend: speex or webrtc.", "backend", "speex");
+	QCommandLineOption paramOption(
+	    "param",
+	    "Parameter values to search, name=a,b,c or name=first:last[:step]; may be repeated. A "
+	    "single value applies to every run.",
+	    "name=values");
+	QCommandLineOption randomOption("random", "Runs this many random combinations of the grid.",
+	                                "count");
+	QCommandLineOption seedOption("seed", "Seed of the random search.", "seed", "1");
+	QCommandLineOption jobsOption("jobs", "Worker threads, all the cores by default.", "count");
+	QCommandLineOption warmupOption("warmup", "Seconds of each recording left out of the metrics.",
+	                                "s", "1");
+	QCommandLineOption rankOption("rank", "Ranking: score, erle, sdr, stability or cpu.", "metric",
+	                              "score");
+	QCommandLineOption topOption("top", "Combinations reported, 0 for all.", "count", "20");
+	parser.addOptions({backendOption, paramOption, randomOption, seedOption, jobsOption,
+	                   warmupOption, rankOption, topOption});
+	parser.process(app);
+
+	const QString backend = parser.value(backendOption);
+	const QString rank = parser.value(rankOption);
+	const QStringList metrics = {"score", "erle", "sdr", "stability", "cpu"};
+	if (parser.positionalArguments().isEmpty() || (backend != "speex" && backend != "webrtc") ||
+	    !metrics.contains(rank))
+		parser.showHelp(1);
+
+	QList<Parameter> parameters;
+	quint64 combinations = 1;
+	for (const QString& argument : parser.values(paramOption))
+	{
+		Parameter parameter;
+		if (!parseParameter(argument, parameter))
+		{
+			std::cerr << "Invalid parameter values: " << argument.toStdString() << "\n";
+			return 1;
+		}
+		combinations *= quint64(parameter.values.size());
+		parameters.append(parameter);
+	}
+
+	std::vector<Recording> recordings;
+	for (const QString& argument : parser.positionalArguments())
+	{
+		Recording recording;
+		if (!loadRecording(argument, recording))
+		{
+			std::cerr << "Unable to load " << argument.toStdString()
+			          << ": needs 16-bit or float samples and the same rate at both ends\n";
+			return 1;
+		}
+		recordings.push_back(std::move(recording));
+	}
+
+	// Checks the parameter names and values once before handing them to the workers
+	for (Recording& recording : recordings)
+	{
+		std::unique_ptr<AudioEffect> probe = createEffect(backend, recording);
+		try
+		{
+			for (const Parameter& parameter : parameters)
+			{
+				for (const QVariant& value : parameter.values)
+					probe->setParameter(parameter.name, value);
+			}
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "Rejected by the " << backend.toStdString() << " backend: " << e.what()
+			          << "\n";
+			return 1;
+		}
+		prepare(recording, int(probe->getFrameSize()), parser.value(warmupOption).toDouble());
+	}
+
+	std::vector<quint64> indices;
+	if (parser.isSet(randomOption) && parser.value(randomOption).toULongLong() < combinations)
+	{
+		std::mt19937_64 random(parser.value(seedOption).toULongLong());
+		std::uniform_int_distribution<quint64> pick(0, combinations - 1);
+		std::set<quint64> picked;
+		while (picked.size() < parser.value(randomOption).toULongLong())
+			picked.insert(pick(random));
+		indices.assign(picked.begin(), picked.end());
+	}
+	else
+	{
+		for (quint64 index = 0; index < combinations; ++index)
+			indices.push_back(index);
+	}
+
+	int jobs = parser.value(jobsOption).toInt();
+	if (jobs <= 0)
+		jobs = int(std::max(1u, std::thread::hardware_concurrency()));
+	jobs = int(std::min<std::size_t>(std::size_t(jobs), indices.size()));
+
+	std::cerr << "Running " << indices.size() << " of " << combinations << " combinations over "
+	          << recordings.size() << " recordings on " << jobs << " threads\n";
+
+	std::vector<Result> results(indices.size());
+	std::atomic<std::size_t> next{0};
+	std::vector<std::thread> workers;
+	QElapsedTimer timer;
+	timer.start();
+	for (int job = 0; job < jobs; ++job)
+	{
+		workers.emplace_back([&] {
+			for (std::size_t i = next++; i < indices.size(); i = next++)
+			{
+				results[i] = evaluate(backend, combinationOf(parameters, indices[i]), recordings);
+				results[i].combination = indices[i];
+			}
+		});
+	}
+	for (std::thread& worker : workers)
+		worker.join();
+	std::cerr << "Done in " << timer.elapsed() / 1000.0 << " s\n";
+
+	std::stable_sort(results.begin(), results.end(), [&](const Result& a, const Result& b) {
+		return rankValue(a, rank) > rankValue(b, rank);
+	});
+
+	std::cout << "rank score erle_db speech_sdr_db level_std_db us_per_frame parameters\n";
+	std::cout << std::fixed << std::setprecision(2);
+	const int top = parser.value(topOption).toInt();
+	for (std::size_t i = 0; i < results.size() && (top <= 0 || int(i) < top); ++i)
+	{
+		const Result& result = results[i];
+		std::cout << i + 1 << " " << result.score << " " << result.erleDb << " " << result.sdrDb
+		          << " " << result.levelStdDb << " " << result.usPerFrame;
+		for (const auto& setting : combinationOf(parameters, result.combination))
+			std::cout << " " << setting.first.toStdString() << "="
+			          << setting.second.toString().toStdString();
+		std::cout << "\n";
+	}
+	return 0;
+}
@@ -0,0 +1,253 @@
+// Measures the cost and the echo return loss enhancement of the echo cancellation reference
+// options: full stereo, mono downmix and a single selected channel. The scene is a stereo far end
+// played through two loudspeakers with different synthetic room responses; how much the two
+// channels have in common is set with --correlation.
+//
+// Speex at 48 kHz, 250 ms tail, 70 ms rt60, 20 s scene, on a loaded single-core VM (effect time
+// varies by about 30% from run to run, ERLE doesn't vary):
+//   correlation  reference  effect_us_per_frame  relative_cost  erle_db
+//   0.8          full       3400-4700            1.0            15.3
+//   0.8          mono       1900-2900            0.55-0.78      7.7
+//   0.8          left       2200-3100            0.64-0.83      5.3
+//   0.3          full / mono / left                             22.7 / 3.6 / 2.9
+//   1.0          full / mono / left                             49.2 / 46.5 / 46.5
+// The mixer costs 1-2 us per frame in every mode. Downmixing only pays off when the channels are
+// nearly identical; otherwise it loses 8-20 dB of ERLE to save a fifth to half the time.
+// The WebRTC backend wasn't measured.
+
+#include "ReferenceMixer.h"
+#include "SpeexDSP.h"
+#include "WebRTCDSP.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace SpeexWebRTCTest;
+
+namespace {
+
+struct Scene
+{
+	QAudioFormat nearFormat;
+	QAudioFormat farFormat;
+	std::vector<qint16> farEnd; // stereo, interleaved
+	std::vector<qint16> nearEnd;
+};
+
+std::vector<float> makeImpulseResponse(std::mt19937& random, int sampleRate, double rt60Ms)
+{
+	// Amplitude decays by 60 dB over rt60Ms, normalised to unit energy
+	const int length = int(sampleRate * rt60Ms / 1000);
+	const double decay = std::log(1000.0) / length;
+	std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+
+	std::vector<float> response(length);
+	double energy = 0;
+	for (int i = 0; i < length; ++i)
+	{
+		response[i] = float(std::exp(-decay * i)) * noise(random);
+		energy += response[i] * response[i];
+	}
+	for (float& tap : response)
+		tap = float(tap / std::sqrt(energy));
+	return response;
+}
+
+QAudioFormat makeFormat(int sampleRate, int channels)
+{
+	QAudioFormat format;
+	format.setSampleRate(sampleRate);
+	format.setChannelCount(channels);
+	format.setSampleSize(16);
+	format.setCodec("audio/pcm");
+	format.setByteOrder(QAudioFormat::LittleEndian);
+	format.setSampleType(QAudioFormat::SignedInt);
+	return format;
+}
+
+Scene makeScene(int sampleRate, int seconds, double correlation, double rt60Ms)
+{
+	std::mt19937 random(1);
+	Scene scene;
+	scene.nearFormat = makeFormat(sampleRate, 1);
+	scene.farFormat = makeFormat(sampleRate, 2);
+
+	// Both channels share a common source in the given proportion
+	const int samples = sampleRate * seconds;
+	std::normal_distribution<float> noise(0.0f, 2500.0f);
+	const float own = float(std::sqrt(1 - correlation * correlation));
+	scene.farEnd.resize(2 * samples);
+	for (int i = 0; i < samples; ++i)
+	{
+		const float common = noise(random);
+		for (int channel = 0; channel < 2; ++channel)
+		{
+			const float sample = float(correlation) * common + own * noise(random);
+			scene.farEnd[2 * i + channel] =
+			    qint16(std::max(-32767.0f, std::min(32767.0f, sample)));
+		}
+	}
+
+	const std::vector<float> left = makeImpulseResponse(random, sampleRate, rt60Ms);
+	const std::vector<float> right = makeImpulseResponse(random, sampleRate, rt60Ms);
+
+	scene.nearEnd.resize(samples);
+	for (int i = 0; i < samples; ++i)
+	{
+		float echo = 0;
+		const int taps = std::min(int(left.size()), i + 1);
+		for (int k = 0; k < taps; ++k)
+			echo += left[k] * scene.farEnd[2 * (i - k)] + right[k] * scene.farEnd[2 * (i - k) + 1];
+		scene.nearEnd[i] = qint16(std::max(-32767.0f, std::min(32767.0f, 0.5f * echo)));
+	}
+	return scene;
+}
+
+struct Result
+{
+	int channels = 0;
+	double mixerUsPerFrame = 0;
+	double effectUsPerFrame = 0;
+	// Over the second half of the run, after convergence
+	double erle = 0;
+};
+
+Result run(const Scene& scene, const ReferenceConditioning& conditioning, bool webrtc)
+{
+	const ReferenceMixer mixer(conditioning, scene.farFormat);
+	const QAudioFormat& referenceFormat = mixer.getOutputFormat();
+
+	QScopedPointer<AudioEffect> effect;
+	if (webrtc)
+		effect.reset(new WebRTCDSP(scene.nearFormat, referenceFormat));
+	else
+		effect.reset(new SpeexDSP(scene.nearFormat, referenceFormat));
+	effect->setParameter("echo_cancellation_enabled", true);
+
+	const int frameSize = effect->getFrameSize();
+	const int frames = int(scene.nearEnd.size()) / frameSize;
+
+	std::vector<qint16> nearEnd(frameSize);
+	std::vector<qint16> reference(frameSize * referenceFormat.channelCount());
+
+	SampleSpan<qint16> nearSpan;
+	nearSpan.data = nearEnd.data();
+	nearSpan.frames = frameSize;
+	nearSpan.channels = 1;
+
+	SampleSpan<const qint16> referenceSpan;
+	referenceSpan.data = reference.data();
+	referenceSpan.frames = frameSize;
+	referenceSpan.channels = referenceFormat.channelCount();
+
+	qint64 mixerElapsed = 0;
+	qint64 effectElapsed = 0;
+	double nearEnergy = 0;
+	double outEnergy = 0;
+
+	QElapsedTimer timer;
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		const qint16* captured = scene.nearEnd.data() + frame * frameSize;
+		std::copy(captured, captured + frameSize, nearEnd.begin());
+
+		timer.start();
+		mixer.process(reinterpret_cast<const char*>(scene.farEnd.data() + 2 * frame * frameSize),
+		              reinterpret_cast<char*>(reference.data()), frameSize);
+		mixerElapsed += timer.nsecsElapsed();
+
+		timer.start();
+		effect->process(nearSpan, referenceSpan);
+		effectElapsed += timer.nsecsElapsed();
+
+		if (frame >= frames / 2)
+		{
+			for (int i = 0; i < frameSize; ++i)
+			{
+				nearEnergy += double(captured[i]) * captured[i];
+				outEnergy += double(nearEnd[i]) * nearEnd[i];
+			}
+		}
+	}
+
+	Result result;
+	result.channels = referenceFormat.channelCount();
+	result.mixerUsPerFrame = mixerElapsed / 1e3 / frames;
+	result.effectUsPerFrame = effectElapsed / 1e3 / frames;
+	result.erle = 10 * std::log10(nearEnergy / std::max(outEnergy, 1.0));
+	return result;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription(
+	    "Benchmarks cost and ERLE of the echo cancellation reference options");
+	parser.addHelpOption();
+	QCommandLineOption backendOption("backend", "Backend: speex or webrtc.", "backend", "speex");
+	QCommandLineOption rateOption("rate", "Sample rate.", "hz", "48000");
+	QCommandLineOption secondsOption("seconds", "Length of the synthetic scene.", "s", "20");
+	QCommandLineOption referencesOption("references", "Reference options to compare.", "list",
+	                                    "full mono left");
+	QCommandLineOption correlationOption(
+	    "correlation", "Share of the far-end source common to both channels, 0 to 1.", "ratio",
+	    "0.8");
+	QCommandLineOption rt60Option("rt60", "Room reverberation time.", "ms", "70");
+	parser.addOptions({backendOption, rateOption, secondsOption, referencesOption,
+	                   correlationOption, rt60Option});
+	parser.process(app);
+
+	const QString backend = parser.value(backendOption);
+	const int seconds = parser.value(secondsOption).toInt();
+	const double correlation = parser.value(correlationOption).toDouble();
+	if ((backend != "speex" && backend != "webrtc") || seconds < 2 || correlation < 0 ||
+	    correlation > 1)
+		parser.showHelp(1);
+
+	// Options are separated with spaces, a comma separated list selects channels
+	const QStringList references =
+	    parser.value(referencesOption).split(' ', QString::SkipEmptyParts);
+
+	std::cout << "Synthesizing " << seconds << " s scene...\n";
+	const Scene scene = makeScene(parser.value(rateOption).toInt(), seconds, correlation,
+	                              parser.value(rt60Option).toDouble());
+
+	std::cout << "reference channels mixer_us_per_frame " << backend.toStdString()
+	          << "_us_per_frame relative_cost erle_db\n";
+	std::cout << std::fixed << std::setprecision(1);
+
+	double fullCost = 0;
+	for (const QString& reference : references)
+	{
+		bool ok = false;
+		const ReferenceConditioning conditioning = ReferenceConditioning::parse(reference, &ok);
+		if (!ok)
+		{
+			std::cerr << "Skipping invalid reference " << reference.toStdString() << "\n";
+			continue;
+		}
+
+		const Result result = run(scene, conditioning, backend == "webrtc");
+		const double cost = result.mixerUsPerFrame + result.effectUsPerFrame;
+		if (fullCost == 0)
+			fullCost = cost;
+		std::cout << reference.toStdString() << " " << result.channels << " "
+		          << std::setprecision(2) << result.mixerUsPerFrame << std::setprecision(1) << " "
+		          << result.effectUsPerFrame << " " << std::setprecision(2) << cost / fullCost
+		          << std::setprecision(1) << " " << result.erle << "\n";
+	}
+	return 0;
+}
@@ -0,0 +1,476 @@
+// Soak test of AudioProcessor. Several streams run on free-running virtual devices (see
+// VirtualAudioDevice) for hours of simulated time while their parameters change, their backends
+// are switched and they are torn down and created again at random. Memory, file descriptors and
+// queue depths are sampled at a fixed simulated interval, and the run fails when one of them
+// keeps growing after the warm-up: what is fine for an hour and bad after a day shows up here.
+
+#include "AudioProcessor.h"
+#include "VirtualAudioDevice.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace SpeexWebRTCTest;
+
+namespace {
+
+const double pi = 3.14159265358979323846;
+const int sampleRate = 48000;
+const int echoDelay = sampleRate / 50;
+
+QAudioFormat makeFormat(int channels)
+{
+	QAudioFormat format;
+	format.setSampleRate(sampleRate);
+	format.setChannelCount(channels);
+	format.setSampleSize(16);
+	format.setCodec("audio/pcm");
+	format.setByteOrder(QAudioFormat::LittleEndian);
+	format.setSampleType(QAudioFormat::SignedInt);
+	return format;
+}
+
+// Talk spurts of a modulated tone, half a second on and one off
+float talker(qint64 sample, double pitch, qint64 offset)
+{
+	const qint64 burst = sampleRate / 2;
+	const qint64 position = sample + offset;
+	if ((position / burst) % 3 != 0)
+		return 0;
+	return float(6000 * std::sin(2 * pi * pitch * position / sampleRate) *
+	             std::sin(pi * (position % burst) / burst));
+}
+
+qint16 clip(float sample)
+{
+	return qint16(qBound(-32767.0f, sample, 32767.0f));
+}
+
+struct StreamSettings
+{
+	std::chrono::microseconds period{10000};
+	double captureDriftPpm = 0;
+	double monitorDriftPpm = 0;
+	std::chrono::microseconds maxLead{100000};
+	QString recordingDirectory;
+};
+
+// One processor on its three devices. The monitor buffer lives on the monitor device thread, so
+// restarting a stream means creating it again.
+class Stream
+{
+public:
+	Stream(Backend backend, const StreamSettings& settings, quint32 seed)
+	    : format_(makeFormat(1)), monitorFormat_(makeFormat(2)), group_(settings.maxLead)
+	{
+		processor_.reset(new AudioProcessor(format_, monitorFormat_, monitorBuffer_));
+		processor_->switchBackend(backend);
+		processor_->setRecordingDirectory(settings.recordingDirectory);
+		processor_->open(QIODevice::ReadWrite | QIODevice::Truncate);
+		monitorBuffer_.open(QIODevice::ReadWrite | QIODevice::Truncate);
+
+		VirtualDeviceSettings device;
+		device.period = settings.period;
+		device.freeRunning = true;
+		device.seed = seed;
+
+		device.driftPpm = settings.captureDriftPpm;
+		capture_.reset(new VirtualAudioDevice(VirtualAudioDevice::Direction::Capture, format_,
+		                                      *processor_, device, &group_));
+		device.driftPpm = settings.monitorDriftPpm;
+		monitor_.reset(new VirtualAudioDevice(VirtualAudioDevice::Direction::Capture,
+		                                      monitorFormat_, monitorBuffer_, device, &group_));
+		device.driftPpm = 0;
+		playback_.reset(new VirtualAudioDevice(VirtualAudioDevice::Direction::Playback, format_,
+		                                       *processor_, device, &group_));
+		monitorBuffer_.moveToThread(monitor_.data());
+
+		const qint64 offset = qint64(seed) * sampleRate / 3;
+		std::shared_ptr<std::mt19937> random(new std::mt19937(seed));
+		capture_->setSource(
+		    [this, offset, random](char* data, int frames)
+		    {
+			    std::normal_distribution<float> noise(0.0f, 30.0f);
+			    qint16* samples = reinterpret_cast<qint16*>(data);
+			    for (int i = 0; i < frames; ++i, ++captured_)
+			    {
+				    const float echo =
+				        captured_ >= echoDelay ? talker(captured_ - echoDelay, 180, offset) : 0;
+				    const float nearEnd = talker(captured_, 130, offset + sampleRate);
+				    samples[i] = clip(nearEnd + 0.5f * echo + noise(*random));
+			    }
+		    });
+		monitor_->setSource(
+		    [this, offset](char* data, int frames)
+		    {
+			    qint16* samples = reinterpret_cast<qint16*>(data);
+			    for (int i = 0; i < frames; ++i, ++monitored_)
+				    samples[2 * i] = samples[2 * i + 1] = clip(talker(monitored_, 180, offset));
+		    });
+
+		capture_->start();
+		monitor_->start();
+		playback_->start();
+	}
+
+	// Devices first, they use the processor and the monitor buffer
+	~Stream()
+	{
+		capture_->stop();
+		monitor_->stop();
+		playback_->stop();
+	}
+
+	AudioProcessor& processor()
+	{
+		return *processor_;
+	}
+
+	double seconds() const
+	{
+		return double(capture_->frames()) / sampleRate;
+	}
+
+	// Audio queued between capture and playback, and far end waiting for the near end
+	double latencyMs() const
+	{
+		const QueueDepths depths = processor_->getQueueDepths();
+		return format_.durationForBytes(depths.input + depths.output) / 1000.0;
+	}
+
+	double monitorQueueMs() const
+	{
+		return monitorFormat_.durationForBytes(processor_->getQueueDepths().monitor) / 1000.0;
+	}
+
+private:
+	const QAudioFormat format_;
+	const QAudioFormat monitorFormat_;
+	QBuffer monitorBuffer_;
+	QScopedPointer<AudioProcessor> processor_;
+	VirtualDeviceGroup group_;
+	QScopedPointer<VirtualAudioDevice> capture_;
+	QScopedPointer<VirtualAudioDevice> monitor_;
+	QScopedPointer<VirtualAudioDevice> playback_;
+	qint64 captured_ = 0;
+	qint64 monitored_ = 0;
+};
+
+struct Sample
+{
+	double simulated = 0; // seconds
+	double wall = 0;
+	double rssMb = 0;
+	double heapMb = 0;
+	int fds = 0;
+	// Worst stream
+	double latencyMs = 0;
+	double monitorQueueMs = 0;
+};
+
+double residentMb()
+{
+	QFile status("/proc/self/status");
+	if (!status.open(QIODevice::ReadOnly | QIODevice::Text))
+		return 0;
+	for (const QByteArray& line : status.readAll().split('\n'))
+	{
+		if (line.startsWith("VmRSS:"))
+			return line.simplified().split(' ').value(1).toDouble() / 1024;
+	}
+	return 0;
+}
+
+double heapMb()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+	return mallinfo2().uordblks / 1048576.0;
+#elif defined(__GLIBC__)
+	return unsigned(mallinfo().uordblks) / 1048576.0;
+#else
+	return 0;
+#endif
+}
+
+int openFiles()
+{
+	return QDir("/proc/self/fd").entryList(QDir::AllEntries | QDir::System | QDir::NoDotAndDotDot)
+	    .size();
+}
+
+struct Check
+{
+	const char* name;
+	double limit;
+	std::function<double(const Sample&)> value;
+};
+
+// Sustained growth: the trend over the samples after the warm-up and the difference between the
+// first and the last quarter of them both exceed the limit, so that a single spike or a slow
+// oscillation doesn't fail the run
+bool runCheck(const Check& check, const std::vector<Sample>& samples)
+{
+	const std::size_t count = samples.size();
+	if (count < 4)
+	{
+		std::cout << check.name << " too few samples after the warm-up\n";
+		return true;
+	}
+
+	double meanTime = 0, meanValue = 0;
+	for (const Sample& sample : samples)
+	{
+		meanTime += sample.simulated / count;
+		meanValue += check.value(sample) / count;
+	}
+	double covariance = 0, variance = 0;
+	for (const Sample& sample : samples)
+	{
+		covariance += (sample.simulated - meanTime) * (check.value(sample) - meanValue);
+		variance += (sample.simulated - meanTime) * (sample.simulated - meanTime);
+	}
+	const double window = samples.back().simulated - samples.front().simulated;
+	const double trend = variance > 0 ? covariance / variance * window : 0;
+
+	const std::size_t quarter = count / 4;
+	double first = 0, last = 0;
+	for (std::size_t i = 0; i < quarter; ++i)
+	{
+		first += check.value(samples[i]) / quarter;
+		last += check.value(samples[count - 1 - i]) / quarter;
+	}
+
+	const bool ok = trend <= check.limit || last - first <= check.limit;
+	std::cout << check.name << " first_quarter " << first << " last_quarter " << last << " trend "
+	          << trend << " limit " << check.limit << (ok ? " OK" : " FAIL") << "\n";
+	return ok;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Soak test of the processor on virtual devices");
+	parser.addHelpOption();
+	QCommandLineOption streamsOption("streams", "Streams running at the same time.", "count", "4");
+	QCommandLineOption durationOption("duration", "Simulated time.", "seconds", "3600");
+	QCommandLineOption warmupOption("warmup", "Simulated time before growth is checked.",
+	                                "seconds", "300");
+	QCommandLineOption periodOption("period", "Device period.", "ms", "10");
+	QCommandLineOption actionOption("action-interval",
+	                                "Mean simulated time between random actions of a stream.",
+	                                "seconds", "30");
+	QCommandLineOption sampleOption("sample-interval", "Simulated time between samples.",
+	                                "seconds", "30");
+	QCommandLineOption captureDriftOption("capture-drift", "Capture clock error.", "ppm", "0");
+	QCommandLineOption monitorDriftOption("monitor-drift", "Monitor clock error.", "ppm", "0");
+	QCommandLineOption recordOption("record", "Record the streams into temporary directories.");
+	QCommandLineOption seedOption("seed", "Seed of the random actions.", "seed", "1");
+	QCommandLineOption csvOption("csv", "Write the samples to a CSV file.", "file");
+	QCommandLineOption rssLimitOption("rss-limit", "Allowed resident memory growth.", "MB", "32");
+	QCommandLineOption heapLimitOption("heap-limit", "Allowed heap growth.", "MB", "16");
+	QCommandLineOption fdLimitOption("fd-limit", "Allowed growth of open files.", "count", "4");
+	QCommandLineOption latencyLimitOption(
+	    "latency-limit", "Allowed growth of the queued audio of the worst stream.", "ms", "50");
+	parser.addOptions({streamsOption, durationOption, warmupOption, periodOption, actionOption,
+	                   sampleOption, captureDriftOption, monitorDriftOption, recordOption,
+	                   seedOption, csvOption, rssLimitOption, heapLimitOption, fdLimitOption,
+	                   latencyLimitOption});
+	parser.process(app);
+
+	const int streamCount = parser.value(streamsOption).toInt();
+	const double duration = parser.value(durationOption).toDouble();
+	const double warmup = parser.value(warmupOption).toDouble();
+	const double actionInterval = parser.value(actionOption).toDouble();
+	const double sampleInterval = parser.value(sampleOption).toDouble();
+	if (streamCount <= 0 || duration <= 0 || warmup < 0 || warmup >= duration ||
+	    actionInterval <= 0 || sampleInterval <= 0)
+		parser.showHelp(1);
+
+	StreamSettings settings;
+	settings.period =
+	    std::chrono::microseconds(qRound64(parser.value(periodOption).toDouble() * 1000));
+	settings.captureDriftPpm = parser.value(captureDriftOption).toDouble();
+	settings.monitorDriftPpm = parser.value(monitorDriftOption).toDouble();
+
+	// A restarted stream records into the same directory, so the files don't pile up
+	std::vector<std::unique_ptr<QTemporaryDir>> recordings;
+	std::vector<std::unique_ptr<Stream>> streams;
+	std::vector<double> previousSeconds(streamCount, 0);
+	std::vector<double> nextAction(streamCount, 0);
+	std::vector<Backend> backends(streamCount);
+
+	std::mt19937 random(parser.value(seedOption).toUInt());
+	std::exponential_distribution<double> actionDelay(1 / actionInterval);
+	std::uniform_int_distribution<int> action(0, 9);
+	std::bernoulli_distribution coin;
+	const QStringList params = {"noise_reduction_enabled", "echo_cancellation_enabled",
+	                            "gain_control_enabled"};
+	std::uniform_int_distribution<int> param(0, params.size() - 1);
+
+	quint32 seed = 1;
+	const auto createStream = [&](int index)
+	{
+		StreamSettings streamSettings = settings;
+		if (parser.isSet(recordOption))
+			streamSettings.recordingDirectory = recordings[index]->path();
+		streams[index].reset(new Stream(backends[index], streamSettings, seed++));
+	};
+
+	for (int i = 0; i < streamCount; ++i)
+	{
+		recordings.emplace_back(parser.isSet(recordOption) ? new QTemporaryDir : nullptr);
+		streams.emplace_back();
+		backends[i] = i % 2 ? Backend::WebRTC : Backend::Speex;
+		createStream(i);
+		nextAction[i] = actionDelay(random);
+	}
+
+	quint64 parameterChanges = 0, backendSwitches = 0, restarts = 0;
+	const auto act = [&](int index)
+	{
+		const int choice = action(random);
+		if (choice < 6)
+		{
+			try
+			{
+				streams[index]->processor().setEffectParam(params.at(param(random)), coin(random));
+				++parameterChanges;
+			}
+			catch (const std::invalid_argument&)
+			{
+				// Not a parameter of this backend
+			}
+		}
+		else if (choice < 9)
+		{
+			backends[index] = backends[index] == Backend::Speex ? Backend::WebRTC : Backend::Speex;
+			streams[index]->processor().switchBackend(backends[index]);
+			++backendSwitches;
+		}
+		else
+		{
+			previousSeconds[index] += streams[index]->seconds();
+			streams[index].reset();
+			createStream(index);
+			++restarts;
+		}
+	};
+
+	QFile csvFile(parser.value(csvOption));
+	QTextStream csv(&csvFile);
+	if (parser.isSet(csvOption))
+	{
+		if (!csvFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+		{
+			std::cerr << "Unable to open " << parser.value(csvOption).toStdString() << "\n";
+			return 1;
+		}
+		csv << "simulated_s,wall_s,rss_mb,heap_mb,fds,latency_ms,monitor_queue_ms\n";
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+	std::vector<Sample> samples;
+	double nextSample = sampleInterval;
+	double simulated = 0;
+	while (simulated < duration)
+	{
+		QThread::msleep(20);
+
+		simulated = duration;
+		for (int i = 0; i < streamCount; ++i)
+		{
+			while (previousSeconds[i] + streams[i]->seconds() >= nextAction[i])
+			{
+				act(i);
+				nextAction[i] += actionDelay(random);
+			}
+			simulated = std::min(simulated, previousSeconds[i] + streams[i]->seconds());
+		}
+
+		if (simulated < nextSample)
+			continue;
+		nextSample += sampleInterval;
+
+		Sample sample;
+		sample.simulated = simulated;
+		sample.wall = timer.nsecsElapsed() / 1e9;
+		sample.rssMb = residentMb();
+		sample.heapMb = heapMb();
+		sample.fds = openFiles();
+		for (const auto& stream : streams)
+		{
+			sample.latencyMs = std::max(sample.latencyMs, stream->latencyMs());
+			sample.monitorQueueMs = std::max(sample.monitorQueueMs, stream->monitorQueueMs());
+		}
+		samples.push_back(sample);
+
+		if (csvFile.isOpen())
+		{
+			csv << sample.simulated << "," << sample.wall << "," << sample.rssMb << ","
+			    << sample.heapMb << "," << sample.fds << "," << sample.latencyMs << ","
+			    << sample.monitorQueueMs << "\n";
+			csv.flush();
+		}
+		std::cerr << std::fixed << std::setprecision(1) << "simulated " << sample.simulated
+		          << " s, rss " << sample.rssMb << " MB, heap " << sample.heapMb << " MB, fds "
+		          << sample.fds << ", latency " << sample.latencyMs << " ms, monitor queue "
+		          << sample.monitorQueueMs << " ms\n";
+	}
+	const double wall = timer.nsecsElapsed() / 1e9;
+	streams.clear();
+
+	std::cout << "simulated_seconds " << simulated << "\n"
+	          << "wall_seconds " << wall << "\n"
+	          << "realtime_factor " << simulated * streamCount / wall << "\n"
+	          << "parameter_changes " << parameterChanges << "\n"
+	          << "backend_switches " << backendSwitches << "\n"
+	          << "restarts " << restarts << "\n";
+
+	std::vector<Sample> measured;
+	for (const Sample& sample : samples)
+	{
+		if (sample.simulated >= warmup)
+			measured.push_back(sample);
+	}
+
+	const std::vector<Check> checks = {
+	    {"rss_mb", parser.value(rssLimitOption).toDouble(),
+	     [](const Sample& sample) { return sample.rssMb; }},
+	    {"heap_mb", parser.value(heapLimitOption).toDouble(),
+	     [](const Sample& sample) { return sample.heapMb; }},
+	    {"fds", parser.value(fdLimitOption).toDouble(),
+	     [](const Sample& sample) { return double(sample.fds); }},
+	    {"latency_ms", parser.value(latencyLimitOption).toDouble(),
+	     [](const Sample& sample) { return sample.latencyMs; }},
+	    {"monitor_queue_ms", parser.value(latencyLimitOption).toDouble(),
+	     [](const Sample& sample) { return sample.monitorQueueMs; }},
+	};
+	bool ok = true;
+	for (const Check& check : checks)
+		ok = runCheck(check, measured) && ok;
+	return ok ? 0 : 1;
+}
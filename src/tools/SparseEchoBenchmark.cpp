@@ -0,0 +1,196 @@
+// Measures echo return loss enhancement against CPU time of the Speex echo canceller for several
+// filter lengths and sparse partition decimations. The echo is a synthetic room (white noise far
+// end, exponentially decaying random impulse response) which changes three quarters of the way
+// through the run, so that re-activation of skipped partitions is exercised too.
+
+#include <speex/speex_echo.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+const int frameSizeMs = 25;
+
+struct Scene
+{
+	int sampleRate = 0;
+	std::vector<spx_int16_t> farEnd;
+	std::vector<spx_int16_t> nearEnd;
+};
+
+std::vector<float> makeImpulseResponse(std::mt19937& random, int sampleRate, double rt60Ms)
+{
+	// Amplitude decays by 60 dB over rt60Ms, normalised to unit energy
+	const int length = int(sampleRate * rt60Ms / 1000);
+	const double decay = std::log(1000.0) / length;
+	std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+
+	std::vector<float> response(length);
+	double energy = 0;
+	for (int i = 0; i < length; ++i)
+	{
+		response[i] = float(std::exp(-decay * i)) * noise(random);
+		energy += response[i] * response[i];
+	}
+	for (float& tap : response)
+		tap = float(tap / std::sqrt(energy));
+	return response;
+}
+
+Scene makeScene(int sampleRate, int seconds, double delayMs, double rt60Ms)
+{
+	std::mt19937 random(1);
+	Scene scene;
+	scene.sampleRate = sampleRate;
+
+	const int samples = sampleRate * seconds;
+	std::uniform_int_distribution<int> noise(-4000, 4000);
+	scene.farEnd.resize(samples);
+	for (auto& sample : scene.farEnd)
+		sample = spx_int16_t(noise(random));
+
+	const std::vector<float> before = makeImpulseResponse(random, sampleRate, rt60Ms);
+	const std::vector<float> after = makeImpulseResponse(random, sampleRate, rt60Ms);
+	const int delay = int(sampleRate * delayMs / 1000);
+	const int pathChange = samples * 3 / 4;
+
+	scene.nearEnd.resize(samples);
+	for (int i = 0; i < samples; ++i)
+	{
+		const std::vector<float>& response = i < pathChange ? before : after;
+		float echo = 0;
+		const int taps = std::min(int(response.size()), i - delay + 1);
+		for (int k = 0; k < taps; ++k)
+			echo += response[k] * scene.farEnd[i - delay - k];
+		scene.nearEnd[i] = spx_int16_t(std::max(-32767.0f, std::min(32767.0f, 0.5f * echo)));
+	}
+	return scene;
+}
+
+struct Result
+{
+	double usPerFrame = 0;
+	double activePartitions = 0;
+	// ERLE in dB over each quarter of the run
+	double erle[4] = {};
+};
+
+Result run(const Scene& scene, int tailFrames, int decimation)
+{
+	const int frameSize = scene.sampleRate * frameSizeMs / 1000;
+	const int frames = int(scene.nearEnd.size()) / frameSize;
+
+	SpeexEchoState* echo = speex_echo_state_init(frameSize, frameSize * tailFrames);
+	spx_int32_t sampleRate = scene.sampleRate;
+	speex_echo_ctl(echo, SPEEX_ECHO_SET_SAMPLING_RATE, &sampleRate);
+	speex_echo_ctl(echo, SPEEX_ECHO_SET_SPARSE, &decimation);
+
+	std::vector<spx_int16_t> out(frameSize);
+	double nearEnergy[4] = {};
+	double outEnergy[4] = {};
+	qint64 elapsed = 0;
+	qint64 activeSum = 0;
+
+	QElapsedTimer timer;
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		const spx_int16_t* nearEnd = scene.nearEnd.data() + frame * frameSize;
+
+		timer.start();
+		speex_echo_cancellation(echo, nearEnd, scene.farEnd.data() + frame * frameSize,
+		                        out.data());
+		elapsed += timer.nsecsElapsed();
+
+		spx_int32_t active = 0;
+		speex_echo_ctl(echo, SPEEX_ECHO_GET_ACTIVE_PARTITIONS, &active);
+		activeSum += active;
+
+		const int quarter = frame * 4 / frames;
+		for (int i = 0; i < frameSize; ++i)
+		{
+			nearEnergy[quarter] += double(nearEnd[i]) * nearEnd[i];
+			outEnergy[quarter] += double(out[i]) * out[i];
+		}
+	}
+	speex_echo_state_destroy(echo);
+
+	Result result;
+	result.usPerFrame = elapsed / 1e3 / frames;
+	result.activePartitions = double(activeSum) / frames;
+	for (int quarter = 0; quarter < 4; ++quarter)
+		result.erle[quarter] =
+		    10 * std::log10(nearEnergy[quarter] / std::max(outEnergy[quarter], 1.0));
+	return result;
+}
+
+QList<int> parseIntList(const QString& value)
+{
+	QList<int> list;
+	for (const QString& item : value.split(','))
+	{
+		bool ok = false;
+		const int number = item.toInt(&ok);
+		if (ok && number >= 0)
+			list.append(number);
+	}
+	return list;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription(
+	    "Benchmarks ERLE against CPU time of sparse Speex echo cancellation");
+	parser.addHelpOption();
+	QCommandLineOption rateOption("rate", "Sample rate.", "hz", "48000");
+	QCommandLineOption secondsOption("seconds", "Length of the synthetic scene.", "s", "40");
+	QCommandLineOption tailsOption("tails", "Filter lengths in frames of 25 ms.", "list",
+	                               "10,20,40");
+	QCommandLineOption decimationsOption("decimations", "Sparse decimations, 0 disables.", "list",
+	                                     "0,4,16");
+	QCommandLineOption delayOption("delay", "Echo path delay.", "ms", "10");
+	QCommandLineOption rt60Option("rt60", "Room reverberation time.", "ms", "70");
+	parser.addOptions(
+	    {rateOption, secondsOption, tailsOption, decimationsOption, delayOption, rt60Option});
+	parser.process(app);
+
+	const QList<int> tails = parseIntList(parser.value(tailsOption));
+	const QList<int> decimations = parseIntList(parser.value(decimationsOption));
+	const int seconds = parser.value(secondsOption).toInt();
+	if (tails.isEmpty() || decimations.isEmpty() || seconds < 4)
+		parser.showHelp(1);
+
+	std::cout << "Synthesizing " << seconds << " s scene...\n";
+	const Scene scene = makeScene(parser.value(rateOption).toInt(), seconds,
+	                              parser.value(delayOption).toDouble(),
+	                              parser.value(rt60Option).toDouble());
+
+	// The first quarter is convergence, the last one follows the echo path change
+	std::cout << "tail_ms decimation us_per_frame active_partitions erle_converging_db "
+	             "erle_converged_db erle_after_change_db\n";
+	std::cout << std::fixed << std::setprecision(1);
+	for (int tail : tails)
+	{
+		for (int decimation : decimations)
+		{
+			const Result result = run(scene, tail, decimation);
+			std::cout << tail * frameSizeMs << " " << decimation << " " << result.usPerFrame << " "
+			          << result.activePartitions << "/" << tail << " " << result.erle[0] << " "
+			          << (result.erle[1] + result.erle[2]) / 2 << " " << result.erle[3] << "\n";
+		}
+	}
+	return 0;
+}
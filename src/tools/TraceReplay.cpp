@@ -0,0 +1,183 @@
+// Replays a session trace recorded by AudioProcessor through a fresh processing tract as fast as
+// possible. Writes source.lac and processed.lac into the working directory (lossless_decode turns
+// them into WAV files) and prints timing and queue statistics of the original session. With
+// --shadow, a second backend processes the same frames and its output and per-frame comparison go
+// to shadow.wav and shadow.csv.
+
+#include "AudioProcessor.h"
+#include "TraceReader.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <iostream>
+
+using namespace SpeexWebRTCTest;
+
+namespace {
+
+// Same value types as the recorded parameters: booleans for switches, integers for dials
+QVariant parseValue(const QString& value)
+{
+	if (value == "true" || value == "false")
+		return value == "true";
+
+	bool ok = false;
+	const int intValue = value.toInt(&ok);
+	if (ok)
+		return intValue;
+	return value;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Replays a session trace faster than realtime");
+	parser.addHelpOption();
+	parser.addPositionalArgument("trace", "Session trace file");
+	QCommandLineOption shadowOption("shadow", "Backend to run in shadow: speex or webrtc.",
+	                                "backend");
+	QCommandLineOption shadowParamOption(
+	    "shadow-param", "Effect parameter of the shadow backend only, may be repeated.",
+	    "name=value");
+	QCommandLineOption referenceOption(
+	    "reference",
+	    "Echo cancellation reference: full, mono, left, right or a list of monitor channels.",
+	    "channels", "full");
+	parser.addOptions({shadowOption, shadowParamOption, referenceOption});
+	parser.process(app);
+
+	if (parser.positionalArguments().size() != 1)
+		parser.showHelp(1);
+
+	const QString shadow = parser.value(shadowOption);
+	if (!shadow.isEmpty() && shadow != "speex" && shadow != "webrtc")
+		parser.showHelp(1);
+
+	bool ok = false;
+	const ReferenceConditioning reference =
+	    ReferenceConditioning::parse(parser.value(referenceOption), &ok);
+	if (!ok)
+		parser.showHelp(1);
+
+	TraceReader reader(parser.positionalArguments().first());
+	if (!reader.open())
+	{
+		std::cerr << "Unable to open trace: " << reader.errorString().toStdString() << "\n";
+		return 1;
+	}
+
+	QBuffer monitorDevice;
+	AudioProcessor processor(reader.getFormat(), reader.getMonitorFormat(), monitorDevice);
+	processor.open(QIODevice::ReadWrite | QIODevice::Truncate);
+
+	try
+	{
+		processor.setReferenceConditioning(reference);
+	}
+	catch (const std::invalid_argument& e)
+	{
+		std::cerr << "Invalid echo cancellation reference: " << e.what() << "\n";
+		return 1;
+	}
+
+	const auto applyShadowParams = [&]
+	{
+		for (const QString& param : parser.values(shadowParamOption))
+			processor.setShadowEffectParam(param.section('=', 0, 0),
+			                               parseValue(param.section('=', 1)));
+	};
+
+	// Offline there is no deadline, so the shadow gets every frame
+	if (!shadow.isEmpty())
+	{
+		processor.startShadow(shadow == "speex" ? Backend::Speex : Backend::WebRTC, true);
+		applyShadowParams();
+	}
+
+	quint64 frames = 0;
+	quint64 underruns = 0;
+	quint64 lastTimestamp = 0;
+	qint64 maxInputQueue = 0;
+	qint64 maxMonitorQueue = 0;
+	qint64 maxOutputQueue = 0;
+	quint64 shortReads = 0;
+
+	QElapsedTimer timer;
+	timer.start();
+
+	TraceRecord record;
+	// Frames that don't match the size of the effect and parameters it rejects stop the replay
+	bool replayFailed = false;
+	try
+	{
+		while (reader.readEvent(record))
+		{
+			lastTimestamp = record.timestamp;
+
+			switch (record.type)
+			{
+			case TraceEvent::Backend:
+				if (static_cast<Backend>(record.backend) != processor.getCurrentBackend())
+					processor.switchBackend(static_cast<Backend>(record.backend));
+				break;
+			case TraceEvent::Parameter:
+				processor.setEffectParam(record.name, record.value);
+				// Shadow overrides win over the parameters recorded in the trace
+				applyShadowParams();
+				break;
+			case TraceEvent::CaptureWrite:
+				maxInputQueue = std::max(maxInputQueue, record.inputQueue);
+				break;
+			case TraceEvent::MonitorWrite:
+				maxMonitorQueue = std::max(maxMonitorQueue, record.monitorQueue);
+				break;
+			case TraceEvent::PlaybackRead:
+				if (record.bytes < record.requested)
+					++shortReads;
+				break;
+			case TraceEvent::Frame:
+				++frames;
+				if (record.farEndUnderrun)
+					++underruns;
+				maxOutputQueue = std::max(maxOutputQueue, record.outputQueue);
+				processor.replayFrame(record.nearEnd, record.farEnd);
+				processor.readAll();
+				break;
+			}
+		}
+	}
+	catch (const std::invalid_argument& e)
+	{
+		std::cerr << "Unable to replay the trace: " << e.what() << "\n";
+		replayFailed = true;
+	}
+
+	const qint64 elapsed = timer.nsecsElapsed();
+	processor.close();
+
+	if (!reader.errorString().isEmpty())
+		std::cerr << "Trace error: " << reader.errorString().toStdString() << "\n";
+
+	const double traceSeconds = lastTimestamp / 1e9;
+	const double replaySeconds = elapsed / 1e9;
+
+	std::cout << "Frames:               " << frames << "\n";
+	std::cout << "Far-end underruns:    " << underruns << "\n";
+	std::cout << "Short playback reads: " << shortReads << "\n";
+	std::cout << "Max input queue:      " << maxInputQueue << " bytes\n";
+	std::cout << "Max monitor queue:    " << maxMonitorQueue << " bytes\n";
+	std::cout << "Max output queue:     " << maxOutputQueue << " bytes\n";
+	std::cout << "Session duration:     " << traceSeconds << " s\n";
+	std::cout << "Replay duration:      " << replaySeconds << " s\n";
+	if (replaySeconds > 0)
+		std::cout << "Speed:                " << traceSeconds / replaySeconds << "x realtime\n";
+
+	return reader.errorString().isEmpty() && !replayFailed ? 0 : 1;
+}
@@ -0,0 +1,271 @@
+// Compares the VAD-only engine (SpeexVAD) with the voice activity decisions of the full Speex
+// preprocessor (SpeexDSP in its default configuration), frame by frame, and measures what both
+// cost. The signal is synthetic speech: talk spurts of a glottal pulse train through moving
+// formant resonators, separated by pauses, in white or pink background noise at several SNRs and
+// sample rates.
+
+#include "SpeexDSP.h"
+#include "SpeexVAD.h"
+#include "WebRTCDSP.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace SpeexWebRTCTest;
+
+namespace {
+
+const double pi = 3.14159265358979323846;
+
+QAudioFormat makeFormat(int sampleRate)
+{
+	QAudioFormat format;
+	format.setSampleRate(sampleRate);
+	format.setChannelCount(1);
+	format.setSampleSize(16);
+	format.setCodec("audio/pcm");
+	format.setByteOrder(QAudioFormat::LittleEndian);
+	format.setSampleType(QAudioFormat::SignedInt);
+	return format;
+}
+
+std::vector<float> makeSpeech(std::mt19937& random, int sampleRate, int samples)
+{
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+	std::normal_distribution<double> aspiration(0.0, 0.05);
+
+	std::vector<float> speech(samples);
+	bool talking = false;
+	int left = 0;
+	double pitch = 120;
+	double phase = 0;
+	double envelope = 0;
+	double resonators[3][2] = {};
+	for (int i = 0; i < samples; ++i)
+	{
+		if (--left <= 0)
+		{
+			talking = !talking;
+			left = int(sampleRate * (talking ? 0.3 + 1.2 * uniform(random)
+			                                 : 0.2 + 1.5 * uniform(random)));
+			pitch = 90 + 120 * uniform(random);
+		}
+		envelope += ((talking ? 1 : 0) - envelope) * 0.002;
+
+		double excitation = aspiration(random);
+		phase += pitch * (1 + 0.1 * std::sin(2 * pi * 3 * i / sampleRate)) / sampleRate;
+		if (phase >= 1)
+		{
+			phase -= 1;
+			excitation += 1;
+		}
+
+		const double formants[3] = {700 + 300 * std::sin(2 * pi * 2.0 * i / sampleRate),
+		                            1200 + 500 * std::sin(2 * pi * 1.3 * i / sampleRate), 2500};
+		double sample = 0;
+		for (int k = 0; k < 3; ++k)
+		{
+			const double radius = 0.97;
+			const double w = 2 * pi * formants[k] / sampleRate;
+			const double y = excitation + 2 * radius * std::cos(w) * resonators[k][0] -
+			                 radius * radius * resonators[k][1];
+			resonators[k][1] = resonators[k][0];
+			resonators[k][0] = y;
+			sample += y / (k + 1);
+		}
+		speech[i] = float(sample * envelope);
+	}
+	return speech;
+}
+
+std::vector<float> makeNoise(std::mt19937& random, int samples, bool pink)
+{
+	std::normal_distribution<double> white(0.0, 1.0);
+	std::vector<float> noise(samples);
+	double b0 = 0, b1 = 0, b2 = 0;
+	for (int i = 0; i < samples; ++i)
+	{
+		double sample = white(random);
+		if (pink)
+		{
+			// Three pole approximation of a 1/f spectrum
+			b0 = 0.99765 * b0 + sample * 0.0990460;
+			b1 = 0.96300 * b1 + sample * 0.2965164;
+			b2 = 0.57000 * b2 + sample * 1.0526913;
+			sample = (b0 + b1 + b2 + sample * 0.1848) / 3;
+		}
+		noise[i] = float(sample);
+	}
+	return noise;
+}
+
+std::vector<qint16> mix(const std::vector<float>& speech, const std::vector<float>& noise,
+                        double snr)
+{
+	double speechEnergy = 0;
+	double noiseEnergy = 0;
+	for (size_t i = 0; i < speech.size(); ++i)
+	{
+		speechEnergy += speech[i] * speech[i];
+		noiseEnergy += noise[i] * noise[i];
+	}
+	const double gain = std::sqrt(speechEnergy / noiseEnergy / std::pow(10, snr / 10));
+
+	std::vector<float> mixed(speech.size());
+	float peak = 1e-9f;
+	for (size_t i = 0; i < speech.size(); ++i)
+	{
+		mixed[i] = float(speech[i] + gain * noise[i]);
+		peak = std::max(peak, std::abs(mixed[i]));
+	}
+
+	std::vector<qint16> samples(speech.size());
+	for (size_t i = 0; i < speech.size(); ++i)
+		samples[i] = qint16(mixed[i] / peak * 12000);
+	return samples;
+}
+
+struct Decisions
+{
+	std::vector<bool> voice;
+	double usPerFrame = 0;
+};
+
+Decisions run(AudioEffect& effect, const std::vector<qint16>& signal)
+{
+	const int frameSize = effect.getFrameSize();
+	const int frames = int(signal.size()) / frameSize;
+
+	bool voice = false;
+	QObject::connect(&effect, &AudioEffect::voiceActivityChanged,
+	                 [&](bool active) { voice = active; });
+
+	std::vector<qint16> frame(frameSize);
+	std::vector<qint16> reference(frameSize);
+	SampleSpan<qint16> frameSpan;
+	frameSpan.data = frame.data();
+	frameSpan.frames = frameSize;
+	frameSpan.channels = 1;
+	SampleSpan<const qint16> referenceSpan;
+	referenceSpan.data = reference.data();
+	referenceSpan.frames = frameSize;
+	referenceSpan.channels = 1;
+
+	Decisions decisions;
+	qint64 elapsed = 0;
+	QElapsedTimer timer;
+	for (int index = 0; index < frames; ++index)
+	{
+		std::copy(signal.begin() + index * frameSize, signal.begin() + (index + 1) * frameSize,
+		          frame.begin());
+		timer.start();
+		effect.process(frameSpan, referenceSpan);
+		elapsed += timer.nsecsElapsed();
+		decisions.voice.push_back(voice);
+	}
+	decisions.usPerFrame = elapsed / 1e3 / frames;
+	return decisions;
+}
+
+double agreement(const Decisions& a, const Decisions& b)
+{
+	const size_t frames = std::min(a.voice.size(), b.voice.size());
+	size_t same = 0;
+	for (size_t i = 0; i < frames; ++i)
+		same += a.voice[i] == b.voice[i];
+	return 100.0 * same / frames;
+}
+
+double speechShare(const Decisions& decisions)
+{
+	return 100.0 * std::count(decisions.voice.begin(), decisions.voice.end(), true) /
+	       decisions.voice.size();
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription(
+	    "Benchmarks the VAD-only engine against the decisions of the full preprocessor");
+	parser.addHelpOption();
+	QCommandLineOption rateOption("rate", "Sample rates to compare.", "list", "16000 48000");
+	QCommandLineOption secondsOption("seconds", "Length of the synthetic speech.", "s", "60");
+	QCommandLineOption snrOption("snr", "Speech to noise ratios to compare.", "list",
+	                             "50 40 30 15 5");
+	QCommandLineOption pinkOption("pink", "Pink instead of white background noise.");
+	QCommandLineOption hangoverOption("hangover", "Hangover of the VAD-only engine.", "ms", "0");
+	QCommandLineOption webrtcOption("webrtc", "Also time the VAD of the full WebRTC APM.");
+	parser.addOptions({rateOption, secondsOption, snrOption, pinkOption, hangoverOption,
+	                   webrtcOption});
+	parser.process(app);
+
+	QList<int> sampleRates;
+	for (const QString& value : parser.value(rateOption).split(' ', QString::SkipEmptyParts))
+	{
+		const int sampleRate = value.toInt();
+		if (sampleRate <= 0)
+			parser.showHelp(1);
+		sampleRates.append(sampleRate);
+	}
+	const int seconds = parser.value(secondsOption).toInt();
+	if (sampleRates.isEmpty() || seconds <= 0)
+		parser.showHelp(1);
+
+	std::cout << "rate_hz snr_db agreement_pct speex_speech_pct vad_speech_pct speex_us_per_frame "
+	             "vad_us_per_frame relative_cost";
+	if (parser.isSet(webrtcOption))
+		std::cout << " webrtc_us_per_10ms";
+	std::cout << "\n" << std::fixed << std::setprecision(1);
+
+	for (const int sampleRate : sampleRates)
+	{
+		const QAudioFormat format = makeFormat(sampleRate);
+
+		// Reseeded for every rate, so its signal doesn't depend on the other rates listed
+		std::mt19937 random(1);
+		const int samples = sampleRate * seconds;
+		const std::vector<float> speech = makeSpeech(random, sampleRate, samples);
+		const std::vector<float> noise = makeNoise(random, samples, parser.isSet(pinkOption));
+
+		for (const QString& value : parser.value(snrOption).split(' ', QString::SkipEmptyParts))
+		{
+			const std::vector<qint16> signal = mix(speech, noise, value.toDouble());
+
+			SpeexDSP speex(format, format);
+			const Decisions reference = run(speex, signal);
+
+			SpeexVAD vad(format);
+			vad.setParameter("vad_hangover_ms", parser.value(hangoverOption).toInt());
+			const Decisions decisions = run(vad, signal);
+
+			std::cout << sampleRate << " " << value.toStdString() << " " << std::setprecision(2)
+			          << agreement(reference, decisions) << std::setprecision(1) << " "
+			          << speechShare(reference) << " " << speechShare(decisions) << " "
+			          << reference.usPerFrame << " " << decisions.usPerFrame << " "
+			          << std::setprecision(2) << decisions.usPerFrame / reference.usPerFrame
+			          << std::setprecision(1);
+
+			// The APM runs on 10 ms frames, its decisions don't line up with the 25 ms ones
+			if (parser.isSet(webrtcOption))
+			{
+				WebRTCDSP webrtc(format, format);
+				std::cout << " " << run(webrtc, signal).usPerFrame;
+			}
+			std::cout << "\n";
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,208 @@
+// Drives AudioProcessor through virtual capture, monitor and playback devices (see
+// VirtualAudioDevice), so that its threads and queues can be load-tested without sound hardware.
+// The monitor device plays a far-end signal, the capture device records a near-end talker plus
+// an echo of it; device periods, jitter and clock drift are configurable, and free-running devices
+// push the whole pipeline as fast as it goes.
+
+#include "AudioProcessor.h"
+#include "VirtualAudioDevice.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+
+#include <cmath>
+#include <iostream>
+#include <random>
+
+using namespace SpeexWebRTCTest;
+
+namespace {
+
+const double pi = 3.14159265358979323846;
+const int sampleRate = 48000;
+// Echo path delay and gain from the monitor to the capture device
+const int echoDelay = sampleRate / 50;
+const float echoGain = 0.5f;
+
+QAudioFormat makeFormat(int channels)
+{
+	QAudioFormat format;
+	format.setSampleRate(sampleRate);
+	format.setChannelCount(channels);
+	format.setSampleSize(16);
+	format.setCodec("audio/pcm");
+	format.setByteOrder(QAudioFormat::LittleEndian);
+	format.setSampleType(QAudioFormat::SignedInt);
+	return format;
+}
+
+// Talk spurts of a modulated tone, half a second on and one off, phase-shifted per talker
+float talker(qint64 sample, double pitch, qint64 offset)
+{
+	const qint64 burst = sampleRate / 2;
+	const qint64 position = sample + offset;
+	if ((position / burst) % 3 != 0)
+		return 0;
+	return float(6000 * std::sin(2 * pi * pitch * position / sampleRate) *
+	             std::sin(pi * (position % burst) / burst));
+}
+
+float farEnd(qint64 sample)
+{
+	return talker(sample, 180, 0);
+}
+
+qint16 clip(float sample)
+{
+	return qint16(qBound(-32767.0f, sample, 32767.0f));
+}
+
+VirtualDeviceSettings deviceSettings(const QCommandLineParser& parser,
+                                     const QCommandLineOption& periodOption,
+                                     const QCommandLineOption& jitterOption,
+                                     const QCommandLineOption& driftOption,
+                                     bool freeRunning,
+                                     quint32 seed)
+{
+	const auto microseconds = [&](const QCommandLineOption& option)
+	{ return std::chrono::microseconds(qRound64(parser.value(option).toDouble() * 1000)); };
+
+	VirtualDeviceSettings settings;
+	settings.period = microseconds(periodOption);
+	settings.jitter = microseconds(jitterOption);
+	settings.driftPpm = parser.value(driftOption).toDouble();
+	settings.freeRunning = freeRunning;
+	settings.seed = seed;
+	return settings;
+}
+
+void report(const char* name, const VirtualAudioDevice& device)
+{
+	std::cout << name << "_callbacks " << device.callbacks() << "\n"
+	          << name << "_short_transfers " << device.shortTransfers() << "\n"
+	          << name << "_max_lateness_us " << device.maxLateness().count() << "\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Runs AudioProcessor on virtual audio devices");
+	parser.addHelpOption();
+	QCommandLineOption backendOption("backend", "Backend: speex or webrtc.", "backend", "speex");
+	QCommandLineOption durationOption("duration", "Audio to capture.", "seconds", "10");
+	QCommandLineOption periodOption("period", "Capture and monitor device period.", "ms", "10");
+	QCommandLineOption playbackPeriodOption("playback-period", "Playback device period.", "ms",
+	                                        "10");
+	QCommandLineOption jitterOption("jitter", "Maximum lateness of a device callback.", "ms", "0");
+	QCommandLineOption captureDriftOption("capture-drift", "Capture clock error.", "ppm", "0");
+	QCommandLineOption monitorDriftOption("monitor-drift", "Monitor clock error.", "ppm", "0");
+	QCommandLineOption playbackDriftOption("playback-drift", "Playback clock error.", "ppm", "0");
+	QCommandLineOption freeRunningOption("free-running",
+	                                     "Run the devices as fast as the processor goes.");
+	QCommandLineOption maxLeadOption("max-lead",
+	                                 "Audio a free-running device may get ahead of the others.",
+	                                 "ms", "100");
+	parser.addOptions({backendOption, durationOption, periodOption, playbackPeriodOption,
+	                   jitterOption, captureDriftOption, monitorDriftOption, playbackDriftOption,
+	                   freeRunningOption, maxLeadOption});
+	parser.process(app);
+
+	const QString backend = parser.value(backendOption);
+	const double duration = parser.value(durationOption).toDouble();
+	if ((backend != "speex" && backend != "webrtc") || duration <= 0)
+		parser.showHelp(1);
+	const bool freeRunning = parser.isSet(freeRunningOption);
+
+	const QAudioFormat format = makeFormat(1);
+	const QAudioFormat monitorFormat = makeFormat(2);
+
+	QBuffer monitorBuffer;
+	AudioProcessor processor(format, monitorFormat, monitorBuffer);
+	processor.switchBackend(backend == "speex" ? Backend::Speex : Backend::WebRTC);
+	processor.open(QIODevice::ReadWrite | QIODevice::Truncate);
+	monitorBuffer.open(QIODevice::ReadWrite | QIODevice::Truncate);
+
+	VirtualDeviceGroup group(std::chrono::milliseconds(parser.value(maxLeadOption).toInt()));
+	QScopedPointer<VirtualAudioDevice> capture, monitor, playback;
+	try
+	{
+		capture.reset(new VirtualAudioDevice(
+		    VirtualAudioDevice::Direction::Capture, format, processor,
+		    deviceSettings(parser, periodOption, jitterOption, captureDriftOption, freeRunning, 1),
+		    &group));
+		monitor.reset(new VirtualAudioDevice(
+		    VirtualAudioDevice::Direction::Capture, monitorFormat, monitorBuffer,
+		    deviceSettings(parser, periodOption, jitterOption, monitorDriftOption, freeRunning, 2),
+		    &group));
+		playback.reset(new VirtualAudioDevice(VirtualAudioDevice::Direction::Playback, format,
+		                                      processor,
+		                                      deviceSettings(parser, playbackPeriodOption,
+		                                                     jitterOption, playbackDriftOption,
+		                                                     freeRunning, 3),
+		                                      &group));
+	}
+	catch (const std::invalid_argument& e)
+	{
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+
+	// The processor reads the monitor buffer on its readyRead(), on the monitor device thread
+	monitorBuffer.moveToThread(monitor.data());
+
+	// The signals are functions of the sample index, so each device makes its own
+	std::mt19937 random(1);
+	std::normal_distribution<float> noise(0.0f, 30.0f);
+	qint64 captured = 0;
+	capture->setSource(
+	    [&](char* data, int frames)
+	    {
+		    qint16* samples = reinterpret_cast<qint16*>(data);
+		    for (int i = 0; i < frames; ++i, ++captured)
+		    {
+			    const float echo = captured >= echoDelay ? farEnd(captured - echoDelay) : 0;
+			    const float nearEnd = talker(captured, 130, sampleRate);
+			    samples[i] = clip(nearEnd + echoGain * echo + noise(random));
+		    }
+	    });
+	qint64 monitored = 0;
+	monitor->setSource(
+	    [&](char* data, int frames)
+	    {
+		    qint16* samples = reinterpret_cast<qint16*>(data);
+		    for (int i = 0; i < frames; ++i, ++monitored)
+			    samples[2 * i] = samples[2 * i + 1] = clip(farEnd(monitored));
+	    });
+
+	QElapsedTimer timer;
+	timer.start();
+	capture->start(QThread::HighPriority);
+	monitor->start(QThread::HighPriority);
+	playback->start(QThread::HighPriority);
+
+	const quint64 targetFrames = quint64(duration * sampleRate);
+	while (capture->frames() < targetFrames)
+		QThread::msleep(10);
+
+	capture->stop();
+	monitor->stop();
+	playback->stop();
+	const double seconds = timer.nsecsElapsed() / 1e9;
+
+	report("capture", *capture);
+	report("monitor", *monitor);
+	report("playback", *playback);
+	std::cout << "audio_seconds " << double(capture->frames()) / sampleRate << "\n"
+	          << "wall_seconds " << seconds << "\n"
+	          << "realtime_factor " << double(capture->frames()) / sampleRate / seconds << "\n"
+	          << "output_queue_bytes " << processor.bytesAvailable() << "\n"
+	          << "processing_load " << processor.getProcessingLoad() << "\n"
+	          << "quality_tier " << qualityTierName(processor.getQualityTier()).toStdString()
+	          << "\n";
+	return 0;
+}